@@ -102,6 +102,10 @@ static GList *mem_block_info_list = NULL;
 static int total_blocks = 0;
 static size_t total_bytes = 0;
 
+/* Guards the database and running totals, as blocks may be allocated
+ * and freed from worker threads as well as the main thread */
+static GMutex mem_db_mutex;
+
 
 void
 debug_init( void )
@@ -162,6 +166,8 @@ fecundity_report( int top_n_lines )
         int i;
 	boolean new_source_line;
 
+	g_mutex_lock( &mem_db_mutex );
+
 	/* Sort the memory database by source code line locations, so
 	 * that the same lines of code are grouped together */
 	mem_block_info_list = g_list_sort( mem_block_info_list, (GCompareFunc)mbi_origin_compare );
@@ -204,6 +210,8 @@ fecundity_report( int top_n_lines )
 		mbi_llink = mbi_llink->next;
 	}
 
+	g_mutex_unlock( &mem_db_mutex );
+
 	/* Sort the source code locations by fecundity */
 	srci_list = g_list_sort( srci_list, (GCompareFunc)source_fecundity_compare );
 
@@ -238,10 +246,17 @@ debug_show_mem_totals( void )
 {
 	static int last_total_blocks = 0;
 	static size_t last_total_bytes = 0;
+	int blocks;
+	size_t bytes;
 
-	g_message( "Allocated: %d blocks, %u bytes (%+d, %+d)", total_blocks, total_bytes, total_blocks - last_total_blocks, (int)total_bytes - (int)last_total_bytes );
-	last_total_blocks = total_blocks;
-	last_total_bytes = total_bytes;
+	g_mutex_lock( &mem_db_mutex );
+	blocks = total_blocks;
+	bytes = total_bytes;
+	g_mutex_unlock( &mem_db_mutex );
+
+	g_message( "Allocated: %d blocks, %u bytes (%+d, %+d)", blocks, bytes, blocks - last_total_blocks, (int)bytes - (int)last_total_bytes );
+	last_total_blocks = blocks;
+	last_total_bytes = bytes;
 }
 
 
@@ -278,12 +293,16 @@ new_block_info( void *block, size_t size, const char *type, const char *src_file
 	mbi->alloc_time = time( NULL );
 	mbi->resize_count = 0;
 
+	g_mutex_lock( &mem_db_mutex );
+
 	/* Add to database */
 	mem_block_info_list = g_list_prepend( mem_block_info_list, mbi );
 
 	/* Add to running totals */
 	total_bytes += size;
 	++total_blocks;
+
+	g_mutex_unlock( &mem_db_mutex );
 }
 
 
@@ -291,6 +310,8 @@ new_block_info( void *block, size_t size, const char *type, const char *src_file
 static void
 update_block_info( struct MemBlockInfo *mbi, void *block, size_t size )
 {
+	g_mutex_lock( &mem_db_mutex );
+
         /* Adjust running byte total */
 	total_bytes += size;
 	total_bytes -= mbi->size;
@@ -299,6 +320,8 @@ update_block_info( struct MemBlockInfo *mbi, void *block, size_t size )
 	mbi->block = block;
 	mbi->size = size;
 	++mbi->resize_count;
+
+	g_mutex_unlock( &mem_db_mutex );
 }
 
 
@@ -308,9 +331,11 @@ update_block_info( struct MemBlockInfo *mbi, void *block, size_t size )
 static struct MemBlockInfo *
 find_block_info( const void *block, boolean remove )
 {
-	struct MemBlockInfo *mbi;
+	struct MemBlockInfo *mbi = NULL;
 	GList *mbi_llink;
 
+	g_mutex_lock( &mem_db_mutex );
+
 	mbi_llink = mem_block_info_list;
 	while (mbi_llink != NULL) {
 		mbi = (struct MemBlockInfo *)mbi_llink->data;
@@ -319,12 +344,15 @@ find_block_info( const void *block, boolean remove )
 				mem_block_info_list = g_list_remove_link( mem_block_info_list, mbi_llink );
 				g_list_free_1( mbi_llink );
 			}
-			return mbi;
+			break;
 		}
+		mbi = NULL;
 		mbi_llink = mbi_llink->next;
 	}
 
-	return NULL;
+	g_mutex_unlock( &mem_db_mutex );
+
+	return mbi;
 }
 
 
@@ -341,8 +369,10 @@ destroy_block_info( struct MemBlockInfo *mbi )
 		((byte *)mbi->block)[i] = 0;
 
 	/* Subtract from running totals */
+	g_mutex_lock( &mem_db_mutex );
 	total_bytes -= mbi->size;
 	--total_blocks;
+	g_mutex_unlock( &mem_db_mutex );
 
 	free( mbi );
 }
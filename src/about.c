@@ -32,6 +32,8 @@
 #include "geometry.h"
 #include "ogl.h"
 #include "tmaptext.h"
+#include "vbuf.h"
+#include "xform.h"
 
 
 /* Interval normalization macro */
@@ -42,7 +44,7 @@
 static double about_part;
 
 /* Display list for "fsv" geometry */
-static GLuint fsv_dlist = NULL_DLIST;
+static unsigned int fsv_dlist = NULL_DLIST;
 
 /* TRUE while giving About presentation */
 static boolean about_active = FALSE;
@@ -52,68 +54,60 @@ static boolean about_active = FALSE;
 static void
 draw_fsv( void )
 {
+	XformMatrix prev_projection, prev_view, m;
 	double dy, p, q;
 
 	if (about_part < 0.5) {
 		/* Set up a black, all-encompassing fog */
-		glEnable( GL_FOG );
-		glFogi( GL_FOG_MODE, GL_LINEAR );
-		glFogf( GL_FOG_START, 200.0 );
-		glFogf( GL_FOG_END, 1800.0 );
+		ogl_enable( GL_FOG );
+		ogl_fog_linear( 200.0, 1800.0 );
 	}
 
 	/* Set up projection matrix */
-	glMatrixMode( GL_PROJECTION );
-	glPushMatrix( );
-	glLoadIdentity( );
+	xform_copy( prev_projection, xform_projection( ) );
 	dy = 80.0 / ogl_aspect_ratio( );
-	glFrustum( - 80.0, 80.0, - dy, dy, 80.0, 2000.0 );
+	xform_matrix_frustum( m, - 80.0, 80.0, - dy, dy, 80.0, 2000.0 );
+	xform_set_projection( m );
 
 	/* Set up modelview matrix */
-	glMatrixMode( GL_MODELVIEW );
-	glPushMatrix( );
-	glLoadIdentity( );
+	xform_copy( prev_view, xform_view( ) );
+	xform_identity( m );
 	if (about_part < 0.5) {
 		/* Spinning and approaching fast */
 		p = INTERVAL_PART(about_part, 0.0, 0.5);
 		q = pow( 1.0 - p, 1.5 );
-		glTranslated( 0.0, 0.0, -150.0 - 1800.0 * q );
-		glRotated( 900.0 * q, 0.0, 1.0, 0.0 );
+		xform_matrix_translate( m, 0.0, 0.0, -150.0 - 1800.0 * q );
+		xform_matrix_rotate( m, 900.0 * q, 0.0, 1.0, 0.0 );
 	}
 	else if (about_part < 0.625) {
 		/* Holding still for a moment */
-		glTranslated( 0.0, 0.0, -150.0 );
+		xform_matrix_translate( m, 0.0, 0.0, -150.0 );
 	}
 	else if (about_part < 0.75) {
 		/* Flipping up and back */
 		p = INTERVAL_PART(about_part, 0.625, 0.75);
 		q = 1.0 - SQR(1.0 - p);
-		glTranslated( 0.0, 40.0 * q, -150.0 - 50.0 * q );
-		glRotated( 365.0 * q, 1.0, 0.0, 0.0 );
+		xform_matrix_translate( m, 0.0, 40.0 * q, -150.0 - 50.0 * q );
+		xform_matrix_rotate( m, 365.0 * q, 1.0, 0.0, 0.0 );
 	}
 	else {
 		/* Holding still again */
-		glTranslated( 0.0, 40.0, -200.0 );
-		glRotated( 5.0, 1.0, 0.0, 0.0 );
+		xform_matrix_translate( m, 0.0, 40.0, -200.0 );
+		xform_matrix_rotate( m, 5.0, 1.0, 0.0, 0.0 );
 	}
+	xform_set_view( m );
 
 	/* Draw "fsv" geometry, using a display list if possible */
-	if (fsv_dlist == NULL_DLIST) {
-		fsv_dlist = glGenLists( 1 );
-		glNewList( fsv_dlist, GL_COMPILE_AND_EXECUTE );
+	if (ogl_list_begin( &fsv_dlist, FALSE )) {
 		geometry_gldraw_fsv( );
-		glEndList( );
+		ogl_list_end( );
 	}
-	else
-		glCallList( fsv_dlist );
 
 	/* Restore previous matrices */
-	glMatrixMode( GL_PROJECTION );
-	glPopMatrix( );
-	glMatrixMode( GL_MODELVIEW );
-	glPopMatrix( );
+	xform_set_projection( prev_projection );
+	xform_set_view( prev_view );
 
-	glDisable( GL_FOG );
+	ogl_disable( GL_FOG );
 }
 
 
@@ -123,22 +117,22 @@ draw_text( void )
 {
         XYZvec tpos;
 	XYvec tdims;
+	XformMatrix prev_projection, prev_view, m;
 	double dy, p, q;
 
 	if (about_part < 0.625)
 		return;
 
 	/* Set up projection matrix */
-	glMatrixMode( GL_PROJECTION );
-	glPushMatrix( );
-	glLoadIdentity( );
+	xform_copy( prev_projection, xform_projection( ) );
 	dy = 1.0 / ogl_aspect_ratio( );
-	glFrustum( - 1.0, 1.0, - dy, dy, 1.0, 205.0 );
+	xform_matrix_frustum( m, - 1.0, 1.0, - dy, dy, 1.0, 205.0 );
+	xform_set_projection( m );
 
 	/* Set up modelview matrix */
-	glMatrixMode( GL_MODELVIEW );
-	glPushMatrix( );
-	glLoadIdentity( );
+	xform_copy( prev_view, xform_view( ) );
+	xform_identity( m );
+	xform_set_view( m );
 
         if (about_part < 0.75)
 		p = INTERVAL_PART(about_part, 0.625, 0.75);
@@ -153,7 +147,7 @@ draw_text( void )
 	tpos.x = 0.0;
 	tpos.y = -35.0; /* -35 */
 	tpos.z = -200.0 * q;
-	glColor3f( 1.0, 1.0, 1.0 );
+	vbuf_color3f( 1.0, 1.0, 1.0 );
 	text_draw_straight( "fsv - 3D File System Visualizer", &tpos, &tdims );
 
 	tdims.y = 15.0;
@@ -163,10 +157,8 @@ draw_text( void )
 	text_post( );
 
 	/* Restore previous matrices */
-	glMatrixMode( GL_PROJECTION );
-	glPopMatrix( );
-	glMatrixMode( GL_MODELVIEW );
-	glPopMatrix( );
+	xform_set_projection( prev_projection );
+	xform_set_view( prev_view );
 }
 
 
@@ -196,10 +188,7 @@ about( AboutMesg mesg )
 			return FALSE;
 		/* We now return you to your regularly scheduled program */
 		morph_break( &about_part );
-		if (fsv_dlist != NULL_DLIST) {
-			glDeleteLists( fsv_dlist, 1 );
-			fsv_dlist = NULL_DLIST;
-		}
+		ogl_list_free( &fsv_dlist );
 		redraw( );
 		about_active = FALSE;
 		return TRUE;
@@ -27,13 +27,25 @@
 
 #include <gtk/gtk.h>
 
-#include "ogl.h" /* ogl_draw( ) */
+#include "memstat.h"
+#include "ogl.h" /* ogl_queue_render( ), ogl_widget( ) */
 
 
 /* The framerate is maintained as a rolling average over this
  * length of time (in seconds) */
 #define FRAMERATE_AVERAGE_TIME 4.0
 
+/* Default frame-time budget (in seconds, see animation_high_detail( )) */
+#define DEFAULT_FRAME_BUDGET 0.012
+
+/* The view counts as moving for this long (in seconds) after it was
+ * last moved by hand, so that detail doesn't flicker back in between
+ * one mouse motion event and the next */
+#define MOTION_SETTLE_TIME 0.15
+
+/* Weight of the newest frame in the estimate of full-detail frame time */
+#define FRAME_TIME_SMOOTHING 0.25
+
 
 /* Messages for framerate_iteration( ) */
 enum {
@@ -55,6 +67,20 @@ static float framerate = 0.0;
 /* TRUE for as long as something somewhere is being animated */
 static boolean animation_active = FALSE;
 
+/* Longest a full-detail frame may take to draw while the view is in
+ * motion, before detail is reduced (in seconds) */
+static double frame_budget = DEFAULT_FRAME_BUDGET;
+
+/* TRUE while morphs are running, or the view is being moved by hand,
+ * and the time it was last moved by hand */
+static boolean in_motion = FALSE;
+static double t_motion = -1.0;
+
+/* Running estimate of the time a full-detail frame takes to draw, and
+ * whether the last frame was drawn with reduced detail */
+static double full_detail_time = 0.0;
+static boolean reduced_frame = FALSE;
+
 
 /* Schedules an event (callback) to occur after the given number of
  * frames have elapsed */
@@ -147,6 +173,7 @@ morph_full( double *var, MorphType type, double target_value, double duration, v
 
 	/* Create new morph record */
 	new_morph = NEW(Morph);
+	memstat_add( MEMSTAT_MORPH, 1, sizeof(Morph) );
 	new_morph->type = type;
 	new_morph->var = var;
 	new_morph->start_value = *var;
@@ -230,6 +257,7 @@ morph_break( double *var )
 	while (morph != NULL) {
 		mnext = morph->next;
 		xfree( morph );
+		memstat_add( MEMSTAT_MORPH, -1, - (int64)sizeof(Morph) );
 		morph = mnext;
 	}
 }
@@ -270,6 +298,7 @@ morph_iteration( void )
 				G_LIST_REMOVE(morph_queue, morph);
 			}
 			xfree( morph );
+			memstat_add( MEMSTAT_MORPH, -1, - (int64)sizeof(Morph) );
                         continue;
 		}
 
@@ -410,11 +439,12 @@ framerate_iteration( int mesg )
 }
 
 
-/* Top-level animation loop */
+/* Top-level animation loop, run on every tick of the viewport's frame
+ * clock (i.e. once per displayed frame) while anything is animated */
 static gboolean
-animation_loop( G_GNUC_UNUSED gpointer user_data )
+animation_tick_cb( G_GNUC_UNUSED GtkWidget *widget, G_GNUC_UNUSED GdkFrameClock *frame_clock, G_GNUC_UNUSED gpointer user_data )
 {
-	boolean state_changed, schevents_pending = FALSE;
+	boolean state_changed, settling, schevents_pending = FALSE;
 
 	/* Update morphing variables */
 	state_changed = morph_iteration( );
@@ -423,6 +453,13 @@ animation_loop( G_GNUC_UNUSED gpointer user_data )
 	if (state_changed)
 		ogl_pick_invalidate( );
 
+	settling = (xgettime( ) - t_motion) < MOTION_SETTLE_TIME;
+	in_motion = state_changed || settling;
+
+	/* Bring back full detail once everything has come to rest */
+	if (!in_motion && reduced_frame)
+		globals.need_redraw = TRUE;
+
 	if (globals.need_redraw) {
 		/* Tell GtkGLArea to redraw (actual rendering happens
 		 * in render_cb, where the FBO is properly bound) */
@@ -438,14 +475,14 @@ animation_loop( G_GNUC_UNUSED gpointer user_data )
 			globals.need_redraw = FALSE;
 	}
 
-	if (!state_changed && !schevents_pending) {
+	if (!state_changed && !schevents_pending && !settling) {
                 /* Entering steady state */
 		framerate_iteration( STOP_TIMING );
 		animation_active = FALSE;
+		return G_SOURCE_REMOVE;
 	}
 
-	/* (returning FALSE terminates looping) */
-	return animation_active;
+	return G_SOURCE_CONTINUE;
 }
 
 
@@ -453,15 +490,62 @@ animation_loop( G_GNUC_UNUSED gpointer user_data )
 void
 redraw( void )
 {
-	/* Ensure that animation loop is active.
-	 * Use G_PRIORITY_DEFAULT_IDLE rather than G_PRIORITY_LOW so the
-	 * animation loop isn't starved by GTK 3's frame clock and other
-	 * internal events that run at higher priorities. */
-	if (!animation_active)
-		g_idle_add_full( G_PRIORITY_DEFAULT_IDLE, animation_loop, NULL, NULL );
+	GtkWidget *gl_area_w;
 
-	animation_active = TRUE;
 	globals.need_redraw = TRUE;
+
+	/* Ensure that animation loop is active. It runs off the frame
+	 * clock, and so keeps pace with the display. Without a viewport
+	 * (yet), there is nothing to draw */
+	if (animation_active)
+		return;
+	gl_area_w = ogl_widget( );
+	if (gl_area_w == NULL)
+		return;
+	gtk_widget_add_tick_callback( gl_area_w, animation_tick_cb, NULL, NULL );
+	animation_active = TRUE;
+}
+
+
+/* Version of redraw( ) for when the view has been moved by hand. Until
+ * it has stopped for a bit, it counts as being in motion (see
+ * animation_high_detail( )) */
+void
+redraw_motion( void )
+{
+	t_motion = xgettime( );
+	in_motion = TRUE;
+	redraw( );
+}
+
+
+/* Sets the frame-time budget (in seconds) */
+void
+animation_set_frame_budget( double budget )
+{
+	frame_budget = MAX(0.0, budget);
+}
+
+
+/* Returns TRUE if the next frame should be drawn in full detail. That
+ * is always so when nothing is moving, and otherwise as long as frames
+ * in full detail have been drawing within the budget. Detail is reduced
+ * (see geometry_draw( )) for the rest of the motion once they don't */
+boolean
+animation_high_detail( void )
+{
+	return !in_motion || (full_detail_time <= frame_budget);
+}
+
+
+/* Call after drawing a frame, with whether it was in full detail, and
+ * how long it took to draw (in seconds) */
+void
+animation_frame_drawn( boolean high_detail, double draw_time )
+{
+	reduced_frame = !high_detail;
+	if (high_detail)
+		full_detail_time += FRAME_TIME_SMOOTHING * (draw_time - full_detail_time);
 }
 
 
@@ -70,6 +70,10 @@ void morph( double *var, MorphType type, double target_value, double duration );
 void morph_finish( double *var );
 void morph_break( double *var );
 void redraw( void );
+void redraw_motion( void );
+void animation_set_frame_budget( double budget );
+boolean animation_high_detail( void );
+void animation_frame_drawn( boolean high_detail, double draw_time );
 
 
 /* end animation.h */
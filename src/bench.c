@@ -0,0 +1,320 @@
+/* bench.c */
+
+/* Headless rendering benchmark */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+
+#include "common.h"
+#include "bench.h"
+
+#include <epoxy/gl.h>
+
+#include "camera.h"
+#include "color.h" /* color_init( ) */
+#include "geometry.h"
+#include "ogl.h"
+#include "scanfs.h"
+
+
+/* The benchmark scans a directory, opens it all up, and then flies the
+ * camera along a scripted path in each visualization mode, drawing into
+ * an offscreen framebuffer (see ogl_offscreen_init( )) with no window or
+ * display server involved. The camera moves by frame count rather than
+ * by the clock, so that every run draws the same frames. Results go to
+ * stdout as JSON */
+
+/* Offscreen framebuffer size */
+#define BENCH_WIDTH		1280
+#define BENCH_HEIGHT		720
+
+/* Frames drawn along the camera path, in each mode */
+#define BENCH_FRAMES		240
+
+
+/* Measurements of one frame */
+typedef struct _BenchFrame BenchFrame;
+struct _BenchFrame {
+	double	cpu_ms;		/* Time to issue the frame */
+	double	frame_ms;	/* Time until the frame was finished */
+	int	draw_calls;
+	int64	triangles;
+};
+
+/* Modes gone through, and their names in the results */
+#define BENCH_NUM_MODES		3
+static const FsvMode bench_modes[BENCH_NUM_MODES] = { FSV_DISCV, FSV_MAPV, FSV_TREEV };
+static const char *bench_mode_names[BENCH_NUM_MODES] = { "discv", "mapv", "treev" };
+
+
+/* Marks every directory in the subtree as expanded */
+static void
+bench_expand_recursive( GNode *dnode )
+{
+	GNode *node;
+
+	DIR_NODE_DESC(dnode)->tree_expanded = TRUE;
+
+	node = dnode->children;
+	while ((node != NULL) && NODE_IS_DIR(node)) {
+		bench_expand_recursive( node );
+		node = node->next;
+	}
+}
+
+
+/* Puts the camera t of the way (t in [0, 1]) along the scripted path,
+ * which starts from the given camera state */
+static void
+bench_camera_path( const Camera *start, double t )
+{
+	double k, r;
+
+	/* Zoom in to a quarter of the starting distance, and back out */
+	k = 1.0 - 0.75 * SQR(sin( PI * t ));
+	camera->distance = k * start->distance;
+	camera->near_clip = k * start->near_clip;
+	camera->far_clip = k * start->far_clip;
+
+	switch (globals.fsv_mode) {
+		case FSV_DISCV:
+		/* Straight-down view: pan around a circle */
+		r = 0.5 * DISCV_GEOM_PARAMS(root_dnode)->radius;
+		DISCV_CAMERA(camera)->target.x = r * sin( 2.0 * PI * t );
+		DISCV_CAMERA(camera)->target.y = r * (1.0 - cos( 2.0 * PI * t ));
+		break;
+
+		case FSV_MAPV:
+		case FSV_TREEV:
+		/* Go around once, swinging from overhead down low and
+		 * back up */
+		camera->theta = fmod( start->theta + 360.0 * t, 360.0 );
+		camera->phi = 45.0 + 35.0 * cos( 2.0 * PI * t );
+		break;
+
+		SWITCH_FAIL
+	}
+
+	ogl_pick_invalidate( );
+}
+
+
+/* Draws a frame, and measures it */
+static void
+bench_draw( BenchFrame *frame )
+{
+	double t0, t1, t2;
+
+	t0 = xgettime( );
+	ogl_draw( );
+	t1 = xgettime( );
+	glFinish( );
+	t2 = xgettime( );
+
+	frame->cpu_ms = 1000.0 * (t1 - t0);
+	frame->frame_ms = 1000.0 * (t2 - t0);
+	ogl_frame_counts( &frame->draw_calls, &frame->triangles );
+}
+
+
+/* qsort( ) comparison function for doubles */
+static int
+compare_doubles( const void *a, const void *b )
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	if (x < y)
+		return -1;
+	if (x > y)
+		return 1;
+	return 0;
+}
+
+
+/* Writes out a string as a JSON string literal */
+static void
+json_string( FILE *stream, const char *str )
+{
+	const char *c;
+
+	fputc( '"', stream );
+	for (c = str; *c != '\0'; c++) {
+		if ((*c == '"') || (*c == '\\'))
+			fprintf( stream, "\\%c", *c );
+		else if ((unsigned char)*c < 0x20)
+			fprintf( stream, "\\u%04x", (unsigned char)*c );
+		else
+			fputc( *c, stream );
+	}
+	fputc( '"', stream );
+}
+
+
+/* Writes out the mean and percentiles of n values as a JSON object
+ * (values gets sorted) */
+static void
+json_summary( FILE *stream, double *values, int n )
+{
+	static const int percentiles[] = { 50, 90, 95, 99 };
+	double sum = 0.0;
+	int i, k;
+
+	qsort( values, n, sizeof(double), compare_doubles );
+	for (i = 0; i < n; i++)
+		sum += values[i];
+
+	fprintf( stream, "{ \"mean\": %.3f", sum / (double)n );
+	for (i = 0; i < (int)(sizeof(percentiles) / sizeof(int)); i++) {
+		/* Nearest rank */
+		k = (percentiles[i] * n + 99) / 100 - 1;
+		fprintf( stream, ", \"p%d\": %.3f", percentiles[i], values[CLAMP(k, 0, n - 1)] );
+	}
+	fprintf( stream, ", \"max\": %.3f }", values[n - 1] );
+}
+
+
+/* Writes out the results of one mode */
+static void
+json_mode( FILE *stream, const char *name, const BenchFrame *first_frame, const BenchFrame *frames, int n )
+{
+	double *values;
+	int i;
+
+	fprintf( stream, "\t\t{\n\t\t\t\"mode\": \"%s\",\n", name );
+	fprintf( stream, "\t\t\t\"first_frame_ms\": %.3f,\n", first_frame->frame_ms );
+	fprintf( stream, "\t\t\t\"frames\": %d,\n", n );
+
+	values = NEW_ARRAY(double, n);
+	for (i = 0; i < n; i++)
+		values[i] = frames[i].cpu_ms;
+	fprintf( stream, "\t\t\t\"cpu_ms\": " );
+	json_summary( stream, values, n );
+	for (i = 0; i < n; i++)
+		values[i] = frames[i].frame_ms;
+	fprintf( stream, ",\n\t\t\t\"frame_ms\": " );
+	json_summary( stream, values, n );
+	for (i = 0; i < n; i++)
+		values[i] = (double)frames[i].draw_calls;
+	fprintf( stream, ",\n\t\t\t\"draw_calls\": " );
+	json_summary( stream, values, n );
+	for (i = 0; i < n; i++)
+		values[i] = (double)frames[i].triangles;
+	fprintf( stream, ",\n\t\t\t\"triangles\": " );
+	json_summary( stream, values, n );
+	xfree( values );
+
+	/* Frame by frame */
+	fprintf( stream, ",\n\t\t\t\"per_frame\": {\n\t\t\t\t\"cpu_ms\": [" );
+	for (i = 0; i < n; i++)
+		fprintf( stream, "%s%.3f", (i > 0) ? ", " : "", frames[i].cpu_ms );
+	fprintf( stream, "],\n\t\t\t\t\"frame_ms\": [" );
+	for (i = 0; i < n; i++)
+		fprintf( stream, "%s%.3f", (i > 0) ? ", " : "", frames[i].frame_ms );
+	fprintf( stream, "],\n\t\t\t\t\"draw_calls\": [" );
+	for (i = 0; i < n; i++)
+		fprintf( stream, "%s%d", (i > 0) ? ", " : "", frames[i].draw_calls );
+	fprintf( stream, "],\n\t\t\t\t\"triangles\": [" );
+	for (i = 0; i < n; i++)
+		fprintf( stream, "%s%" G_GINT64_FORMAT, (i > 0) ? ", " : "", frames[i].triangles );
+	fprintf( stream, "]\n\t\t\t}\n\t\t}" );
+}
+
+
+/* Runs the benchmark on the given directory, with the core-profile
+ * renderer if core is TRUE. Returns FALSE if it could not be run */
+boolean
+bench_run( const char *root_dir, boolean core )
+{
+	BenchFrame first_frame;
+	BenchFrame *frames;
+	Camera start;
+	double t0, scan_ms;
+	int node_count = 1;
+	int m, f, i;
+
+	globals.headless = TRUE;
+
+	if (!ogl_offscreen_init( BENCH_WIDTH, BENCH_HEIGHT, core )) {
+		fprintf( stderr, _("fsv: Could not set up offscreen OpenGL rendering\n") );
+		return FALSE;
+	}
+	color_init( );
+
+	/* Scan, and open everything up */
+	t0 = xgettime( );
+	scanfs( root_dir );
+	scan_ms = 1000.0 * (xgettime( ) - t0);
+	if (globals.fstree == NULL) {
+		fprintf( stderr, _("fsv: %s: Could not scan\n"), root_dir );
+		ogl_offscreen_end( );
+		return FALSE;
+	}
+	bench_expand_recursive( root_dnode );
+	globals.current_node = root_dnode;
+	for (i = 0; i < NUM_NODE_TYPES; i++)
+		node_count += DIR_NODE_DESC(root_dnode)->subtree.counts[i];
+
+	printf( "{\n" );
+	printf( "\t\"version\": \"%s\",\n", VERSION );
+	printf( "\t\"renderer\": \"%s\",\n", ogl_core_profile( ) ? "core" : "legacy" );
+	printf( "\t\"gl_renderer\": " );
+	json_string( stdout, (const char *)glGetString( GL_RENDERER ) );
+	printf( ",\n\t\"root\": " );
+	json_string( stdout, node_absname( root_dnode ) );
+	printf( ",\n\t\"nodes\": %d,\n", node_count );
+	printf( "\t\"scan_ms\": %.3f,\n", scan_ms );
+	printf( "\t\"viewport\": [%d, %d],\n", BENCH_WIDTH, BENCH_HEIGHT );
+	printf( "\t\"modes\": [\n" );
+
+	frames = NEW_ARRAY(BenchFrame, BENCH_FRAMES);
+	for (m = 0; m < BENCH_NUM_MODES; m++) {
+		/* cf. fsv_set_mode( ) */
+		geometry_init( bench_modes[m] );
+		camera_init( bench_modes[m], TRUE );
+		globals.fsv_mode = bench_modes[m];
+		start = *camera;
+
+		/* The first frame lays out and builds everything */
+		bench_camera_path( &start, 0.0 );
+		bench_draw( &first_frame );
+
+		for (f = 0; f < BENCH_FRAMES; f++) {
+			bench_camera_path( &start, (double)f / (double)BENCH_FRAMES );
+			bench_draw( &frames[f] );
+		}
+
+		json_mode( stdout, bench_mode_names[m], &first_frame, frames, BENCH_FRAMES );
+		printf( "%s\n", (m < (BENCH_NUM_MODES - 1)) ? "," : "" );
+	}
+	xfree( frames );
+
+	printf( "\t]\n}\n" );
+	fflush( stdout );
+
+	ogl_offscreen_end( );
+
+	return TRUE;
+}
+
+
+/* end bench.c */
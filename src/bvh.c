@@ -0,0 +1,391 @@
+/* bvh.c */
+
+/* Bounding volume hierarchies */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "common.h"
+#include "bvh.h"
+
+#include <float.h>
+
+#include "memstat.h"
+
+
+/* A binary tree of axis-aligned boxes over a set of items, which the
+ * caller describes through a callback. It is built top-down, splitting
+ * each set at the median along its longest axis, so it is balanced no
+ * matter how the items are distributed. When the items move without
+ * the set itself changing, the tree can be refit (boxes recomputed,
+ * bottom up) in linear time instead of being built over */
+
+/* Most items a leaf holds */
+#define BVH_LEAF_ITEMS 4
+
+/* Deepest a tree can get (being balanced, this allows for any number of
+ * items that fits in an int) */
+#define BVH_MAX_DEPTH 40
+
+/* Tree node. Nodes are stored depth-first, so the left child of an
+ * interior node immediately follows it, and all children come after
+ * their parent */
+typedef struct _BvhNode BvhNode;
+struct _BvhNode {
+	BvhBox	box;
+	int	first;	/* Leaf: first item. Interior: right child */
+	int	count;	/* Leaf: number of items. Interior: 0 */
+};
+
+struct _Bvh {
+	void	**items;	/* Items, in leaf order */
+	int	num_items;
+	BvhNode	*nodes;		/* Root first */
+	int	num_nodes;
+};
+
+/* An item while the tree is being built */
+typedef struct _BvhPrim BvhPrim;
+struct _BvhPrim {
+	void	*item;
+	BvhBox	box;
+	float	center[3];
+};
+
+
+/* Makes a box empty */
+void
+bvh_box_clear( BvhBox *box )
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		box->min[i] = FLT_MAX;
+		box->max[i] = - FLT_MAX;
+	}
+}
+
+
+/* Grows a box to take in a point */
+void
+bvh_box_add_point( BvhBox *box, double x, double y, double z )
+{
+	box->min[0] = MIN(box->min[0], (float)x);
+	box->min[1] = MIN(box->min[1], (float)y);
+	box->min[2] = MIN(box->min[2], (float)z);
+	box->max[0] = MAX(box->max[0], (float)x);
+	box->max[1] = MAX(box->max[1], (float)y);
+	box->max[2] = MAX(box->max[2], (float)z);
+}
+
+
+/* Grows a box to take in another */
+void
+bvh_box_add_box( BvhBox *box, const BvhBox *box2 )
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		box->min[i] = MIN(box->min[i], box2->min[i]);
+		box->max[i] = MAX(box->max[i], box2->max[i]);
+	}
+}
+
+
+/* Tells if a box is empty */
+boolean
+bvh_box_is_empty( const BvhBox *box )
+{
+	return (box->min[0] > box->max[0]) || (box->min[1] > box->max[1]) || (box->min[2] > box->max[2]);
+}
+
+
+/* Reorders prims[lo..hi] so that the one at position nth is where it
+ * would be if they were sorted by center along the given axis, with
+ * none before it greater and none after it less (quickselect) */
+static void
+select_nth( BvhPrim *prims, int lo, int hi, int nth, int axis )
+{
+	BvhPrim tmp;
+	float pivot;
+	int i, j;
+
+	while (lo < hi) {
+		pivot = prims[(lo + hi) / 2].center[axis];
+		i = lo;
+		j = hi;
+		while (i <= j) {
+			while (prims[i].center[axis] < pivot)
+				++i;
+			while (prims[j].center[axis] > pivot)
+				--j;
+			if (i <= j) {
+				tmp = prims[i];
+				prims[i] = prims[j];
+				prims[j] = tmp;
+				++i;
+				--j;
+			}
+		}
+
+		if (nth <= j)
+			hi = j;
+		else if (nth >= i)
+			lo = i;
+		else
+			break;
+	}
+}
+
+
+/* Builds the subtree over prims[first..first+count-1], returning the
+ * index of its root node */
+static int
+build_recursive( Bvh *bvh, BvhPrim *prims, int first, int count )
+{
+	BvhBox centers;
+	float extent, max_extent = -1.0;
+	int index, axis = 0, mid, i;
+
+	index = bvh->num_nodes++;
+	bvh_box_clear( &bvh->nodes[index].box );
+	bvh_box_clear( &centers );
+	for (i = first; i < first + count; i++) {
+		bvh_box_add_box( &bvh->nodes[index].box, &prims[i].box );
+		bvh_box_add_point( &centers, prims[i].center[0], prims[i].center[1], prims[i].center[2] );
+	}
+
+	if (count <= BVH_LEAF_ITEMS) {
+		for (i = first; i < first + count; i++)
+			bvh->items[i] = prims[i].item;
+		bvh->nodes[index].first = first;
+		bvh->nodes[index].count = count;
+		return index;
+	}
+
+	/* Split at the median along the longest axis */
+	for (i = 0; i < 3; i++) {
+		extent = centers.max[i] - centers.min[i];
+		if (extent > max_extent) {
+			max_extent = extent;
+			axis = i;
+		}
+	}
+	mid = first + count / 2;
+	select_nth( prims, first, first + count - 1, mid, axis );
+
+	build_recursive( bvh, prims, first, mid - first );
+	bvh->nodes[index].first = build_recursive( bvh, prims, mid, first + count - mid );
+	bvh->nodes[index].count = 0;
+
+	return index;
+}
+
+
+/* Builds a hierarchy over the given items (the array is copied) */
+Bvh *
+bvh_new( void **items, int num_items, BvhBoxFunc box_func, void *data )
+{
+	Bvh *bvh;
+	BvhPrim *prims;
+	int i, j;
+
+	g_assert( num_items > 0 );
+
+	prims = NEW_ARRAY(BvhPrim, num_items);
+	for (i = 0; i < num_items; i++) {
+		prims[i].item = items[i];
+		(box_func)( items[i], &prims[i].box, data );
+		for (j = 0; j < 3; j++)
+			prims[i].center[j] = 0.5f * (prims[i].box.min[j] + prims[i].box.max[j]);
+	}
+
+	/* A binary tree with at most one item per leaf has fewer than
+	 * twice as many nodes as items, and this one has no more leaves
+	 * than that */
+	bvh = NEW(Bvh);
+	bvh->items = NEW_ARRAY(void *, num_items);
+	bvh->num_items = num_items;
+	bvh->nodes = NEW_ARRAY(BvhNode, 2 * num_items);
+	bvh->num_nodes = 0;
+	build_recursive( bvh, prims, 0, num_items );
+	xfree( prims );
+
+	memstat_add( MEMSTAT_BVH, 1, sizeof(Bvh) + (int64)num_items * (sizeof(void *) + 2 * sizeof(BvhNode)) );
+
+	return bvh;
+}
+
+
+/* Recomputes the boxes of a hierarchy after its items have moved */
+void
+bvh_refit( Bvh *bvh, BvhBoxFunc box_func, void *data )
+{
+	BvhNode *bnode;
+	BvhBox box;
+	int i, j;
+
+	/* Children come after their parent, so going backwards visits
+	 * both children of a node before the node itself */
+	for (i = bvh->num_nodes - 1; i >= 0; i--) {
+		bnode = &bvh->nodes[i];
+		if (bnode->count > 0) {
+			bvh_box_clear( &bnode->box );
+			for (j = bnode->first; j < bnode->first + bnode->count; j++) {
+				(box_func)( bvh->items[j], &box, data );
+				bvh_box_add_box( &bnode->box, &box );
+			}
+		}
+		else {
+			bnode->box = bvh->nodes[i + 1].box;
+			bvh_box_add_box( &bnode->box, &bvh->nodes[bnode->first].box );
+		}
+	}
+}
+
+
+/* Returns the number of items in a hierarchy */
+int
+bvh_num_items( const Bvh *bvh )
+{
+	return bvh->num_items;
+}
+
+
+/* Gets the box enclosing all the items of a hierarchy */
+void
+bvh_get_bounds( const Bvh *bvh, BvhBox *box )
+{
+	*box = bvh->nodes[0].box;
+}
+
+
+/* Clips the ray segment [*t0, *t1] to a box. Returns FALSE if none of
+ * it is left */
+static boolean
+ray_clip_box( const BvhBox *box, const double *origin, const double *direction, const double *inv_direction, double *t0, double *t1 )
+{
+	double ta, tb;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		if (direction[i] == 0.0) {
+			/* Ray runs parallel to this pair of planes */
+			if ((origin[i] < box->min[i]) || (origin[i] > box->max[i]))
+				return FALSE;
+			continue;
+		}
+		ta = ((double)box->min[i] - origin[i]) * inv_direction[i];
+		tb = ((double)box->max[i] - origin[i]) * inv_direction[i];
+		*t0 = MAX(*t0, MIN(ta, tb));
+		*t1 = MIN(*t1, MAX(ta, tb));
+		if (*t0 > *t1)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/* Casts the ray origin + t * direction (0 <= t < t_max) through a
+ * hierarchy. hit_func is called on the items whose boxes the ray passes
+ * through, nearer boxes first, until no box is left that could hold a
+ * nearer hit. Returns the ray parameter of the nearest hit, or t_max if
+ * there was none */
+double
+bvh_raycast( const Bvh *bvh, const double *origin, const double *direction, double t_max, BvhRayFunc hit_func, void *data )
+{
+	const BvhNode *bnode;
+	double inv_direction[3];
+	double stack_t[BVH_MAX_DEPTH];
+	double t_near, ta0, ta1, tb0, tb1;
+	int stack[BVH_MAX_DEPTH];
+	int depth = 0;
+	int a, b, i;
+
+	for (i = 0; i < 3; i++)
+		inv_direction[i] = (direction[i] == 0.0) ? 0.0 : 1.0 / direction[i];
+
+	ta0 = 0.0;
+	ta1 = t_max;
+	if (!ray_clip_box( &bvh->nodes[0].box, origin, direction, inv_direction, &ta0, &ta1 ))
+		return t_max;
+	stack[depth] = 0;
+	stack_t[depth++] = ta0;
+
+	while (depth > 0) {
+		--depth;
+		if (stack_t[depth] >= t_max)
+			continue; /* A nearer hit has turned up since */
+		bnode = &bvh->nodes[stack[depth]];
+
+		if (bnode->count > 0) {
+			for (i = bnode->first; i < bnode->first + bnode->count; i++)
+				t_max = (hit_func)( bvh->items[i], t_max, data );
+			continue;
+		}
+
+		/* Visit the nearer child first (it goes on top) */
+		a = stack[depth] + 1;
+		b = bnode->first;
+		ta0 = tb0 = 0.0;
+		ta1 = tb1 = t_max;
+		if (!ray_clip_box( &bvh->nodes[a].box, origin, direction, inv_direction, &ta0, &ta1 ))
+			a = -1;
+		if (!ray_clip_box( &bvh->nodes[b].box, origin, direction, inv_direction, &tb0, &tb1 ))
+			b = -1;
+		if ((a >= 0) && (b >= 0) && (tb0 < ta0)) {
+			i = a;
+			a = b;
+			b = i;
+			t_near = ta0;
+			ta0 = tb0;
+			tb0 = t_near;
+		}
+		if (b >= 0) {
+			stack[depth] = b;
+			stack_t[depth++] = tb0;
+		}
+		if (a >= 0) {
+			stack[depth] = a;
+			stack_t[depth++] = ta0;
+		}
+	}
+
+	return t_max;
+}
+
+
+/* Destroys a hierarchy */
+void
+bvh_free( Bvh *bvh )
+{
+	if (bvh == NULL)
+		return;
+
+	memstat_add( MEMSTAT_BVH, -1, - (int64)(sizeof(Bvh) + (int64)bvh->num_items * (sizeof(void *) + 2 * sizeof(BvhNode))) );
+
+	xfree( bvh->items );
+	xfree( bvh->nodes );
+	xfree( bvh );
+}
+
+
+/* end bvh.c */
@@ -0,0 +1,61 @@
+/* bvh.h */
+
+/* Bounding volume hierarchies */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifdef FSV_BVH_H
+	#error
+#endif
+#define FSV_BVH_H
+
+
+/* Axis-aligned bounding box. An empty box has min > max */
+typedef struct _BvhBox BvhBox;
+struct _BvhBox {
+	float	min[3];
+	float	max[3];
+};
+
+/* A hierarchy over a set of items (contents are private to bvh.c) */
+typedef struct _Bvh Bvh;
+
+/* Callback giving the current bounding box of an item */
+typedef void (*BvhBoxFunc)( void *item, BvhBox *box, void *data );
+
+/* Callback intersecting a ray with an item, returning the ray parameter
+ * of the nearest hit closer than t_max (or t_max if there is none) */
+typedef double (*BvhRayFunc)( void *item, double t_max, void *data );
+
+
+void bvh_box_clear( BvhBox *box );
+void bvh_box_add_point( BvhBox *box, double x, double y, double z );
+void bvh_box_add_box( BvhBox *box, const BvhBox *box2 );
+boolean bvh_box_is_empty( const BvhBox *box );
+Bvh *bvh_new( void **items, int num_items, BvhBoxFunc box_func, void *data );
+void bvh_refit( Bvh *bvh, BvhBoxFunc box_func, void *data );
+int bvh_num_items( const Bvh *bvh );
+void bvh_get_bounds( const Bvh *bvh, BvhBox *box );
+double bvh_raycast( const Bvh *bvh, const double *origin, const double *direction, double t_max, BvhRayFunc hit_func, void *data );
+void bvh_free( Bvh *bvh );
+
+
+/* end bvh.h */
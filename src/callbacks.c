@@ -28,9 +28,11 @@
 #include <gtk/gtk.h>
 
 #include "about.h"
+#include "animation.h" /* redraw( ) */
 #include "camera.h"
 #include "color.h"
 #include "dialog.h"
+#include "frametime.h"
 #include "fsv.h"
 
 
@@ -100,6 +102,15 @@ on_vis_treev_activate( GtkMenuItem *menuitem, G_GNUC_UNUSED gpointer user_data )
 }
 
 
+/* Vis -> Frame timing */
+void
+on_vis_frame_timing_activate( G_GNUC_UNUSED GtkMenuItem *menuitem, G_GNUC_UNUSED gpointer user_data )
+{
+	frametime_set_overlay( !frametime_overlay( ) );
+	redraw( );
+}
+
+
 /* Colors -> By node type */
 void
 on_color_by_nodetype_activate( GtkMenuItem *menuitem, G_GNUC_UNUSED gpointer user_data )
@@ -143,6 +154,14 @@ on_help_about_fsv_activate( G_GNUC_UNUSED GtkMenuItem *menuitem, G_GNUC_UNUSED g
 }
 
 
+/* Help -> Statistics... */
+void
+on_help_statistics_activate( G_GNUC_UNUSED GtkMenuItem *menuitem, G_GNUC_UNUSED gpointer user_data )
+{
+	dialog_statistics( );
+}
+
+
 /** Toolbar **/
 
 
@@ -25,6 +25,10 @@ void
 on_vis_treev_activate                  (GtkMenuItem     *menuitem,
                                         gpointer         user_data);
 
+void
+on_vis_frame_timing_activate           (GtkMenuItem     *menuitem,
+                                        gpointer         user_data);
+
 void
 on_color_by_nodetype_activate         (GtkMenuItem     *menuitem,
                                         gpointer         user_data);
@@ -45,6 +49,10 @@ void
 on_help_about_fsv_activate             (GtkMenuItem     *menuitem,
                                         gpointer         user_data);
 
+void
+on_help_statistics_activate            (GtkMenuItem     *menuitem,
+                                        gpointer         user_data);
+
 void
 on_back_button_clicked                 (GtkButton       *button,
                                         gpointer         user_data);
@@ -356,7 +356,7 @@ camera_scrollbar_move_cb( GtkAdjustment *adj, const char *mesg )
 	/* Camera is under user control */
 	camera->manual_control = TRUE;
 
-	redraw( );
+	redraw_motion( );
 }
 
 
@@ -1430,7 +1430,7 @@ camera_dolly( double dk )
 	 * wheel notch forces a synchronous scrollbar widget redraw */
 	camera_update_scrollbars( FALSE );
 	ogl_pick_invalidate( );
-	redraw( );
+	redraw_motion( );
 }
 
 
@@ -1463,7 +1463,7 @@ camera_revolve( double dtheta, double dphi )
 
 	camera_update_scrollbars( TRUE );
 	ogl_pick_invalidate( );
-	redraw( );
+	redraw_motion( );
 }
 
 
@@ -1533,7 +1533,7 @@ camera_pan( double dx, double dy )
 
 	camera_update_scrollbars( TRUE );
 	ogl_pick_invalidate( );
-	redraw( );
+	redraw_motion( );
 }
 
 
@@ -634,7 +634,8 @@ color_init( void )
 	color_read_config( );
 
 	/* Update radio menu in window with configured color mode */
-	window_set_color_mode( color_mode );
+	if (!globals.headless)
+		window_set_color_mode( color_mode );
 
 	/* Generate spectrum color table */
 	generate_spectrum_colors( );
@@ -388,6 +388,88 @@ node_absname( GNode *node )
 }
 
 
+/* Path-to-node index. Every non-metanode in the filesystem tree is
+ * entered here, keyed by (parent directory ID, base name), so that
+ * resolving a path costs one lookup per component no matter how wide
+ * the directories along the way are. The index is built lazily on the
+ * first lookup after a scan, and thrown away by node_index_invalidate( ) */
+static GHashTable *node_index = NULL;
+
+
+/* Hash function for the node index */
+static guint
+node_index_hash( gconstpointer key )
+{
+	const GNode *node = (const GNode *)key;
+
+	return (NODE_DESC(node->parent)->id * 2654435761U) ^ g_str_hash( NODE_DESC(node)->name );
+}
+
+
+/* Equality function for the node index */
+static gboolean
+node_index_equal( gconstpointer a, gconstpointer b )
+{
+	const GNode *node_a = (const GNode *)a;
+	const GNode *node_b = (const GNode *)b;
+
+	if (node_a->parent != node_b->parent)
+		return FALSE;
+
+	return !strcmp( NODE_DESC(node_a)->name, NODE_DESC(node_b)->name );
+}
+
+
+/* Enters all nodes in the given directory's subtree into the index */
+static void
+node_index_add_recursive( GNode *dnode )
+{
+	GNode *node;
+
+	node = dnode->children;
+	while (node != NULL) {
+		g_hash_table_insert( node_index, node, node );
+		if (NODE_IS_DIR(node))
+			node_index_add_recursive( node );
+		node = node->next;
+	}
+}
+
+
+/* Discards the path-to-node index. This must be called whenever the
+ * filesystem tree is freed or rebuilt */
+void
+node_index_invalidate( void )
+{
+	if (node_index != NULL) {
+		g_hash_table_destroy( node_index );
+		node_index = NULL;
+	}
+}
+
+
+/* Returns the child of the given directory with the given base name,
+ * or NULL if there is no such child */
+static GNode *
+node_index_lookup( GNode *dnode, const char *name )
+{
+	GNode key_node;
+	NodeDesc key_desc;
+
+	if (node_index == NULL) {
+		node_index = g_hash_table_new( node_index_hash, node_index_equal );
+		node_index_add_recursive( root_dnode );
+	}
+
+	/* Dummy node carrying just enough to hash/compare */
+	key_desc.name = name;
+	key_node.data = &key_desc;
+	key_node.parent = dnode;
+
+	return (GNode *)g_hash_table_lookup( node_index, &key_node );
+}
+
+
 /* This does roughly the opposite of node_absname( ): given an (absolute)
  * filename, return the corresponding node if it is present in the current
  * filesystem tree (NULL otherwise) */
@@ -397,9 +479,11 @@ node_named( const char *absname )
 	GNode *node;
 	int len;
         const char *root_name;
-	const char delimiters[] = "/";
 	char *absname_partial_copy;
-	char *name;
+	char *name = NULL, *p;
+
+	if (globals.fstree == NULL)
+		return NULL;
 
 	/* The root directory name should be an initial substring of the
 	 * desired node's absolute name. Otherwise, the desired node
@@ -413,51 +497,42 @@ node_named( const char *absname )
 			 * a slash or a terminating null) */
 			len = 0;
 		}
+		else if ((absname[len] != '/') && (absname[len] != '\0')) {
+			/* e.g. root "/usr/lib" vs. "/usr/lib64/foo" */
+			return NULL;
+		}
                 /* Copy the rest of the string into working space */
 		absname_partial_copy = xstrdup( &absname[len] );
 	}
 	else
 		return NULL;
 
-	switch (strlen( absname_partial_copy )) {
-		case 0:
-		/* Absolute names of root directory and desired node
-		 * match perfectly, but are not equal to "/" */
-		g_assert( !strcmp( absname, node_absname( root_dnode ) ) );
-		g_assert( strcmp( "/", absname ) );
-		xfree( absname_partial_copy );
-		return root_dnode;
-
-		case 1:
-		/* Absolute names of root directory and desired node
-		 * match perfectly, both equal to "/" */
-		g_assert( !strcmp( absname, node_absname( root_dnode ) ) );
-		g_assert( !strcmp( "/", absname ) );
-		xfree( absname_partial_copy );
-		return root_dnode;
-
-		default:
-		/* Root directory is not the desired node, so we'll have
-		 * to perform component-by-component matching */
-		break;
-	}
-
-	name = strtok( absname_partial_copy, delimiters );
-	node = root_dnode->children;
+	/* Walk down one path component at a time. Runs of slashes
+	 * are treated as one, as are trailing slashes */
+	node = root_dnode;
+	p = absname_partial_copy;
 	while (node != NULL) {
-		if (!strcmp( name, NODE_DESC(node)->name )) {
-			name = strtok( NULL, delimiters );
-			if (name == NULL)
-                                break;
-			node = node->children;
-			continue;
-		}
-		node = node->next;
+		while (*p == '/')
+			++p;
+		if (*p == '\0')
+			break;
+		name = p;
+		while ((*p != '/') && (*p != '\0'))
+			++p;
+		if (*p == '/')
+			*p++ = '\0';
+
+		if (!NODE_IS_DIR(node))
+			node = NULL; /* leaf can't have children */
+		else
+			node = node_index_lookup( node, name );
 	}
 
 #ifdef DEBUG
-	if (node != NULL)
-		g_assert( !strcmp( absname, node_absname( node ) ) );
+	/* (absname itself may have extra slashes, so check the last
+	 * component looked up rather than the whole path) */
+	if ((node != NULL) && (node != root_dnode))
+		g_assert( !strcmp( name, NODE_DESC(node)->name ) );
 #endif
 
 	xfree( absname_partial_copy );
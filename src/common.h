@@ -228,17 +228,36 @@ struct _DirNodeDesc {
 		int64		size;	/* Total subtree size (bytes) */
 		unsigned int	counts[NUM_NODE_TYPES]; /* Node type totals */
 	} subtree;
-	/* Following pointer should be of type GtkTreeIter* (heap-allocated) */
-	void		*ctnode;	/* Directory tree entry */
-	unsigned int	a_dlist;	/* Display list A */
-	unsigned int	b_dlist;	/* Display list B */
-	unsigned int	c_dlist;	/* Display list C */
+	struct _VBufRange *a_vbuf;	/* Geometry A (vertex buffer range) */
+	struct _VBufRange *b_vbuf;	/* Geometry B (vertex buffer range) */
+	struct _VBufRange *label_vbuf;	/* Name labels (vertex buffer range) */
+	struct _LabelSet *label_set;	/* Where the labels are, for placement */
+	struct _Bvh *bvh;		/* World-space bounds of the children */
+	unsigned int	occ_query;	/* Occlusion query object (0 = none) */
+	unsigned int	occ_frame;	/* Frame the query was issued in */
+	struct _Impostor *impostor;	/* Cached picture of the subtree */
+	struct _BuildJob *build_job;	/* Geometry being built in advance */
 	/* Flag: TRUE if directory geometry is being drawn expanded */
 	bitfield	geom_expanded : 1;
-	/* Flags: TRUE if geometry in X_dlist needs to be rebuilt */
-	bitfield	a_dlist_stale : 1;
-	bitfield	b_dlist_stale : 1;
-	bitfield	c_dlist_stale : 1;
+	/* Flag: TRUE if directory tree entry is expanded. This is the
+	 * authoritative state; the directory tree widget mirrors it */
+	bitfield	tree_expanded : 1;
+	/* Flags: TRUE if geometry A/B/C needs to be rebuilt */
+	bitfield	a_stale : 1;
+	bitfield	b_stale : 1;
+	bitfield	c_stale : 1;
+	/* Flag: TRUE if instance records of the children (MapV) need
+	 * to be rewritten */
+	bitfield	i_stale : 1;
+	/* Curve detail that geometry A/B was last built with (TreeV:
+	 * stride through the unit circle table; DiscV: detail level) */
+	bitfield	curve_detail : 5;
+	/* Flag: TRUE if the bounds of the children need updating */
+	bitfield	bvh_stale : 1;
+	/* Flags: TRUE if the last occlusion query found the subtree
+	 * hidden, and if a query is still in flight */
+	bitfield	occluded : 1;
+	bitfield	occ_pending : 1;
 };
 
 /* Generalized node descriptor */
@@ -288,6 +307,9 @@ struct Globals {
 
 	/* TRUE when viewport needs to be redrawn */
 	boolean need_redraw;
+
+	/* TRUE when running without a window (see bench.c) */
+	boolean headless;
 };
 
 
@@ -317,6 +339,7 @@ double xgettime( void);
 const char *i64toa( int64 number );
 const char *abbrev_size( int64 size );
 const char *node_absname( GNode *node );
+void node_index_invalidate( void );
 GNode *node_named( const char *absname );
 const struct NodeInfo *get_node_info( GNode *node );
 const char *rgb2hex( RGBcolor *color );
@@ -37,6 +37,7 @@
 #include "filelist.h" /* dir_contents_list_add( ) */
 #include "fsv.h"
 #include "gui.h"
+#include "memstat.h"
 #include "window.h"
 
 /* OK/Cancel button XPM's */
@@ -1329,6 +1330,38 @@ dialog_node_properties( GNode *node )
 }
 
 
+/**** Help -> Statistics... ****/
+
+/* Shows the memory accounting counters */
+void
+dialog_statistics( void )
+{
+	GtkWidget *window_w;
+	GtkWidget *main_vbox_w;
+	GtkWidget *text_area_w;
+	char strbuf[256];
+	char *report;
+
+	window_w = gui_dialog_window( _("Statistics"), NULL );
+	gui_window_modalize( window_w, main_window_w );
+	main_vbox_w = gui_vbox_add( window_w, 5 );
+
+	snprintf( strbuf, sizeof(strbuf), _("Memory use for %s nodes:"), i64toa( memstat_count( MEMSTAT_GNODE ) ) );
+	gui_label_add( main_vbox_w, strbuf );
+
+	report = memstat_report( );
+	text_area_w = gui_text_area_add( main_vbox_w, report );
+	gtk_text_view_set_monospace( GTK_TEXT_VIEW(text_area_w), TRUE );
+	gtk_text_view_set_wrap_mode( GTK_TEXT_VIEW(text_area_w), GTK_WRAP_NONE );
+	xfree( report );
+
+	/* Close button */
+	gui_button_add( main_vbox_w, _("Close"), G_CALLBACK(close_cb), window_w );
+
+	gtk_widget_show( window_w );
+}
+
+
 /**** Context-sensitive right-click menu ****/
 
 /* (I know, it's not a dialog, but where else to put this? :-) */
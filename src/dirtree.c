@@ -34,6 +34,7 @@
 #include "filelist.h"
 #include "geometry.h"
 #include "gui.h"
+#include "memstat.h"
 #include "window.h"
 
 /* Mini collapsed/expanded directory icon XPM's */
@@ -45,7 +46,7 @@
 /* Time for the directory tree to scroll to a given entry (in seconds) */
 #define DIRTREE_SCROLL_TIME 0.5
 
-/* Column indices in the TreeStore (must match gui.c CTREE_COL_* enum) */
+/* Column indices in the tree model (must match gui.c CTREE_COL_* enum) */
 enum {
 	COL_PIXBUF = 0,
 	COL_NAME   = 1,
@@ -63,11 +64,436 @@ static Icon dir_colexp_mini_icons[2];
 static GNode *dirtree_current_dnode;
 
 
-/* Helper: get the TreeStore model from the tree view */
-static GtkTreeStore *
-get_tree_store( void )
+/**** Directory tree model ****/
+
+/* The directory tree is shown through a custom GtkTreeModel that serves
+ * rows straight out of the filesystem tree, rather than through a
+ * GtkTreeStore holding a copy of every directory. An iter's user_data is
+ * the directory node; user_data2 is its row index among its siblings.
+ *
+ * Subdirectories are listed in alphabetical order, whereas the
+ * filesystem tree is sorted by size. The alphabetical row index of a
+ * directory's subdirectories is built the first time the view asks about
+ * them, so only directories that have been shown cost any memory */
+
+/* Row index for the subdirectories of one directory */
+typedef struct _DirTreeRows DirTreeRows;
+struct _DirTreeRows {
+	int	count;		/* Number of subdirectories */
+	GNode	**dnodes;	/* Subdirectories, sorted by name */
+};
+
+typedef struct _DirTreeModel DirTreeModel;
+typedef struct _DirTreeModelClass DirTreeModelClass;
+
+struct _DirTreeModel {
+	GObject		parent;
+	int		stamp;		/* Validity stamp for iters */
+	GHashTable	*rows_table;	/* Directory node -> DirTreeRows */
+};
+
+struct _DirTreeModelClass {
+	GObjectClass	parent_class;
+};
+
+static void dir_tree_model_tree_model_init( GtkTreeModelIface *iface );
+
+G_DEFINE_TYPE_WITH_CODE(DirTreeModel, dir_tree_model, G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, dir_tree_model_tree_model_init))
+
+#define DIR_TREE_MODEL(obj)	G_TYPE_CHECK_INSTANCE_CAST((obj), dir_tree_model_get_type( ), DirTreeModel)
+
+/* The model currently attached to the tree view (NULL during a scan) */
+static DirTreeModel *dirtree_model = NULL;
+
+
+/* Compare function for sorting subdirectory rows by name */
+static int
+compare_dnode_name( const GNode **a, const GNode **b )
+{
+	return strcmp( NODE_DESC(*a)->name, NODE_DESC(*b)->name );
+}
+
+
+/* Frees a row index (hash table value destructor) */
+static void
+dir_tree_rows_free( DirTreeRows *rows )
+{
+	memstat_add( MEMSTAT_DIRTREE, - rows->count, - (int64)(sizeof(DirTreeRows) + rows->count * sizeof(GNode *)) );
+	if (rows->dnodes != NULL)
+		xfree( rows->dnodes );
+	xfree( rows );
+}
+
+
+/* Returns the row index for the subdirectories of the given directory,
+ * building it if necessary */
+static DirTreeRows *
+dir_tree_rows( DirTreeModel *model, GNode *dnode )
+{
+	DirTreeRows *rows;
+	GNode *node;
+	int i;
+
+	rows = g_hash_table_lookup( model->rows_table, dnode );
+	if (rows != NULL)
+		return rows;
+
+	/* Directories always come before leaf nodes */
+	rows = NEW(DirTreeRows);
+	rows->count = 0;
+	node = dnode->children;
+	while ((node != NULL) && NODE_IS_DIR(node)) {
+		++rows->count;
+		node = node->next;
+	}
+
+	rows->dnodes = NULL;
+	if (rows->count > 0) {
+		rows->dnodes = NEW_ARRAY(GNode *, rows->count);
+		node = dnode->children;
+		for (i = 0; i < rows->count; i++) {
+			rows->dnodes[i] = node;
+			node = node->next;
+		}
+		qsort( rows->dnodes, rows->count, sizeof(GNode *), (int (*)( const void *, const void * ))compare_dnode_name );
+	}
+
+	g_hash_table_insert( model->rows_table, dnode, rows );
+	memstat_add( MEMSTAT_DIRTREE, rows->count, sizeof(DirTreeRows) + rows->count * sizeof(GNode *) );
+
+	return rows;
+}
+
+
+/* Returns the row index of a directory among its siblings */
+static int
+dir_tree_row_index( DirTreeModel *model, GNode *dnode )
+{
+	DirTreeRows *rows;
+	int lo, hi, mid, c;
+
+	rows = dir_tree_rows( model, dnode->parent );
+	lo = 0;
+	hi = rows->count - 1;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		c = strcmp( NODE_DESC(dnode)->name, NODE_DESC(rows->dnodes[mid])->name );
+		if (c == 0)
+			return mid;
+		if (c < 0)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+
+	g_assert_not_reached( );
+	return 0;
+}
+
+
+/* Fills in an iter pointing at the given directory */
+static void
+dir_tree_iter_set( DirTreeModel *model, GtkTreeIter *iter, GNode *dnode, int index )
+{
+	iter->stamp = model->stamp;
+	iter->user_data = dnode;
+	iter->user_data2 = GINT_TO_POINTER(index);
+	iter->user_data3 = NULL;
+}
+
+
+static GtkTreeModelFlags
+dir_tree_model_get_flags( G_GNUC_UNUSED GtkTreeModel *tree_model )
+{
+	return GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+
+static gint
+dir_tree_model_get_n_columns( G_GNUC_UNUSED GtkTreeModel *tree_model )
+{
+	return 3;
+}
+
+
+static GType
+dir_tree_model_get_column_type( G_GNUC_UNUSED GtkTreeModel *tree_model, gint index )
+{
+	switch (index) {
+		case COL_PIXBUF:
+		return GDK_TYPE_PIXBUF;
+
+		case COL_NAME:
+		return G_TYPE_STRING;
+
+		case COL_DATA:
+		return G_TYPE_POINTER;
+
+		default:
+		return G_TYPE_INVALID;
+	}
+}
+
+
+static gboolean
+dir_tree_model_get_iter( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path )
+{
+	DirTreeModel *model = DIR_TREE_MODEL(tree_model);
+	DirTreeRows *rows;
+	GNode *dnode;
+	gint *indices;
+	int depth, i;
+
+	indices = gtk_tree_path_get_indices( path );
+	depth = gtk_tree_path_get_depth( path );
+	if (depth <= 0)
+		return FALSE;
+
+	/* Top-level rows are the children of the metanode */
+	dnode = globals.fstree;
+	for (i = 0; i < depth; i++) {
+		rows = dir_tree_rows( model, dnode );
+		if ((indices[i] < 0) || (indices[i] >= rows->count))
+			return FALSE;
+		dnode = rows->dnodes[indices[i]];
+	}
+
+	dir_tree_iter_set( model, iter, dnode, indices[depth - 1] );
+
+	return TRUE;
+}
+
+
+static GtkTreePath *
+dir_tree_model_get_path( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	DirTreeModel *model = DIR_TREE_MODEL(tree_model);
+	GtkTreePath *path;
+	GNode *dnode;
+
+	g_return_val_if_fail( iter->stamp == model->stamp, NULL );
+
+	path = gtk_tree_path_new( );
+	dnode = (GNode *)iter->user_data;
+	gtk_tree_path_prepend_index( path, GPOINTER_TO_INT(iter->user_data2) );
+	dnode = dnode->parent;
+	while (!NODE_IS_METANODE(dnode)) {
+		gtk_tree_path_prepend_index( path, dir_tree_row_index( model, dnode ) );
+		dnode = dnode->parent;
+	}
+
+	return path;
+}
+
+
+static void
+dir_tree_model_get_value( G_GNUC_UNUSED GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value )
+{
+	GNode *dnode = (GNode *)iter->user_data;
+	const char *name;
+
+	switch (column) {
+		case COL_PIXBUF:
+		g_value_init( value, GDK_TYPE_PIXBUF );
+		g_value_set_object( value, dir_colexp_mini_icons[dirtree_entry_expanded( dnode ) ? 1 : 0].pixbuf );
+		break;
+
+		case COL_NAME:
+		g_value_init( value, G_TYPE_STRING );
+		if (strlen( NODE_DESC(dnode)->name ) > 0)
+			name = NODE_DESC(dnode)->name;
+		else
+			name = _("/. (root)");
+		g_value_set_static_string( value, name );
+		break;
+
+		case COL_DATA:
+		g_value_init( value, G_TYPE_POINTER );
+		g_value_set_pointer( value, dnode );
+		break;
+
+		SWITCH_FAIL
+	}
+}
+
+
+static gboolean
+dir_tree_model_iter_next( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	DirTreeModel *model = DIR_TREE_MODEL(tree_model);
+	DirTreeRows *rows;
+	GNode *dnode = (GNode *)iter->user_data;
+	int index;
+
+	rows = dir_tree_rows( model, dnode->parent );
+	index = GPOINTER_TO_INT(iter->user_data2) + 1;
+	if (index >= rows->count)
+		return FALSE;
+
+	dir_tree_iter_set( model, iter, rows->dnodes[index], index );
+
+	return TRUE;
+}
+
+
+static gboolean
+dir_tree_model_iter_previous( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	DirTreeModel *model = DIR_TREE_MODEL(tree_model);
+	DirTreeRows *rows;
+	GNode *dnode = (GNode *)iter->user_data;
+	int index;
+
+	rows = dir_tree_rows( model, dnode->parent );
+	index = GPOINTER_TO_INT(iter->user_data2) - 1;
+	if (index < 0)
+		return FALSE;
+
+	dir_tree_iter_set( model, iter, rows->dnodes[index], index );
+
+	return TRUE;
+}
+
+
+static gboolean
+dir_tree_model_iter_nth_child( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n )
+{
+	DirTreeModel *model = DIR_TREE_MODEL(tree_model);
+	DirTreeRows *rows;
+	GNode *dnode;
+
+	if (parent == NULL)
+		dnode = globals.fstree;
+	else
+		dnode = (GNode *)parent->user_data;
+
+	rows = dir_tree_rows( model, dnode );
+	if ((n < 0) || (n >= rows->count))
+		return FALSE;
+
+	dir_tree_iter_set( model, iter, rows->dnodes[n], n );
+
+	return TRUE;
+}
+
+
+static gboolean
+dir_tree_model_iter_children( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent )
+{
+	return dir_tree_model_iter_nth_child( tree_model, iter, parent, 0 );
+}
+
+
+static gboolean
+dir_tree_model_iter_has_child( G_GNUC_UNUSED GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	GNode *dnode = (GNode *)iter->user_data;
+
+	/* Directories always come before leaf nodes */
+	return (dnode->children != NULL) && NODE_IS_DIR(dnode->children);
+}
+
+
+static gint
+dir_tree_model_iter_n_children( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	DirTreeModel *model = DIR_TREE_MODEL(tree_model);
+
+	if (iter == NULL)
+		return dir_tree_rows( model, globals.fstree )->count;
+
+	return dir_tree_rows( model, (GNode *)iter->user_data )->count;
+}
+
+
+static gboolean
+dir_tree_model_iter_parent( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child )
+{
+	DirTreeModel *model = DIR_TREE_MODEL(tree_model);
+	GNode *dnode = (GNode *)child->user_data;
+
+	if (NODE_IS_METANODE(dnode->parent))
+		return FALSE;
+
+	dir_tree_iter_set( model, iter, dnode->parent, dir_tree_row_index( model, dnode->parent ) );
+
+	return TRUE;
+}
+
+
+static void
+dir_tree_model_finalize( GObject *object )
+{
+	DirTreeModel *model = DIR_TREE_MODEL(object);
+
+	g_hash_table_destroy( model->rows_table );
+
+	G_OBJECT_CLASS(dir_tree_model_parent_class)->finalize( object );
+}
+
+
+static void
+dir_tree_model_tree_model_init( GtkTreeModelIface *iface )
+{
+	iface->get_flags = dir_tree_model_get_flags;
+	iface->get_n_columns = dir_tree_model_get_n_columns;
+	iface->get_column_type = dir_tree_model_get_column_type;
+	iface->get_iter = dir_tree_model_get_iter;
+	iface->get_path = dir_tree_model_get_path;
+	iface->get_value = dir_tree_model_get_value;
+	iface->iter_next = dir_tree_model_iter_next;
+	iface->iter_previous = dir_tree_model_iter_previous;
+	iface->iter_children = dir_tree_model_iter_children;
+	iface->iter_has_child = dir_tree_model_iter_has_child;
+	iface->iter_n_children = dir_tree_model_iter_n_children;
+	iface->iter_nth_child = dir_tree_model_iter_nth_child;
+	iface->iter_parent = dir_tree_model_iter_parent;
+}
+
+
+static void
+dir_tree_model_class_init( DirTreeModelClass *klass )
+{
+	G_OBJECT_CLASS(klass)->finalize = dir_tree_model_finalize;
+}
+
+
+static void
+dir_tree_model_init( DirTreeModel *model )
+{
+	static int next_stamp = 1;
+
+	model->stamp = next_stamp++;
+	model->rows_table = g_hash_table_new_full( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)dir_tree_rows_free );
+}
+
+
+/* Fills in an iter/path for the given directory's entry. The path
+ * should be freed by the caller. Returns FALSE if there is no model */
+static boolean
+dirtree_entry_locate( GNode *dnode, GtkTreeIter *iter, GtkTreePath **path )
 {
-	return GTK_TREE_STORE(gtk_tree_view_get_model( GTK_TREE_VIEW(dir_tree_w) ));
+	if (dirtree_model == NULL)
+		return FALSE;
+
+	dir_tree_iter_set( dirtree_model, iter, dnode, dir_tree_row_index( dirtree_model, dnode ) );
+	if (path != NULL)
+		*path = dir_tree_model_get_path( GTK_TREE_MODEL(dirtree_model), iter );
+
+	return TRUE;
+}
+
+
+/* Makes the tree view redraw a directory's entry (e.g. for a new icon) */
+static void
+dirtree_entry_changed( GtkTreeIter *iter )
+{
+	GtkTreePath *path;
+
+	path = dir_tree_model_get_path( GTK_TREE_MODEL(dirtree_model), iter );
+	gtk_tree_model_row_changed( GTK_TREE_MODEL(dirtree_model), path, iter );
+	gtk_tree_path_free( path );
 }
 
 
@@ -75,28 +501,32 @@ get_tree_store( void )
 static GNode *
 dnode_from_path( GtkTreePath *path )
 {
-	GtkTreeStore *store = get_tree_store( );
 	GtkTreeIter iter;
-	GNode *dnode = NULL;
 
-	if (gtk_tree_model_get_iter( GTK_TREE_MODEL(store), &iter, path ))
-		gtk_tree_model_get( GTK_TREE_MODEL(store), &iter, COL_DATA, &dnode, -1 );
+	if ((dirtree_model != NULL) && dir_tree_model_get_iter( GTK_TREE_MODEL(dirtree_model), &iter, path ))
+		return (GNode *)iter.user_data;
 
-	return dnode;
+	return NULL;
 }
 
 
-/* Helper: get GNode from a tree iter */
-static GNode *
-dnode_from_iter( GtkTreeIter *iter )
+/**** Directory tree ****/
+
+/* Sets the expansion flag of every directory in the given subtree */
+static void
+dirtree_set_expanded_recursive( GNode *dnode, boolean expanded )
 {
-	GtkTreeStore *store = get_tree_store( );
-	GNode *dnode = NULL;
+	GNode *node;
 
-	gtk_tree_model_get( GTK_TREE_MODEL(store), iter, COL_DATA, &dnode, -1 );
-	return dnode;
-}
+	DIR_NODE_DESC(dnode)->tree_expanded = expanded;
 
+	/* Directories always come before leaf nodes */
+	node = dnode->children;
+	while ((node != NULL) && NODE_IS_DIR(node)) {
+		dirtree_set_expanded_recursive( node, expanded );
+		node = node->next;
+	}
+}
 
 /* Callback for button press in the directory tree area */
 static int
@@ -171,19 +601,19 @@ dirtree_select_cb( GtkWidget *tree_w, GdkEventButton *ev_button )
 static void
 dirtree_collapse_cb( G_GNUC_UNUSED GtkTreeView *tree_view, GtkTreeIter *iter, G_GNUC_UNUSED GtkTreePath *path, G_GNUC_UNUSED gpointer user_data )
 {
-	GtkTreeStore *store;
 	GNode *dnode;
 
-	if (globals.fsv_mode == FSV_SPLASH)
-		return;
+	dnode = (GNode *)iter->user_data;
 
-	dnode = dnode_from_iter( iter );
-	if (dnode == NULL)
-		return;
+	/* The tree view has dropped the expansion state of all rows
+	 * under this one, so do likewise */
+	dirtree_set_expanded_recursive( dnode, FALSE );
 
 	/* Update the icon to collapsed */
-	store = get_tree_store( );
-	gtk_tree_store_set( store, iter, COL_PIXBUF, dir_colexp_mini_icons[0].pixbuf, -1 );
+	dirtree_entry_changed( iter );
+
+	if (globals.fsv_mode == FSV_SPLASH)
+		return;
 
 	colexp( dnode, COLEXP_COLLAPSE_RECURSIVE );
 }
@@ -193,19 +623,16 @@ dirtree_collapse_cb( G_GNUC_UNUSED GtkTreeView *tree_view, GtkTreeIter *iter, G_
 static void
 dirtree_expand_cb( G_GNUC_UNUSED GtkTreeView *tree_view, GtkTreeIter *iter, G_GNUC_UNUSED GtkTreePath *path, G_GNUC_UNUSED gpointer user_data )
 {
-	GtkTreeStore *store;
 	GNode *dnode;
 
-	if (globals.fsv_mode == FSV_SPLASH)
-		return;
-
-	dnode = dnode_from_iter( iter );
-	if (dnode == NULL)
-		return;
+	dnode = (GNode *)iter->user_data;
+	DIR_NODE_DESC(dnode)->tree_expanded = TRUE;
 
 	/* Update the icon to expanded */
-	store = get_tree_store( );
-	gtk_tree_store_set( store, iter, COL_PIXBUF, dir_colexp_mini_icons[1].pixbuf, -1 );
+	dirtree_entry_changed( iter );
+
+	if (globals.fsv_mode == FSV_SPLASH)
+		return;
 
 	colexp( dnode, COLEXP_EXPAND );
 }
@@ -241,55 +668,39 @@ dirtree_pass_widget( GtkWidget *tree_w )
 }
 
 
-/* Clears out all entries from the directory tree */
+/* Clears out all entries from the directory tree. This must be called
+ * before the filesystem tree is freed */
 void
 dirtree_clear( void )
 {
-	GtkTreeStore *store = get_tree_store( );
-
-	gtk_tree_store_clear( store );
+	gtk_tree_view_set_model( GTK_TREE_VIEW(dir_tree_w), NULL );
+	if (dirtree_model != NULL) {
+		g_object_unref( dirtree_model );
+		dirtree_model = NULL;
+	}
 	dirtree_current_dnode = NULL;
 }
 
 
-/* Adds a new entry to the directory tree */
+/* Call this after the filesystem tree has been fully built. This hooks
+ * up a model over the new tree, and opens the root directory entry */
 void
-dirtree_entry_new( GNode *dnode )
+dirtree_no_more_entries( void )
 {
-	GtkTreeIter *parent_iter = NULL;
-	GtkTreeIter *new_iter;
-	const char *name;
-	boolean expanded;
-
-	g_assert( NODE_IS_DIR(dnode) );
+	GtkTreeIter iter;
+	GtkTreePath *path;
 
-	parent_iter = DIR_NODE_DESC(dnode->parent)->ctnode;
-	if (strlen( NODE_DESC(dnode)->name ) > 0)
-		name = NODE_DESC(dnode)->name;
-	else
-		name = _("/. (root)");
-	expanded = g_node_depth( dnode ) <= 2;
-
-	new_iter = gui_ctree_node_add( dir_tree_w, parent_iter, dir_colexp_mini_icons, name, expanded, dnode );
-	DIR_NODE_DESC(dnode)->ctnode = new_iter;
-
-	if (parent_iter != NULL && dirtree_entry_expanded( dnode->parent )) {
-		/* Select the new entry */
-		GtkTreeSelection *sel = gtk_tree_view_get_selection( GTK_TREE_VIEW(dir_tree_w) );
-		gtk_tree_selection_select_iter( sel, new_iter );
-		/* Scroll to the new entry */
-		GtkTreePath *path = gtk_tree_model_get_path( GTK_TREE_MODEL(get_tree_store( )), new_iter );
-		gtk_tree_view_scroll_to_cell( GTK_TREE_VIEW(dir_tree_w), path, NULL, FALSE, 0.0, 0.0 );
-		gtk_tree_path_free( path );
-	}
-}
+	g_assert( dirtree_model == NULL );
 
+	dirtree_model = g_object_new( dir_tree_model_get_type( ), NULL );
+	gtk_tree_view_set_model( GTK_TREE_VIEW(dir_tree_w), GTK_TREE_MODEL(dirtree_model) );
 
-/* Call this after the last call to dirtree_entry_new( ) */
-void
-dirtree_no_more_entries( void )
-{
-	/* No freeze/thaw needed with GtkTreeView */
+	/* Bring the view in line with the expansion flags. (A new tree
+	 * has only the root directory expanded) */
+	DIR_NODE_DESC(root_dnode)->tree_expanded = TRUE;
+	dirtree_entry_locate( root_dnode, &iter, &path );
+	gtk_tree_view_expand_row( GTK_TREE_VIEW(dir_tree_w), path, FALSE );
+	gtk_tree_path_free( path );
 }
 
 
@@ -299,7 +710,7 @@ dirtree_no_more_entries( void )
 void
 dirtree_entry_show( GNode *dnode )
 {
-	GtkTreeIter *iter;
+	GtkTreeIter iter;
 	GtkTreePath *path;
 	GtkTreeSelection *sel;
 
@@ -311,21 +722,16 @@ dirtree_entry_show( GNode *dnode )
 		gui_update( );
 	}
 
-	iter = DIR_NODE_DESC(dnode)->ctnode;
-	if (iter != NULL) {
-		path = gtk_tree_model_get_path( GTK_TREE_MODEL(get_tree_store( )), iter );
-		if (path != NULL) {
-			/* Select the entry */
-			sel = gtk_tree_view_get_selection( GTK_TREE_VIEW(dir_tree_w) );
-			gtk_tree_selection_select_iter( sel, iter );
-			/* Scroll to the entry */
-			gtk_tree_view_scroll_to_cell( GTK_TREE_VIEW(dir_tree_w), path, NULL, TRUE, 0.5, 0.0 );
-			gtk_tree_path_free( path );
-		}
+	sel = gtk_tree_view_get_selection( GTK_TREE_VIEW(dir_tree_w) );
+	if (dirtree_entry_locate( dnode, &iter, &path )) {
+		/* Select the entry */
+		gtk_tree_selection_select_iter( sel, &iter );
+		/* Scroll to the entry */
+		gtk_tree_view_scroll_to_cell( GTK_TREE_VIEW(dir_tree_w), path, NULL, TRUE, 0.5, 0.0 );
+		gtk_tree_path_free( path );
 	}
 	else {
-		/* No iter - unselect all */
-		GtkTreeSelection *sel = gtk_tree_view_get_selection( GTK_TREE_VIEW(dir_tree_w) );
+		/* No entry - unselect all */
 		gtk_tree_selection_unselect_all( sel );
 	}
 
@@ -333,28 +739,15 @@ dirtree_entry_show( GNode *dnode )
 }
 
 
-/* Returns TRUE if the entry for the given directory is expanded */
+/* Returns TRUE if the entry for the given directory is expanded. This
+ * only reads the directory's expansion flag, so it is cheap enough for
+ * layout and drawing code to call freely */
 boolean
 dirtree_entry_expanded( GNode *dnode )
 {
-	GtkTreeIter *iter;
-	GtkTreePath *path;
-	boolean expanded;
-
 	g_assert( NODE_IS_DIR(dnode) );
 
-	iter = DIR_NODE_DESC(dnode)->ctnode;
-	if (iter == NULL)
-		return FALSE;
-
-	path = gtk_tree_model_get_path( GTK_TREE_MODEL(get_tree_store( )), iter );
-	if (path == NULL)
-		return FALSE;
-
-	expanded = gtk_tree_view_row_expanded( GTK_TREE_VIEW(dir_tree_w), path );
-	gtk_tree_path_free( path );
-
-	return expanded;
+	return DIR_NODE_DESC(dnode)->tree_expanded;
 }
 
 
@@ -376,57 +769,27 @@ unblock_colexp_handlers( void )
 }
 
 
-/* Helper: recursively collapse a row and all its children */
-static void
-collapse_recursive( GtkTreeView *tree_view, GtkTreeIter *iter )
-{
-	GtkTreeModel *model = gtk_tree_view_get_model( tree_view );
-	GtkTreeIter child;
-	GtkTreePath *path;
-
-	/* Collapse children first (depth-first) */
-	if (gtk_tree_model_iter_children( model, &child, iter )) {
-		do {
-			collapse_recursive( tree_view, &child );
-		} while (gtk_tree_model_iter_next( model, &child ));
-	}
-
-	/* Collapse this row */
-	path = gtk_tree_model_get_path( model, iter );
-	gtk_tree_view_collapse_row( tree_view, path );
-	/* Update icon to collapsed */
-	gtk_tree_store_set( GTK_TREE_STORE(model), iter, COL_PIXBUF, dir_colexp_mini_icons[0].pixbuf, -1 );
-	gtk_tree_path_free( path );
-}
-
-
-/* Recursively collapses the directory tree entry of the given directory */
+/* Recursively collapses the directory tree entry of the given directory.
+ * (GtkTreeView forgets the expansion state of a collapsed row's
+ * descendants, so collapsing the row itself is sufficient) */
 void
 dirtree_entry_collapse_recursive( GNode *dnode )
 {
-	GtkTreeIter *iter;
+	GtkTreeIter iter;
+	GtkTreePath *path;
 
 	g_assert( NODE_IS_DIR(dnode) );
 
-	iter = DIR_NODE_DESC(dnode)->ctnode;
-	if (iter == NULL)
+	dirtree_set_expanded_recursive( dnode, FALSE );
+
+	if (!dirtree_entry_locate( dnode, &iter, &path ))
 		return;
 
 	block_colexp_handlers( );
-	collapse_recursive( GTK_TREE_VIEW(dir_tree_w), iter );
+	gtk_tree_view_collapse_row( GTK_TREE_VIEW(dir_tree_w), path );
+	gtk_tree_model_row_changed( GTK_TREE_MODEL(dirtree_model), path, &iter );
 	unblock_colexp_handlers( );
-}
 
-
-/* Helper: expand a row and update its icon */
-static void
-expand_row( GtkTreeView *tree_view, GtkTreeIter *iter )
-{
-	GtkTreeModel *model = gtk_tree_view_get_model( tree_view );
-	GtkTreePath *path = gtk_tree_model_get_path( model, iter );
-
-	gtk_tree_view_expand_row( tree_view, path, FALSE );
-	gtk_tree_store_set( GTK_TREE_STORE(model), iter, COL_PIXBUF, dir_colexp_mini_icons[1].pixbuf, -1 );
 	gtk_tree_path_free( path );
 }
 
@@ -437,39 +800,33 @@ expand_row( GtkTreeView *tree_view, GtkTreeIter *iter )
 void
 dirtree_entry_expand( GNode *dnode )
 {
+	GtkTreeIter iter;
+	GtkTreePath *path;
 	GNode *up_node;
 
 	g_assert( NODE_IS_DIR(dnode) );
 
-	block_colexp_handlers( );
 	up_node = dnode;
 	while (NODE_IS_DIR(up_node)) {
-		if (!dirtree_entry_expanded( up_node )) {
-			GtkTreeIter *iter = DIR_NODE_DESC(up_node)->ctnode;
-			if (iter != NULL)
-				expand_row( GTK_TREE_VIEW(dir_tree_w), iter );
-		}
+		DIR_NODE_DESC(up_node)->tree_expanded = TRUE;
 		up_node = up_node->parent;
 	}
-	unblock_colexp_handlers( );
-}
 
+	if (!dirtree_entry_locate( dnode, &iter, &path ))
+		return;
 
-/* Helper: recursively expand a row and all its children */
-static void
-expand_recursive( GtkTreeView *tree_view, GtkTreeIter *iter )
-{
-	GtkTreeModel *model = gtk_tree_view_get_model( tree_view );
-	GtkTreeIter child;
-
-	/* Expand this row */
-	expand_row( tree_view, iter );
+	/* This opens any collapsed ancestor rows too */
+	block_colexp_handlers( );
+	gtk_tree_view_expand_to_path( GTK_TREE_VIEW(dir_tree_w), path );
+	gtk_tree_path_free( path );
+	unblock_colexp_handlers( );
 
-	/* Expand children */
-	if (gtk_tree_model_iter_children( model, &child, iter )) {
-		do {
-			expand_recursive( tree_view, &child );
-		} while (gtk_tree_model_iter_next( model, &child ));
+	/* Refresh icons */
+	up_node = dnode;
+	while (NODE_IS_DIR(up_node)) {
+		dirtree_entry_locate( up_node, &iter, NULL );
+		dirtree_entry_changed( &iter );
+		up_node = up_node->parent;
 	}
 }
 
@@ -479,7 +836,8 @@ expand_recursive( GtkTreeView *tree_view, GtkTreeIter *iter )
 void
 dirtree_entry_expand_recursive( GNode *dnode )
 {
-	GtkTreeIter *iter;
+	GtkTreeIter iter;
+	GtkTreePath *path;
 
 	g_assert( NODE_IS_DIR(dnode) );
 
@@ -489,13 +847,19 @@ dirtree_entry_expand_recursive( GNode *dnode )
 		g_assert( dirtree_entry_expanded( dnode->parent ) );
 #endif
 
-	iter = DIR_NODE_DESC(dnode)->ctnode;
-	if (iter == NULL)
+	dirtree_set_expanded_recursive( dnode, TRUE );
+
+	if (!dirtree_entry_locate( dnode, &iter, &path ))
 		return;
 
+	/* Icons of descendant rows are computed as they come into view,
+	 * so only this row needs an explicit refresh */
 	block_colexp_handlers( );
-	expand_recursive( GTK_TREE_VIEW(dir_tree_w), iter );
+	gtk_tree_view_expand_row( GTK_TREE_VIEW(dir_tree_w), path, TRUE );
+	gtk_tree_model_row_changed( GTK_TREE_MODEL(dirtree_model), path, &iter );
 	unblock_colexp_handlers( );
+
+	gtk_tree_path_free( path );
 }
 
 
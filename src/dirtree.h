@@ -32,7 +32,6 @@
 void dirtree_pass_widget( GtkWidget *ctree_w );
 #endif
 void dirtree_clear( void );
-void dirtree_entry_new( GNode *dnode );
 void dirtree_no_more_entries( void );
 void dirtree_entry_show( GNode *dnode );
 boolean dirtree_entry_expanded( GNode *dnode );
@@ -25,6 +25,8 @@
 #include "common.h"
 #include "filelist.h"
 
+#include <pwd.h>
+#include <time.h>
 #include <gtk/gtk.h>
 
 #include "about.h"
@@ -33,20 +35,42 @@
 #include "dirtree.h"
 #include "geometry.h"
 #include "gui.h"
+#include "memstat.h"
 #include "window.h"
 
 
 /* Time for the filelist to scroll to a given entry (in seconds) */
 #define FILELIST_SCROLL_TIME 0.5
 
-/* Model column indices for the normal file list (1 visible column).
- * Model: pixbuf (0), name (1), node_ptr (2) */
+/* Directories with at least this many entries have all of their sort
+ * orders computed at once, in parallel */
+#define FILELIST_PARALLEL_SORT_MIN 65536
+
+/* Model column indices for the normal file list (6 visible columns).
+ * Model: pixbuf (0), name (1), size (2), allocation size (3),
+ * modification time (4), owner (5), type (6), node_ptr (7) */
 enum {
-	FLIST_COL_PIXBUF = 0,
-	FLIST_COL_NAME   = 1,
-	FLIST_COL_DATA   = 2
+	FLIST_COL_PIXBUF     = 0,
+	FLIST_COL_NAME       = 1,
+	FLIST_COL_SIZE       = 2,
+	FLIST_COL_SIZE_ALLOC = 3,
+	FLIST_COL_MTIME      = 4,
+	FLIST_COL_OWNER      = 5,
+	FLIST_COL_TYPE       = 6,
+	FLIST_COL_DATA       = 7
 };
 
+/* Sort keys, one per visible column (in the same order) */
+typedef enum {
+	FLIST_SORT_NAME,
+	FLIST_SORT_SIZE,
+	FLIST_SORT_SIZE_ALLOC,
+	FLIST_SORT_MTIME,
+	FLIST_SORT_OWNER,
+	FLIST_SORT_TYPE,
+	FLIST_NUM_SORTS
+} FileListSort;
+
 /* Model column indices for the scan monitor (3 visible columns).
  * Model: pixbuf (0), type (1), found (2), bytes (3), data (4) */
 enum {
@@ -109,83 +133,806 @@ filelist_reset_access( void )
 }
 
 
-/* Compare function for sorting nodes alphabetically */
+/**** Sort orders ****/
+
+/* Each column of the file list can sort the listing. Rather than
+ * reordering rows on every click, each directory keeps one permutation
+ * array per sort key (row -> entry), plus its inverse (entry -> row) for
+ * going from a node back to its row. A permutation is computed the first
+ * time it is needed, and kept until the next scan; descending order just
+ * reads it backwards. Big directories have all their permutations
+ * computed at once, each in its own thread */
+
+/* All sort orders of one directory's entries */
+typedef struct _FileListOrder FileListOrder;
+struct _FileListOrder {
+	int		count;		/* Number of entries */
+	GNode		**nodes;	/* Entries, in filesystem tree order */
+	GHashTable	*node_table;	/* Node -> entry index + 1 (lazy) */
+	int		*perms[FLIST_NUM_SORTS];	/* Row -> entry index */
+	int		*inverse[FLIST_NUM_SORTS];	/* Entry index -> row */
+};
+
+/* Element of the array that is sorted to get a permutation */
+typedef struct _FileListSortEntry FileListSortEntry;
+struct _FileListSortEntry {
+	GNode	*node;
+	int	index;		/* Entry index */
+};
+
+/* A permutation to be computed. Everything is allocated up front, so
+ * that a job can be run in any thread */
+typedef struct _FileListSortJob FileListSortJob;
+struct _FileListSortJob {
+	FileListOrder		*order;
+	FileListSort		key;
+	FileListSortEntry	*entries;
+};
+
+/* Sort orders of listed directories (directory node -> FileListOrder) */
+static GHashTable *order_cache = NULL;
+
+/* User names of owners seen so far (UID -> name) */
+static GHashTable *owner_names = NULL;
+
+/* Current sort key, and direction */
+static FileListSort filelist_sort_key = FLIST_SORT_NAME;
+static boolean filelist_sort_descending = FALSE;
+
+
+/* Returns the size shown for a node. For directories, this is the total
+ * size of everything underneath */
+static int64
+node_total_size( GNode *node )
+{
+	if (NODE_IS_DIR(node))
+		return NODE_DESC(node)->size + DIR_NODE_DESC(node)->subtree.size;
+
+	return NODE_DESC(node)->size;
+}
+
+
+/* Returns the user name of the given UID. The name is looked up (and
+ * remembered) if the UID has not been seen before */
+static const char *
+owner_name( uid_t user_id )
+{
+	struct passwd *pw;
+	char *name;
+
+	if (owner_names == NULL)
+		owner_names = g_hash_table_new( g_direct_hash, g_direct_equal );
+
+	name = g_hash_table_lookup( owner_names, GUINT_TO_POINTER(user_id) );
+	if (name == NULL) {
+		pw = getpwuid( user_id );
+		if (pw == NULL)
+			name = xstrdup( _("Unknown") );
+		else
+			name = xstrdup( pw->pw_name );
+		g_hash_table_insert( owner_names, GUINT_TO_POINTER(user_id), name );
+	}
+
+	return name;
+}
+
+
+/* Compare functions for the various sort keys. Ties are broken by name,
+ * so that every order is well-defined */
+
 static int
-compare_node( GNode *a, GNode *b )
+compare_name( const FileListSortEntry *a, const FileListSortEntry *b )
 {
-	return strcmp( NODE_DESC(a)->name, NODE_DESC(b)->name );
+	return strcmp( NODE_DESC(a->node)->name, NODE_DESC(b->node)->name );
 }
 
 
-/* Helper: find a row by its data pointer and return its path.
- * Returns NULL if not found. Caller must free the path. */
-static GtkTreePath *
-find_path_by_data( GtkTreeView *tree_view, gpointer data )
+static int
+compare_size( const FileListSortEntry *a, const FileListSortEntry *b )
 {
-	GtkTreeModel *model = gtk_tree_view_get_model( tree_view );
-	GtkTreeIter iter;
-	gboolean valid;
-	int num_cols_val;
-	int data_col;
+	int64 size_a, size_b;
 
-	/* Get data column index */
-	num_cols_val = *(int *)g_object_get_data( G_OBJECT(tree_view), "num_cols" );
-	data_col = num_cols_val + 1;
+	size_a = node_total_size( a->node );
+	size_b = node_total_size( b->node );
+	if (size_a != size_b)
+		return (size_a < size_b) ? -1 : 1;
 
-	valid = gtk_tree_model_get_iter_first( model, &iter );
-	while (valid) {
-		gpointer row_data;
-		gtk_tree_model_get( model, &iter, data_col, &row_data, -1 );
-		if (row_data == data)
-			return gtk_tree_model_get_path( model, &iter );
-		valid = gtk_tree_model_iter_next( model, &iter );
+	return compare_name( a, b );
+}
+
+
+static int
+compare_size_alloc( const FileListSortEntry *a, const FileListSortEntry *b )
+{
+	if (NODE_DESC(a->node)->size_alloc != NODE_DESC(b->node)->size_alloc)
+		return (NODE_DESC(a->node)->size_alloc < NODE_DESC(b->node)->size_alloc) ? -1 : 1;
+
+	return compare_name( a, b );
+}
+
+
+static int
+compare_mtime( const FileListSortEntry *a, const FileListSortEntry *b )
+{
+	if (NODE_DESC(a->node)->mtime != NODE_DESC(b->node)->mtime)
+		return (NODE_DESC(a->node)->mtime < NODE_DESC(b->node)->mtime) ? -1 : 1;
+
+	return compare_name( a, b );
+}
+
+
+/* Note: owner names must already be in owner_names, as this may be
+ * running in a worker thread */
+static int
+compare_owner( const FileListSortEntry *a, const FileListSortEntry *b )
+{
+	const char *name_a, *name_b;
+	int c;
+
+	if (NODE_DESC(a->node)->user_id != NODE_DESC(b->node)->user_id) {
+		name_a = g_hash_table_lookup( owner_names, GUINT_TO_POINTER(NODE_DESC(a->node)->user_id) );
+		name_b = g_hash_table_lookup( owner_names, GUINT_TO_POINTER(NODE_DESC(b->node)->user_id) );
+		c = strcmp( name_a, name_b );
+		if (c != 0)
+			return c;
 	}
-	return NULL;
+
+	return compare_name( a, b );
 }
 
 
-/* Displays contents of a directory in the file list */
-void
-filelist_populate( GNode *dnode )
+static int
+compare_type( const FileListSortEntry *a, const FileListSortEntry *b )
 {
+	if (NODE_DESC(a->node)->type != NODE_DESC(b->node)->type)
+		return (NODE_DESC(a->node)->type < NODE_DESC(b->node)->type) ? -1 : 1;
+
+	return compare_name( a, b );
+}
+
+
+/* Compare functions, by sort key */
+static int (*sort_compares[FLIST_NUM_SORTS])( const FileListSortEntry *, const FileListSortEntry * ) = {
+	compare_name,
+	compare_size,
+	compare_size_alloc,
+	compare_mtime,
+	compare_owner,
+	compare_type
+};
+
+
+/* Frees a directory's sort orders (hash table value destructor) */
+static void
+file_list_order_free( FileListOrder *order )
+{
+	int k;
+
+	for (k = 0; k < FLIST_NUM_SORTS; k++) {
+		if (order->perms[k] != NULL) {
+			xfree( order->perms[k] );
+			xfree( order->inverse[k] );
+		}
+	}
+	if (order->node_table != NULL)
+		g_hash_table_destroy( order->node_table );
+	if (order->nodes != NULL)
+		xfree( order->nodes );
+	xfree( order );
+}
+
+
+/* Returns the sort orders of the given directory. Only the entry array
+ * is set up here; permutations are computed as needed */
+static FileListOrder *
+file_list_order( GNode *dnode )
+{
+	FileListOrder *order;
 	GNode *node;
-	GList *node_list = NULL, *node_llink;
-	Icon *icon;
-	GtkListStore *store;
-	GtkTreeIter iter;
-	int count = 0;
+	int i, k;
+
+	if (order_cache == NULL)
+		order_cache = g_hash_table_new_full( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)file_list_order_free );
+
+	order = g_hash_table_lookup( order_cache, dnode );
+	if (order != NULL)
+		return order;
+
+	order = NEW(FileListOrder);
+	order->count = g_node_n_children( dnode );
+	order->nodes = NULL;
+	if (order->count > 0) {
+		order->nodes = NEW_ARRAY(GNode *, order->count);
+		node = dnode->children;
+		for (i = 0; i < order->count; i++) {
+			order->nodes[i] = node;
+			node = node->next;
+		}
+	}
+	order->node_table = NULL;
+	for (k = 0; k < FLIST_NUM_SORTS; k++) {
+		order->perms[k] = NULL;
+		order->inverse[k] = NULL;
+	}
+
+	g_hash_table_insert( order_cache, dnode, order );
+	memstat_add( MEMSTAT_FILELIST, order->count, sizeof(FileListOrder) + order->count * sizeof(GNode *) );
+
+	return order;
+}
+
+
+/* Returns the entry index of a node in a directory's sort orders */
+static int
+file_list_order_index( FileListOrder *order, GNode *node )
+{
+	int i;
+
+	if (order->node_table == NULL) {
+		order->node_table = g_hash_table_new( g_direct_hash, g_direct_equal );
+		for (i = 0; i < order->count; i++)
+			g_hash_table_insert( order->node_table, order->nodes[i], GINT_TO_POINTER(i + 1) );
+	}
+
+	return GPOINTER_TO_INT(g_hash_table_lookup( order->node_table, node )) - 1;
+}
+
+
+/* Allocates everything needed to compute a permutation */
+static void
+file_list_sort_job_init( FileListSortJob *job, FileListOrder *order, FileListSort key )
+{
+	int i;
+
+	job->order = order;
+	job->key = key;
+	job->entries = NEW_ARRAY(FileListSortEntry, order->count);
+	order->perms[key] = NEW_ARRAY(int, order->count);
+	order->inverse[key] = NEW_ARRAY(int, order->count);
+	memstat_add( MEMSTAT_FILELIST, 0, 2 * order->count * sizeof(int) );
+
+	/* Owner names cannot be looked up from a worker thread */
+	if (key == FLIST_SORT_OWNER) {
+		for (i = 0; i < order->count; i++)
+			owner_name( NODE_DESC(order->nodes[i])->user_id );
+	}
+}
+
+
+/* Computes a permutation (and its inverse). This may run in a worker
+ * thread, so it must not allocate memory or touch the GUI */
+static gpointer
+file_list_sort_job_run( gpointer data )
+{
+	FileListSortJob *job = (FileListSortJob *)data;
+	FileListOrder *order = job->order;
+	int *perm, *inverse;
+	int i;
+
+	for (i = 0; i < order->count; i++) {
+		job->entries[i].node = order->nodes[i];
+		job->entries[i].index = i;
+	}
+	qsort( job->entries, order->count, sizeof(FileListSortEntry), (int (*)( const void *, const void * ))sort_compares[job->key] );
+
+	perm = order->perms[job->key];
+	inverse = order->inverse[job->key];
+	for (i = 0; i < order->count; i++) {
+		perm[i] = job->entries[i].index;
+		inverse[perm[i]] = i;
+	}
+
+	return NULL;
+}
+
+
+/* Returns a directory's permutation for the given sort key, computing
+ * it if necessary */
+static const int *
+file_list_order_perm( FileListOrder *order, FileListSort key )
+{
+	FileListSortJob jobs[FLIST_NUM_SORTS];
+	GThread *threads[FLIST_NUM_SORTS];
+	int k;
+
+	/* Nothing to sort in an empty directory */
+	if ((order->perms[key] != NULL) || (order->count == 0))
+		return order->perms[key];
+
+	if (order->count < FILELIST_PARALLEL_SORT_MIN) {
+		/* Small directory: just the one permutation */
+		file_list_sort_job_init( &jobs[key], order, key );
+		file_list_sort_job_run( &jobs[key] );
+		xfree( jobs[key].entries );
+		return order->perms[key];
+	}
+
+	/* Big directory: compute all remaining permutations at once,
+	 * the requested one in this thread and the others in new ones */
+	for (k = 0; k < FLIST_NUM_SORTS; k++) {
+		threads[k] = NULL;
+		if (order->perms[k] == NULL)
+			file_list_sort_job_init( &jobs[k], order, (FileListSort)k );
+		else
+			jobs[k].entries = NULL;
+	}
+	for (k = 0; k < FLIST_NUM_SORTS; k++) {
+		if ((jobs[k].entries != NULL) && (k != (int)key))
+			threads[k] = g_thread_new( "filelist-sort", file_list_sort_job_run, &jobs[k] );
+	}
+	file_list_sort_job_run( &jobs[key] );
+	for (k = 0; k < FLIST_NUM_SORTS; k++) {
+		if (threads[k] != NULL)
+			g_thread_join( threads[k] );
+		if (jobs[k].entries != NULL)
+			xfree( jobs[k].entries );
+	}
+
+	return order->perms[key];
+}
+
+
+/* Throws away all sort orders. This must be done before the filesystem
+ * tree is freed */
+static void
+file_list_order_cache_clear( void )
+{
+	if (order_cache != NULL) {
+		g_hash_table_destroy( order_cache );
+		order_cache = NULL;
+	}
+	memstat_clear( MEMSTAT_FILELIST );
+}
+
+
+/**** File list model ****/
+
+/* The file list is shown through a custom GtkTreeModel that serves rows
+ * straight out of the filesystem tree, rather than through a
+ * GtkListStore holding a copy of every entry. Rows are materialized as
+ * the view asks for them, through the directory's permutation for the
+ * current sort key. An iter's user_data is the node; user_data2 is its
+ * row index. Going the other way (node to row) is done through the
+ * inverse permutation */
+
+typedef struct _FileListModel FileListModel;
+typedef struct _FileListModelClass FileListModelClass;
+
+struct _FileListModel {
+	GObject		parent;
+	int		stamp;		/* Validity stamp for iters */
+	GNode		*dnode;		/* Directory being listed */
+	FileListOrder	*order;		/* Its sort orders */
+	FileListSort	sort_key;	/* Sort key in effect */
+	boolean		descending;	/* TRUE if listed in reverse */
+	const int	*perm;		/* order->perms[sort_key] */
+};
+
+struct _FileListModelClass {
+	GObjectClass	parent_class;
+};
+
+static void file_list_model_tree_model_init( GtkTreeModelIface *iface );
+
+G_DEFINE_TYPE_WITH_CODE(FileListModel, file_list_model, G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, file_list_model_tree_model_init))
+
+#define FILE_LIST_MODEL(obj)	G_TYPE_CHECK_INSTANCE_CAST((obj), file_list_model_get_type( ), FileListModel)
+
+/* The model currently attached to the file list (NULL if none) */
+static FileListModel *filelist_model = NULL;
+
+
+/* Fills in an iter pointing at the given row */
+static void
+file_list_iter_set( FileListModel *model, GtkTreeIter *iter, int row )
+{
+	int r;
+
+	if (model->descending)
+		r = model->order->count - 1 - row;
+	else
+		r = row;
+
+	iter->stamp = model->stamp;
+	iter->user_data = model->order->nodes[model->perm[r]];
+	iter->user_data2 = GINT_TO_POINTER(row);
+	iter->user_data3 = NULL;
+}
+
+
+/* Returns the row index of the given node, or -1 if it is not listed */
+static int
+file_list_row_index( FileListModel *model, GNode *node )
+{
+	int row;
+
+	if (node->parent != model->dnode)
+		return -1;
+
+	row = model->order->inverse[model->sort_key][file_list_order_index( model->order, node )];
+	if (model->descending)
+		row = model->order->count - 1 - row;
+
+	return row;
+}
+
+
+static GtkTreeModelFlags
+file_list_model_get_flags( G_GNUC_UNUSED GtkTreeModel *tree_model )
+{
+	return GTK_TREE_MODEL_LIST_ONLY | GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+
+static gint
+file_list_model_get_n_columns( G_GNUC_UNUSED GtkTreeModel *tree_model )
+{
+	return FLIST_COL_DATA + 1;
+}
+
+
+static GType
+file_list_model_get_column_type( G_GNUC_UNUSED GtkTreeModel *tree_model, gint index )
+{
+	switch (index) {
+		case FLIST_COL_PIXBUF:
+		return GDK_TYPE_PIXBUF;
+
+		case FLIST_COL_NAME:
+		case FLIST_COL_SIZE:
+		case FLIST_COL_SIZE_ALLOC:
+		case FLIST_COL_MTIME:
+		case FLIST_COL_OWNER:
+		case FLIST_COL_TYPE:
+		return G_TYPE_STRING;
+
+		case FLIST_COL_DATA:
+		return G_TYPE_POINTER;
+
+		default:
+		return G_TYPE_INVALID;
+	}
+}
+
+
+static gboolean
+file_list_model_get_iter( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path )
+{
+	FileListModel *model = FILE_LIST_MODEL(tree_model);
+	int row;
+
+	if (gtk_tree_path_get_depth( path ) != 1)
+		return FALSE;
+
+	row = gtk_tree_path_get_indices( path )[0];
+	if ((row < 0) || (row >= model->order->count))
+		return FALSE;
+
+	file_list_iter_set( model, iter, row );
+
+	return TRUE;
+}
+
+
+static GtkTreePath *
+file_list_model_get_path( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	FileListModel *model = FILE_LIST_MODEL(tree_model);
+
+	g_return_val_if_fail( iter->stamp == model->stamp, NULL );
+
+	return gtk_tree_path_new_from_indices( GPOINTER_TO_INT(iter->user_data2), -1 );
+}
+
+
+static void
+file_list_model_get_value( G_GNUC_UNUSED GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value )
+{
+	GNode *node = (GNode *)iter->user_data;
+	struct tm *tm;
 	char strbuf[64];
 
-	g_assert( NODE_IS_DIR(dnode) );
+	switch (column) {
+		case FLIST_COL_PIXBUF:
+		g_value_init( value, GDK_TYPE_PIXBUF );
+		g_value_set_object( value, node_type_mini_icons[NODE_DESC(node)->type].pixbuf );
+		break;
+
+		case FLIST_COL_NAME:
+		g_value_init( value, G_TYPE_STRING );
+		g_value_set_static_string( value, NODE_DESC(node)->name );
+		break;
+
+		case FLIST_COL_SIZE:
+		g_value_init( value, G_TYPE_STRING );
+		g_value_set_string( value, abbrev_size( node_total_size( node ) ) );
+		break;
+
+		case FLIST_COL_SIZE_ALLOC:
+		g_value_init( value, G_TYPE_STRING );
+		g_value_set_string( value, abbrev_size( NODE_DESC(node)->size_alloc ) );
+		break;
+
+		case FLIST_COL_MTIME:
+		g_value_init( value, G_TYPE_STRING );
+		tm = localtime( &NODE_DESC(node)->mtime );
+		if ((tm == NULL) || (strftime( strbuf, sizeof(strbuf), "%Y-%m-%d %H:%M", tm ) == 0))
+			strcpy( strbuf, "" );
+		g_value_set_string( value, strbuf );
+		break;
+
+		case FLIST_COL_OWNER:
+		g_value_init( value, G_TYPE_STRING );
+		g_value_set_static_string( value, owner_name( NODE_DESC(node)->user_id ) );
+		break;
+
+		case FLIST_COL_TYPE:
+		g_value_init( value, G_TYPE_STRING );
+		g_value_set_static_string( value, _(node_type_names[NODE_DESC(node)->type]) );
+		break;
 
-	/* Get an alphabetized list of directory's immediate children */
-	node = dnode->children;
-	while (node != NULL) {
-		G_LIST_PREPEND(node_list, node);
-		node = node->next;
+		case FLIST_COL_DATA:
+		g_value_init( value, G_TYPE_POINTER );
+		g_value_set_pointer( value, node );
+		break;
+
+		SWITCH_FAIL
 	}
-	G_LIST_SORT(node_list, compare_node);
+}
 
-	/* Update file list */
-	store = GTK_LIST_STORE(gtk_tree_view_get_model( GTK_TREE_VIEW(file_tree_w) ));
-	gtk_list_store_clear( store );
-	node_llink = node_list;
-	while (node_llink != NULL) {
-		node = (GNode *)node_llink->data;
-		icon = &node_type_mini_icons[NODE_DESC(node)->type];
 
-		gtk_list_store_append( store, &iter );
-		gtk_list_store_set( store, &iter,
-			FLIST_COL_PIXBUF, icon->pixbuf,
-			FLIST_COL_NAME, NODE_DESC(node)->name,
-			FLIST_COL_DATA, node,
-			-1 );
+static gboolean
+file_list_model_iter_next( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	FileListModel *model = FILE_LIST_MODEL(tree_model);
+	int row;
+
+	row = GPOINTER_TO_INT(iter->user_data2) + 1;
+	if (row >= model->order->count)
+		return FALSE;
+
+	file_list_iter_set( model, iter, row );
+
+	return TRUE;
+}
+
+
+static gboolean
+file_list_model_iter_previous( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	FileListModel *model = FILE_LIST_MODEL(tree_model);
+	int row;
+
+	row = GPOINTER_TO_INT(iter->user_data2) - 1;
+	if (row < 0)
+		return FALSE;
+
+	file_list_iter_set( model, iter, row );
+
+	return TRUE;
+}
+
+
+static gboolean
+file_list_model_iter_nth_child( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n )
+{
+	FileListModel *model = FILE_LIST_MODEL(tree_model);
+
+	/* A flat list: only the (invisible) root has children */
+	if ((parent != NULL) || (n < 0) || (n >= model->order->count))
+		return FALSE;
+
+	file_list_iter_set( model, iter, n );
+
+	return TRUE;
+}
+
+
+static gboolean
+file_list_model_iter_children( GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent )
+{
+	return file_list_model_iter_nth_child( tree_model, iter, parent, 0 );
+}
+
+
+static gboolean
+file_list_model_iter_has_child( G_GNUC_UNUSED GtkTreeModel *tree_model, G_GNUC_UNUSED GtkTreeIter *iter )
+{
+	return FALSE;
+}
+
+
+static gint
+file_list_model_iter_n_children( GtkTreeModel *tree_model, GtkTreeIter *iter )
+{
+	if (iter == NULL)
+		return FILE_LIST_MODEL(tree_model)->order->count;
+
+	return 0;
+}
+
+
+static gboolean
+file_list_model_iter_parent( G_GNUC_UNUSED GtkTreeModel *tree_model, G_GNUC_UNUSED GtkTreeIter *iter, G_GNUC_UNUSED GtkTreeIter *child )
+{
+	return FALSE;
+}
+
+
+static void
+file_list_model_tree_model_init( GtkTreeModelIface *iface )
+{
+	iface->get_flags = file_list_model_get_flags;
+	iface->get_n_columns = file_list_model_get_n_columns;
+	iface->get_column_type = file_list_model_get_column_type;
+	iface->get_iter = file_list_model_get_iter;
+	iface->get_path = file_list_model_get_path;
+	iface->get_value = file_list_model_get_value;
+	iface->iter_next = file_list_model_iter_next;
+	iface->iter_previous = file_list_model_iter_previous;
+	iface->iter_children = file_list_model_iter_children;
+	iface->iter_has_child = file_list_model_iter_has_child;
+	iface->iter_n_children = file_list_model_iter_n_children;
+	iface->iter_nth_child = file_list_model_iter_nth_child;
+	iface->iter_parent = file_list_model_iter_parent;
+}
+
 
-		++count;
-		node_llink = node_llink->next;
+static void
+file_list_model_class_init( G_GNUC_UNUSED FileListModelClass *klass )
+{
+}
+
+
+static void
+file_list_model_init( FileListModel *model )
+{
+	static int next_stamp = 1;
+
+	model->stamp = next_stamp++;
+	model->dnode = NULL;
+	model->order = NULL;
+	model->perm = NULL;
+}
+
+
+/* Creates a model listing the immediate children of a directory, in
+ * the current sort order. The sort orders themselves belong to the
+ * cache, and outlive the model */
+static FileListModel *
+file_list_model_new( GNode *dnode )
+{
+	FileListModel *model;
+
+	model = g_object_new( file_list_model_get_type( ), NULL );
+	model->dnode = dnode;
+	model->order = file_list_order( dnode );
+	model->sort_key = filelist_sort_key;
+	model->descending = filelist_sort_descending;
+	model->perm = file_list_order_perm( model->order, model->sort_key );
+
+	return model;
+}
+
+
+/* Detaches and releases the current file list model, if any */
+static void
+filelist_model_release( void )
+{
+	if (filelist_model != NULL) {
+		if (file_tree_w != NULL)
+			gtk_tree_view_set_model( GTK_TREE_VIEW(file_tree_w), NULL );
+		g_object_unref( filelist_model );
+		filelist_model = NULL;
+	}
+}
+
+
+/**** File list ****/
+
+/* Selects (and scrolls to) the given node's entry, if it is listed.
+ * Otherwise, the selection is cleared */
+static void
+filelist_entry_select( GNode *node )
+{
+	GtkTreePath *path = NULL;
+	GtkTreeSelection *sel;
+	int row;
+
+	if ((filelist_model != NULL) && (node != NULL)) {
+		row = file_list_row_index( filelist_model, node );
+		if (row >= 0)
+			path = gtk_tree_path_new_from_indices( row, -1 );
+	}
+
+	sel = gtk_tree_view_get_selection( GTK_TREE_VIEW(file_tree_w) );
+	if (path != NULL) {
+		gtk_tree_selection_select_path( sel, path );
+		gtk_tree_view_scroll_to_cell( GTK_TREE_VIEW(file_tree_w), path, NULL, TRUE, 0.5, 0.0 );
+		gtk_tree_path_free( path );
+	}
+	else
+		gtk_tree_selection_unselect_all( sel );
+}
+
+
+/* Shows the current sort key and direction in the column headers */
+static void
+filelist_sort_indicators( void )
+{
+	GtkTreeViewColumn *column;
+	int i;
+
+	for (i = 0; i < FLIST_NUM_SORTS; i++) {
+		column = gtk_tree_view_get_column( GTK_TREE_VIEW(file_tree_w), i );
+		gtk_tree_view_column_set_sort_indicator( column, i == (int)filelist_sort_key );
+		gtk_tree_view_column_set_sort_order( column, filelist_sort_descending ? GTK_SORT_DESCENDING : GTK_SORT_ASCENDING );
+	}
+}
+
+
+/* Callback for a click on a column header. Clicking on the current sort
+ * column reverses the order; clicking on another sorts by that column
+ * (biggest/newest first, for sizes and times) */
+static void
+filelist_column_clicked_cb( G_GNUC_UNUSED GtkTreeViewColumn *column, gpointer data )
+{
+	FileListSort key = (FileListSort)GPOINTER_TO_INT(data);
+	GtkTreeSelection *sel;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	GNode *dnode, *node = NULL;
+
+	if (key == filelist_sort_key)
+		filelist_sort_descending = !filelist_sort_descending;
+	else {
+		filelist_sort_key = key;
+		switch (key) {
+			case FLIST_SORT_SIZE:
+			case FLIST_SORT_SIZE_ALLOC:
+			case FLIST_SORT_MTIME:
+			filelist_sort_descending = TRUE;
+			break;
+
+			default:
+			filelist_sort_descending = FALSE;
+			break;
+		}
 	}
+	filelist_sort_indicators( );
 
-	g_list_free( node_list );
+	if (filelist_model == NULL)
+		return;
+
+	/* Relist the directory in the new order, keeping the selection */
+	sel = gtk_tree_view_get_selection( GTK_TREE_VIEW(file_tree_w) );
+	if (gtk_tree_selection_get_selected( sel, &model, &iter ))
+		node = (GNode *)iter.user_data;
+	dnode = filelist_model->dnode;
+	filelist_model_release( );
+	filelist_model = file_list_model_new( dnode );
+	gtk_tree_view_set_model( GTK_TREE_VIEW(file_tree_w), GTK_TREE_MODEL(filelist_model) );
+	if (node != NULL)
+		filelist_entry_select( node );
+}
+
+
+/* Displays contents of a directory in the file list */
+void
+filelist_populate( GNode *dnode )
+{
+	int count;
+	char strbuf[64];
+
+	g_assert( NODE_IS_DIR(dnode) );
+
+	/* Swap in a model for the new directory. The view holds its own
+	 * reference; ours is kept for node-to-row lookups */
+	filelist_model_release( );
+	filelist_model = file_list_model_new( dnode );
+	gtk_tree_view_set_model( GTK_TREE_VIEW(file_tree_w), GTK_TREE_MODEL(filelist_model) );
+	count = filelist_model->order->count;
 
 	/* Set node count message in the left statusbar */
 	switch (count) {
@@ -214,8 +961,6 @@ void
 filelist_show_entry( GNode *node )
 {
 	GNode *dnode;
-	GtkTreePath *path;
-	GtkTreeSelection *sel;
 
 	/* Corresponding directory */
 	if (NODE_IS_DIR(node))
@@ -229,16 +974,7 @@ filelist_show_entry( GNode *node )
 	}
 
 	/* Scroll file list to proper entry */
-	path = find_path_by_data( GTK_TREE_VIEW(file_tree_w), node );
-	sel = gtk_tree_view_get_selection( GTK_TREE_VIEW(file_tree_w) );
-	if (path != NULL) {
-		gtk_tree_selection_select_path( sel, path );
-		gtk_tree_view_scroll_to_cell( GTK_TREE_VIEW(file_tree_w), path, NULL, TRUE, 0.5, 0.0 );
-		gtk_tree_path_free( path );
-	}
-	else {
-		gtk_tree_selection_unselect_all( sel );
-	}
+	filelist_entry_select( node );
 }
 
 
@@ -315,13 +1051,30 @@ filelist_select_cb( GtkWidget *tree_w, GdkEventButton *ev_button )
 void
 filelist_init( void )
 {
+	char *col_titles[FLIST_NUM_SORTS];
 	GtkWidget *parent_w;
+	GtkTreeViewColumn *column;
+	int i;
 
-	/* Replace current tree view widget with a single-column one */
+	col_titles[FLIST_SORT_NAME] = _("Name");
+	col_titles[FLIST_SORT_SIZE] = _("Size");
+	col_titles[FLIST_SORT_SIZE_ALLOC] = _("Allocated");
+	col_titles[FLIST_SORT_MTIME] = _("Modified");
+	col_titles[FLIST_SORT_OWNER] = _("Owner");
+	col_titles[FLIST_SORT_TYPE] = _("Type");
+
+	/* Replace current tree view widget with a sortable multi-column one */
+	filelist_model_release( );
 	parent_w = gtk_widget_get_parent( gtk_widget_get_parent( file_tree_w ) );
 	gtk_widget_destroy( gtk_widget_get_parent( file_tree_w ) );
-	file_tree_w = gui_clist_add( parent_w, 1, NULL );
+	file_tree_w = gui_clist_add( parent_w, FLIST_NUM_SORTS, col_titles );
 	g_signal_connect( G_OBJECT(file_tree_w), "button_press_event", G_CALLBACK(filelist_select_cb), NULL );
+	for (i = 0; i < FLIST_NUM_SORTS; i++) {
+		column = gtk_tree_view_get_column( GTK_TREE_VIEW(file_tree_w), i );
+		gtk_tree_view_column_set_clickable( column, TRUE );
+		g_signal_connect( G_OBJECT(column), "clicked", G_CALLBACK(filelist_column_clicked_cb), GINT_TO_POINTER(i) );
+	}
+	filelist_sort_indicators( );
 
 	filelist_populate( root_dnode );
 
@@ -347,7 +1100,10 @@ filelist_scan_monitor_init( void )
 	col_titles[1] = _("Found");
 	col_titles[2] = _("Bytes");
 
-	/* Replace current tree view widget with a 3-column one */
+	/* Replace current tree view widget with a 3-column one. Sort
+	 * orders refer to the filesystem tree about to be freed */
+	filelist_model_release( );
+	file_list_order_cache_clear( );
 	parent_w = gtk_widget_get_parent( gtk_widget_get_parent( file_tree_w ) );
 	gtk_widget_destroy( gtk_widget_get_parent( file_tree_w ) );
 	file_tree_w = gui_clist_add( parent_w, 3, col_titles );
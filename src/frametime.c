@@ -0,0 +1,480 @@
+/* frametime.c */
+
+/* Per-phase frame timing */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "common.h"
+#include "frametime.h"
+
+#include <epoxy/gl.h>
+
+#include "ogl.h" /* ogl_frame_counts( ) */
+#include "tmaptext.h"
+#include "vbuf.h"
+#include "xform.h"
+
+
+/* Each phase of a frame is timed on the CPU with xgettime( ), and on the
+ * GPU with a GL_TIME_ELAPSED query around the GL commands it issues.
+ * Query results are read back a few frames late (by then they are in,
+ * and reading them does not stall the pipeline), at which point the
+ * frame's times go into the on-screen overlay and the log file. Nothing
+ * is timed while neither of those is in use.
+ * The pick pass mostly happens in between frames (see ogl_color_pick( )),
+ * and is counted toward the frame after it. Only the first pick pass
+ * before a frame is timed on the GPU, since a query can't be restarted
+ * until its result is in. Phases begun inside another (as when the pick
+ * pass draws the geometry) count toward the outer one */
+
+/* Frames of queries in flight */
+#define FRAMETIME_LATENCY	4
+
+/* Weight of the newest frame in the overlay's running averages */
+#define OVERLAY_SMOOTHING	0.1
+
+/* Overlay text height, and margin around it (in pixels), and width of
+ * its backing panel (in characters) */
+#define OVERLAY_LINE_HEIGHT	14.0
+#define OVERLAY_MARGIN		6.0
+#define OVERLAY_COLUMNS		30
+
+
+/* Times and counts for one frame */
+typedef struct _FrameTimes FrameTimes;
+struct _FrameTimes {
+	unsigned int	frame;
+	double		cpu_ms[FRAMETIME_NUM_PHASES];
+	double		gpu_ms[FRAMETIME_NUM_PHASES]; /* < 0 if not measured */
+	boolean		queried[FRAMETIME_NUM_PHASES];
+	double		frame_ms;	/* CPU time for all of ogl_draw( ) */
+	int		draw_calls;
+	int64		triangles;
+	boolean		pending;	/* Waiting on query results */
+};
+
+/* Phase names, as they appear in the overlay and log */
+static const char *phase_names[FRAMETIME_NUM_PHASES] = {
+	"frustum",
+	"geometry",
+	"outlines",
+	"labels",
+	"cursor",
+	"pick"
+};
+
+/* Phases that issue GL commands, and so are timed on the GPU too */
+static const boolean phase_on_gpu[FRAMETIME_NUM_PHASES] = {
+	FALSE, TRUE, TRUE, TRUE, TRUE, TRUE
+};
+
+/* Ring of frames with queries in flight. cur_slot is the frame being
+ * drawn (or next to be), and the oldest one with results outstanding */
+static FrameTimes slots[FRAMETIME_LATENCY];
+static GLuint queries[FRAMETIME_LATENCY][FRAMETIME_NUM_PHASES];
+static int cur_slot = 0;
+static unsigned int frame_num = 0;
+
+/* 1 if GL_TIME_ELAPSED queries can be had, 0 if not, -1 until checked */
+static int timer_supported = -1;
+
+/* Phase in progress (or -1), its start time, and whether it has a query
+ * running */
+static int open_phase = -1;
+static double phase_t0;
+static boolean phase_queried;
+
+/* Start time of the frame in progress (0 if none) */
+static double frame_t0 = 0.0;
+
+/* TRUE if the overlay is shown */
+static boolean show_overlay = FALSE;
+
+/* Running averages of retired frames, for the overlay */
+static double overlay_cpu_ms[FRAMETIME_NUM_PHASES];
+static double overlay_gpu_ms[FRAMETIME_NUM_PHASES];
+static double overlay_frame_ms = 0.0;
+static int overlay_draw_calls = 0;
+static int64 overlay_triangles = 0;
+static boolean overlay_primed = FALSE;
+
+/* Per-frame log file, if any */
+static FILE *log_file = NULL;
+
+
+/* Returns TRUE if anything wants the timings */
+static boolean
+frametime_active( void )
+{
+	return show_overlay || (log_file != NULL);
+}
+
+
+/* Empties a frame slot */
+static void
+slot_clear( FrameTimes *ft )
+{
+	int p;
+
+	memset( ft, 0, sizeof(FrameTimes) );
+	for (p = 0; p < FRAMETIME_NUM_PHASES; p++)
+		ft->gpu_ms[p] = -1.0;
+}
+
+
+/* Checks for timer query support, and sets up the query objects. Needs
+ * a current GL context */
+static void
+timer_init( void )
+{
+	int i, gl_version;
+
+	if (timer_supported >= 0)
+		return;
+
+	gl_version = epoxy_gl_version( );
+	timer_supported = (gl_version >= 33) || epoxy_has_gl_extension( "GL_ARB_timer_query" );
+	if (timer_supported)
+		glGenQueries( FRAMETIME_LATENCY * FRAMETIME_NUM_PHASES, &queries[0][0] );
+
+	for (i = 0; i < FRAMETIME_LATENCY; i++)
+		slot_clear( &slots[i] );
+}
+
+
+/* Returns TRUE if all query results for a frame slot are in */
+static boolean
+slot_results_ready( int slot )
+{
+	GLint available;
+	int p;
+
+	for (p = 0; p < FRAMETIME_NUM_PHASES; p++) {
+		if (!slots[slot].queried[p])
+			continue;
+		glGetQueryObjectiv( queries[slot][p], GL_QUERY_RESULT_AVAILABLE, &available );
+		if (!available)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/* Writes the column headings to the log file */
+static void
+log_header( void )
+{
+	int p;
+
+	fprintf( log_file, "frame,frame_cpu_ms" );
+	for (p = 0; p < FRAMETIME_NUM_PHASES; p++) {
+		fprintf( log_file, ",%s_cpu_ms", phase_names[p] );
+		if (phase_on_gpu[p])
+			fprintf( log_file, ",%s_gpu_ms", phase_names[p] );
+	}
+	fprintf( log_file, ",draw_calls,triangles\n" );
+}
+
+
+/* Writes a frame to the log file. GPU times that weren't measured are
+ * left empty */
+static void
+log_frame( const FrameTimes *ft )
+{
+	int p;
+
+	fprintf( log_file, "%u,%.4f", ft->frame, ft->frame_ms );
+	for (p = 0; p < FRAMETIME_NUM_PHASES; p++) {
+		fprintf( log_file, ",%.4f", ft->cpu_ms[p] );
+		if (!phase_on_gpu[p])
+			continue;
+		if (ft->gpu_ms[p] >= 0.0)
+			fprintf( log_file, ",%.4f", ft->gpu_ms[p] );
+		else
+			fprintf( log_file, "," );
+	}
+	fprintf( log_file, ",%d,%" G_GINT64_FORMAT "\n", ft->draw_calls, ft->triangles );
+}
+
+
+/* Folds a frame into the overlay's running averages */
+static void
+overlay_add_frame( const FrameTimes *ft )
+{
+	double k;
+	int p;
+
+	k = overlay_primed ? OVERLAY_SMOOTHING : 1.0;
+	for (p = 0; p < FRAMETIME_NUM_PHASES; p++) {
+		overlay_cpu_ms[p] += k * (ft->cpu_ms[p] - overlay_cpu_ms[p]);
+		if (ft->gpu_ms[p] < 0.0)
+			continue;
+		if (overlay_primed && (overlay_gpu_ms[p] >= 0.0))
+			overlay_gpu_ms[p] += k * (ft->gpu_ms[p] - overlay_gpu_ms[p]);
+		else
+			overlay_gpu_ms[p] = ft->gpu_ms[p];
+	}
+	overlay_frame_ms += k * (ft->frame_ms - overlay_frame_ms);
+	overlay_draw_calls = ft->draw_calls;
+	overlay_triangles = ft->triangles;
+	overlay_primed = TRUE;
+}
+
+
+/* Reads back a frame's query results (waiting for them if need be), and
+ * passes its times on */
+static void
+slot_retire( int slot )
+{
+	FrameTimes *ft = &slots[slot];
+	GLuint64 elapsed_ns;
+	int p;
+
+	for (p = 0; p < FRAMETIME_NUM_PHASES; p++) {
+		if (!ft->queried[p])
+			continue;
+		glGetQueryObjectui64v( queries[slot][p], GL_QUERY_RESULT, &elapsed_ns );
+		ft->gpu_ms[p] = 1.0e-6 * (double)elapsed_ns;
+	}
+
+	if (show_overlay)
+		overlay_add_frame( ft );
+	if (log_file != NULL)
+		log_frame( ft );
+
+	ft->pending = FALSE;
+}
+
+
+/* Opens a file to log the times of every frame drawn to, as CSV.
+ * Returns FALSE (with errno set) if it could not be opened */
+boolean
+frametime_log_open( const char *filename )
+{
+	log_file = fopen( filename, "w" );
+	if (log_file == NULL)
+		return FALSE;
+
+	log_header( );
+
+	return TRUE;
+}
+
+
+/* Shows or hides the timing overlay */
+void
+frametime_set_overlay( boolean show )
+{
+	int i, p;
+
+	if (show && !show_overlay) {
+		/* Start the averages over */
+		for (p = 0; p < FRAMETIME_NUM_PHASES; p++)
+			overlay_gpu_ms[p] = -1.0;
+		overlay_primed = FALSE;
+
+		/* Frames left over from when last shown are stale */
+		if ((log_file == NULL) && (timer_supported >= 0)) {
+			for (i = 0; i < FRAMETIME_LATENCY; i++)
+				slot_clear( &slots[i] );
+		}
+	}
+
+	show_overlay = show;
+}
+
+
+/* Returns TRUE if the timing overlay is shown */
+boolean
+frametime_overlay( void )
+{
+	return show_overlay;
+}
+
+
+/* Call at the start of a frame */
+void
+frametime_frame_begin( void )
+{
+	if (!frametime_active( ))
+		return;
+
+	timer_init( );
+	frame_t0 = xgettime( );
+}
+
+
+/* Call at the end of a frame. Retires the frames whose query results
+ * have come in since */
+void
+frametime_frame_end( void )
+{
+	FrameTimes *ft;
+	int i, slot;
+
+	if (!frametime_active( ) || (frame_t0 == 0.0))
+		return;
+
+	ft = &slots[cur_slot];
+	ft->frame = frame_num++;
+	ft->frame_ms = 1000.0 * (xgettime( ) - frame_t0);
+	ogl_frame_counts( &ft->draw_calls, &ft->triangles );
+	ft->pending = TRUE;
+	frame_t0 = 0.0;
+
+	/* Oldest frames first. The slot about to be reused has to go,
+	 * whether or not its results are in yet */
+	cur_slot = (cur_slot + 1) % FRAMETIME_LATENCY;
+	for (i = 0; i < FRAMETIME_LATENCY; i++) {
+		slot = (cur_slot + i) % FRAMETIME_LATENCY;
+		if (!slots[slot].pending)
+			continue;
+		if ((i > 0) && !slot_results_ready( slot ))
+			break;
+		slot_retire( slot );
+	}
+	slot_clear( &slots[cur_slot] );
+}
+
+
+/* Call at the start of a phase */
+void
+frametime_phase_begin( FrameTimePhase phase )
+{
+	FrameTimes *ft = &slots[cur_slot];
+
+	if (!frametime_active( ) || (open_phase >= 0))
+		return;
+
+	timer_init( );
+	open_phase = phase;
+	phase_t0 = xgettime( );
+
+	phase_queried = timer_supported && phase_on_gpu[phase] && !ft->queried[phase];
+	if (phase_queried) {
+		glBeginQuery( GL_TIME_ELAPSED, queries[cur_slot][phase] );
+		ft->queried[phase] = TRUE;
+	}
+}
+
+
+/* Call at the end of a phase */
+void
+frametime_phase_end( FrameTimePhase phase )
+{
+	if (open_phase != (int)phase)
+		return;
+
+	if (phase_queried)
+		glEndQuery( GL_TIME_ELAPSED );
+	slots[cur_slot].cpu_ms[phase] += 1000.0 * (xgettime( ) - phase_t0);
+	open_phase = -1;
+}
+
+
+/* Draws one line of the overlay, left-aligned (row 0 is the top line) */
+static void
+overlay_line( const char *text, int row, double top )
+{
+	static const XYvec max_dims = { 10000.0, OVERLAY_LINE_HEIGHT };
+	XYZvec pos;
+	XYvec dims;
+
+	text_get_extents( text, &max_dims, &dims );
+	pos.x = OVERLAY_MARGIN + 0.5 * dims.x;
+	pos.y = top - ((double)row + 0.5) * OVERLAY_LINE_HEIGHT;
+	pos.z = 0.0;
+	text_draw_straight( text, &pos, &max_dims );
+}
+
+
+/* Draws the timing overlay in the top left corner of the viewport, if
+ * it is shown. Times are averaged over recent frames */
+void
+frametime_draw_overlay( void )
+{
+	static const int num_lines = FRAMETIME_NUM_PHASES + 3;
+	static const XYvec max_dims = { 10000.0, OVERLAY_LINE_HEIGHT };
+	XformMatrix prev_projection, prev_view, m;
+	XYvec char_dims;
+	GLint viewport[4];
+	char line[64], gpu_str[16];
+	double gpu_total = 0.0;
+	double top, x1, y0;
+	int p;
+
+	if (!show_overlay)
+		return;
+
+	glGetIntegerv( GL_VIEWPORT, viewport );
+
+	/* Project straight to pixels */
+	xform_copy( prev_projection, xform_projection( ) );
+	xform_matrix_ortho( m, 0.0, (double)viewport[2], 0.0, (double)viewport[3], -1.0, 1.0 );
+	xform_set_projection( m );
+	xform_copy( prev_view, xform_view( ) );
+	xform_identity( m );
+	xform_set_view( m );
+
+	glDisable( GL_DEPTH_TEST );
+	ogl_disable( GL_LIGHTING );
+
+	/* Dark backing panel, for legibility over the scene */
+	top = (double)viewport[3] - OVERLAY_MARGIN;
+	text_get_extents( "M", &max_dims, &char_dims );
+	x1 = 2.0 * OVERLAY_MARGIN + (double)OVERLAY_COLUMNS * char_dims.x;
+	y0 = top - (double)num_lines * OVERLAY_LINE_HEIGHT - OVERLAY_MARGIN;
+	vbuf_color3f( 0.0, 0.0, 0.0 );
+	vbuf_begin( GL_QUADS );
+	vbuf_vertex3d( 0.0, y0, 0.0 );
+	vbuf_vertex3d( x1, y0, 0.0 );
+	vbuf_vertex3d( x1, (double)viewport[3], 0.0 );
+	vbuf_vertex3d( 0.0, (double)viewport[3], 0.0 );
+	vbuf_end( );
+
+	text_pre( );
+	vbuf_color3f( 1.0, 1.0, 0.6 );
+	overlay_line( "phase       cpu ms   gpu ms", 0, top );
+	for (p = 0; p < FRAMETIME_NUM_PHASES; p++) {
+		if (overlay_gpu_ms[p] >= 0.0) {
+			g_snprintf( gpu_str, sizeof(gpu_str), "%8.3f", overlay_gpu_ms[p] );
+			gpu_total += overlay_gpu_ms[p];
+		}
+		else
+			g_snprintf( gpu_str, sizeof(gpu_str), "%8s", "-" );
+		g_snprintf( line, sizeof(line), "%-9s %8.3f %s", phase_names[p], overlay_cpu_ms[p], gpu_str );
+		overlay_line( line, p + 1, top );
+	}
+	g_snprintf( line, sizeof(line), "%-9s %8.3f %8.3f", "frame", overlay_frame_ms, gpu_total );
+	overlay_line( line, FRAMETIME_NUM_PHASES + 1, top );
+	g_snprintf( line, sizeof(line), "draws %d  tris %" G_GINT64_FORMAT, overlay_draw_calls, overlay_triangles );
+	overlay_line( line, FRAMETIME_NUM_PHASES + 2, top );
+	text_post( );
+
+	glEnable( GL_DEPTH_TEST );
+
+	xform_set_projection( prev_projection );
+	xform_set_view( prev_view );
+}
+
+
+/* end frametime.c */
@@ -34,11 +34,14 @@
 
 #include "about.h"
 #include "animation.h"
+#include "bench.h"
 #include "camera.h"
 #include "color.h" /* color_init( ), color_write_config( ) */
 #include "filelist.h"
+#include "frametime.h" /* frametime_log_open( ) */
 #include "geometry.h"
 #include "gui.h" /* gui_update( ) */
+#include "memstat.h"
 #include "ogl.h" /* ogl_gl_query( ) */
 #include "scanfs.h"
 #include "window.h"
@@ -333,6 +336,11 @@ enum {
 	OPT_TREEV,
 	OPT_CACHEDIR,
 	OPT_NOCACHE,
+	OPT_MEMSTATS,
+	OPT_CORE,
+	OPT_LEGACY,
+	OPT_BENCHMARK,
+	OPT_FRAME_LOG,
 	OPT_HELP
 };
 
@@ -340,8 +348,19 @@ enum {
 /* Initial visualization mode */
 static FsvMode initial_fsv_mode = FSV_MAPV;
 
+/* TRUE to print memory statistics after each filesystem scan */
+static boolean dump_memstats = FALSE;
+
+/* TRUE to ask for a core-profile GL context and render with shaders,
+ * FALSE to stick with the fixed-function (legacy) renderer */
+static boolean core_renderer = FALSE;
+
+/* TRUE to run the rendering benchmark instead of the program proper */
+static boolean run_benchmark = FALSE;
+
 /* Token strings for config file */
 static const char *tokens_fsv_mode[] = { "discv", "mapv", "treev", NULL };
+static const char *tokens_renderer[] = { "legacy", "core", NULL };
 
 /* Command-line options */
 static struct option cli_opts[] = {
@@ -350,6 +369,11 @@ static struct option cli_opts[] = {
 	{ "treev", no_argument, NULL, OPT_TREEV },
 	{ "cachedir", required_argument, NULL, OPT_CACHEDIR },
 	{ "nocache", no_argument, NULL, OPT_NOCACHE },
+	{ "memstats", no_argument, NULL, OPT_MEMSTATS },
+	{ "core", no_argument, NULL, OPT_CORE },
+	{ "legacy", no_argument, NULL, OPT_LEGACY },
+	{ "benchmark", no_argument, NULL, OPT_BENCHMARK },
+	{ "frame-log", required_argument, NULL, OPT_FRAME_LOG },
 	{ "help", no_argument, NULL, OPT_HELP },
 	{ NULL, 0, NULL, 0 }
 };
@@ -364,6 +388,14 @@ static const char usage_summary[] = __("\n"
     "  --mapv       Start in Map Visualisation mode (default)\n"
     "  --discv      Start in Disc Visualisation mode\n"
     "  --treev      Start in Tree Visualisation mode\n"
+    "  --memstats   Print memory statistics to stdout after scanning\n"
+    "  --core       Render with shaders (OpenGL 3.2 core profile)\n"
+    "  --legacy     Render with fixed-function OpenGL (default)\n"
+    "  --benchmark  Fly through rootdir offscreen in each mode, and\n"
+    "               print timings to stdout as JSON (needs no display)\n"
+    "  --frame-log FILE\n"
+    "               Log the times of each part of every frame drawn\n"
+    "               to FILE, as CSV\n"
     "  --help       Print this help and exit\n"
     "\n");
 
@@ -464,6 +496,11 @@ fsv_load( const char *dir )
 	/* Scan filesystem */
 	scanfs( dir );
 
+	if (dump_memstats) {
+		printf( _("Memory statistics for %s:\n"), node_absname( root_dnode ) );
+		memstat_dump( stdout );
+	}
+
 	/* Clear/reset node history */
 	g_list_free( globals.history );
 	globals.history = NULL;
@@ -535,7 +572,9 @@ main( int argc, char **argv )
 	textdomain( PACKAGE );
 #endif
 
-	/* Read saved visualization mode from config (CLI options override) */
+	/* Read saved visualization mode and renderer from config
+	 * (CLI options override), and the frame-time budget (in
+	 * milliseconds) beyond which detail is reduced while moving */
 	{
 		GKeyFile *kf = g_key_file_new( );
 		gchar *cfg_path = config_file_path( );
@@ -551,6 +590,13 @@ main( int argc, char **argv )
 				}
 				g_free( str );
 			}
+			str = g_key_file_get_string( kf, "Settings", "renderer", NULL );
+			if (str != NULL) {
+				core_renderer = !strcmp( str, tokens_renderer[1] );
+				g_free( str );
+			}
+			if (g_key_file_has_key( kf, "Settings", "frame_budget_ms", NULL ))
+				animation_set_frame_budget( 0.001 * g_key_file_get_double( kf, "Settings", "frame_budget_ms", NULL ) );
 		}
 		g_free( cfg_path );
 		g_key_file_free( kf );
@@ -589,6 +635,34 @@ main( int argc, char **argv )
 			/* TODO: Implement caching */
 			break;
 
+			case OPT_MEMSTATS:
+			/* --memstats */
+			dump_memstats = TRUE;
+			break;
+
+			case OPT_CORE:
+			/* --core */
+			core_renderer = TRUE;
+			break;
+
+			case OPT_LEGACY:
+			/* --legacy */
+			core_renderer = FALSE;
+			break;
+
+			case OPT_BENCHMARK:
+			/* --benchmark */
+			run_benchmark = TRUE;
+			break;
+
+			case OPT_FRAME_LOG:
+			/* --frame-log <file> */
+			if (!frametime_log_open( optarg )) {
+				fprintf( stderr, _("fsv: %s: %s\n"), optarg, strerror( errno ) );
+				exit( EXIT_FAILURE );
+			}
+			break;
+
 			case OPT_HELP:
 			/* --help */
 			default:
@@ -639,11 +713,17 @@ main( int argc, char **argv )
 		}
 	}
 
-	/* Request a legacy (compatibility profile) GL context.
-	 * GtkGLArea defaults to core profile, which doesn't support
-	 * the legacy GL calls (glBegin/glEnd, display lists, fixed-
-	 * function lighting) used throughout this codebase. */
-	{
+	/* The benchmark does without GTK+ altogether */
+	if (run_benchmark)
+		exit( bench_run( root_dir, core_renderer ) ? EXIT_SUCCESS : EXIT_FAILURE );
+
+	/* Request a legacy (compatibility profile) GL context, unless
+	 * the core-profile renderer was asked for. GtkGLArea defaults to
+	 * core profile, which doesn't support the legacy GL calls (glBegin/
+	 * glEnd, display lists, fixed-function lighting) that the legacy
+	 * renderer uses. (If a core-profile context can't be had, GDK falls
+	 * back to a legacy one, and so does fsv; see realize_cb( ) in ogl.c) */
+	if (!core_renderer) {
 		const char *gdk_gl = g_getenv( "GDK_GL" );
 		if (gdk_gl == NULL) {
 			g_setenv( "GDK_GL", "legacy", TRUE );
@@ -29,11 +29,18 @@
 
 #include "about.h"
 #include "animation.h"
+#include "bvh.h"
 #include "camera.h"
 #include "color.h"
 #include "dirtree.h" /* dirtree_entry_expanded( ) */
+#include "frametime.h"
+#include "impostor.h"
+#include "mapvinst.h"
+#include "memstat.h"
 #include "ogl.h"
 #include "tmaptext.h"
+#include "vbuf.h"
+#include "xform.h"
 
 /* 3D geometry for splash screen */
 #include "fsv3d.h"
@@ -46,25 +53,20 @@
 /* Color-buffer picking mode flag */
 static boolean picking_mode = FALSE;
 
-/* Use this to set the current GL color for a node.
- * In picking mode, encode the node ID as an RGB color. */
-#define node_glcolor( node ) do { \
-	if (picking_mode) { \
-		unsigned int _nid = NODE_DESC(node)->id; \
-		glColor4ub( (_nid >> 16) & 0xFF, (_nid >> 8) & 0xFF, _nid & 0xFF, 0 ); \
-	} else { \
-		glColor3fv( (const float *)NODE_DESC(node)->color ); \
-	} \
-} while(0)
+/* TRUE while directories are collapsing/expanding. Buffered geometry
+ * may then be drawn displaced, instead of being rebuilt every frame
+ * (see vbuf_range_usable( )) */
+static boolean colexp_active = FALSE;
+
+/* Use this to set the current color for a node. The node ID is passed
+ * along in the integer pick attribute as well, so that the same vertex
+ * buffers serve the pick pass (see ogl_color_pick( )) */
+#define node_glcolor( node )	node_glcolor_face( node, 0 )
 
-/* Set the pick color with a face flag (used for top-face detection) */
+/* Set the color with a face flag (used for top-face detection) */
 #define node_glcolor_face( node, face ) do { \
-	if (picking_mode) { \
-		unsigned int _nid = NODE_DESC(node)->id; \
-		glColor4ub( (_nid >> 16) & 0xFF, (_nid >> 8) & 0xFF, _nid & 0xFF, (face) ); \
-	} else { \
-		glColor3fv( (const float *)NODE_DESC(node)->color ); \
-	} \
+	vbuf_color3fv( (const float *)NODE_DESC(node)->color ); \
+	vbuf_pick_id( NODE_DESC(node)->id, (face) ); \
 } while(0)
 
 
@@ -79,6 +81,7 @@ typedef struct {
 static FrustumPlane frustum_planes[6]; /* left, right, bottom, top, near, far */
 static double frustum_mvp[16]; /* combined MVP matrix */
 static double frustum_proj_scale; /* P[1][1] for screen-size estimation */
+static int frustum_viewport_w; /* viewport width in pixels */
 static int frustum_viewport_h; /* viewport height in pixels */
 
 /* Minimum projected screen size in pixels before culling a subtree */
@@ -95,22 +98,31 @@ static int frustum_viewport_h; /* viewport height in pixels */
 /* TRUE during the wireframe outline pass, causes higher cull threshold */
 static boolean drawing_outlines = FALSE;
 
-/* Extracts frustum planes from the current GL matrices.
+/* TRUE if the geometry pass shades in the outlines itself, so there is
+ * no outline pass (see ogl_cel_lines( )) */
+static boolean cel_lines = FALSE;
+
+/* TRUE while a subtree is being drawn into its impostor (see
+ * "Impostors" below) */
+static boolean impostor_capturing = FALSE;
+
+/* Extracts frustum planes from the current view and projection matrices.
  * Call once per frame before any recursive draw. */
 static void
 frustum_extract( void )
 {
-	double mv[16], proj[16];
+	const double *mv, *proj;
 	double *m = frustum_mvp;
 	double len;
 	int i, j;
 	GLint viewport[4];
 
-	glGetDoublev( GL_MODELVIEW_MATRIX, mv );
-	glGetDoublev( GL_PROJECTION_MATRIX, proj );
+	mv = xform_view( );
+	proj = xform_projection( );
 	glGetIntegerv( GL_VIEWPORT, viewport );
 
 	frustum_proj_scale = proj[5]; /* P[1][1] = cot(fov/2) */
+	frustum_viewport_w = viewport[2];
 	frustum_viewport_h = viewport[3];
 
 	/* Compute MVP = P * MV (column-major) */
@@ -190,23 +202,6 @@ frustum_test_aabb( double x0, double y0, double z0,
 }
 
 
-/* Tests a bounding sphere against the frustum.
- * Returns TRUE if at least partially inside, FALSE if fully outside. */
-static boolean
-frustum_test_sphere( double cx, double cy, double cz, double radius )
-{
-	int i;
-
-	for (i = 0; i < 6; i++) {
-		if (frustum_planes[i].a * cx + frustum_planes[i].b * cy +
-		    frustum_planes[i].c * cz + frustum_planes[i].d < -radius)
-			return FALSE;
-	}
-
-	return TRUE;
-}
-
-
 /* Estimates the projected screen size (in pixels) of a sphere
  * at the given world-space position. Returns HUGE_VAL if at or
  * behind the camera (don't cull). */
@@ -225,6 +220,392 @@ screen_size_pixels( double cx, double cy, double cz, double radius )
 }
 
 
+/* Curve tessellation */
+
+/* Unit circle, sampled every (360 / UNIT_CIRCLE_STEPS) degrees. Curves
+ * are drawn through every Nth entry (the "stride"), N depending on how
+ * big the curve appears on screen */
+#define UNIT_CIRCLE_STEPS 288 /* 1.25 degree resolution */
+static XYvec *unit_circle = NULL;
+
+/* Maximum distance (in pixels) a tessellated curve may stray from
+ * the true curve, and the looser limit while drawing with reduced
+ * detail (see geometry_draw( )) */
+#define CURVE_TOLERANCE 0.5
+#define CURVE_TOLERANCE_COARSE 2.0
+
+/* TRUE while drawing with reduced detail. Curves then only get refined
+ * once they stray beyond CURVE_TOLERANCE_COARSE, and are never made
+ * coarser, so geometry isn't rebuilt over and over as the view moves */
+static boolean coarse_curves = FALSE;
+
+
+/* Builds the unit circle table, if it isn't already there */
+static void
+unit_circle_init( void )
+{
+	double theta;
+	int i;
+
+	if (unit_circle != NULL)
+		return;
+
+	unit_circle = NEW_ARRAY(XYvec, UNIT_CIRCLE_STEPS);
+	for (i = 0; i < UNIT_CIRCLE_STEPS; i++) {
+		theta = 360.0 * (double)i / (double)UNIT_CIRCLE_STEPS;
+		unit_circle[i].x = cos( RAD(theta) );
+		unit_circle[i].y = sin( RAD(theta) );
+	}
+}
+
+
+/* Returns how far (in pixels) a curve of the given on-screen radius
+ * strays from the true curve when drawn with the given stride */
+static double
+curve_error( double r_pixels, int stride )
+{
+	double seg_arc_width;
+
+	seg_arc_width = 360.0 * (double)stride / (double)UNIT_CIRCLE_STEPS;
+
+	/* Sagitta of one segment */
+	return r_pixels * (1.0 - cos( RAD(0.5 * seg_arc_width) ));
+}
+
+
+/* Returns how far (in pixels) curves may currently stray */
+static double
+curve_tolerance( void )
+{
+	return coarse_curves ? CURVE_TOLERANCE_COARSE : CURVE_TOLERANCE;
+}
+
+
+/* Label placement
+ *
+ * A directory's labels are recorded together into one vertex buffer
+ * range, noting where each label went and how big it is. Label passes
+ * then don't draw ranges outright, but submit the labels in them as
+ * candidates. Once the pass is done, the candidates are ranked by
+ * on-screen size and importance, and laid down one after another on a
+ * coarse screen-space occupancy grid; those that would land on an
+ * occupied cell are dropped, and the rest are drawn */
+
+/* Size of an occupancy grid cell, in pixels */
+#define LABEL_GRID_CELL 8
+
+/* Most labels drawn in one frame */
+#define LABEL_MAX_COUNT 768
+
+/* Minimum projected height of a label, in pixels */
+#define LABEL_MIN_HEIGHT 5.0
+
+/* One label in a directory's label range */
+typedef struct _LabelSpan LabelSpan;
+struct _LabelSpan {
+	GNode	*node;		/* Node being labeled */
+	int	first;		/* Triangle vertices in the range */
+	int	count;
+	float	center[3];	/* World-space center */
+	float	half_width;	/* World-space half extents */
+	float	half_height;
+};
+
+/* The labels of a directory */
+typedef struct _LabelSet LabelSet;
+struct _LabelSet {
+	LabelSpan	*spans;
+	int		num;
+	int		alloc;
+};
+
+/* Label under consideration for the current frame */
+typedef struct _LabelCandidate LabelCandidate;
+struct _LabelCandidate {
+	const VBufRange	*range;
+	const LabelSpan	*span;
+	int		matrix;		/* Index into label_matrices */
+	double		priority;
+	int		cell_x0, cell_y0;	/* Grid cells covered */
+	int		cell_x1, cell_y1;
+};
+
+/* Label set being recorded (each thread has its own, cf. vbuf.c) */
+static GPrivate label_rec_key;
+
+/* Candidates of the current frame, and the model transformations their
+ * ranges were submitted under */
+static LabelCandidate *label_candidates = NULL;
+static int label_candidates_num = 0;
+static int label_candidates_alloc = 0;
+static XformMatrix *label_matrices = NULL;
+static int label_matrices_num = 0;
+static int label_matrices_alloc = 0;
+
+/* Occupancy grid */
+static byte *label_grid = NULL;
+static int label_grid_w = 0;
+static int label_grid_h = 0;
+
+
+/* Makes the given label set (which is created if *set is NULL) the one
+ * being recorded, emptying it */
+static void
+label_set_record( LabelSet **set )
+{
+	g_assert( g_private_get( &label_rec_key ) == NULL );
+
+	if (*set == NULL) {
+		*set = NEW(LabelSet);
+		memset( *set, 0, sizeof(LabelSet) );
+	}
+	(*set)->num = 0;
+	g_private_set( &label_rec_key, *set );
+}
+
+
+/* Starts recording the labels of a directory (in place of
+ * vbuf_record_begin( )) */
+static void
+label_record_begin( DirNodeDesc *dir_ndesc )
+{
+	label_set_record( &dir_ndesc->label_set );
+	vbuf_record_begin( &dir_ndesc->label_vbuf );
+}
+
+
+/* Starts recording labels into a set and range of a build job, under the
+ * given model transformation (cf. vbuf_record_begin_deferred( )) */
+static void
+label_record_begin_deferred( LabelSet **set, VBufRange **range, const double *matrix )
+{
+	label_set_record( set );
+	vbuf_record_begin_deferred( range, matrix );
+}
+
+
+/* Finishes recording labels */
+static void
+label_record_end( void )
+{
+	g_assert( g_private_get( &label_rec_key ) != NULL );
+
+	vbuf_record_end( );
+	g_private_set( &label_rec_key, NULL );
+}
+
+
+/* Call before drawing a label. Returns a value to pass to label_add( ) */
+static int
+label_mark( void )
+{
+	if (g_private_get( &label_rec_key ) == NULL)
+		return 0;
+
+	return vbuf_record_position( );
+}
+
+
+/* Call after drawing a label: notes the label just drawn, centered at
+ * the given position and occupying the given dimensions (in the current
+ * model space). Labels drawn outside of a label recording are left be */
+static void
+label_add( GNode *node, int first, const XYZvec *center, const XYvec *dims )
+{
+	LabelSet *set;
+	LabelSpan *span;
+	const double *m;
+	double scale;
+
+	set = (LabelSet *)g_private_get( &label_rec_key );
+	if (set == NULL)
+		return;
+
+	if (set->num == set->alloc) {
+		set->alloc = MAX(16, 2 * set->alloc);
+		RESIZE(set->spans, set->alloc, LabelSpan);
+	}
+	span = &set->spans[set->num++];
+
+	span->node = node;
+	span->first = first;
+	span->count = vbuf_record_position( ) - first;
+	m = vbuf_record_matrix( );
+	xform_apply( m, center->x, center->y, center->z, span->center );
+	/* Labels lie in the xy plane, which model transformations here
+	 * only ever rotate and scale uniformly */
+	scale = sqrt( SQR(m[0]) + SQR(m[1]) );
+	span->half_width = 0.5 * scale * dims->x;
+	span->half_height = 0.5 * scale * dims->y;
+}
+
+
+/* Projects a world-space point to window coordinates. Returns FALSE if
+ * it is at or behind the camera */
+static boolean
+screen_project( const float *p, XYvec *win )
+{
+	const double *m = frustum_mvp;
+	double x, y, w;
+
+	w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+	if (w <= 0.0)
+		return FALSE;
+	x = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+	y = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+
+	win->x = (0.5 + 0.5 * x / w) * (double)frustum_viewport_w;
+	win->y = (0.5 + 0.5 * y / w) * (double)frustum_viewport_h;
+
+	return TRUE;
+}
+
+
+/* Starts label placement for a frame. Call after frustum_extract( ) */
+static void
+label_place_begin( void )
+{
+	int grid_w, grid_h;
+
+	label_candidates_num = 0;
+	label_matrices_num = 0;
+
+	grid_w = (frustum_viewport_w + LABEL_GRID_CELL - 1) / LABEL_GRID_CELL;
+	grid_h = (frustum_viewport_h + LABEL_GRID_CELL - 1) / LABEL_GRID_CELL;
+	if ((grid_w != label_grid_w) || (grid_h != label_grid_h)) {
+		xfree( label_grid );
+		label_grid = NEW_ARRAY(byte, MAX(1, grid_w * grid_h));
+		label_grid_w = grid_w;
+		label_grid_h = grid_h;
+	}
+	memset( label_grid, 0, MAX(1, grid_w * grid_h) );
+}
+
+
+/* Submits the (already recorded) labels of a directory as candidates,
+ * under the current model transformation */
+static void
+label_submit( DirNodeDesc *dir_ndesc )
+{
+	LabelSet *set = dir_ndesc->label_set;
+	LabelCandidate *cand;
+	LabelSpan *span;
+	XYvec win;
+	double hw, hh;
+	int i;
+
+	if ((set == NULL) || (set->num == 0) || (dir_ndesc->label_vbuf == NULL))
+		return;
+
+	if (label_matrices_num == label_matrices_alloc) {
+		label_matrices_alloc = MAX(64, 2 * label_matrices_alloc);
+		RESIZE(label_matrices, label_matrices_alloc, XformMatrix);
+	}
+	xform_copy( label_matrices[label_matrices_num], xform_current( ) );
+
+	for (i = 0; i < set->num; i++) {
+		span = &set->spans[i];
+		if (span->count == 0)
+			continue;
+
+		/* Too small to read, or off-screen? */
+		hh = screen_size_pixels( span->center[0], span->center[1], span->center[2], span->half_height );
+		if ((2.0 * hh) < LABEL_MIN_HEIGHT)
+			continue;
+		if (!screen_project( span->center, &win ))
+			continue;
+		hw = hh * span->half_width / span->half_height;
+		if (((win.x + hw) < 0.0) || ((win.x - hw) >= (double)frustum_viewport_w))
+			continue;
+		if (((win.y + hh) < 0.0) || ((win.y - hh) >= (double)frustum_viewport_h))
+			continue;
+
+		if (label_candidates_num == label_candidates_alloc) {
+			label_candidates_alloc = MAX(256, 2 * label_candidates_alloc);
+			RESIZE(label_candidates, label_candidates_alloc, LabelCandidate);
+		}
+		cand = &label_candidates[label_candidates_num++];
+		cand->range = dir_ndesc->label_vbuf;
+		cand->span = span;
+		cand->matrix = label_matrices_num;
+
+		/* Bigger labels first. Directory names count double, and
+		 * the current node always gets its label */
+		cand->priority = hh;
+		if (NODE_IS_DIR(span->node))
+			cand->priority *= 2.0;
+		if (span->node == globals.current_node)
+			cand->priority = HUGE_VAL;
+
+		cand->cell_x0 = MAX(0, (int)floor( (win.x - hw) / (double)LABEL_GRID_CELL ));
+		cand->cell_y0 = MAX(0, (int)floor( (win.y - hh) / (double)LABEL_GRID_CELL ));
+		cand->cell_x1 = MIN(label_grid_w - 1, (int)floor( (win.x + hw) / (double)LABEL_GRID_CELL ));
+		cand->cell_y1 = MIN(label_grid_h - 1, (int)floor( (win.y + hh) / (double)LABEL_GRID_CELL ));
+	}
+
+	++label_matrices_num;
+}
+
+
+/* Compare function for sorting label candidates (highest priority first) */
+static int
+label_candidate_compare( const void *a, const void *b )
+{
+	const LabelCandidate *ca = (const LabelCandidate *)a;
+	const LabelCandidate *cb = (const LabelCandidate *)b;
+
+	if (ca->priority > cb->priority)
+		return -1;
+	if (ca->priority < cb->priority)
+		return 1;
+
+	return 0;
+}
+
+
+/* Picks out the labels to draw this frame, and queues them up. Call
+ * with the model transformation at identity, and vbuf_flush( ) after */
+static void
+label_place_end( void )
+{
+	LabelCandidate *cand;
+	int placed = 0;
+	int i, x, y;
+	boolean clear;
+
+	qsort( label_candidates, label_candidates_num, sizeof(LabelCandidate), label_candidate_compare );
+
+	for (i = 0; (i < label_candidates_num) && (placed < LABEL_MAX_COUNT); i++) {
+		cand = &label_candidates[i];
+
+		/* Check for overlap */
+		clear = TRUE;
+		for (y = cand->cell_y0; clear && (y <= cand->cell_y1); y++) {
+			for (x = cand->cell_x0; x <= cand->cell_x1; x++) {
+				if (label_grid[y * label_grid_w + x]) {
+					clear = FALSE;
+					break;
+				}
+			}
+		}
+		if (!clear && (cand->priority != HUGE_VAL))
+			continue;
+
+		/* Claim the space */
+		for (y = cand->cell_y0; y <= cand->cell_y1; y++) {
+			for (x = cand->cell_x0; x <= cand->cell_x1; x++)
+				label_grid[y * label_grid_w + x] = 1;
+		}
+
+		xform_push( );
+		xform_multiply( label_matrices[cand->matrix] );
+		vbuf_queue_triangles( cand->range, cand->span->first, cand->span->count );
+		xform_pop( );
+		++placed;
+	}
+}
+
+
 /* TreeV arrangement flag: set when tree geometry changes,
  * cleared after treev_arrange() runs */
 static boolean treev_needs_arrange = FALSE;
@@ -235,6 +616,397 @@ static boolean treev_needs_arrange = FALSE;
 static boolean treev_animating = FALSE;
 
 
+/* Subtree bounds */
+
+/* Each expanded directory keeps a bounding volume hierarchy over its
+ * children, in world space. The box of a subdirectory takes in both its
+ * own geometry and (unless it is collapsed) the bounds of its children,
+ * so the root of a directory's hierarchy encloses everything drawn under
+ * it, wherever the layout happens to put it. The draw recursions cull
+ * whole subtrees against these boxes.
+ *
+ * Hierarchies are brought up to date, bottom up, at the start of each
+ * frame. Those of directories flagged with bvh_stale are refit while
+ * geometry is on the move, and rebuilt once it has come to rest */
+
+/* Where the children of a directory are laid out in world space (cf.
+ * the accumulated arguments of the draw recursions) */
+typedef struct _BoundsFrame BoundsFrame;
+struct _BoundsFrame {
+	double x, y, scale;	/* DiscV: directory center and scale */
+	double z;		/* MapV: top face of directory */
+	double r0;		/* TreeV: inner radius of platform, */
+	double subtree_r0;	/* and of the platforms beyond it; */
+	double theta, height;	/* angle and height of platform */
+};
+
+/* TRUE when the bounds of every directory need updating */
+static boolean bounds_all_stale = TRUE;
+
+/* Ray being cast for picking (see geometry_pick( )), with the frame of
+ * the nodes being tested, and the nearest hit so far */
+typedef struct _PickRay PickRay;
+struct _PickRay {
+	double origin[3];
+	double direction[3];
+	BoundsFrame frame;
+	GNode *node;
+	unsigned int face_id;
+};
+
+
+/* Flags the bounds of a directory, and of every directory containing
+ * it, for updating */
+static void
+bounds_queue_update( GNode *dnode )
+{
+	GNode *up_node;
+
+	up_node = dnode;
+	while (up_node != NULL) {
+		DIR_NODE_DESC(up_node)->bvh_stale = TRUE;
+		up_node = up_node->parent;
+	}
+}
+
+
+/* Flags the bounds of every directory in the subtree rooted at the
+ * specified directory for updating (collapsed ones are left alone) */
+static void
+bounds_queue_update_recursive( GNode *dnode )
+{
+	GNode *node;
+
+	DIR_NODE_DESC(dnode)->bvh_stale = TRUE;
+
+	node = dnode->children;
+	while (node != NULL) {
+		if (!NODE_IS_DIR(node))
+			break;
+		if (!DIR_COLLAPSED(node))
+			bounds_queue_update_recursive( node );
+		node = node->next;
+	}
+}
+
+
+/* Brings a directory's hierarchy up to date, box_func giving the boxes
+ * of its children as laid out in the specified frame */
+static void
+bounds_update( GNode *dnode, BvhBoxFunc box_func, BoundsFrame *frame )
+{
+	DirNodeDesc *dir_ndesc;
+	GNode *node;
+	void **items;
+	int num_items, i = 0;
+
+	dir_ndesc = DIR_NODE_DESC(dnode);
+	num_items = g_node_n_children( dnode );
+
+	if ((dir_ndesc->bvh != NULL) && (bvh_num_items( dir_ndesc->bvh ) == num_items) && (colexp_active || treev_animating)) {
+		/* Children are moving; the same tree will do */
+		bvh_refit( dir_ndesc->bvh, box_func, frame );
+		return;
+	}
+
+	bvh_free( dir_ndesc->bvh );
+	dir_ndesc->bvh = NULL;
+	if (num_items == 0)
+		return;
+
+	items = NEW_ARRAY(void *, num_items);
+	node = dnode->children;
+	while (node != NULL) {
+		items[i++] = node;
+		node = node->next;
+	}
+	dir_ndesc->bvh = bvh_new( items, num_items, box_func, frame );
+	xfree( items );
+}
+
+
+/* Grows a box to take in the bounds of a directory's children, if they
+ * are being drawn */
+static void
+bounds_add_subtree( BvhBox *box, GNode *node )
+{
+	BvhBox subtree_box;
+
+	if (!NODE_IS_DIR(node) || DIR_COLLAPSED(node) || (DIR_NODE_DESC(node)->bvh == NULL))
+		return;
+
+	bvh_get_bounds( DIR_NODE_DESC(node)->bvh, &subtree_box );
+	bvh_box_add_box( box, &subtree_box );
+}
+
+
+/* Tells if a subtree with the given bounds is to be drawn, i.e. if its
+ * box is at least partially inside the view frustum, and no smaller on
+ * screen than threshold (pixels) */
+static boolean
+bounds_visible( const BvhBox *box, double threshold )
+{
+	double cx, cy, cz, radius;
+
+	if (bvh_box_is_empty( box ))
+		return FALSE;
+
+	cx = 0.5 * (box->min[0] + box->max[0]);
+	cy = 0.5 * (box->min[1] + box->max[1]);
+	cz = 0.5 * (box->min[2] + box->max[2]);
+	radius = 0.5 * sqrt( SQR(box->max[0] - box->min[0]) + SQR(box->max[1] - box->min[1]) + SQR(box->max[2] - box->min[2]) );
+	if ((radius > 0.0) && (screen_size_pixels( cx, cy, cz, radius ) < threshold))
+		return FALSE;
+
+	return frustum_test_aabb( box->min[0], box->min[1], box->min[2], box->max[0], box->max[1], box->max[2] );
+}
+
+
+/* Occlusion culling (MapV and TreeV). At the end of the geometry pass,
+ * the box of each subtree that made it past the frustum test is drawn,
+ * invisibly, inside an occlusion query, i.e. tested against the depth
+ * buffer of the frame just drawn. Subtrees whose boxes then come up
+ * with no samples at all are skipped in the next frame, and queried
+ * again. Results are only picked up once they are available, so the CPU
+ * never waits on the GPU, at the price of a frame's lag */
+
+/* Number of frames a query result is taken to hold for */
+#define OCCLUSION_MAX_AGE 2
+
+/* A subtree waiting for its query to be issued */
+typedef struct _OcclusionTest OcclusionTest;
+struct _OcclusionTest {
+	GNode *dnode;
+	BvhBox box;
+};
+
+/* Subtrees to query at the end of the geometry pass */
+static OcclusionTest *occlusion_queue = NULL;
+static int occlusion_queue_num = 0;
+static int occlusion_queue_size = 0;
+
+/* Query objects not belonging to any directory */
+static GLuint *occlusion_free_queries = NULL;
+static int occlusion_free_num = 0;
+static int occlusion_free_size = 0;
+
+/* Number of the frame being drawn, and TRUE during its geometry pass */
+static unsigned int occlusion_frame = 0;
+static boolean occlusion_collecting = FALSE;
+
+
+/* Disregards all query results so far (called when the layout changes) */
+static void
+occlusion_reset( void )
+{
+	occlusion_frame += OCCLUSION_MAX_AGE + 1;
+}
+
+
+/* Tells if a subtree, whose box passed the frustum test, was hidden as
+ * of the last frame. During the geometry pass, this also picks up the
+ * result of the subtree's last query, and queues up a new one */
+static boolean
+occlusion_test( GNode *dnode, const BvhBox *box )
+{
+	DirNodeDesc *dir_ndesc;
+	const FrustumPlane *near_plane = &frustum_planes[4];
+	GLuint result;
+	double px, py, pz;
+
+	dir_ndesc = DIR_NODE_DESC(dnode);
+
+	/* Pictures show everything, hidden or not */
+	if (impostor_capturing)
+		return FALSE;
+
+	if (occlusion_collecting) {
+		if (dir_ndesc->occ_pending) {
+			glGetQueryObjectuiv( dir_ndesc->occ_query, GL_QUERY_RESULT_AVAILABLE, &result );
+			if (result) {
+				glGetQueryObjectuiv( dir_ndesc->occ_query, GL_QUERY_RESULT, &result );
+				dir_ndesc->occluded = (result == 0);
+				dir_ndesc->occ_pending = FALSE;
+			}
+		}
+
+		/* A box reaching through the near plane can't be tested
+		 * (its front faces get clipped away), but it's in view */
+		px = (near_plane->a >= 0.0) ? box->min[0] : box->max[0];
+		py = (near_plane->b >= 0.0) ? box->min[1] : box->max[1];
+		pz = (near_plane->c >= 0.0) ? box->min[2] : box->max[2];
+		if ((near_plane->a * px + near_plane->b * py + near_plane->c * pz + near_plane->d) < 0.0)
+			dir_ndesc->occluded = FALSE;
+		else if (!dir_ndesc->occ_pending) {
+			if (occlusion_queue_num == occlusion_queue_size) {
+				occlusion_queue_size = MAX(64, 2 * occlusion_queue_size);
+				RESIZE(occlusion_queue, occlusion_queue_size, OcclusionTest);
+			}
+			occlusion_queue[occlusion_queue_num].dnode = dnode;
+			occlusion_queue[occlusion_queue_num].box = *box;
+			++occlusion_queue_num;
+		}
+	}
+
+	return dir_ndesc->occluded && ((occlusion_frame - dir_ndesc->occ_frame) <= OCCLUSION_MAX_AGE);
+}
+
+
+/* Call before the geometry pass */
+static void
+occlusion_begin( void )
+{
+	/* The pick pass goes by what the last frame found */
+	occlusion_collecting = !picking_mode;
+	if (occlusion_collecting)
+		++occlusion_frame;
+	occlusion_queue_num = 0;
+}
+
+
+/* Draws a box (for an occlusion query) */
+static void
+occlusion_draw_box( const BvhBox *box )
+{
+	const float *p0 = box->min, *p1 = box->max;
+
+	vbuf_begin( GL_QUADS );
+	/* Bottom, top */
+	vbuf_vertex3d( p0[0], p0[1], p0[2] );
+	vbuf_vertex3d( p0[0], p1[1], p0[2] );
+	vbuf_vertex3d( p1[0], p1[1], p0[2] );
+	vbuf_vertex3d( p1[0], p0[1], p0[2] );
+	vbuf_vertex3d( p0[0], p0[1], p1[2] );
+	vbuf_vertex3d( p1[0], p0[1], p1[2] );
+	vbuf_vertex3d( p1[0], p1[1], p1[2] );
+	vbuf_vertex3d( p0[0], p1[1], p1[2] );
+	/* Front, back */
+	vbuf_vertex3d( p0[0], p0[1], p0[2] );
+	vbuf_vertex3d( p1[0], p0[1], p0[2] );
+	vbuf_vertex3d( p1[0], p0[1], p1[2] );
+	vbuf_vertex3d( p0[0], p0[1], p1[2] );
+	vbuf_vertex3d( p0[0], p1[1], p0[2] );
+	vbuf_vertex3d( p0[0], p1[1], p1[2] );
+	vbuf_vertex3d( p1[0], p1[1], p1[2] );
+	vbuf_vertex3d( p1[0], p1[1], p0[2] );
+	/* Left, right */
+	vbuf_vertex3d( p0[0], p0[1], p0[2] );
+	vbuf_vertex3d( p0[0], p0[1], p1[2] );
+	vbuf_vertex3d( p0[0], p1[1], p1[2] );
+	vbuf_vertex3d( p0[0], p1[1], p0[2] );
+	vbuf_vertex3d( p1[0], p0[1], p0[2] );
+	vbuf_vertex3d( p1[0], p1[1], p0[2] );
+	vbuf_vertex3d( p1[0], p1[1], p1[2] );
+	vbuf_vertex3d( p1[0], p0[1], p1[2] );
+	vbuf_end( );
+}
+
+
+/* Call after the geometry pass: issues the queries queued up during it */
+static void
+occlusion_end( void )
+{
+	DirNodeDesc *dir_ndesc;
+	int i;
+
+	if (!occlusion_collecting)
+		return;
+	occlusion_collecting = FALSE;
+	if (occlusion_queue_num == 0)
+		return;
+
+	/* Boxes write neither color nor depth, and are drawn slightly
+	 * nearer than they are, so that faces lying flush against the
+	 * geometry inside are not lost to the depth test. (With the core
+	 * renderer, only the first draw buffer is masked here; see
+	 * ogl_pick_ids( ) for the other. The legacy renderer draws to just
+	 * the one, and its context may lack glColorMaski( )) */
+	if (ogl_core_profile( ))
+		glColorMaski( 0, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+	else
+		glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+	glDepthMask( GL_FALSE );
+	glDisable( GL_CULL_FACE );
+	glPolygonOffset( -1.0, -1.0 );
+
+	for (i = 0; i < occlusion_queue_num; i++) {
+		dir_ndesc = DIR_NODE_DESC(occlusion_queue[i].dnode);
+		if (dir_ndesc->occ_query == 0) {
+			if (occlusion_free_num > 0)
+				dir_ndesc->occ_query = occlusion_free_queries[--occlusion_free_num];
+			else
+				glGenQueries( 1, &dir_ndesc->occ_query );
+		}
+		glBeginQuery( GL_SAMPLES_PASSED, dir_ndesc->occ_query );
+		occlusion_draw_box( &occlusion_queue[i].box );
+		glEndQuery( GL_SAMPLES_PASSED );
+		dir_ndesc->occ_pending = TRUE;
+		dir_ndesc->occ_frame = occlusion_frame;
+	}
+	occlusion_queue_num = 0;
+
+	glPolygonOffset( 1.0, 1.0 );
+	glEnable( GL_CULL_FACE );
+	glDepthMask( GL_TRUE );
+	if (ogl_core_profile( ))
+		glColorMaski( 0, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+	else
+		glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+}
+
+
+/* Gives back a directory's query object, for reuse */
+static void
+occlusion_free( DirNodeDesc *dir_ndesc )
+{
+	if (dir_ndesc->occ_query == 0)
+		return;
+
+	if (occlusion_free_num == occlusion_free_size) {
+		occlusion_free_size = MAX(64, 2 * occlusion_free_size);
+		RESIZE(occlusion_free_queries, occlusion_free_size, GLuint);
+	}
+	occlusion_free_queries[occlusion_free_num++] = dir_ndesc->occ_query;
+	dir_ndesc->occ_query = 0;
+	dir_ndesc->occ_pending = FALSE;
+	dir_ndesc->occluded = FALSE;
+}
+
+
+/* Finds where the ray origin + t * direction enters a box. Returns the
+ * ray parameter (or t_max if the box is missed, or not entered before
+ * that), and the axis whose pair of faces the ray came in through in
+ * *axis (-1 if it starts out inside) */
+static double
+ray_box_entry( const double *origin, const double *direction, const BvhBox *box, double t_max, int *axis )
+{
+	double t0 = 0.0, t1 = t_max;
+	double ta, tb;
+	int i;
+
+	*axis = -1;
+	for (i = 0; i < 3; i++) {
+		if (direction[i] == 0.0) {
+			/* Ray runs parallel to this pair of faces */
+			if ((origin[i] < box->min[i]) || (origin[i] > box->max[i]))
+				return t_max;
+			continue;
+		}
+		ta = (box->min[i] - origin[i]) / direction[i];
+		tb = (box->max[i] - origin[i]) / direction[i];
+		if (MIN(ta, tb) > t0) {
+			t0 = MIN(ta, tb);
+			*axis = i;
+		}
+		t1 = MIN(t1, MAX(ta, tb));
+		if (t0 > t1)
+			return t_max;
+	}
+
+	return t0;
+}
+
+
 /* Forward declarations */
 static void outline_pre( void );
 static void outline_post( void );
@@ -243,14 +1015,410 @@ static void cursor_hidden_part( void );
 static void cursor_visible_part( void );
 static void cursor_post( void );
 static void queue_uncached_draw( void );
+static void bounds_update_all( void );
 static void discv_draw_cursor( double pos );
 
 
+/* Impostors (MapV and TreeV). A large expanded subtree that is far away,
+ * and so small on screen, is drawn once into a texture (outlines and
+ * all), and from then on as a single quad wearing that picture. The
+ * quad stands square to the view the picture was taken from, at the
+ * depth of the front of the subtree's box, so that what lies in front
+ * of the subtree still hides it, and the directory it stands on does
+ * not show through. The picture is taken over once the camera has
+ * swung around the subtree, or moved in or out, by more than a little,
+ * or once anything in the scene has changed. The pick pass always
+ * draws the real thing */
+
+/* Fewest nodes a subtree must have to be worth a picture */
+#define IMPOSTOR_MIN_NODES 512
+
+/* Largest on-screen size (see screen_size_pixels( )) a subtree can have
+ * to be drawn as an impostor, and closest it can be, in multiples of
+ * its radius */
+#define IMPOSTOR_MAX_PIXELS 256.0
+#define IMPOSTOR_MIN_DISTANCE 4.0
+
+/* How far (degrees) the camera may swing around a subtree, and by what
+ * factor its size on screen may change, before the picture is taken
+ * over */
+#define IMPOSTOR_MAX_ANGLE 1.5
+#define IMPOSTOR_MAX_ZOOM 1.1
+
+/* Most pictures taken per frame, and largest texture side */
+#define IMPOSTOR_CAPTURES_PER_FRAME 4
+#define IMPOSTOR_MAX_TEXTURE 512
+
+/* Frames an impostor may go unused before it is freed */
+#define IMPOSTOR_MAX_IDLE 240
+
+/* What to do with a subtree (see impostor_check( )) */
+enum {
+	IMPOSTOR_NONE,		/* Draw it as usual */
+	IMPOSTOR_READY,		/* Leave it out; its impostor stands in */
+	IMPOSTOR_CAPTURE	/* Draw it into its picture (for now) */
+};
+
+/* Directories holding impostors (cf. Impostor.slot) */
+static DirNodeDesc **impostor_dirs = NULL;
+static int impostor_dirs_num = 0;
+static int impostor_dirs_size = 0;
+
+/* Impostors to draw at the end of the geometry pass */
+static Impostor **impostor_queue = NULL;
+static int impostor_queue_num = 0;
+static int impostor_queue_size = 0;
+
+/* Scene state: bumped whenever anything is to be drawn differently */
+static unsigned int impostor_generation = 0;
+
+/* Number of the frame being drawn, TRUE during its geometry pass, and
+ * pictures taken in it so far */
+static unsigned int impostor_frame = 0;
+static boolean impostor_placing = FALSE;
+static int impostor_captures = 0;
+
+/* Camera position of the frame being drawn */
+static double impostor_eye[3];
+
+/* The picture being taken: its directory, framing (NDC rectangle
+ * x0, y0, x1, y1, and depth of the quad), the projection to go back to
+ * afterward, and where the subtree stood */
+static GNode *impostor_capture_dnode = NULL;
+static double impostor_capture_rect[5];
+static XformMatrix impostor_capture_prev_projection;
+static double impostor_capture_center[3];
+static double impostor_capture_pixels;
+
+
+/* Disregards all pictures taken so far (called when the scene changes) */
+static void
+impostor_invalidate( void )
+{
+	++impostor_generation;
+}
+
+
+/* Frees a directory's impostor */
+static void
+impostor_remove( DirNodeDesc *dir_ndesc )
+{
+	Impostor *imp = dir_ndesc->impostor;
+
+	if (imp == NULL)
+		return;
+
+	/* Move the last one into its slot */
+	impostor_dirs[imp->slot] = impostor_dirs[--impostor_dirs_num];
+	impostor_dirs[imp->slot]->impostor->slot = imp->slot;
+
+	impostor_free( imp );
+	dir_ndesc->impostor = NULL;
+}
+
+
+/* Call before the geometry pass */
+static void
+impostor_begin( void )
+{
+	XformMatrix view_inverse;
+
+	impostor_queue_num = 0;
+	impostor_placing = FALSE;
+	if (picking_mode)
+		return;
+
+	++impostor_frame;
+	impostor_captures = 0;
+	/* Pictures would be out of date as soon as they were taken */
+	if (colexp_active || treev_animating)
+		return;
+	if (!impostor_available( ))
+		return;
+	impostor_placing = TRUE;
+	if (!xform_invert( view_inverse, xform_view( ) )) {
+		impostor_placing = FALSE;
+		return;
+	}
+	impostor_eye[0] = view_inverse[12];
+	impostor_eye[1] = view_inverse[13];
+	impostor_eye[2] = view_inverse[14];
+}
+
+
+/* Tells if a picture taken from eye, at the given size on screen, will
+ * still do for a subtree centered at c, now that far */
+static boolean
+impostor_usable( const Impostor *imp, const double *c, double pixels )
+{
+	double u[3], v[3];
+	double u_len, v_len, cos_angle;
+	int i;
+
+	if ((imp->generation != impostor_generation) || (pixels > IMPOSTOR_MAX_ZOOM * imp->pixels) || (imp->pixels > IMPOSTOR_MAX_ZOOM * pixels))
+		return FALSE;
+
+	for (i = 0; i < 3; i++) {
+		u[i] = impostor_eye[i] - c[i];
+		v[i] = imp->eye[i] - c[i];
+	}
+	u_len = sqrt( SQR(u[0]) + SQR(u[1]) + SQR(u[2]) );
+	v_len = sqrt( SQR(v[0]) + SQR(v[1]) + SQR(v[2]) );
+	if ((u_len < EPSILON) || (v_len < EPSILON))
+		return FALSE;
+	cos_angle = (u[0] * v[0] + u[1] * v[1] + u[2] * v[2]) / (u_len * v_len);
+
+	return cos_angle >= cos( RAD(IMPOSTOR_MAX_ANGLE) );
+}
+
+
+/* Works out the framing of a picture of the given box: the NDC
+ * rectangle it covers, and the depth of its nearest corner. Returns
+ * FALSE if any of it is behind the camera */
+static boolean
+impostor_frame_box( const BvhBox *box, double *rect )
+{
+	const double *m = frustum_mvp;
+	double x, y, z, w;
+	int c;
+
+	rect[0] = rect[1] = rect[4] = HUGE_VAL;
+	rect[2] = rect[3] = - HUGE_VAL;
+	for (c = 0; c < 8; c++) {
+		x = (c & 1) ? box->max[0] : box->min[0];
+		y = (c & 2) ? box->max[1] : box->min[1];
+		z = (c & 4) ? box->max[2] : box->min[2];
+		w = m[3] * x + m[7] * y + m[11] * z + m[15];
+		if (w <= EPSILON)
+			return FALSE;
+		rect[0] = MIN(rect[0], (m[0] * x + m[4] * y + m[8] * z + m[12]) / w);
+		rect[1] = MIN(rect[1], (m[1] * x + m[5] * y + m[9] * z + m[13]) / w);
+		rect[2] = MAX(rect[2], (m[0] * x + m[4] * y + m[8] * z + m[12]) / w);
+		rect[3] = MAX(rect[3], (m[1] * x + m[5] * y + m[9] * z + m[13]) / w);
+		rect[4] = MIN(rect[4], (m[2] * x + m[6] * y + m[10] * z + m[14]) / w);
+	}
+
+	return (rect[2] > rect[0]) && (rect[3] > rect[1]) && (rect[4] > -1.0);
+}
+
+
+/* Flushes what the geometry pass has queued up so far */
+static void
+impostor_flush( void )
+{
+	vbuf_flush( FALSE );
+	if ((globals.fsv_mode == FSV_MAPV) && mapvinst_available( ))
+		mapvinst_flush( FALSE );
+}
+
+
+/* Decides what to do with a subtree, whose box passed the other tests.
+ * During the geometry pass, a subtree may get an impostor, or have its
+ * picture taken: then the caller is to draw it (geometry, followed by
+ * outlines after impostor_capture_outlines( ) unless cel_lines is set,
+ * in which case they are already in), and finish up with
+ * impostor_capture_finish( ). In the other passes, subtrees drawn as
+ * impostors are left out */
+static int
+impostor_check( GNode *dnode, const BvhBox *box )
+{
+	DirNodeDesc *dir_ndesc;
+	Impostor *imp;
+	XformMatrix crop, projection;
+	double c[3];
+	double radius, pixels, sx, sy;
+	int width, height, num_nodes = 0;
+	int i;
+
+	dir_ndesc = DIR_NODE_DESC(dnode);
+	imp = dir_ndesc->impostor;
+
+	if (impostor_capturing || picking_mode)
+		return IMPOSTOR_NONE;
+	if (!impostor_placing) {
+		if ((imp != NULL) && (imp->frame == impostor_frame))
+			return IMPOSTOR_READY;
+		return IMPOSTOR_NONE;
+	}
+
+	/* Worth a picture? */
+	if (!DIR_EXPANDED(dnode))
+		return IMPOSTOR_NONE;
+	for (i = 0; i < NUM_NODE_TYPES; i++)
+		num_nodes += dir_ndesc->subtree.counts[i];
+	if (num_nodes < IMPOSTOR_MIN_NODES)
+		return IMPOSTOR_NONE;
+	for (i = 0; i < 3; i++)
+		c[i] = 0.5 * (box->min[i] + box->max[i]);
+	radius = 0.5 * sqrt( SQR(box->max[0] - box->min[0]) + SQR(box->max[1] - box->min[1]) + SQR(box->max[2] - box->min[2]) );
+	pixels = screen_size_pixels( c[0], c[1], c[2], radius );
+	if (pixels > IMPOSTOR_MAX_PIXELS)
+		return IMPOSTOR_NONE;
+	if ((SQR(impostor_eye[0] - c[0]) + SQR(impostor_eye[1] - c[1]) + SQR(impostor_eye[2] - c[2])) < SQR(IMPOSTOR_MIN_DISTANCE * radius))
+		return IMPOSTOR_NONE;
+
+	if ((imp == NULL) || !impostor_usable( imp, c, pixels )) {
+		/* Take the picture over */
+		if (impostor_captures >= IMPOSTOR_CAPTURES_PER_FRAME)
+			return IMPOSTOR_NONE;
+		if (!impostor_frame_box( box, impostor_capture_rect ))
+			return IMPOSTOR_NONE;
+		width = (int)ceil( 0.5 * (impostor_capture_rect[2] - impostor_capture_rect[0]) * frustum_viewport_w );
+		height = (int)ceil( 0.5 * (impostor_capture_rect[3] - impostor_capture_rect[1]) * frustum_viewport_h );
+		width = CLAMP(width, 1, IMPOSTOR_MAX_TEXTURE);
+		height = CLAMP(height, 1, IMPOSTOR_MAX_TEXTURE);
+
+		if (imp == NULL) {
+			imp = impostor_new( );
+			if (impostor_dirs_num == impostor_dirs_size) {
+				impostor_dirs_size = MAX(64, 2 * impostor_dirs_size);
+				RESIZE(impostor_dirs, impostor_dirs_size, DirNodeDesc *);
+			}
+			imp->slot = impostor_dirs_num;
+			impostor_dirs[impostor_dirs_num++] = dir_ndesc;
+			dir_ndesc->impostor = imp;
+		}
+
+		/* Draw what is queued up so far, then switch over to a
+		 * projection framing just the subtree's box */
+		impostor_flush( );
+		impostor_capture_begin( imp, width, height );
+		sx = 2.0 / (impostor_capture_rect[2] - impostor_capture_rect[0]);
+		sy = 2.0 / (impostor_capture_rect[3] - impostor_capture_rect[1]);
+		xform_identity( crop );
+		crop[0] = sx;
+		crop[5] = sy;
+		crop[12] = - 0.5 * (impostor_capture_rect[0] + impostor_capture_rect[2]) * sx;
+		crop[13] = - 0.5 * (impostor_capture_rect[1] + impostor_capture_rect[3]) * sy;
+		xform_copy( impostor_capture_prev_projection, xform_projection( ) );
+		xform_mult( projection, crop, impostor_capture_prev_projection );
+		xform_set_projection( projection );
+		frustum_extract( );
+
+		impostor_capture_dnode = dnode;
+		for (i = 0; i < 3; i++)
+			impostor_capture_center[i] = c[i];
+		impostor_capture_pixels = pixels;
+		impostor_capturing = TRUE;
+		++impostor_captures;
+
+		return IMPOSTOR_CAPTURE;
+	}
+
+	imp->frame = impostor_frame;
+	if (impostor_queue_num == impostor_queue_size) {
+		impostor_queue_size = MAX(64, 2 * impostor_queue_size);
+		RESIZE(impostor_queue, impostor_queue_size, Impostor *);
+	}
+	impostor_queue[impostor_queue_num++] = imp;
+
+	return IMPOSTOR_READY;
+}
+
+
+/* Call between drawing the geometry of a subtree into its picture and
+ * drawing the outlines */
+static void
+impostor_capture_outlines( void )
+{
+	impostor_flush( );
+	outline_pre( );
+	drawing_outlines = TRUE;
+}
+
+
+/* Call after drawing a subtree into its picture. The impostor is then
+ * queued up for drawing, in place of the subtree */
+static void
+impostor_capture_finish( void )
+{
+	Impostor *imp;
+	const double *rect = impostor_capture_rect;
+	XformMatrix inverse;
+	double p[4];
+	int c, i;
+
+	impostor_flush( );
+	if (drawing_outlines) {
+		drawing_outlines = FALSE;
+		outline_post( );
+	}
+
+	imp = DIR_NODE_DESC(impostor_capture_dnode)->impostor;
+	impostor_capture_end( imp );
+	xform_set_projection( impostor_capture_prev_projection );
+	frustum_extract( );
+	impostor_capturing = FALSE;
+
+	/* Quad corners: the corners of the picture's rectangle, back in
+	 * world space */
+	xform_invert( inverse, frustum_mvp );
+	for (c = 0; c < 4; c++) {
+		p[0] = ((c == 1) || (c == 2)) ? rect[2] : rect[0];
+		p[1] = (c >= 2) ? rect[3] : rect[1];
+		p[2] = rect[4];
+		p[3] = inverse[3] * p[0] + inverse[7] * p[1] + inverse[11] * p[2] + inverse[15];
+		for (i = 0; i < 3; i++)
+			imp->corners[c][i] = (float)((inverse[i] * p[0] + inverse[4 + i] * p[1] + inverse[8 + i] * p[2] + inverse[12 + i]) / p[3]);
+	}
+	for (i = 0; i < 3; i++)
+		imp->eye[i] = impostor_eye[i];
+	imp->pixels = impostor_capture_pixels;
+	imp->generation = impostor_generation;
+	imp->frame = impostor_frame;
+
+	if (impostor_queue_num == impostor_queue_size) {
+		impostor_queue_size = MAX(64, 2 * impostor_queue_size);
+		RESIZE(impostor_queue, impostor_queue_size, Impostor *);
+	}
+	impostor_queue[impostor_queue_num++] = imp;
+	impostor_capture_dnode = NULL;
+}
+
+
+/* Call after the geometry pass (and its flush): draws the impostors
+ * queued up during it, and frees those that have gone unused a while */
+static void
+impostor_end( void )
+{
+	int i;
+
+	if (!impostor_placing)
+		return;
+	impostor_placing = FALSE;
+
+	if (impostor_queue_num > 0) {
+		impostor_draw_pre( );
+		for (i = 0; i < impostor_queue_num; i++)
+			impostor_draw( impostor_queue[i] );
+		impostor_draw_post( );
+		impostor_queue_num = 0;
+		ogl_pick_ids_partial( );
+	}
+
+	i = 0;
+	while (i < impostor_dirs_num) {
+		if ((impostor_frame - impostor_dirs[i]->impostor->frame) > IMPOSTOR_MAX_IDLE)
+			impostor_remove( impostor_dirs[i] );
+		else
+			++i;
+	}
+}
+
+
 /**** DISC VISUALIZATION **************************************/
 
 
 /* Geometry constants */
-#define DISCV_CURVE_GRANULARITY		15.0
+#define DISCV_MAX_DISC_STRIDE		36	/* 8 segments */
+#define DISCV_MIN_DISC_STRIDE		3	/* 96 segments */
+#define DISCV_SPOT_RADIUS		1.0	/* pixels */
+
+/* Detail levels: the discs of a directory are built to suit a
+ * projected scale of 2^(level - DISCV_LEVEL_BIAS) pixels per unit.
+ * Level 0 means "not built yet" */
+#define DISCV_LEVEL_BIAS		24
+#define DISCV_MAX_LEVEL			31
 #define DISCV_LEAF_RANGE_ARC_WIDTH	315.0
 #define DISCV_LEAF_STEM_PROPORTION	0.5
 
@@ -423,50 +1591,119 @@ discv_init( void )
 {
 	DiscVGeomParams *gparams;
 
+	unit_circle_init( );
+
 	gparams = DISCV_GEOM_PARAMS(globals.fstree);
 	gparams->radius = 0.0;
 	gparams->theta = 0.0;
 
-	discv_init_recursive( globals.fstree, 270.0 );
+	discv_init_recursive( globals.fstree, 270.0 );
+
+	gparams->pos.x = 0.0;
+	gparams->pos.y = - DISCV_GEOM_PARAMS(root_dnode)->radius;
+
+	/* Initialize cursor to root position */
+	discv_cursor_prev_pos.x = 0.0;
+	discv_cursor_prev_pos.y = 0.0;
+	discv_cursor_prev_radius = 2.0 * DISCV_GEOM_PARAMS(root_dnode)->radius;
+
+	/* DiscV mode is entirely 2D */
+	vbuf_normal3d( 0.0, 0.0, 1.0 );
+}
+
+
+/* Picks the detail level for the discs of a directory, whose children
+ * are drawn at the given world-space position and scale. prev_level is
+ * the level the directory was last built with; it is kept while the
+ * projected scale stays near it, so geometry isn't rebuilt back and
+ * forth at a threshold */
+static int
+discv_detail_level( double x, double y, double scale, int prev_level )
+{
+	double ppu, level;
+
+	ppu = screen_size_pixels( x, y, 0.0, scale );
+	if (ppu == HUGE_VAL)
+		return DISCV_MAX_LEVEL;
+	if (ppu <= 0.0)
+		return 1;
+
+	level = log( ppu ) / log( 2.0 ) + (double)DISCV_LEVEL_BIAS;
+	if ((prev_level > 0) && (ABS(level - (double)prev_level) < 0.75))
+		return prev_level;
+	if (coarse_curves && (prev_level > 0) && (level > (double)prev_level) && (level < (double)prev_level + 2.0))
+		return prev_level;
+
+	return CLAMP((int)floor( level + 0.5 ), 1, DISCV_MAX_LEVEL);
+}
+
+
+/* Returns the (upper bound of the) pixels-per-unit scale that discs
+ * built at the given detail level are drawn with */
+static double
+discv_level_scale( int level )
+{
+	return ldexp( 1.0, level - DISCV_LEVEL_BIAS + 1 );
+}
+
 
-	gparams->pos.x = 0.0;
-	gparams->pos.y = - DISCV_GEOM_PARAMS(root_dnode)->radius;
+/* Returns the stride through the unit circle table to draw a disc
+ * of the given on-screen radius with */
+static int
+discv_disc_stride( double r_pixels )
+{
+	static const int strides[] = { 36, 24, 18, 12, 9, 6, 4, DISCV_MIN_DISC_STRIDE };
+	int i;
 
-	/* Initialize cursor to root position */
-	discv_cursor_prev_pos.x = 0.0;
-	discv_cursor_prev_pos.y = 0.0;
-	discv_cursor_prev_radius = 2.0 * DISCV_GEOM_PARAMS(root_dnode)->radius;
+	for (i = 0; strides[i] > DISCV_MIN_DISC_STRIDE; i++) {
+		if (curve_error( r_pixels, strides[i] ) <= curve_tolerance( ))
+			break;
+	}
 
-	/* DiscV mode is entirely 2D */
-	glNormal3d( 0.0, 0.0, 1.0 );
+	return strides[i];
 }
 
 
-/* Draws a DiscV node. dir_deployment is deployment of parent directory */
+/* Draws a DiscV node. dir_deployment is deployment of parent directory,
+ * and ppu the on-screen scale (pixels per unit) to tessellate for */
 static void
-discv_gldraw_node( GNode *node, double dir_deployment )
+discv_gldraw_node( GNode *node, double dir_deployment, double ppu )
 {
-	static const int seg_count = (int)(360.0 / DISCV_CURVE_GRANULARITY + 0.999);
 	DiscVGeomParams *gparams;
 	XYvec center, p;
-	double theta;
-	int s;
+	double r_pixels, half_edge;
+	int s, seg_count, stride;
 
 	gparams = DISCV_GEOM_PARAMS(node);
 
 	center.x = dir_deployment * gparams->pos.x;
 	center.y = dir_deployment * gparams->pos.y;
 
+	r_pixels = ppu * gparams->radius;
+	if (r_pixels < DISCV_SPOT_RADIUS) {
+		/* Disc is down to a spot on the screen. Draw it as a
+		 * square of the same area */
+		half_edge = (0.5 * sqrt( PI )) * gparams->radius;
+		vbuf_begin( GL_QUADS );
+		vbuf_vertex2d( center.x - half_edge, center.y - half_edge );
+		vbuf_vertex2d( center.x + half_edge, center.y - half_edge );
+		vbuf_vertex2d( center.x + half_edge, center.y + half_edge );
+		vbuf_vertex2d( center.x - half_edge, center.y + half_edge );
+		vbuf_end( );
+		return;
+	}
+
+	stride = discv_disc_stride( r_pixels );
+	seg_count = UNIT_CIRCLE_STEPS / stride;
+
 	/* Draw disc */
-	glBegin( GL_TRIANGLE_FAN );
-	glVertex2d( center.x, center.y );
+	vbuf_begin( GL_TRIANGLE_FAN );
+	vbuf_vertex2d( center.x, center.y );
 	for (s = 0; s <= seg_count; s++) {
-		theta = (double)s / (double)seg_count * 360.0;
-		p.x = center.x + gparams->radius * cos( RAD(theta) );
-		p.y = center.y + gparams->radius * sin( RAD(theta) );
-		glVertex2d( p.x, p.y );
+		p = unit_circle[(s * stride) % UNIT_CIRCLE_STEPS];
+		vbuf_vertex2d( center.x + gparams->radius * p.x, center.y + gparams->radius * p.y );
 	}
-	glEnd( );
+	vbuf_end( );
 }
 
 
@@ -495,16 +1732,16 @@ discv_gldraw_folder( GNode *node )
 	folder_tab.y = folder_c1.y - border;
 
 	node_glcolor( node );
-	glBegin( GL_LINE_STRIP );
-	glVertex2d( folder_c0.x, folder_c0.y );
-	glVertex2d( folder_c0.x, folder_tab.y );
-	glVertex2d( folder_c0.x + border, folder_c1.y );
-	glVertex2d( folder_tab.x - border, folder_c1.y );
-	glVertex2d( folder_tab.x, folder_tab.y );
-	glVertex2d( folder_c1.x, folder_tab.y );
-	glVertex2d( folder_c1.x, folder_c0.y );
-	glVertex2d( folder_c0.x, folder_c0.y );
-	glEnd( );
+	vbuf_begin( GL_LINE_STRIP );
+	vbuf_vertex2d( folder_c0.x, folder_c0.y );
+	vbuf_vertex2d( folder_c0.x, folder_tab.y );
+	vbuf_vertex2d( folder_c0.x + border, folder_c1.y );
+	vbuf_vertex2d( folder_tab.x - border, folder_c1.y );
+	vbuf_vertex2d( folder_tab.x, folder_tab.y );
+	vbuf_vertex2d( folder_c1.x, folder_tab.y );
+	vbuf_vertex2d( folder_c1.x, folder_c0.y );
+	vbuf_vertex2d( folder_c0.x, folder_c0.y );
+	vbuf_end( );
 }
 
 
@@ -514,17 +1751,18 @@ static void
 discv_build_dir( GNode *dnode )
 {
 	GNode *node;
-	double dpm;
+	double dpm, ppu;
 
 	dpm = DIR_NODE_DESC(dnode)->deployment;
 	/* TODO: Fix this, please */
 	dpm = 1.0;
 
+	ppu = discv_level_scale( DIR_NODE_DESC(dnode)->curve_detail );
+
 	node = dnode->children;
 	while (node != NULL) {
-		glLoadName( NODE_DESC(node)->id );
 		node_glcolor( node );
-		discv_gldraw_node( node, dpm );
+		discv_gldraw_node( node, dpm, ppu );
 		node = node->next;
 	}
 }
@@ -535,8 +1773,9 @@ discv_apply_label( GNode *node )
 {
 	DiscVGeomParams *gparams;
 	XYZvec label_pos;
-	XYvec label_dims;
+	XYvec label_dims, extents;
 	double r;
+	int first;
 
 	gparams = DISCV_GEOM_PARAMS(node);
 	r = gparams->radius;
@@ -550,7 +1789,116 @@ discv_apply_label( GNode *node )
 	label_dims.x = 1.5 * r;
 	label_dims.y = (2.0 - MAGIC_NUMBER) * r;
 
+	first = label_mark( );
 	text_draw_straight( NODE_DESC(node)->name, &label_pos, &label_dims );
+	text_get_extents( NODE_DESC(node)->name, &label_dims, &extents );
+	label_add( node, first, &label_pos, &extents );
+}
+
+
+/* Bounds callback: box of a node on its parent's DiscV frame, taking in
+ * the subtree of a directory */
+static void
+discv_node_box( void *item, BvhBox *box, void *data )
+{
+	GNode *node = (GNode *)item;
+	BoundsFrame *frame = (BoundsFrame *)data;
+	DiscVGeomParams *gparams;
+	double x, y, r;
+
+	gparams = DISCV_GEOM_PARAMS(node);
+	x = frame->x + frame->scale * gparams->pos.x;
+	y = frame->y + frame->scale * gparams->pos.y;
+	r = frame->scale * gparams->radius;
+
+	bvh_box_clear( box );
+	bvh_box_add_point( box, x - r, y - r, 0.0 );
+	bvh_box_add_point( box, x + r, y + r, 0.0 );
+	bounds_add_subtree( box, node );
+}
+
+
+/* Gets the DiscV frame of a directory's children, given the frame the
+ * directory itself is in */
+static void
+discv_children_frame( GNode *dnode, const BoundsFrame *frame, BoundsFrame *children_frame )
+{
+	children_frame->x = frame->x + frame->scale * DISCV_GEOM_PARAMS(dnode)->pos.x;
+	children_frame->y = frame->y + frame->scale * DISCV_GEOM_PARAMS(dnode)->pos.y;
+	children_frame->scale = frame->scale * DIR_NODE_DESC(dnode)->deployment;
+}
+
+
+/* Updates the bounds of the subtree rooted at the specified directory,
+ * which is in the given frame (force to update all of it) */
+static void
+discv_bounds_recursive( GNode *dnode, const BoundsFrame *frame, boolean force )
+{
+	DirNodeDesc *dir_ndesc;
+	BoundsFrame children_frame;
+	GNode *node;
+
+	dir_ndesc = DIR_NODE_DESC(dnode);
+	if (!force && !dir_ndesc->bvh_stale)
+		return;
+	dir_ndesc->bvh_stale = FALSE;
+	if (DIR_COLLAPSED(dnode))
+		return;
+
+	discv_children_frame( dnode, frame, &children_frame );
+
+	/* Subdirectories first, as their boxes take in their bounds */
+	node = dnode->children;
+	while (node != NULL) {
+		if (!NODE_IS_DIR(node))
+			break;
+		discv_bounds_recursive( node, &children_frame, force );
+		node = node->next;
+	}
+
+	bounds_update( dnode, discv_node_box, &children_frame );
+}
+
+
+/* Ray casting callback for DiscV: hits a node's disc, or anything in
+ * its subtree (see geometry_pick( )) */
+static double
+discv_ray_hit( void *item, double t_max, void *data )
+{
+	GNode *node = (GNode *)item;
+	PickRay *ray = (PickRay *)data;
+	DiscVGeomParams *gparams;
+	BoundsFrame frame;
+	BvhBox box;
+	double x, y, r, t;
+
+	/* Nothing too small to be drawn is hit */
+	discv_node_box( node, &box, &ray->frame );
+	if (!bounds_visible( &box, CULL_SIZE_THRESHOLD ))
+		return t_max;
+
+	/* Disc lies in the z = 0 plane */
+	gparams = DISCV_GEOM_PARAMS(node);
+	if (ray->direction[2] != 0.0) {
+		t = - ray->origin[2] / ray->direction[2];
+		x = ray->origin[0] + t * ray->direction[0] - (ray->frame.x + ray->frame.scale * gparams->pos.x);
+		y = ray->origin[1] + t * ray->direction[1] - (ray->frame.y + ray->frame.scale * gparams->pos.y);
+		r = ray->frame.scale * gparams->radius;
+		if ((t >= 0.0) && (t < t_max) && ((SQR(x) + SQR(y)) <= SQR(r))) {
+			ray->node = node;
+			ray->face_id = 0;
+			t_max = t;
+		}
+	}
+
+	if (NODE_IS_DIR(node) && !DIR_COLLAPSED(node) && (DIR_NODE_DESC(node)->bvh != NULL)) {
+		frame = ray->frame;
+		discv_children_frame( node, &frame, &ray->frame );
+		t_max = bvh_raycast( DIR_NODE_DESC(node)->bvh, ray->origin, ray->direction, t_max, discv_ray_hit, ray );
+		ray->frame = frame;
+	}
+
+	return t_max;
 }
 
 
@@ -562,85 +1910,87 @@ discv_draw_recursive( GNode *dnode, int action, double acc_x, double acc_y, doub
 {
 	DirNodeDesc *dir_ndesc;
 	DiscVGeomParams *dir_gparams;
+	BoundsFrame frame;
+	BvhBox box;
 	GNode *node;
 	boolean dir_collapsed;
 	boolean dir_expanded;
 	double world_x, world_y, world_scale, world_radius;
-	boolean visible;
+	int level;
 
 	dir_ndesc = DIR_NODE_DESC(dnode);
 	dir_gparams = DISCV_GEOM_PARAMS(dnode);
 
-	/* Compute world-space bounding sphere */
+	/* Frustum and size culling, against the box of the directory
+	 * disc together with everything under it (the children lie
+	 * outside the disc, and theirs further out still) */
+	if (NODE_IS_DIR(dnode)) {
+		frame.x = acc_x;
+		frame.y = acc_y;
+		frame.scale = acc_scale;
+		discv_node_box( dnode, &box, &frame );
+		if (!bounds_visible( &box, CULL_SIZE_THRESHOLD ))
+			return;
+	}
+
 	world_x = acc_x + acc_scale * dir_gparams->pos.x;
 	world_y = acc_y + acc_scale * dir_gparams->pos.y;
 	world_scale = acc_scale * dir_ndesc->deployment;
 	world_radius = world_scale * dir_gparams->radius;
 
-	/* Size culling: skip entire subtree if projected size is tiny */
-	if (world_radius > 0.0 &&
-	    screen_size_pixels( world_x, world_y, 0.0, world_radius ) < CULL_SIZE_THRESHOLD)
-		return;
-
-	/* Frustum culling: test if this node's disc is on-screen
-	 * (don't skip subtree -- children may extend beyond parent disc) */
-	visible = world_radius <= 0.0 ||
-	          frustum_test_sphere( world_x, world_y, 0.0, world_radius );
-
-	glPushMatrix( );
+	xform_push( );
 
 	dir_collapsed = DIR_COLLAPSED(dnode);
 	dir_expanded = DIR_EXPANDED(dnode);
 
-	glTranslated( dir_gparams->pos.x, dir_gparams->pos.y, 0.0 );
-	glScaled( dir_ndesc->deployment,  dir_ndesc->deployment,  1.0 );
-
-	if (visible && action == DISCV_DRAW_GEOMETRY) {
-		/* Draw folder or leaf nodes (display list A) */
-		if (picking_mode) {
-			/* Pick mode: draw directly, bypass display lists */
-			if (!dir_collapsed)
-				discv_build_dir( dnode );
+	xform_translate( dir_gparams->pos.x, dir_gparams->pos.y, 0.0 );
+	xform_scale( dir_ndesc->deployment,  dir_ndesc->deployment,  1.0 );
+
+	if (action == DISCV_DRAW_GEOMETRY) {
+		/* Disc detail to suit the directory's size on screen.
+		 * (Left alone while picking, which doesn't need it) */
+		if (!picking_mode && !dir_collapsed) {
+			level = discv_detail_level( world_x, world_y, world_scale, dir_ndesc->curve_detail );
+			if (level != (int)dir_ndesc->curve_detail) {
+				dir_ndesc->curve_detail = level;
+				dir_ndesc->a_stale = TRUE;
+			}
 		}
-		else if (dir_ndesc->a_dlist_stale) {
+
+		/* Draw folder or leaf nodes (geometry A). The folder is
+		 * made of lines, which the pick pass leaves out */
+		if (dir_ndesc->a_stale || !vbuf_range_usable( dir_ndesc->a_vbuf, colexp_active )) {
 			/* Rebuild */
-			if (dir_ndesc->a_dlist == NULL_DLIST)
-				dir_ndesc->a_dlist = glGenLists( 1 );
-			glNewList( dir_ndesc->a_dlist, GL_COMPILE_AND_EXECUTE );
+			vbuf_record_begin( &dir_ndesc->a_vbuf );
 			if (!dir_collapsed)
 				discv_build_dir( dnode );
 			if (!dir_expanded)
 				discv_gldraw_folder( dnode );
-			glEndList( );
-			dir_ndesc->a_dlist_stale = FALSE;
+			vbuf_record_end( );
+			dir_ndesc->a_stale = FALSE;
 		}
-		else
-			glCallList( dir_ndesc->a_dlist );
+		vbuf_queue( dir_ndesc->a_vbuf );
 	}
 
-	if (visible && action == DISCV_DRAW_LABELS &&
+	if (action == DISCV_DRAW_LABELS &&
 	    !(world_radius > 0.0 &&
 	      screen_size_pixels( world_x, world_y, 0.0, world_radius ) < LABEL_SIZE_THRESHOLD)) {
-		/* Draw name label(s) (display list B) */
-		if (dir_ndesc->b_dlist_stale) {
-			/* Rebuild */
-			if (dir_ndesc->b_dlist == NULL_DLIST)
-				dir_ndesc->b_dlist = glGenLists( 1 );
-			glNewList( dir_ndesc->b_dlist, GL_COMPILE_AND_EXECUTE );
+		/* Draw name label(s) (geometry B) */
+		if (dir_ndesc->b_stale || !vbuf_range_usable( dir_ndesc->label_vbuf, colexp_active )) {
+			label_record_begin( dir_ndesc );
 			/* Label leaf nodes */
 			node = dnode->children;
 			while (node != NULL) {
 				discv_apply_label( node );
 				node = node->next;
 			}
-			glEndList( );
-			dir_ndesc->b_dlist_stale = FALSE;
+			label_record_end( );
+			dir_ndesc->b_stale = FALSE;
 		}
-		else
-			glCallList( dir_ndesc->b_dlist );
+		label_submit( dir_ndesc );
 	}
 
-	/* Update geometry status (always, even if frustum-culled) */
+	/* Update geometry status */
 	dir_ndesc->geom_expanded = !dir_collapsed;
 
 	if (dir_expanded) {
@@ -654,7 +2004,7 @@ discv_draw_recursive( GNode *dnode, int action, double acc_x, double acc_y, doub
 		}
 	}
 
-	glPopMatrix( );
+	xform_pop( );
 }
 
 
@@ -662,22 +2012,41 @@ discv_draw_recursive( GNode *dnode, int action, double acc_x, double acc_y, doub
 static void
 discv_draw( boolean high_detail )
 {
+	frametime_phase_begin( FRAMETIME_FRUSTUM );
 	frustum_extract( );
+	frametime_phase_end( FRAMETIME_FRUSTUM );
+	xform_load_identity( );
+
+	frametime_phase_begin( FRAMETIME_GEOMETRY );
+	bounds_update_all( );
 
 	glLineWidth( 3.0 );
 
 	/* Draw low-detail geometry (culled tree walk) */
+	ogl_pick_ids( TRUE );
 	discv_draw_recursive( globals.fstree, DISCV_DRAW_GEOMETRY, 0.0, 0.0, 1.0 );
+	vbuf_flush( picking_mode );
+	ogl_pick_ids( FALSE );
+	frametime_phase_end( FRAMETIME_GEOMETRY );
 
 	if (high_detail) {
 		/* Node name labels */
+		frametime_phase_begin( FRAMETIME_LABELS );
 		text_pre( );
-		glColor3f( 0.0, 0.0, 0.0 );
+		vbuf_color3f( 0.0, 0.0, 0.0 );
+		label_place_begin( );
 		discv_draw_recursive( globals.fstree, DISCV_DRAW_LABELS, 0.0, 0.0, 1.0 );
+		label_place_end( );
+		vbuf_flush( FALSE );
 		text_post( );
+		frametime_phase_end( FRAMETIME_LABELS );
+	}
 
+	if (!picking_mode) {
 		/* Node cursor */
+		frametime_phase_begin( FRAMETIME_CURSOR );
 		discv_draw_cursor( CURSOR_POS(camera->pan_part) );
+		frametime_phase_end( FRAMETIME_CURSOR );
 	}
 
 	glLineWidth( 1.0 );
@@ -687,9 +2056,12 @@ discv_draw( boolean high_detail )
 static void
 discv_gldraw_cursor( XYvec pos, double radius )
 {
-	static const int seg_count = (int)(360.0 / DISCV_CURVE_GRANULARITY + 0.999);
-	double theta;
+	XYvec p;
 	int i, s;
+	int seg_count, stride;
+
+	stride = discv_disc_stride( screen_size_pixels( pos.x, pos.y, 0.0, radius ) );
+	seg_count = UNIT_CIRCLE_STEPS / stride;
 
 	cursor_pre( );
 	for (i = 0; i < 2; i++) {
@@ -698,13 +2070,12 @@ discv_gldraw_cursor( XYvec pos, double radius )
 		else
 			cursor_visible_part( );
 
-		glBegin( GL_LINE_LOOP );
+		vbuf_begin( GL_LINE_LOOP );
 		for (s = 0; s < seg_count; s++) {
-			theta = (double)s / (double)seg_count * 360.0;
-			glVertex2d( pos.x + radius * cos( RAD(theta) ),
-			            pos.y + radius * sin( RAD(theta) ) );
+			p = unit_circle[s * stride];
+			vbuf_vertex2d( pos.x + radius * p.x, pos.y + radius * p.y );
 		}
-		glEnd( );
+		vbuf_end( );
 	}
 	cursor_post( );
 }
@@ -785,6 +2156,11 @@ static double mapv_leaf_height = 128.0;
 static XYZvec mapv_cursor_prev_c0;
 static XYZvec mapv_cursor_prev_c1;
 
+/* Flag: TRUE if the instance buffer needs to be recreated (after a new
+ * layout). Node boxes are drawn as instances if the GL supports it (see
+ * mapvinst.c) */
+static boolean mapv_instances_reset = TRUE;
+
 
 /* Returns the z-position of the bottom of a node */
 double
@@ -1055,6 +2431,7 @@ mapv_init( void )
 	gparams->height = mapv_dir_height;
 
 	mapv_init_recursive( root_dnode );
+	mapv_instances_reset = TRUE;
 
 	/* Initial cursor state */
 	if (globals.current_node == root_dnode)
@@ -1113,37 +2490,34 @@ mapv_gldraw_node( GNode *node )
 	gparams = MAPV_GEOM_PARAMS(node);
 
 	/* Draw sides of node */
-	glBegin( GL_QUAD_STRIP );
-	glNormal3d( 0.0, normal.y, normal_z_ny ); /* Rear face */
-	glVertex3d( gparams->c0.x, gparams->c1.y, 0.0 );
-	glVertex3d( gparams->c0.x + offset.x, gparams->c1.y - offset.y, gparams->height );
-	glNormal3d( normal.x, 0.0, normal_z_nx ); /* Right face */
-	glVertex3d( gparams->c1.x, gparams->c1.y, 0.0 );
-	glVertex3d( gparams->c1.x - offset.x, gparams->c1.y - offset.y, gparams->height );
-	glNormal3d( 0.0, - normal.y, normal_z_ny ); /* Front face */
-	glVertex3d( gparams->c1.x, gparams->c0.y, 0.0 );
-	glVertex3d( gparams->c1.x - offset.x, gparams->c0.y + offset.y, gparams->height );
-	glNormal3d( - normal.x, 0.0, normal_z_nx ); /* Left face */
-	glVertex3d( gparams->c0.x, gparams->c0.y, 0.0 );
-	glVertex3d( gparams->c0.x + offset.x, gparams->c0.y + offset.y, gparams->height );
-	glVertex3d( gparams->c0.x, gparams->c1.y, 0.0 ); /* Close strip */
-	glVertex3d( gparams->c0.x + offset.x, gparams->c1.y - offset.y, gparams->height );
-	glEnd( );
+	vbuf_begin( GL_QUAD_STRIP );
+	vbuf_normal3d( 0.0, normal.y, normal_z_ny ); /* Rear face */
+	vbuf_vertex3d( gparams->c0.x, gparams->c1.y, 0.0 );
+	vbuf_vertex3d( gparams->c0.x + offset.x, gparams->c1.y - offset.y, gparams->height );
+	vbuf_normal3d( normal.x, 0.0, normal_z_nx ); /* Right face */
+	vbuf_vertex3d( gparams->c1.x, gparams->c1.y, 0.0 );
+	vbuf_vertex3d( gparams->c1.x - offset.x, gparams->c1.y - offset.y, gparams->height );
+	vbuf_normal3d( 0.0, - normal.y, normal_z_ny ); /* Front face */
+	vbuf_vertex3d( gparams->c1.x, gparams->c0.y, 0.0 );
+	vbuf_vertex3d( gparams->c1.x - offset.x, gparams->c0.y + offset.y, gparams->height );
+	vbuf_normal3d( - normal.x, 0.0, normal_z_nx ); /* Left face */
+	vbuf_vertex3d( gparams->c0.x, gparams->c0.y, 0.0 );
+	vbuf_vertex3d( gparams->c0.x + offset.x, gparams->c0.y + offset.y, gparams->height );
+	vbuf_vertex3d( gparams->c0.x, gparams->c1.y, 0.0 ); /* Close strip */
+	vbuf_vertex3d( gparams->c0.x + offset.x, gparams->c1.y - offset.y, gparams->height );
+	vbuf_end( );
 
 	/* Top face has ID of 1 */
-	glPushName( 1 );
 	node_glcolor_face( node, 1 );
 
 	/* Draw top face */
-	glNormal3d( 0.0, 0.0, 1.0 );
-	glBegin( GL_QUADS );
-	glVertex3d( gparams->c0.x + offset.x, gparams->c0.y + offset.y, gparams->height );
-	glVertex3d( gparams->c1.x - offset.x, gparams->c0.y + offset.y, gparams->height );
-	glVertex3d( gparams->c1.x - offset.x, gparams->c1.y - offset.y, gparams->height );
-	glVertex3d( gparams->c0.x + offset.x, gparams->c1.y - offset.y, gparams->height );
-	glEnd( );
-
-	glPopName( );
+	vbuf_normal3d( 0.0, 0.0, 1.0 );
+	vbuf_begin( GL_QUADS );
+	vbuf_vertex3d( gparams->c0.x + offset.x, gparams->c0.y + offset.y, gparams->height );
+	vbuf_vertex3d( gparams->c1.x - offset.x, gparams->c0.y + offset.y, gparams->height );
+	vbuf_vertex3d( gparams->c1.x - offset.x, gparams->c1.y - offset.y, gparams->height );
+	vbuf_vertex3d( gparams->c0.x + offset.x, gparams->c1.y - offset.y, gparams->height );
+	vbuf_end( );
 }
 
 
@@ -1182,16 +2556,16 @@ mapv_gldraw_folder( GNode *dnode )
 	folder_tab.y = folder_c1.y - border;
 
 	node_glcolor( dnode );
-	glBegin( GL_LINE_STRIP );
-	glVertex2d( folder_c0.x, folder_c0.y );
-	glVertex2d( folder_c0.x, folder_tab.y );
-	glVertex2d( folder_c0.x + border, folder_c1.y );
-	glVertex2d( folder_tab.x - border, folder_c1.y );
-	glVertex2d( folder_tab.x, folder_tab.y );
-	glVertex2d( folder_c1.x, folder_tab.y );
-	glVertex2d( folder_c1.x, folder_c0.y );
-	glVertex2d( folder_c0.x, folder_c0.y );
-	glEnd( );
+	vbuf_begin( GL_LINE_STRIP );
+	vbuf_vertex2d( folder_c0.x, folder_c0.y );
+	vbuf_vertex2d( folder_c0.x, folder_tab.y );
+	vbuf_vertex2d( folder_c0.x + border, folder_c1.y );
+	vbuf_vertex2d( folder_tab.x - border, folder_c1.y );
+	vbuf_vertex2d( folder_tab.x, folder_tab.y );
+	vbuf_vertex2d( folder_c1.x, folder_tab.y );
+	vbuf_vertex2d( folder_c1.x, folder_c0.y );
+	vbuf_vertex2d( folder_c0.x, folder_c0.y );
+	vbuf_end( );
 }
 
 
@@ -1207,7 +2581,6 @@ mapv_build_dir( GNode *dnode )
 	node = dnode->children;
 	while (node != NULL) {
 		/* Draw node */
-		glLoadName( NODE_DESC(node)->id );
 		node_glcolor( node );
 		mapv_gldraw_node( node );
 		node = node->next;
@@ -1215,13 +2588,62 @@ mapv_build_dir( GNode *dnode )
 }
 
 
+/* Returns the number of nodes in a directory's subtree (not including
+ * the directory itself). This is also the number of instance records
+ * the subtree takes up */
+static int
+mapv_subtree_instances( GNode *dnode )
+{
+	int count = 0;
+	int i;
+
+	for (i = 0; i < NUM_NODE_TYPES; i++)
+		count += DIR_NODE_DESC(dnode)->subtree.counts[i];
+
+	return count;
+}
+
+
+/* Fills in the instance records for the children of a directory
+ * (cf. mapv_build_dir( )). z0 is the height of the directory's top face */
+static void
+mapv_stage_instances( GNode *dnode, int first, int count, double z0 )
+{
+	MapVInstance *inst;
+	MapVGeomParams *gparams;
+	const float *color;
+	GNode *node;
+	int i;
+
+	inst = mapvinst_stage( first, count );
+	node = dnode->children;
+	while (node != NULL) {
+		gparams = MAPV_GEOM_PARAMS(node);
+		inst->c0[0] = gparams->c0.x;
+		inst->c0[1] = gparams->c0.y;
+		inst->c1[0] = gparams->c1.x;
+		inst->c1[1] = gparams->c1.y;
+		inst->z0 = z0;
+		inst->height = gparams->height;
+		color = (const float *)NODE_DESC(node)->color;
+		for (i = 0; i < 3; i++)
+			inst->color[i] = (unsigned char)(255.0 * CLAMP(color[i], 0.0, 1.0) + 0.5);
+		inst->type = NODE_DESC(node)->type;
+		inst->node_id = NODE_DESC(node)->id;
+		++inst;
+		node = node->next;
+	}
+}
+
+
 /* Draws a node name label */
 static void
 mapv_apply_label( GNode *node )
 {
 	XYZvec label_pos;
-	XYvec dims, label_dims;
+	XYvec dims, label_dims, extents;
 	double k;
+	int first;
 
 	/* Obtain dimensions of top face */
 	dims.x = MAPV_NODE_WIDTH(node);
@@ -1242,91 +2664,483 @@ mapv_apply_label( GNode *node )
 	else
 		label_pos.z = MAPV_GEOM_PARAMS(node)->height;
 
+	first = label_mark( );
 	text_draw_straight( NODE_DESC(node)->name, &label_pos, &label_dims );
+	text_get_extents( NODE_DESC(node)->name, &label_dims, &extents );
+	label_add( node, first, &label_pos, &extents );
+}
+
+
+/* Draws the name labels of the non-subdirectory children of a
+ * directory */
+static void
+mapv_build_dir_labels( GNode *dnode )
+{
+	GNode *node;
+
+	node = dnode->children;
+	while (node != NULL) {
+		if (!NODE_IS_DIR(node))
+			mapv_apply_label( node );
+		node = node->next;
+	}
+}
+
+
+/* Build jobs. When a sizable directory starts to expand, the geometry
+ * of its children (geometry A and labels) is built in a worker thread,
+ * while the GL thread carries on drawing. The recordings are made in the
+ * children's resting place, so that they can be drawn (displaced) all
+ * the while the directory grows, and taken in as is once it settles.
+ * Drawing never waits for a worker: until its job is done, the
+ * directory is drawn without its children. Workers only read the
+ * layout, and allocate memory; a job is waited for or cancelled before
+ * anything it reads is changed or freed */
+
+/* Fewest children a directory must have to be worth a build job */
+#define BUILD_JOB_MIN_CHILDREN		64
+
+typedef struct _BuildJob BuildJob;
+struct _BuildJob {
+	GNode		*dnode;
+	XformMatrix	matrix;		/* Model transformation of children */
+	VBufRange	*a_vbuf;	/* Deferred recordings */
+	VBufRange	*label_vbuf;
+	LabelSet	*label_set;
+	boolean		running;	/* Picked up by a worker */
+	boolean		done;
+	boolean		cancelled;	/* Dropped before it ran */
+};
+
+/* Worker threads, and the jobs submitted to them that have not yet been
+ * collected or discarded */
+static GThreadPool *build_job_pool = NULL;
+static GList *build_job_list = NULL;
+
+/* Guards the running/done/cancelled flags of jobs */
+static GMutex build_job_mutex;
+static GCond build_job_cond;
+
+
+/* Frees a build job, along with whatever it built */
+static void
+build_job_free( BuildJob *job )
+{
+	vbuf_range_free( &job->a_vbuf );
+	vbuf_range_free( &job->label_vbuf );
+	if (job->label_set != NULL) {
+		xfree( job->label_set->spans );
+		xfree( job->label_set );
+	}
+	xfree( job );
+}
+
+
+/* Idle callback: has a directory whose build job is done drawn with
+ * its children (see build_job_collect( )) */
+static gboolean
+build_job_done_cb( G_GNUC_UNUSED gpointer user_data )
+{
+	redraw( );
+
+	return G_SOURCE_REMOVE;
+}
+
+
+/* Worker thread function: builds the geometry of a job's directory */
+static void
+build_job_run( gpointer data, G_GNUC_UNUSED gpointer user_data )
+{
+	BuildJob *job = (BuildJob *)data;
+
+	g_mutex_lock( &build_job_mutex );
+	if (job->cancelled) {
+		g_mutex_unlock( &build_job_mutex );
+		build_job_free( job );
+		return;
+	}
+	job->running = TRUE;
+	g_mutex_unlock( &build_job_mutex );
+
+	vbuf_record_begin_deferred( &job->a_vbuf, job->matrix );
+	mapv_build_dir( job->dnode );
+	vbuf_record_end( );
+
+	/* cf. mapv_draw( ) */
+	vbuf_color3f( 0.0, 0.0, 0.0 );
+	label_record_begin_deferred( &job->label_set, &job->label_vbuf, job->matrix );
+	mapv_build_dir_labels( job->dnode );
+	label_record_end( );
+
+	g_mutex_lock( &build_job_mutex );
+	job->done = TRUE;
+	g_cond_broadcast( &build_job_cond );
+	g_mutex_unlock( &build_job_mutex );
+
+	g_idle_add( build_job_done_cb, NULL );
+}
+
+
+/* Starts building the geometry of a directory's children in advance, if
+ * it is big enough to bother */
+static void
+build_job_submit( GNode *dnode )
+{
+	DirNodeDesc *dir_ndesc = DIR_NODE_DESC(dnode);
+	BuildJob *job;
+	int num_threads;
+
+	if (dir_ndesc->build_job != NULL)
+		return;
+	if (g_node_n_children( dnode ) < BUILD_JOB_MIN_CHILDREN)
+		return;
+
+	if (build_job_pool == NULL) {
+		/* Leave a processor for the GL thread */
+		num_threads = MAX(1, (int)g_get_num_processors( ) - 1);
+		build_job_pool = g_thread_pool_new( build_job_run, NULL, num_threads, FALSE, NULL );
+	}
+
+	job = NEW(BuildJob);
+	memset( job, 0, sizeof(BuildJob) );
+	job->dnode = dnode;
+	xform_identity( job->matrix );
+	xform_matrix_translate( job->matrix, 0.0, 0.0, geometry_mapv_node_z0( dnode ) + MAPV_GEOM_PARAMS(dnode)->height );
+
+	dir_ndesc->build_job = job;
+	build_job_list = g_list_prepend( build_job_list, job );
+	g_thread_pool_push( build_job_pool, job, NULL );
+}
+
+
+/* Detaches a directory's build job, and waits for it to finish if a
+ * worker is on it. A job that no worker has picked up yet is cancelled.
+ * Returns the job if it has finished, NULL otherwise. (Only for jobs
+ * being dropped, not from drawing) */
+static BuildJob *
+build_job_finish( DirNodeDesc *dir_ndesc )
+{
+	BuildJob *job = dir_ndesc->build_job;
+
+	if (job == NULL)
+		return NULL;
+	dir_ndesc->build_job = NULL;
+	build_job_list = g_list_remove( build_job_list, job );
+
+	g_mutex_lock( &build_job_mutex );
+	if (!job->running) {
+		/* The worker frees it */
+		job->cancelled = TRUE;
+		job = NULL;
+	}
+	else {
+		while (!job->done)
+			g_cond_wait( &build_job_cond, &build_job_mutex );
+	}
+	g_mutex_unlock( &build_job_mutex );
+
+	return job;
+}
+
+
+/* Takes in the geometry built in advance for an expanding directory,
+ * if its job is done. Returns FALSE if it is still queued or running */
+static boolean
+build_job_collect( GNode *dnode )
+{
+	DirNodeDesc *dir_ndesc = DIR_NODE_DESC(dnode);
+	BuildJob *job = dir_ndesc->build_job;
+	LabelSet *label_set;
+	boolean done;
+
+	g_mutex_lock( &build_job_mutex );
+	done = job->done;
+	g_mutex_unlock( &build_job_mutex );
+	if (!done)
+		return FALSE;
+
+	dir_ndesc->build_job = NULL;
+	build_job_list = g_list_remove( build_job_list, job );
+
+	vbuf_range_adopt( &dir_ndesc->a_vbuf, &job->a_vbuf );
+	vbuf_range_adopt( &dir_ndesc->label_vbuf, &job->label_vbuf );
+	label_set = dir_ndesc->label_set;
+	dir_ndesc->label_set = job->label_set;
+	job->label_set = label_set;
+	dir_ndesc->a_stale = FALSE;
+	dir_ndesc->b_stale = FALSE;
+
+	build_job_free( job );
+
+	/* Pictures and pick results so far went without the children */
+	ogl_pick_invalidate( );
+	impostor_invalidate( );
+
+	return TRUE;
+}
+
+
+/* Drops a directory's build job, if it has one */
+static void
+build_job_discard( DirNodeDesc *dir_ndesc )
+{
+	BuildJob *job;
+
+	job = build_job_finish( dir_ndesc );
+	if (job != NULL)
+		build_job_free( job );
+}
+
+
+/* Drops all build jobs */
+static void
+build_job_discard_all( void )
+{
+	BuildJob *job;
+
+	while (build_job_list != NULL) {
+		job = (BuildJob *)build_job_list->data;
+		build_job_discard( DIR_NODE_DESC(job->dnode) );
+	}
+}
+
+
+/* Bounds callback: box of a node standing on its parent's MapV frame,
+ * taking in the subtree of a directory. (Heights are taken at full
+ * deployment, which errs on the tall side while directories grow or
+ * shrink) */
+static void
+mapv_node_box( void *item, BvhBox *box, void *data )
+{
+	GNode *node = (GNode *)item;
+	BoundsFrame *frame = (BoundsFrame *)data;
+	MapVGeomParams *gparams;
+
+	gparams = MAPV_GEOM_PARAMS(node);
+	bvh_box_clear( box );
+	bvh_box_add_point( box, gparams->c0.x, gparams->c0.y, frame->z );
+	bvh_box_add_point( box, gparams->c1.x, gparams->c1.y, frame->z + gparams->height );
+	bounds_add_subtree( box, node );
+}
+
+
+/* Gets the MapV frame of a directory's children, given the frame the
+ * directory itself is in */
+static void
+mapv_children_frame( GNode *dnode, const BoundsFrame *frame, BoundsFrame *children_frame )
+{
+	children_frame->z = frame->z + MAPV_GEOM_PARAMS(dnode)->height;
+}
+
+
+/* Updates the bounds of the subtree rooted at the specified directory,
+ * which is in the given frame (force to update all of it) */
+static void
+mapv_bounds_recursive( GNode *dnode, const BoundsFrame *frame, boolean force )
+{
+	DirNodeDesc *dir_ndesc;
+	BoundsFrame children_frame;
+	GNode *node;
+
+	dir_ndesc = DIR_NODE_DESC(dnode);
+	if (!force && !dir_ndesc->bvh_stale)
+		return;
+	dir_ndesc->bvh_stale = FALSE;
+	if (DIR_COLLAPSED(dnode))
+		return;
+
+	mapv_children_frame( dnode, frame, &children_frame );
+
+	/* Subdirectories first, as their boxes take in their bounds */
+	node = dnode->children;
+	while (node != NULL) {
+		if (!NODE_IS_DIR(node))
+			break;
+		mapv_bounds_recursive( node, &children_frame, force );
+		node = node->next;
+	}
+
+	bounds_update( dnode, mapv_node_box, &children_frame );
+}
+
+
+/* Ray casting callback for MapV: hits a node's box, or anything in its
+ * subtree (see geometry_pick( )). The top face of a node counts as
+ * face 1, like its pick ID says (cf. mapv_gldraw_node( )) */
+static double
+mapv_ray_hit( void *item, double t_max, void *data )
+{
+	GNode *node = (GNode *)item;
+	PickRay *ray = (PickRay *)data;
+	MapVGeomParams *gparams;
+	BoundsFrame frame;
+	BvhBox box;
+	double origin_z, direction_z;
+	double x, y, k, t;
+	double offset_x, offset_y;
+	int axis;
+
+	mapv_node_box( node, &box, &ray->frame );
+	if (!bounds_visible( &box, CULL_SIZE_THRESHOLD ))
+		return t_max;
+
+	gparams = MAPV_GEOM_PARAMS(node);
+	box.min[2] = ray->frame.z;
+	box.max[2] = ray->frame.z + gparams->height;
+	box.min[0] = gparams->c0.x;
+	box.min[1] = gparams->c0.y;
+	box.max[0] = gparams->c1.x;
+	box.max[1] = gparams->c1.y;
+	t = ray_box_entry( ray->origin, ray->direction, &box, t_max, &axis );
+	if (t < t_max) {
+		ray->node = node;
+		ray->face_id = 0;
+		t_max = t;
+		if ((axis == 2) && (ray->direction[2] < 0.0)) {
+			/* Came in from above. The sides slant inward,
+			 * so the top face is only so big */
+			k = mapv_side_slant_ratios[NODE_DESC(node)->type];
+			offset_x = MIN(gparams->height, k * MAPV_NODE_WIDTH(node));
+			offset_y = MIN(gparams->height, k * MAPV_NODE_DEPTH(node));
+			x = ray->origin[0] + t * ray->direction[0];
+			y = ray->origin[1] + t * ray->direction[1];
+			if ((x >= (gparams->c0.x + offset_x)) && (x <= (gparams->c1.x - offset_x)) && (y >= (gparams->c0.y + offset_y)) && (y <= (gparams->c1.y - offset_y)))
+				ray->face_id = 1;
+		}
+	}
+
+	if (NODE_IS_DIR(node) && !DIR_COLLAPSED(node) && (DIR_NODE_DESC(node)->bvh != NULL)) {
+		/* While the directory grows or shrinks, its children
+		 * are scaled heightwise about its top face. Cast the
+		 * ray into their unscaled space instead */
+		frame = ray->frame;
+		mapv_children_frame( node, &frame, &ray->frame );
+		origin_z = ray->origin[2];
+		direction_z = ray->direction[2];
+		ray->origin[2] = ray->frame.z + (origin_z - ray->frame.z) / DIR_NODE_DESC(node)->deployment;
+		ray->direction[2] = direction_z / DIR_NODE_DESC(node)->deployment;
+		t_max = bvh_raycast( DIR_NODE_DESC(node)->bvh, ray->origin, ray->direction, t_max, mapv_ray_hit, ray );
+		ray->origin[2] = origin_z;
+		ray->direction[2] = direction_z;
+		ray->frame = frame;
+	}
+
+	return t_max;
 }
 
 
 /* MapV mode "full draw".
- * acc_z: accumulated Z offset from parent heights. */
+ * acc_z: accumulated Z offset from parent heights.
+ * inst_first: position of the directory's children in the instance
+ * buffer, or -1 if they are not to be drawn as instances */
 static void
-mapv_draw_recursive( GNode *dnode, int action, double acc_z )
+mapv_draw_recursive( GNode *dnode, int action, double acc_z, int inst_first )
 {
 	DirNodeDesc *dir_ndesc;
 	MapVGeomParams *gparams;
+	BoundsFrame frame;
+	BvhBox box;
 	GNode *node;
 	boolean dir_collapsed;
 	boolean dir_expanded;
+	boolean build_pending = FALSE;
 	double node_z;
+	int inst_next, num_children = 0;
 
 	g_assert( NODE_IS_DIR(dnode) || NODE_IS_METANODE(dnode) );
 
 	gparams = MAPV_GEOM_PARAMS(dnode);
 	node_z = acc_z + gparams->height;
 
-	/* Frustum + size culling (children are within parent's XY footprint,
-	 * so culling the parent culls the entire subtree) */
+	/* Frustum + size culling, against the box of the directory
+	 * together with everything stacked on it. Use higher size
+	 * threshold for outline pass. Then occlusion culling */
 	if (NODE_IS_DIR(dnode)) {
-		double half_w = 0.5 * (gparams->c1.x - gparams->c0.x);
-		double half_d = 0.5 * (gparams->c1.y - gparams->c0.y);
-		double half_size = MAX(half_w, half_d);
-		double cx = gparams->c0.x + half_w;
-		double cy = gparams->c0.y + half_d;
-
-		/* Screen-size cull: skip entire subtree if too small.
-		 * Use higher threshold for outline pass. */
-		{
-			double threshold = drawing_outlines ? OUTLINE_SIZE_THRESHOLD : CULL_SIZE_THRESHOLD;
-			if (half_size > 0.0 &&
-			    screen_size_pixels( cx, cy, node_z, half_size ) < threshold)
-				return;
-		}
+		frame.z = acc_z;
+		mapv_node_box( dnode, &box, &frame );
+		if (!bounds_visible( &box, drawing_outlines ? OUTLINE_SIZE_THRESHOLD : CULL_SIZE_THRESHOLD ))
+			return;
+		if (occlusion_test( dnode, &box ))
+			return;
+		switch (impostor_check( dnode, &box )) {
+			case IMPOSTOR_READY:
+			return;
 
-		/* Frustum cull: test XY footprint with generous Z range */
-		if (!frustum_test_aabb( gparams->c0.x, gparams->c0.y, acc_z - 1.0,
-		                        gparams->c1.x, gparams->c1.y, acc_z + 1e9 ))
+			case IMPOSTOR_CAPTURE:
+			mapv_draw_recursive( dnode, MAPV_DRAW_GEOMETRY, acc_z, inst_first );
+			if (!cel_lines) {
+				impostor_capture_outlines( );
+				mapv_draw_recursive( dnode, MAPV_DRAW_GEOMETRY, acc_z, inst_first );
+			}
+			impostor_capture_finish( );
 			return;
+
+			default:
+			break;
+		}
 	}
 
-	glPushMatrix( );
-	glTranslated( 0.0, 0.0, gparams->height );
+	xform_push( );
+	xform_translate( 0.0, 0.0, gparams->height );
 
 	dir_ndesc = DIR_NODE_DESC(dnode);
 	dir_collapsed = DIR_COLLAPSED(dnode);
 	dir_expanded = DIR_EXPANDED(dnode);
 
 	if (!dir_collapsed && !dir_expanded) {
-		/* Grow/shrink children heightwise */
-		glEnable( GL_NORMALIZE );
-		glScaled( 1.0, 1.0, dir_ndesc->deployment );
+		/* Grow/shrink children heightwise. Instance records
+		 * only describe the steady state, so this subtree goes
+		 * through the vertex buffers until it settles */
+		ogl_enable( GL_NORMALIZE );
+		xform_scale( 1.0, 1.0, dir_ndesc->deployment );
+		inst_first = -1;
+	}
+
+	/* Geometry being built in advance is taken in once it is done.
+	 * Until then, the children of the directory are left out */
+	if ((dir_ndesc->build_job != NULL) && !dir_collapsed)
+		build_pending = !build_job_collect( dnode );
+
+	if (dir_collapsed || build_pending)
+		inst_first = -1;
+	if (inst_first >= 0) {
+		/* The children come first, followed by the subtrees
+		 * of the subdirectories, in order */
+		num_children = mapv_subtree_instances( dnode );
+		node = dnode->children;
+		while ((node != NULL) && NODE_IS_DIR(node)) {
+			num_children -= mapv_subtree_instances( node );
+			node = node->next;
+		}
 	}
 
-	if (action == MAPV_DRAW_GEOMETRY) {
-		/* Draw directory face or geometry of children
-		 * (display list A) */
-		if (picking_mode) {
-			/* Pick mode: draw directly, bypass display lists.
-			 * Collapsed dirs are pickable via their parent's
-			 * build_dir, so only expanded dirs need drawing. */
-			if (!dir_collapsed)
-				mapv_build_dir( dnode );
+	if ((action == MAPV_DRAW_GEOMETRY) && (inst_first >= 0)) {
+		/* Draw children as instances */
+		if (dir_ndesc->i_stale) {
+			mapv_stage_instances( dnode, inst_first, num_children, node_z );
+			dir_ndesc->i_stale = FALSE;
 		}
-		else if (dir_ndesc->a_dlist_stale) {
+		mapvinst_queue( inst_first, num_children );
+	}
+	else if ((action == MAPV_DRAW_GEOMETRY) && !build_pending) {
+		/* Draw directory face or geometry of children
+		 * (geometry A). The folder of a collapsed directory is
+		 * made of lines, which the pick pass leaves out; the
+		 * directory itself is pickable via its parent */
+		if (dir_ndesc->a_stale || !vbuf_range_usable( dir_ndesc->a_vbuf, colexp_active )) {
 			/* Rebuild */
-			if (dir_ndesc->a_dlist == NULL_DLIST)
-				dir_ndesc->a_dlist = glGenLists( 1 );
-			glNewList( dir_ndesc->a_dlist, GL_COMPILE_AND_EXECUTE );
+			vbuf_record_begin( &dir_ndesc->a_vbuf );
 			if (dir_collapsed)
 				mapv_gldraw_folder( dnode );
 			else
 				mapv_build_dir( dnode );
-			glEndList( );
-			dir_ndesc->a_dlist_stale = FALSE;
+			vbuf_record_end( );
+			dir_ndesc->a_stale = FALSE;
 		}
-		else
-			glCallList( dir_ndesc->a_dlist );
+		vbuf_queue( dir_ndesc->a_vbuf );
 	}
 
-	if (action == MAPV_DRAW_LABELS) {
+	if ((action == MAPV_DRAW_LABELS) && !build_pending) {
 		/* Label distance culling: skip if too small to read */
 		double lhs = 0.5 * MAX(gparams->c1.x - gparams->c0.x,
 		                       gparams->c1.y - gparams->c0.y);
@@ -1334,51 +3148,45 @@ mapv_draw_recursive( GNode *dnode, int action, double acc_z )
 		    screen_size_pixels( 0.5 * (gparams->c0.x + gparams->c1.x),
 		                        0.5 * (gparams->c0.y + gparams->c1.y),
 		                        node_z, lhs ) >= LABEL_SIZE_THRESHOLD) {
-			/* Draw name label(s) (display list B) */
-			if (dir_ndesc->b_dlist_stale) {
-				/* Rebuild */
-				if (dir_ndesc->b_dlist == NULL_DLIST)
-					dir_ndesc->b_dlist = glGenLists( 1 );
-				glNewList( dir_ndesc->b_dlist, GL_COMPILE_AND_EXECUTE );
+			/* Draw name label(s) (geometry B) */
+			if (dir_ndesc->b_stale || !vbuf_range_usable( dir_ndesc->label_vbuf, colexp_active )) {
+				label_record_begin( dir_ndesc );
 				if (dir_collapsed) {
 					/* Label directory */
 					mapv_apply_label( dnode );
 				}
 				else {
 					/* Label non-subdirectory children */
-					node = dnode->children;
-					while (node != NULL) {
-						if (!NODE_IS_DIR(node))
-							mapv_apply_label( node );
-						node = node->next;
-					}
+					mapv_build_dir_labels( dnode );
 				}
-				glEndList( );
-				dir_ndesc->b_dlist_stale = FALSE;
+				label_record_end( );
+				dir_ndesc->b_stale = FALSE;
 			}
-			else
-				glCallList( dir_ndesc->b_dlist );
+			label_submit( dir_ndesc );
 		}
 	}
 
 	/* Update geometry status */
-	dir_ndesc->geom_expanded = !dir_collapsed;
+	if (!build_pending)
+		dir_ndesc->geom_expanded = !dir_collapsed;
 
-	if (!dir_collapsed) {
+	if (!dir_collapsed && !build_pending) {
 		/* Recurse into subdirectories */
+		inst_next = inst_first + num_children;
 		node = dnode->children;
 		while (node != NULL) {
 			if (!NODE_IS_DIR(node))
 				break;
-			mapv_draw_recursive( node, action, node_z );
+			mapv_draw_recursive( node, action, node_z, (inst_first < 0) ? -1 : inst_next );
+			inst_next += mapv_subtree_instances( node );
 			node = node->next;
 		}
 	}
 
 	if (!dir_collapsed && !dir_expanded)
-		glDisable( GL_NORMALIZE );
+		ogl_disable( GL_NORMALIZE );
 
-	glPopMatrix( );
+	xform_pop( );
 }
 
 
@@ -1402,7 +3210,7 @@ mapv_gldraw_cursor( const XYZvec *c0, const XYZvec *c1 )
 		else if (i == 1)
 			cursor_visible_part( );
 
-		glBegin( GL_LINES );
+		vbuf_begin( GL_LINES );
 		for (c = 0; c < 8; c++) {
 			if (c & 1) {
 				p.x = c1->x;
@@ -1431,16 +3239,16 @@ mapv_gldraw_cursor( const XYZvec *c0, const XYZvec *c1 )
 				delta.z = corner_dims.z;
 			}
 
-			glVertex3d( p.x, p.y, p.z );
-			glVertex3d( p.x + delta.x, p.y, p.z );
+			vbuf_vertex3d( p.x, p.y, p.z );
+			vbuf_vertex3d( p.x + delta.x, p.y, p.z );
 
-			glVertex3d( p.x, p.y, p.z );
-			glVertex3d( p.x, p.y + delta.y, p.z );
+			vbuf_vertex3d( p.x, p.y, p.z );
+			vbuf_vertex3d( p.x, p.y + delta.y, p.z );
 
-			glVertex3d( p.x, p.y, p.z );
-			glVertex3d( p.x, p.y, p.z + delta.z );
+			vbuf_vertex3d( p.x, p.y, p.z );
+			vbuf_vertex3d( p.x, p.y, p.z + delta.z );
 		}
-		glEnd( );
+		vbuf_end( );
 	}
 	cursor_post( );
 }
@@ -1475,27 +3283,76 @@ mapv_draw_cursor( double pos )
 static void
 mapv_draw( boolean high_detail )
 {
+	boolean instanced;
+	int inst_first;
+
+	frametime_phase_begin( FRAMETIME_FRUSTUM );
 	frustum_extract( );
+	frametime_phase_end( FRAMETIME_FRUSTUM );
+	xform_load_identity( );
 
-	/* Draw low-detail geometry (culled tree walk) */
-	mapv_draw_recursive( globals.fstree, MAPV_DRAW_GEOMETRY, 0.0 );
+	frametime_phase_begin( FRAMETIME_GEOMETRY );
 
-	if (high_detail) {
+	/* Every directory was queued for rebuilding by mapv_init( ),
+	 * so a new instance buffer gets filled in as it is drawn */
+	instanced = mapvinst_available( );
+	if (instanced && mapv_instances_reset) {
+		mapvinst_reset( mapv_subtree_instances( globals.fstree ), mapv_side_slant_ratios );
+		mapv_instances_reset = FALSE;
+	}
+	inst_first = instanced ? 0 : -1;
+
+	bounds_update_all( );
+
+	/* Draw low-detail geometry (culled tree walk), with the outlines
+	 * shaded in if possible */
+	cel_lines = high_detail && ogl_cel_lines( TRUE );
+	occlusion_begin( );
+	impostor_begin( );
+	ogl_pick_ids( TRUE );
+	mapv_draw_recursive( globals.fstree, MAPV_DRAW_GEOMETRY, 0.0, inst_first );
+	vbuf_flush( picking_mode );
+	if (instanced)
+		mapvinst_flush( picking_mode );
+	ogl_pick_ids( FALSE );
+	impostor_end( );
+	occlusion_end( );
+	if (cel_lines)
+		ogl_cel_lines( FALSE );
+	frametime_phase_end( FRAMETIME_GEOMETRY );
+
+	if (high_detail && !cel_lines) {
 		/* "Cel lines" — skip outlines on small/distant subtrees */
+		frametime_phase_begin( FRAMETIME_OUTLINES );
 		outline_pre( );
 		drawing_outlines = TRUE;
-		mapv_draw_recursive( globals.fstree, MAPV_DRAW_GEOMETRY, 0.0 );
+		mapv_draw_recursive( globals.fstree, MAPV_DRAW_GEOMETRY, 0.0, inst_first );
+		vbuf_flush( FALSE );
+		if (instanced)
+			mapvinst_flush( FALSE );
 		drawing_outlines = FALSE;
 		outline_post( );
+		frametime_phase_end( FRAMETIME_OUTLINES );
+	}
 
+	if (high_detail) {
 		/* Node name labels */
+		frametime_phase_begin( FRAMETIME_LABELS );
 		text_pre( );
-		glColor3f( 0.0, 0.0, 0.0 );
-		mapv_draw_recursive( globals.fstree, MAPV_DRAW_LABELS, 0.0 );
+		vbuf_color3f( 0.0, 0.0, 0.0 );
+		label_place_begin( );
+		mapv_draw_recursive( globals.fstree, MAPV_DRAW_LABELS, 0.0, -1 );
+		label_place_end( );
+		vbuf_flush( FALSE );
 		text_post( );
+		frametime_phase_end( FRAMETIME_LABELS );
+	}
 
+	if (!picking_mode) {
 		/* Node cursor */
+		frametime_phase_begin( FRAMETIME_CURSOR );
 		mapv_draw_cursor( CURSOR_POS(camera->pan_part) );
+		frametime_phase_end( FRAMETIME_CURSOR );
 	}
 }
 
@@ -1509,7 +3366,7 @@ mapv_draw( boolean high_detail )
 #define TREEV_BRANCH_WIDTH		256.0
 #define TREEV_MIN_CORE_RADIUS		8192.0
 #define TREEV_CORE_GROW_FACTOR		1.25
-#define TREEV_CURVE_GRANULARITY		5.0
+#define TREEV_MAX_ARC_STRIDE		16	/* 20 degree segments */
 #define TREEV_PLATFORM_HEIGHT		158.2
 #define TREEV_PLATFORM_SPACING_WIDTH	512.0
 #define TREEV_LEAF_HEIGHT_MULTIPLIER	1.0
@@ -1963,8 +3820,11 @@ treev_init( void )
 	TreeVGeomParams *gparams;
 	int num_points;
 
-	/* Allocate point buffers */
-	num_points = (int)ceil( 360.0 / TREEV_CURVE_GRANULARITY ) + 1;
+	unit_circle_init( );
+
+	/* Allocate point buffers (an arc may need every table entry,
+	 * plus its two endpoints) */
+	num_points = UNIT_CIRCLE_STEPS + 3;
 	if (inner_edge_buf == NULL)
 		inner_edge_buf = NEW_ARRAY(XYvec, num_points);
 	if (outer_edge_buf == NULL)
@@ -2006,6 +3866,8 @@ geometry_treev_reinit( void )
 {
 	treev_init_recursive( globals.fstree );
 	treev_arrange( TRUE );
+	bounds_all_stale = TRUE;
+	occlusion_reset( );
 	queue_uncached_draw( );
 }
 
@@ -2033,8 +3895,8 @@ treev_queue_rearrange( GNode *dnode )
 	while (up_node != NULL) {
 		NODE_DESC(up_node)->flags |= TREEV_NEED_REARRANGE;
 
-		/* Branch geometry has to be rebuilt (display list B) */
-		DIR_NODE_DESC(up_node)->b_dlist_stale = TRUE;
+		/* Branch geometry has to be rebuilt (geometry B) */
+		DIR_NODE_DESC(up_node)->b_stale = TRUE;
 
 		up_node = up_node->parent;
 	}
@@ -2043,28 +3905,94 @@ treev_queue_rearrange( GNode *dnode )
 }
 
 
+/* Picks the stride for drawing curves of radius r about the current
+ * platform center, sizing them on screen at world position (cx,cy).
+ * prev_stride is the stride the geometry was last built with (0 if
+ * none); it is kept until a coarser one would be comfortably good
+ * enough, so geometry isn't rebuilt back and forth at a threshold */
+static int
+treev_arc_stride( double cx, double cy, double r, int prev_stride )
+{
+	double r_pixels;
+	int stride;
+
+	r_pixels = screen_size_pixels( cx, cy, 0.0, r );
+	if (r_pixels == HUGE_VAL)
+		return 1;
+
+	/* Coarsest stride that stays within tolerance */
+	stride = TREEV_MAX_ARC_STRIDE;
+	while ((stride > 1) && (curve_error( r_pixels, stride ) > curve_tolerance( )))
+		stride /= 2;
+
+	if ((prev_stride > 0) && (stride > prev_stride)) {
+		if (coarse_curves || (curve_error( r_pixels, stride ) > (0.5 * CURVE_TOLERANCE)))
+			return prev_stride;
+	}
+
+	return stride;
+}
+
+
+/* Fills buf with the points of a unit-radius arc running from theta0 to
+ * theta1 (in degrees), through every stride'th entry of the unit circle
+ * table in between. Only the two endpoints are computed afresh. Returns
+ * the number of segments in the arc */
+static int
+treev_arc_points( double theta0, double theta1, int stride, XYvec *buf )
+{
+	double seg_arc_width;
+	int k, k0, k1, i;
+	int n = 0;
+
+	g_assert( theta1 >= theta0 );
+	stride = CLAMP(stride, 1, TREEV_MAX_ARC_STRIDE);
+	seg_arc_width = 360.0 * (double)stride / (double)UNIT_CIRCLE_STEPS;
+
+	/* Table entries strictly inside the arc, skipping any that would
+	 * leave a sliver of a segment next to an endpoint */
+	k0 = (int)ceil( theta0 / seg_arc_width + 0.25 );
+	k1 = (int)floor( theta1 / seg_arc_width - 0.25 );
+	k1 = MIN(k1, k0 + UNIT_CIRCLE_STEPS / stride);
+
+	buf[n].x = cos( RAD(theta0) );
+	buf[n].y = sin( RAD(theta0) );
+	++n;
+	for (k = k0; k <= k1; k++) {
+		i = (k * stride) % UNIT_CIRCLE_STEPS;
+		if (i < 0)
+			i += UNIT_CIRCLE_STEPS;
+		buf[n++] = unit_circle[i];
+	}
+	buf[n].x = cos( RAD(theta1) );
+	buf[n].y = sin( RAD(theta1) );
+
+	return n;
+}
+
+
 /* Draws a directory platform, with inner radius of r0 */
 static void
 treev_gldraw_platform( GNode *dnode, double r0 )
 {
 	XYvec p0, p1;
 	XYvec delta;
-	double r1, seg_arc_width;
-	double theta, sin_theta, cos_theta;
+	double r1, half_arc_width;
+	double sin_theta, cos_theta;
 	double z1;
 	int s, seg_count;
 
 	g_assert( NODE_IS_DIR(dnode) );
 
 	r1 = r0 + TREEV_GEOM_PARAMS(dnode)->platform.depth;
-	seg_count = (int)ceil( TREEV_GEOM_PARAMS(dnode)->platform.arc_width / TREEV_CURVE_GRANULARITY );
-	seg_arc_width = TREEV_GEOM_PARAMS(dnode)->platform.arc_width / (double)seg_count;
+	half_arc_width = 0.5 * TREEV_GEOM_PARAMS(dnode)->platform.arc_width;
 
-	/* Calculate and cache inner/outer edge vertices */
-	theta = -0.5 * TREEV_GEOM_PARAMS(dnode)->platform.arc_width;
+	/* Calculate and cache inner/outer edge vertices (unit arc
+	 * goes into the outer edge buffer first, then gets scaled) */
+	seg_count = treev_arc_points( - half_arc_width, half_arc_width, DIR_NODE_DESC(dnode)->curve_detail, outer_edge_buf );
 	for (s = 0; s <= seg_count; s++) {
-		sin_theta = sin( RAD(theta) );
-		cos_theta = cos( RAD(theta) );
+		sin_theta = outer_edge_buf[s].y;
+		cos_theta = outer_edge_buf[s].x;
 		/* p0: point on inner edge */
 		p0.x = r0 * cos_theta;
 		p0.y = r0 * sin_theta;
@@ -2095,43 +4023,41 @@ treev_gldraw_platform( GNode *dnode, double r0 )
 		inner_edge_buf[s].y = p0.y;
 		outer_edge_buf[s].x = p1.x;
 		outer_edge_buf[s].y = p1.y;
-
-		theta += seg_arc_width;
 	}
 
 	/* Height of top face */
         z1 = TREEV_GEOM_PARAMS(dnode)->platform.height;
 
 	/* Everything here is done with quads */
-	glBegin( GL_QUADS );
+	vbuf_begin( GL_QUADS );
 
 	/* Draw inner edge */
 	for (s = 0; s < seg_count; s++) {
 		/* Going up */
 		p0.x = inner_edge_buf[s].x;
 		p0.y = inner_edge_buf[s].y;
-		glNormal3d( - p0.x / r0, - p0.y / r0, 0.0 );
+		vbuf_normal3d( - p0.x / r0, - p0.y / r0, 0.0 );
 		if (s > 0) {
-			glEdgeFlag( GL_FALSE );
-			glVertex3d( p0.x, p0.y, 0.0 );
-			glEdgeFlag( GL_TRUE );
+			vbuf_edge_flag( FALSE );
+			vbuf_vertex3d( p0.x, p0.y, 0.0 );
+			vbuf_edge_flag( TRUE );
 		}
 		else
-			glVertex3d( p0.x, p0.y, 0.0 );
-		glVertex3d( p0.x, p0.y, z1 );
+			vbuf_vertex3d( p0.x, p0.y, 0.0 );
+		vbuf_vertex3d( p0.x, p0.y, z1 );
 
 		/* Going down */
 		p0.x = inner_edge_buf[s + 1].x;
 		p0.y = inner_edge_buf[s + 1].y;
-		glNormal3d( - p0.x / r0, - p0.y / r0, 0.0 );
+		vbuf_normal3d( - p0.x / r0, - p0.y / r0, 0.0 );
 		if ((s + 1) < seg_count) {
-			glEdgeFlag( GL_FALSE );
-			glVertex3d( p0.x, p0.y, z1 );
-			glEdgeFlag( GL_TRUE );
+			vbuf_edge_flag( FALSE );
+			vbuf_vertex3d( p0.x, p0.y, z1 );
+			vbuf_edge_flag( TRUE );
 		}
 		else
-			glVertex3d( p0.x, p0.y, z1 );
-		glVertex3d( p0.x, p0.y, 0.0 );
+			vbuf_vertex3d( p0.x, p0.y, z1 );
+		vbuf_vertex3d( p0.x, p0.y, 0.0 );
 	}
 
 	/* Draw outer edge */
@@ -2139,28 +4065,28 @@ treev_gldraw_platform( GNode *dnode, double r0 )
 		/* Going up */
 		p1.x = outer_edge_buf[s].x;
 		p1.y = outer_edge_buf[s].y;
-		glNormal3d( - p1.x / r1, - p1.y / r1, 0.0 );
+		vbuf_normal3d( - p1.x / r1, - p1.y / r1, 0.0 );
 		if (s < seg_count) {
-			glEdgeFlag( GL_FALSE );
-			glVertex3d( p1.x, p1.y, 0.0 );
-			glEdgeFlag( GL_TRUE );
+			vbuf_edge_flag( FALSE );
+			vbuf_vertex3d( p1.x, p1.y, 0.0 );
+			vbuf_edge_flag( TRUE );
 		}
 		else
-			glVertex3d( p1.x, p1.y, 0.0 );
-		glVertex3d( p1.x, p1.y, z1 );
+			vbuf_vertex3d( p1.x, p1.y, 0.0 );
+		vbuf_vertex3d( p1.x, p1.y, z1 );
 
 		/* Going down */
 		p1.x = outer_edge_buf[s - 1].x;
 		p1.y = outer_edge_buf[s - 1].y;
-		glNormal3d( - p1.x / r1, - p1.y / r1, 0.0 );
+		vbuf_normal3d( - p1.x / r1, - p1.y / r1, 0.0 );
 		if ((s - 1) > 0) {
-			glEdgeFlag( GL_FALSE );
-			glVertex3d( p1.x, p1.y, z1 );
-			glEdgeFlag( GL_TRUE );
+			vbuf_edge_flag( FALSE );
+			vbuf_vertex3d( p1.x, p1.y, z1 );
+			vbuf_edge_flag( TRUE );
 		}
 		else
-			glVertex3d( p1.x, p1.y, z1 );
-		glVertex3d( p1.x, p1.y, 0.0 );
+			vbuf_vertex3d( p1.x, p1.y, z1 );
+		vbuf_vertex3d( p1.x, p1.y, 0.0 );
 	}
 
 	/* Draw leading edge face */
@@ -2168,31 +4094,30 @@ treev_gldraw_platform( GNode *dnode, double r0 )
 	p0.y = inner_edge_buf[0].y;
 	p1.x = outer_edge_buf[0].x;
 	p1.y = outer_edge_buf[0].y;
-	glNormal3d( p0.y / r0, - p0.x / r0, 0.0 );
-	glVertex3d( p0.x, p0.y, 0.0 );
-	glVertex3d( p1.x, p1.y, 0.0 );
-	glVertex3d( p1.x, p1.y, z1 );
-	glVertex3d( p0.x, p0.y, z1 );
+	vbuf_normal3d( p0.y / r0, - p0.x / r0, 0.0 );
+	vbuf_vertex3d( p0.x, p0.y, 0.0 );
+	vbuf_vertex3d( p1.x, p1.y, 0.0 );
+	vbuf_vertex3d( p1.x, p1.y, z1 );
+	vbuf_vertex3d( p0.x, p0.y, z1 );
 
 	/* Draw trailing edge face */
 	p0.x = inner_edge_buf[seg_count].x;
 	p0.y = inner_edge_buf[seg_count].y;
 	p1.x = outer_edge_buf[seg_count].x;
 	p1.y = outer_edge_buf[seg_count].y;
-	glNormal3d( - p0.y / r0, p0.x / r0, 0.0 );
-	glVertex3d( p0.x, p0.y, z1 );
-	glVertex3d( p1.x, p1.y, z1 );
-	glVertex3d( p1.x, p1.y, 0.0 );
-	glVertex3d( p0.x, p0.y, 0.0 );
+	vbuf_normal3d( - p0.y / r0, p0.x / r0, 0.0 );
+	vbuf_vertex3d( p0.x, p0.y, z1 );
+	vbuf_vertex3d( p1.x, p1.y, z1 );
+	vbuf_vertex3d( p1.x, p1.y, 0.0 );
+	vbuf_vertex3d( p0.x, p0.y, 0.0 );
 
-	glEnd( );
+	vbuf_end( );
 	/* Top face has ID of 1 */
-	glPushName( 1 );
 	node_glcolor_face( dnode, 1 );
-	glBegin( GL_QUADS );
+	vbuf_begin( GL_QUADS );
 
 	/* Draw top face */
-	glNormal3d( 0.0, 0.0, 1.0 );
+	vbuf_normal3d( 0.0, 0.0, 1.0 );
 	for (s = 0; s < seg_count; s++) {
 		/* Going out */
 		p0.x = inner_edge_buf[s].x;
@@ -2200,13 +4125,13 @@ treev_gldraw_platform( GNode *dnode, double r0 )
 		p1.x = outer_edge_buf[s].x;
 		p1.y = outer_edge_buf[s].y;
 		if (s > 0) {
-			glEdgeFlag( GL_FALSE );
-			glVertex3d( p0.x, p0.y, z1 );
-			glEdgeFlag( GL_TRUE );
+			vbuf_edge_flag( FALSE );
+			vbuf_vertex3d( p0.x, p0.y, z1 );
+			vbuf_edge_flag( TRUE );
 		}
 		else
-			glVertex3d( p0.x, p0.y, z1 );
-		glVertex3d( p1.x, p1.y, z1 );
+			vbuf_vertex3d( p0.x, p0.y, z1 );
+		vbuf_vertex3d( p1.x, p1.y, z1 );
 
 		/* Going in */
 		p0.x = inner_edge_buf[s + 1].x;
@@ -2214,17 +4139,16 @@ treev_gldraw_platform( GNode *dnode, double r0 )
 		p1.x = outer_edge_buf[s + 1].x;
 		p1.y = outer_edge_buf[s + 1].y;
 		if ((s + 1) < seg_count) {
-			glEdgeFlag( GL_FALSE );
-			glVertex3d( p1.x, p1.y, z1 );
-			glEdgeFlag( GL_TRUE );
+			vbuf_edge_flag( FALSE );
+			vbuf_vertex3d( p1.x, p1.y, z1 );
+			vbuf_edge_flag( TRUE );
 		}
 		else
-			glVertex3d( p1.x, p1.y, z1 );
-		glVertex3d( p0.x, p0.y, z1 );
+			vbuf_vertex3d( p1.x, p1.y, z1 );
+		vbuf_vertex3d( p0.x, p0.y, z1 );
 	}
 
-	glEnd( );
-	glPopName( );
+	vbuf_end( );
 }
 
 
@@ -2288,50 +4212,50 @@ treev_gldraw_leaf( GNode *node, double r0, boolean full_node )
 	}
 
 	/* Draw top face */
-	glNormal3d( 0.0, 0.0, 1.0 );
-	glBegin( GL_QUADS );
+	vbuf_normal3d( 0.0, 0.0, 1.0 );
+	vbuf_begin( GL_QUADS );
 	for (i = 0; i < 4; i++)
-		glVertex3d( corners[i].x, corners[i].y, z1 );
-	glEnd( );
+		vbuf_vertex3d( corners[i].x, corners[i].y, z1 );
+	vbuf_end( );
 
 	if (!full_node) {
 		/* Draw an "X" and we're done */
-		glBegin( GL_LINES );
+		vbuf_begin( GL_LINES );
 		for (i = 0; i < 4; i++)
-			glVertex3d( corners[x_verts[i]].x, corners[x_verts[i]].y, z1 );
-		glEnd( );
+			vbuf_vertex3d( corners[x_verts[i]].x, corners[x_verts[i]].y, z1 );
+		vbuf_end( );
 		return;
 	}
 
 	/* Draw side faces */
-	glBegin( GL_QUAD_STRIP );
+	vbuf_begin( GL_QUAD_STRIP );
 	for (i = 0; i < 4; i++) {
 		switch (i) {
 			case 0:
-			glNormal3d( sin_theta, - cos_theta, 0.0 );
+			vbuf_normal3d( sin_theta, - cos_theta, 0.0 );
 			break;
 
 			case 1:
-			glNormal3d( cos_theta, sin_theta, 0.0 );
+			vbuf_normal3d( cos_theta, sin_theta, 0.0 );
 			break;
 
 			case 2:
-			glNormal3d( - sin_theta, cos_theta, 0.0 );
+			vbuf_normal3d( - sin_theta, cos_theta, 0.0 );
 			break;
 
 			case 3:
-			glNormal3d( - cos_theta, - sin_theta, 0.0 );
+			vbuf_normal3d( - cos_theta, - sin_theta, 0.0 );
 			break;
 
 			SWITCH_FAIL
 		}
-		glVertex3d( corners[i].x, corners[i].y, z1 );
-		glVertex3d( corners[i].x, corners[i].y, z0 );
+		vbuf_vertex3d( corners[i].x, corners[i].y, z1 );
+		vbuf_vertex3d( corners[i].x, corners[i].y, z0 );
 	}
 	/* Close the strip */
-	glVertex3d( corners[0].x, corners[0].y, z1 );
-	glVertex3d( corners[0].x, corners[0].y, z0 );
-	glEnd( );
+	vbuf_vertex3d( corners[0].x, corners[0].y, z1 );
+	vbuf_vertex3d( corners[0].x, corners[0].y, z0 );
+	vbuf_end( );
 }
 
 
@@ -2379,39 +4303,43 @@ treev_gldraw_folder( GNode *dnode, double r0 )
 
 	/* Translate, rotate, and draw folder geometry */
         node_glcolor( dnode );
-	glBegin( GL_LINE_STRIP );
+	vbuf_begin( GL_LINE_STRIP );
 	for (i = 0; i <= 7; i++) {
 		p.x = folder_r + folder_points[i % 7].x;
 		p.y = folder_points[i % 7].y;
 		p_rot.x = p.x * cos_theta - p.y * sin_theta;
 		p_rot.y = p.x * sin_theta + p.y * cos_theta;
 
-		glVertex3d( p_rot.x, p_rot.y, p_rot.z );
+		vbuf_vertex3d( p_rot.x, p_rot.y, p_rot.z );
 	}
-	glEnd( );
+	vbuf_end( );
 }
 
 
-/* Draws the loop around the TreeV center, with the given radius */
+/* Draws the loop around the TreeV center, with the given radius and
+ * curve stride */
 static void
-treev_gldraw_loop( double loop_r )
+treev_gldraw_loop( double loop_r, int stride )
 {
-	static const int seg_count = (int)(360.0 / TREEV_CURVE_GRANULARITY + 0.5);
 	XYvec p0, p1;
 	double loop_r0, loop_r1;
-	double theta, sin_theta, cos_theta;
-	int s;
+	double sin_theta, cos_theta;
+	int s, seg_count;
+	int i;
 
 	/* Inner/outer loop radii */
 	loop_r0 = loop_r - (0.5 * TREEV_BRANCH_WIDTH);
 	loop_r1 = loop_r + (0.5 * TREEV_BRANCH_WIDTH);
 
+	stride = CLAMP(stride, 1, TREEV_MAX_ARC_STRIDE);
+	seg_count = (UNIT_CIRCLE_STEPS + stride - 1) / stride;
+
 	/* Draw loop */
-	glBegin( GL_QUAD_STRIP );
+	vbuf_begin( GL_QUAD_STRIP );
 	for (s = 0; s <= seg_count; s++) {
-		theta = 360.0 * (double)s / (double)seg_count;
-		sin_theta = sin( RAD(theta) );
-		cos_theta = cos( RAD(theta) );
+		i = MIN(s * stride, UNIT_CIRCLE_STEPS) % UNIT_CIRCLE_STEPS;
+		sin_theta = unit_circle[i].y;
+		cos_theta = unit_circle[i].x;
 		/* p0: point on inner edge */
 		p0.x = loop_r0 * cos_theta;
 		p0.y = loop_r0 * sin_theta;
@@ -2419,10 +4347,10 @@ treev_gldraw_loop( double loop_r )
 		p1.x = loop_r1 * cos_theta;
 		p1.y = loop_r1 * sin_theta;
 
-		glVertex2d( p0.x, p0.y );
-		glVertex2d( p1.x, p1.y );
+		vbuf_vertex2d( p0.x, p0.y );
+		vbuf_vertex2d( p1.x, p1.y );
 	}
-	glEnd( );
+	vbuf_end( );
 }
 
 
@@ -2441,26 +4369,27 @@ treev_gldraw_inbranch( double r0 )
 	c1.x = r0;
 	c1.y = (0.5 * TREEV_BRANCH_WIDTH);
 
-	glBegin( GL_QUADS );
-	glVertex2d( c0.x, c0.y );
-	glVertex2d( c1.x, c0.y );
-	glVertex2d( c1.x, c1.y );
-	glVertex2d( c0.x, c1.y );
-	glEnd( );
+	vbuf_begin( GL_QUADS );
+	vbuf_vertex2d( c0.x, c0.y );
+	vbuf_vertex2d( c1.x, c0.y );
+	vbuf_vertex2d( c1.x, c1.y );
+	vbuf_vertex2d( c0.x, c1.y );
+	vbuf_end( );
 }
 
 
 /* Draws part of the branch present on the outer edge of platforms with
  * expanded subdirectories. r1 is the outer radius of the parent directory,
- * and theta0/theta1 are the start/end angles of the arc portion */
+ * theta0/theta1 are the start/end angles of the arc portion, and stride
+ * is the curve stride */
 static void
-treev_gldraw_outbranch( double r1, double theta0, double theta1 )
+treev_gldraw_outbranch( double r1, double theta0, double theta1, int stride )
 {
 	XYvec p0, p1;
 	double arc_r, arc_r0, arc_r1;
-	double arc_width, seg_arc_width;
+	double arc_width;
 	double supp_arc_width;
-	double theta, sin_theta, cos_theta;
+	double sin_theta, cos_theta;
 	int s, seg_count;
 
 	g_assert( theta1 >= theta0 );
@@ -2479,12 +4408,12 @@ treev_gldraw_outbranch( double r1, double theta0, double theta1 )
 	p1.y = (0.5 * TREEV_BRANCH_WIDTH);
 
 	/* Draw branch stem */
-	glBegin( GL_QUADS );
-	glVertex2d( p0.x, p0.y );
-	glVertex2d( p1.x, p0.y );
-	glVertex2d( p1.x, p1.y );
-	glVertex2d( p0.x, p1.y );
-	glEnd( );
+	vbuf_begin( GL_QUADS );
+	vbuf_vertex2d( p0.x, p0.y );
+	vbuf_vertex2d( p1.x, p0.y );
+	vbuf_vertex2d( p1.x, p1.y );
+	vbuf_vertex2d( p0.x, p1.y );
+	vbuf_end( );
 
 	/* Shortcut: If arc is zero-length, don't bother drawing it */
 	arc_width = theta1 - theta0;
@@ -2495,15 +4424,13 @@ treev_gldraw_outbranch( double r1, double theta0, double theta1 )
 	 * (where directories connect to the ends of the arc) */
 	supp_arc_width = (180.0 * TREEV_BRANCH_WIDTH / PI) / arc_r0;
 
-	seg_count = (int)ceil( (arc_width + supp_arc_width) / TREEV_CURVE_GRANULARITY );
-	seg_arc_width = (arc_width + supp_arc_width) / (double)seg_count;
+	seg_count = treev_arc_points( theta0 - 0.5 * supp_arc_width, theta1 + 0.5 * supp_arc_width, stride, inner_edge_buf );
 
 	/* Draw branch arc */
-	glBegin( GL_QUAD_STRIP );
-	theta = theta0 - 0.5 * supp_arc_width;
+	vbuf_begin( GL_QUAD_STRIP );
 	for (s = 0; s <= seg_count; s++) {
-		sin_theta = sin( RAD(theta) );
-		cos_theta = cos( RAD(theta) );
+		sin_theta = inner_edge_buf[s].y;
+		cos_theta = inner_edge_buf[s].x;
 		/* p0: point on inner edge */
 		p0.x = arc_r0 * cos_theta;
 		p0.y = arc_r0 * sin_theta;
@@ -2511,12 +4438,10 @@ treev_gldraw_outbranch( double r1, double theta0, double theta1 )
 		p1.x = arc_r1 * cos_theta;
 		p1.y = arc_r1 * sin_theta;
 
-		glVertex2d( p0.x, p0.y );
-		glVertex2d( p1.x, p1.y );
-
-		theta += seg_arc_width;
+		vbuf_vertex2d( p0.x, p0.y );
+		vbuf_vertex2d( p1.x, p1.y );
 	}
-	glEnd( );
+	vbuf_end( );
 }
 
 
@@ -2551,7 +4476,6 @@ treev_build_dir( GNode *dnode, double r0 )
 		for (n = 0; (n < row_node_count) && (node != NULL); n++) {
 			TREEV_GEOM_PARAMS(node)->leaf.theta = pos.theta;
 			TREEV_GEOM_PARAMS(node)->leaf.distance = pos.r - r0;
-			glLoadName( NODE_DESC(node)->id );
 			node_glcolor( node );
 			treev_gldraw_leaf( node, r0, !NODE_IS_DIR(node) );
 			pos.theta -= inter_arc_width;
@@ -2567,7 +4491,6 @@ treev_build_dir( GNode *dnode, double r0 )
 	TREEV_GEOM_PARAMS(dnode)->platform.depth = pos.r - r0;
 
 	/* Draw underlying directory */
-	glLoadName( NODE_DESC(dnode)->id );
 	node_glcolor( dnode );
 	treev_gldraw_platform( dnode, r0 );
 
@@ -2582,9 +4505,11 @@ static void
 treev_apply_label( GNode *node, double r0, boolean is_leaf )
 {
 	RTZvec label_pos;
-	XYvec leaf_label_dims;
+	XYZvec center;
+	XYvec leaf_label_dims, straight_dims, extents;
 	RTvec platform_label_dims;
 	double height;
+	int first;
 
 	if (is_leaf) {
 		/* Apply label to top face of leaf node */
@@ -2599,7 +4524,13 @@ treev_apply_label( GNode *node, double r0, boolean is_leaf )
 		label_pos.r = r0 + TREEV_GEOM_PARAMS(node)->leaf.distance;
 		label_pos.theta = TREEV_GEOM_PARAMS(node)->leaf.theta;
 		label_pos.z = height + TREEV_GEOM_PARAMS(node->parent)->platform.height;
+		first = label_mark( );
 		text_draw_straight_rotated( NODE_DESC(node)->name, &label_pos, &leaf_label_dims );
+		text_get_extents( NODE_DESC(node)->name, &leaf_label_dims, &extents );
+		center.x = label_pos.r * cos( RAD(label_pos.theta) );
+		center.y = label_pos.r * sin( RAD(label_pos.theta) );
+		center.z = label_pos.z;
+		label_add( node, first, &center, &extents );
 	}
 	else {
 		/* Label directory platform, inside its inner edge */
@@ -2608,8 +4539,306 @@ treev_apply_label( GNode *node, double r0, boolean is_leaf )
 		label_pos.z = 0.0;
 		platform_label_dims.r = ((2.0 - MAGIC_NUMBER) * TREEV_PLATFORM_SPACING_DEPTH);
 		platform_label_dims.theta = TREEV_GEOM_PARAMS(node)->platform.arc_width - (180.0 * TREEV_PLATFORM_SPACING_WIDTH / PI) / label_pos.r;
+		first = label_mark( );
 		text_draw_curved( NODE_DESC(node)->name, &label_pos, &platform_label_dims );
+		/* Placement treats the arc of text as if it were straight */
+		straight_dims.x = (PI / 180.0) * label_pos.r * platform_label_dims.theta;
+		straight_dims.y = platform_label_dims.r;
+		text_get_extents( NODE_DESC(node)->name, &straight_dims, &extents );
+		center.x = label_pos.r - 0.5 * extents.y;
+		center.y = 0.0;
+		center.z = label_pos.z;
+		label_add( node, first, &center, &extents );
+	}
+}
+
+
+/* Grows a box to take in an annular sector, between radii r0 and r1 and
+ * angles theta0 and theta1 (in degrees), extending from z0 to z1 */
+static void
+treev_box_add_sector( BvhBox *box, double r0, double r1, double theta0, double theta1, double z0, double z1 )
+{
+	double theta;
+	int k;
+
+	bvh_box_add_point( box, r0 * cos( RAD(theta0) ), r0 * sin( RAD(theta0) ), z0 );
+	bvh_box_add_point( box, r1 * cos( RAD(theta0) ), r1 * sin( RAD(theta0) ), z1 );
+	bvh_box_add_point( box, r0 * cos( RAD(theta1) ), r0 * sin( RAD(theta1) ), z0 );
+	bvh_box_add_point( box, r1 * cos( RAD(theta1) ), r1 * sin( RAD(theta1) ), z1 );
+
+	/* Outermost points, where the sector crosses the axes */
+	theta1 = MIN(theta1, theta0 + 360.0);
+	for (k = (int)ceil( theta0 / 90.0 ); (90.0 * (double)k) <= theta1; k++) {
+		theta = 90.0 * (double)k;
+		bvh_box_add_point( box, r1 * cos( RAD(theta) ), r1 * sin( RAD(theta) ), z0 );
+	}
+}
+
+
+/* Bounds callback: box of a node on its parent's TreeV platform, taking
+ * in the subtree of a directory. Both forms of a directory are covered
+ * while it is partially deployed; the platform shrinks to / grows from
+ * the leaf, so it stays within the two */
+static void
+treev_node_box( void *item, BvhBox *box, void *data )
+{
+	GNode *node = (GNode *)item;
+	BoundsFrame *frame = (BoundsFrame *)data;
+	TreeVGeomParams *gparams;
+	double r, theta, half_arc_width;
+	double x, y;
+
+	gparams = TREEV_GEOM_PARAMS(node);
+	bvh_box_clear( box );
+
+	if (!NODE_IS_DIR(node) || !DIR_EXPANDED(node)) {
+		/* Leaf form (the edge, to allow for the leaf's rotation) */
+		r = frame->r0 + gparams->leaf.distance;
+		theta = frame->theta + gparams->leaf.theta;
+		x = r * cos( RAD(theta) );
+		y = r * sin( RAD(theta) );
+		bvh_box_add_point( box, x - TREEV_LEAF_NODE_EDGE, y - TREEV_LEAF_NODE_EDGE, 0.0 );
+		bvh_box_add_point( box, x + TREEV_LEAF_NODE_EDGE, y + TREEV_LEAF_NODE_EDGE, frame->height + gparams->leaf.height );
+	}
+
+	if (NODE_IS_DIR(node) && !DIR_COLLAPSED(node)) {
+		/* Platform form, with the branches going in and out */
+		theta = frame->theta + gparams->platform.theta;
+		half_arc_width = 0.5 * MAX(gparams->platform.arc_width, gparams->platform.subtree_arc_width);
+		treev_box_add_sector( box, frame->subtree_r0 - 0.5 * TREEV_PLATFORM_SPACING_DEPTH, frame->subtree_r0 + gparams->platform.depth + 0.5 * TREEV_PLATFORM_SPACING_DEPTH, theta - half_arc_width, theta + half_arc_width, 0.0, gparams->platform.height );
+		bounds_add_subtree( box, node );
+	}
+}
+
+
+/* Gets the TreeV frame of a directory's children, given the frame the
+ * directory itself is in */
+static void
+treev_children_frame( GNode *dnode, const BoundsFrame *frame, BoundsFrame *children_frame )
+{
+	TreeVGeomParams *gparams;
+
+	gparams = TREEV_GEOM_PARAMS(dnode);
+	children_frame->r0 = frame->subtree_r0;
+	children_frame->subtree_r0 = frame->subtree_r0 + gparams->platform.depth + TREEV_PLATFORM_SPACING_DEPTH;
+	children_frame->theta = frame->theta + gparams->platform.theta;
+	children_frame->height = gparams->platform.height;
+}
+
+
+/* Updates the bounds of the subtree rooted at the specified directory,
+ * which is in the given frame (force to update all of it) */
+static void
+treev_bounds_recursive( GNode *dnode, const BoundsFrame *frame, boolean force )
+{
+	DirNodeDesc *dir_ndesc;
+	BoundsFrame children_frame;
+	GNode *node;
+
+	dir_ndesc = DIR_NODE_DESC(dnode);
+	if (!force && !dir_ndesc->bvh_stale)
+		return;
+	dir_ndesc->bvh_stale = FALSE;
+	if (DIR_COLLAPSED(dnode))
+		return;
+
+	treev_children_frame( dnode, frame, &children_frame );
+
+	/* Subdirectories first, as their boxes take in their bounds */
+	node = dnode->children;
+	while (node != NULL) {
+		if (!NODE_IS_DIR(node))
+			break;
+		treev_bounds_recursive( node, &children_frame, force );
+		node = node->next;
+	}
+
+	bounds_update( dnode, treev_node_box, &children_frame );
+}
+
+
+/* Tells if the direction of point (x,y) from the origin falls within
+ * the given range of angles (in degrees) */
+static boolean
+treev_angle_within( double x, double y, double theta0, double arc_width )
+{
+	double theta;
+
+	theta = DEG(atan2( y, x )) - theta0;
+	theta -= 360.0 * floor( theta / 360.0 );
+
+	return theta <= arc_width;
+}
+
+
+/* Intersects the ray origin + t * direction with a platform: the solid
+ * between radii r0 and r1 and angles theta0 and theta0 + arc_width,
+ * from z = 0 up to height. Returns the ray parameter of the hit (t_max
+ * if there is none before that), and the face hit in *face_id (the top
+ * face is 1, cf. treev_gldraw_platform( )) */
+static double
+treev_ray_platform( const double *origin, const double *direction, double r0, double r1, double theta0, double arc_width, double height, double t_max, unsigned int *face_id )
+{
+	double x, y, z, t;
+	double a, b, c, d, r;
+	double theta, sin_theta, cos_theta;
+	int i, j;
+
+	/* Top and bottom faces */
+	for (i = 0; (i < 2) && (direction[2] != 0.0); i++) {
+		z = (i == 0) ? height : 0.0;
+		t = (z - origin[2]) / direction[2];
+		if ((t < 0.0) || (t >= t_max))
+			continue;
+		x = origin[0] + t * direction[0];
+		y = origin[1] + t * direction[1];
+		r = sqrt( SQR(x) + SQR(y) );
+		if ((r >= r0) && (r <= r1) && treev_angle_within( x, y, theta0, arc_width )) {
+			t_max = t;
+			*face_id = (i == 0) ? 1 : 0;
+		}
+	}
+
+	/* Inner and outer edge faces: solve |(x,y)| = r */
+	a = SQR(direction[0]) + SQR(direction[1]);
+	b = origin[0] * direction[0] + origin[1] * direction[1];
+	c = SQR(origin[0]) + SQR(origin[1]);
+	for (i = 0; (i < 2) && (a > 0.0); i++) {
+		r = (i == 0) ? r0 : r1;
+		d = SQR(b) - a * (c - SQR(r));
+		if (d < 0.0)
+			continue;
+		for (j = -1; j <= 1; j += 2) {
+			t = (- b + (double)j * sqrt( d )) / a;
+			if ((t < 0.0) || (t >= t_max))
+				continue;
+			x = origin[0] + t * direction[0];
+			y = origin[1] + t * direction[1];
+			z = origin[2] + t * direction[2];
+			if ((z >= 0.0) && (z <= height) && treev_angle_within( x, y, theta0, arc_width )) {
+				t_max = t;
+				*face_id = 0;
+			}
+		}
+	}
+
+	/* Leading and trailing edge faces, which lie in the planes
+	 * through the z axis with normals (-sin(theta), cos(theta), 0) */
+	for (i = 0; i < 2; i++) {
+		theta = theta0 + ((i == 0) ? 0.0 : arc_width);
+		sin_theta = sin( RAD(theta) );
+		cos_theta = cos( RAD(theta) );
+		d = cos_theta * direction[1] - sin_theta * direction[0];
+		if (d == 0.0)
+			continue;
+		t = (sin_theta * origin[0] - cos_theta * origin[1]) / d;
+		if ((t < 0.0) || (t >= t_max))
+			continue;
+		x = origin[0] + t * direction[0];
+		y = origin[1] + t * direction[1];
+		z = origin[2] + t * direction[2];
+		r = x * cos_theta + y * sin_theta;
+		if ((r >= r0) && (r <= r1) && (z >= 0.0) && (z <= height)) {
+			t_max = t;
+			*face_id = 0;
+		}
+	}
+
+	return t_max;
+}
+
+
+/* Ray casting callback for TreeV: hits a node's leaf or platform, or
+ * anything in its subtree (see geometry_pick( )) */
+static double
+treev_ray_hit( void *item, double t_max, void *data )
+{
+	GNode *node = (GNode *)item;
+	PickRay *ray = (PickRay *)data;
+	TreeVGeomParams *gparams;
+	BoundsFrame frame;
+	BvhBox box;
+	double origin[3], direction[3];
+	double leaf_r, edge, height, deployment;
+	double sin_theta, cos_theta, t;
+	unsigned int face_id = 0;
+	int axis, i;
+
+	treev_node_box( node, &box, &ray->frame );
+	if (!bounds_visible( &box, CULL_SIZE_THRESHOLD ))
+		return t_max;
+
+	gparams = TREEV_GEOM_PARAMS(node);
+	deployment = NODE_IS_DIR(node) ? DIR_NODE_DESC(node)->deployment : 0.0;
+
+	/* Leaf form (or the flat pad left in place of an expanded
+	 * directory), in the leaf's own rotated frame. Cf.
+	 * treev_gldraw_leaf( ) and its callers */
+	leaf_r = ray->frame.r0 + gparams->leaf.distance;
+	edge = TREEV_LEAF_NODE_EDGE;
+	height = (1.0 - deployment) * gparams->leaf.height;
+	if (NODE_IS_DIR(node)) {
+		if (DIR_EXPANDED(node))
+			edge = (0.875 * TREEV_LEAF_NODE_EDGE);
+		height = MAX(TREEV_LEAF_NODE_EDGE / 64.0, height);
+	}
+	sin_theta = sin( RAD(ray->frame.theta + gparams->leaf.theta) );
+	cos_theta = cos( RAD(ray->frame.theta + gparams->leaf.theta) );
+	origin[0] = ray->origin[0] * cos_theta + ray->origin[1] * sin_theta;
+	origin[1] = ray->origin[1] * cos_theta - ray->origin[0] * sin_theta;
+	origin[2] = ray->origin[2];
+	direction[0] = ray->direction[0] * cos_theta + ray->direction[1] * sin_theta;
+	direction[1] = ray->direction[1] * cos_theta - ray->direction[0] * sin_theta;
+	direction[2] = ray->direction[2];
+	box.min[0] = leaf_r - 0.5 * edge;
+	box.max[0] = leaf_r + 0.5 * edge;
+	box.min[1] = - 0.5 * edge;
+	box.max[1] = 0.5 * edge;
+	box.min[2] = ray->frame.height;
+	box.max[2] = ray->frame.height + height;
+	t = ray_box_entry( origin, direction, &box, t_max, &axis );
+	if (t < t_max) {
+		ray->node = node;
+		ray->face_id = 0;
+		t_max = t;
+	}
+
+	if (!NODE_IS_DIR(node) || DIR_COLLAPSED(node))
+		return t_max;
+
+	/* Platform form, and the subtree. While the directory is
+	 * partially deployed, all of it is scaled about the leaf
+	 * position; cast the ray into the unscaled space instead */
+	for (i = 0; i < 3; i++) {
+		origin[i] = ray->origin[i];
+		direction[i] = ray->direction[i];
+	}
+	frame = ray->frame;
+	if (!DIR_EXPANDED(node)) {
+		ray->origin[0] = leaf_r * cos_theta + (origin[0] - leaf_r * cos_theta) / deployment;
+		ray->origin[1] = leaf_r * sin_theta + (origin[1] - leaf_r * sin_theta) / deployment;
+		ray->origin[2] = origin[2] / deployment;
+		for (i = 0; i < 3; i++)
+			ray->direction[i] = direction[i] / deployment;
+	}
+	treev_children_frame( node, &frame, &ray->frame );
+
+	t = treev_ray_platform( ray->origin, ray->direction, ray->frame.r0, ray->frame.r0 + gparams->platform.depth, ray->frame.theta - 0.5 * gparams->platform.arc_width, gparams->platform.arc_width, ray->frame.height, t_max, &face_id );
+	if (t < t_max) {
+		ray->node = node;
+		ray->face_id = face_id;
+		t_max = t;
+	}
+	if (DIR_NODE_DESC(node)->bvh != NULL)
+		t_max = bvh_raycast( DIR_NODE_DESC(node)->bvh, ray->origin, ray->direction, t_max, treev_ray_hit, ray );
+
+	for (i = 0; i < 3; i++) {
+		ray->origin[i] = origin[i];
+		ray->direction[i] = direction[i];
 	}
+	ray->frame = frame;
+
+	return t_max;
 }
 
 
@@ -2620,11 +4849,14 @@ treev_draw_recursive( GNode *dnode, double prev_r0, double r0, int action, doubl
 {
 	DirNodeDesc *dir_ndesc;
 	TreeVGeomParams *dir_gparams;
+	BoundsFrame frame;
+	BvhBox box;
 	GNode *node;
 	GNode *first_node = NULL, *last_node = NULL;
 	RTvec leaf;
 	double subtree_r0;
 	double theta0, theta1;
+	int arc_stride;
 	boolean dir_collapsed;
 	boolean dir_expanded;
 
@@ -2635,22 +4867,67 @@ treev_draw_recursive( GNode *dnode, double prev_r0, double r0, int action, doubl
 	dir_collapsed = DIR_COLLAPSED(dnode);
         dir_expanded = DIR_EXPANDED(dnode);
 
-	/* Size culling for expanded platforms (skip entire subtree).
-	 * Use higher threshold for outline pass. */
+	/* Frustum + size culling, against the box of the directory
+	 * together with everything beyond it. Use higher size threshold
+	 * for outline pass, then occlusion culling. A culled subdirectory
+	 * is still reported as expanded, so that the parent's branches
+	 * reach out to it */
+	if (NODE_IS_DIR(dnode)) {
+		frame.r0 = prev_r0;
+		frame.subtree_r0 = r0;
+		frame.theta = acc_theta;
+		frame.height = TREEV_GEOM_PARAMS(dnode->parent)->platform.height;
+		treev_node_box( dnode, &box, &frame );
+		if (!bounds_visible( &box, drawing_outlines ? OUTLINE_SIZE_THRESHOLD : CULL_SIZE_THRESHOLD ))
+			return dir_expanded;
+		if (occlusion_test( dnode, &box ))
+			return dir_expanded;
+		switch (impostor_check( dnode, &box )) {
+			case IMPOSTOR_READY:
+			return dir_expanded;
+
+			case IMPOSTOR_CAPTURE:
+			treev_draw_recursive( dnode, prev_r0, r0, TREEV_DRAW_GEOMETRY_WITH_BRANCHES, acc_theta );
+			if (!cel_lines) {
+				impostor_capture_outlines( );
+				treev_draw_recursive( dnode, prev_r0, r0, TREEV_DRAW_GEOMETRY, acc_theta );
+			}
+			impostor_capture_finish( );
+			return dir_expanded;
+
+			default:
+			break;
+		}
+	}
+
 	if (!dir_collapsed && NODE_IS_DIR(dnode) &&
 	    dir_gparams->platform.depth > 0.0) {
 		double r_center = r0 + dir_gparams->platform.depth * 0.5;
 		double wt = acc_theta + dir_gparams->platform.theta;
 		double pcx = r_center * cos( RAD(wt) );
 		double pcy = r_center * sin( RAD(wt) );
-		double threshold = drawing_outlines ? OUTLINE_SIZE_THRESHOLD : CULL_SIZE_THRESHOLD;
 
-		if (screen_size_pixels( pcx, pcy, 0.0,
-		    dir_gparams->platform.depth * 0.5 ) < threshold)
-			return FALSE;
+		/* Curve detail to suit the platform's size on screen.
+		 * (Left alone while picking, which doesn't need it) */
+		if ((action >= TREEV_DRAW_GEOMETRY) && !picking_mode) {
+			arc_stride = treev_arc_stride( pcx, pcy, r0 + dir_gparams->platform.depth, dir_ndesc->curve_detail );
+			if (arc_stride != (int)dir_ndesc->curve_detail) {
+				dir_ndesc->curve_detail = arc_stride;
+				dir_ndesc->a_stale = TRUE;
+				dir_ndesc->b_stale = TRUE;
+			}
+		}
+	}
+	else if (NODE_IS_METANODE(dnode) && (action >= TREEV_DRAW_GEOMETRY) && !picking_mode) {
+		/* Same for the center loop */
+		arc_stride = treev_arc_stride( 0.0, 0.0, r0, dir_ndesc->curve_detail );
+		if (arc_stride != (int)dir_ndesc->curve_detail) {
+			dir_ndesc->curve_detail = arc_stride;
+			dir_ndesc->b_stale = TRUE;
+		}
 	}
 
-	glPushMatrix( );
+	xform_push( );
 
 	if (!dir_collapsed) {
 		if (!dir_expanded) {
@@ -2662,47 +4939,35 @@ treev_draw_recursive( GNode *dnode, double prev_r0, double r0, int action, doubl
 				treev_gldraw_folder( dnode, prev_r0 );
 			}
 			else if (action == TREEV_DRAW_LABELS) {
-				glColor3fv( (float *)&treev_leaf_label_color );
+				vbuf_color3fv( (float *)&treev_leaf_label_color );
 				treev_apply_label( dnode, prev_r0, TRUE );
 			}
 
 			/* Platform should shrink to / grow from
 			 * corresponding leaf position */
-			glEnable( GL_NORMALIZE );
+			ogl_enable( GL_NORMALIZE );
 			leaf.r = prev_r0 + dir_gparams->leaf.distance;
 			leaf.theta = dir_gparams->leaf.theta;
-			glRotated( leaf.theta, 0.0, 0.0, 1.0 );
-			glTranslated( leaf.r, 0.0, 0.0 );
-			glScaled( dir_ndesc->deployment, dir_ndesc->deployment, dir_ndesc->deployment );
-			glTranslated( - leaf.r, 0.0, 0.0 );
-			glRotated( - leaf.theta, 0.0, 0.0, 1.0 );
+			xform_rotate( leaf.theta, 0.0, 0.0, 1.0 );
+			xform_translate( leaf.r, 0.0, 0.0 );
+			xform_scale( dir_ndesc->deployment, dir_ndesc->deployment, dir_ndesc->deployment );
+			xform_translate( - leaf.r, 0.0, 0.0 );
+			xform_rotate( - leaf.theta, 0.0, 0.0, 1.0 );
 		}
 
-		glRotated( dir_gparams->platform.theta, 0.0, 0.0, 1.0 );
+		xform_rotate( dir_gparams->platform.theta, 0.0, 0.0, 1.0 );
 	}
 
 	if (action >= TREEV_DRAW_GEOMETRY) {
 		/* Draw directory, in either leaf or platform form
-		 * (display list A) */
-		if (picking_mode) {
-			/* Pick mode: draw directly, bypass display lists */
-			if (dir_collapsed) {
-				glLoadName( NODE_DESC(dnode)->id );
-				node_glcolor( dnode );
-				treev_gldraw_leaf( dnode, prev_r0, TRUE );
-			}
-			else if (NODE_IS_DIR(dnode)) {
-				treev_build_dir( dnode, r0 );
-			}
-		}
-		else if (dir_ndesc->a_dlist_stale) {
+		 * (geometry A). Platforms swing around while the tree
+		 * is being rearranged, so displaced drawing is allowed
+		 * then as well */
+		if (dir_ndesc->a_stale || !vbuf_range_usable( dir_ndesc->a_vbuf, colexp_active || treev_animating )) {
 			/* Rebuild */
-			if (dir_ndesc->a_dlist == NULL_DLIST)
-				dir_ndesc->a_dlist = glGenLists( 1 );
-			glNewList( dir_ndesc->a_dlist, GL_COMPILE_AND_EXECUTE );
+			vbuf_record_begin( &dir_ndesc->a_vbuf );
 			if (dir_collapsed) {
 				/* Leaf form */
-				glLoadName( NODE_DESC(dnode)->id );
 				node_glcolor( dnode );
 				treev_gldraw_leaf( dnode, prev_r0, TRUE );
 				treev_gldraw_folder( dnode, prev_r0 );
@@ -2711,11 +4976,10 @@ treev_draw_recursive( GNode *dnode, double prev_r0, double r0, int action, doubl
 				/* Platform form (with leaf children) */
 				treev_build_dir( dnode, r0 );
 			}
-			glEndList( );
-			dir_ndesc->a_dlist_stale = FALSE;
+			vbuf_record_end( );
+			dir_ndesc->a_stale = FALSE;
 		}
-		else
-			glCallList( dir_ndesc->a_dlist );
+		vbuf_queue( dir_ndesc->a_vbuf );
 	}
 
 	if (!dir_collapsed) {
@@ -2739,37 +5003,38 @@ treev_draw_recursive( GNode *dnode, double prev_r0, double r0, int action, doubl
 	}
 
 	if (dir_expanded && (action == TREEV_DRAW_GEOMETRY_WITH_BRANCHES) && !picking_mode) {
-		/* Draw interconnecting branches (display list B).
-		 * During animation, draw directly to avoid compiling
-		 * display lists that will be stale next frame. */
-		if (dir_ndesc->b_dlist_stale) {
-			if (!treev_animating) {
-				if (dir_ndesc->b_dlist == NULL_DLIST)
-					dir_ndesc->b_dlist = glGenLists( 1 );
-				glNewList( dir_ndesc->b_dlist, GL_COMPILE_AND_EXECUTE );
-			}
-			glLoadName( NODE_DESC(dnode)->id );
-			glColor3fv( (float *)&branch_color );
-			glNormal3d( 0.0, 0.0, 1.0 );
+		/* Draw interconnecting branches (geometry B).
+		 * During animation, draw directly to avoid uploading
+		 * geometry that will be stale next frame. */
+		if (dir_ndesc->b_stale || !vbuf_range_usable( dir_ndesc->b_vbuf, FALSE )) {
+			if (!treev_animating)
+				vbuf_record_begin( &dir_ndesc->b_vbuf );
+			vbuf_color3fv( (float *)&branch_color );
+			vbuf_normal3d( 0.0, 0.0, 1.0 );
+			/* Branches belong to no node. They are left out of
+			 * the pick pass, but not out of the main one, which
+			 * writes node IDs too (see ogl_pick_ids( )) */
+			vbuf_pick_id( 0, 0 );
 			if (NODE_IS_METANODE(dnode)) {
-				treev_gldraw_loop( r0 );
-				treev_gldraw_outbranch( r0, 0.0, 0.0 );
+				treev_gldraw_loop( r0, dir_ndesc->curve_detail );
+				treev_gldraw_outbranch( r0, 0.0, 0.0, dir_ndesc->curve_detail );
 			}
 			else {
 				treev_gldraw_inbranch( r0 );
 				if (first_node != NULL) {
 					theta0 = MIN(0.0, TREEV_GEOM_PARAMS(first_node)->platform.theta);
 					theta1 = MAX(0.0, TREEV_GEOM_PARAMS(last_node)->platform.theta);
-					treev_gldraw_outbranch( r0 + dir_gparams->platform.depth, theta0, theta1 );
+					treev_gldraw_outbranch( r0 + dir_gparams->platform.depth, theta0, theta1, dir_ndesc->curve_detail );
 				}
 			}
 			if (!treev_animating) {
-				glEndList( );
-				dir_ndesc->b_dlist_stale = FALSE;
+				vbuf_record_end( );
+				vbuf_queue( dir_ndesc->b_vbuf );
+				dir_ndesc->b_stale = FALSE;
 			}
 		}
 		else
-			glCallList( dir_ndesc->b_dlist );
+			vbuf_queue( dir_ndesc->b_vbuf );
 	}
 
 	if (action == TREEV_DRAW_LABELS) {
@@ -2790,23 +5055,20 @@ treev_draw_recursive( GNode *dnode, double prev_r0, double r0, int action, doubl
 				label_vis = FALSE;
 		}
 		if (label_vis) {
-			/* Draw name label(s) (display list C) */
-			if (dir_ndesc->c_dlist_stale) {
-				/* Rebuild */
-				if (dir_ndesc->c_dlist == NULL_DLIST)
-					dir_ndesc->c_dlist = glGenLists( 1 );
-				glNewList( dir_ndesc->c_dlist, GL_COMPILE_AND_EXECUTE );
+			/* Draw name label(s) (geometry C) */
+			if (dir_ndesc->c_stale || !vbuf_range_usable( dir_ndesc->label_vbuf, colexp_active || treev_animating )) {
+				label_record_begin( dir_ndesc );
 				if (dir_collapsed) {
 					/* Label directory leaf */
-					glColor3fv( (float *)&treev_leaf_label_color );
+					vbuf_color3fv( (float *)&treev_leaf_label_color );
 					treev_apply_label( dnode, prev_r0, TRUE );
 				}
 				else if (NODE_IS_DIR(dnode)) {
 					/* Label directory platform */
-					glColor3fv( (float *)&treev_platform_label_color );
+					vbuf_color3fv( (float *)&treev_platform_label_color );
 					treev_apply_label( dnode, r0, FALSE );
 					/* Label leaf nodes that aren't directories */
-					glColor3fv( (float *)&treev_leaf_label_color );
+					vbuf_color3fv( (float *)&treev_leaf_label_color );
 					node = dnode->children;
 					while (node != NULL) {
 						if (!NODE_IS_DIR(node))
@@ -2814,11 +5076,10 @@ treev_draw_recursive( GNode *dnode, double prev_r0, double r0, int action, doubl
 						node = node->next;
 					}
 				}
-				glEndList( );
-				dir_ndesc->c_dlist_stale = FALSE;
+				label_record_end( );
+				dir_ndesc->c_stale = FALSE;
 			}
-			else
-				glCallList( dir_ndesc->c_dlist );
+			label_submit( dir_ndesc );
 		}
 	}
 
@@ -2826,9 +5087,9 @@ treev_draw_recursive( GNode *dnode, double prev_r0, double r0, int action, doubl
 	dir_ndesc->geom_expanded = !dir_collapsed;
 
 	if (!dir_collapsed && !dir_expanded)
-		glDisable( GL_NORMALIZE );
+		ogl_disable( GL_NORMALIZE );
 
-	glPopMatrix( );
+	xform_pop( );
 
 	return dir_expanded;
 }
@@ -2844,7 +5105,7 @@ treev_gldraw_cursor( RTZvec *c0, RTZvec *c1 )
 	XYvec cp0, cp1;
 	double theta;
 	double sin_theta, cos_theta;
-	int seg_count;
+	int stride, seg_count;
 	int i, c, s;
 
 	g_assert( c1->r > c0->r );
@@ -2855,7 +5116,9 @@ treev_gldraw_cursor( RTZvec *c0, RTZvec *c1 )
 	corner_dims.theta = bar_part * (c1->theta - c0->theta);
 	corner_dims.z = bar_part * (c1->z - c0->z);
 
-	seg_count = (int)ceil( corner_dims.theta / TREEV_CURVE_GRANULARITY );
+	/* Curve stride, going by the outer corners */
+	theta = 0.5 * (c0->theta + c1->theta);
+	stride = treev_arc_stride( c1->r * cos( RAD(theta) ), c1->r * sin( RAD(theta) ), c1->r, 0 );
 
 	cursor_pre( );
 	for (i = 0; i <= 1; i++) {
@@ -2898,24 +5161,25 @@ treev_gldraw_cursor( RTZvec *c0, RTZvec *c1 )
 			cp0.y = p.r * sin_theta;
 			cp1.x = (p.r + delta.r) * cos_theta;
 			cp1.y = (p.r + delta.r) * sin_theta;
-			glBegin( GL_LINES );
+			vbuf_begin( GL_LINES );
 			/* Radial axis */
-			glVertex3d( cp0.x, cp0.y, p.z );
-			glVertex3d( cp1.x, cp1.y, p.z );
+			vbuf_vertex3d( cp0.x, cp0.y, p.z );
+			vbuf_vertex3d( cp1.x, cp1.y, p.z );
 			/* Vertical axis */
-			glVertex3d( cp0.x, cp0.y, p.z );
-			glVertex3d( cp0.x, cp0.y, p.z + delta.z );
-			glEnd( );
+			vbuf_vertex3d( cp0.x, cp0.y, p.z );
+			vbuf_vertex3d( cp0.x, cp0.y, p.z + delta.z );
+			vbuf_end( );
 
 			/* Tangent axis (curved part) */
-			glBegin( GL_LINE_STRIP );
+			theta = p.theta + delta.theta;
+			seg_count = treev_arc_points( MIN(p.theta, theta), MAX(p.theta, theta), stride, inner_edge_buf );
+			vbuf_begin( GL_LINE_STRIP );
 			for (s = 0; s <= seg_count; s++) {
-				theta = p.theta + delta.theta * (double)s / (double)seg_count;
-				cp0.x = p.r * cos( RAD(theta) );
-				cp0.y = p.r * sin( RAD(theta) );
-				glVertex3d( cp0.x, cp0.y, p.z );
+				cp0.x = p.r * inner_edge_buf[s].x;
+				cp0.y = p.r * inner_edge_buf[s].y;
+				vbuf_vertex3d( cp0.x, cp0.y, p.z );
 			}
-			glEnd( );
+			vbuf_end( );
 		}
 	}
 	cursor_post( );
@@ -2955,26 +5219,58 @@ treev_draw( boolean high_detail )
 		treev_needs_arrange = FALSE;
 	}
 
+	frametime_phase_begin( FRAMETIME_FRUSTUM );
 	frustum_extract( );
-
-	/* Draw low-detail geometry (culled tree walk) */
+	frametime_phase_end( FRAMETIME_FRUSTUM );
+	xform_load_identity( );
+
+	frametime_phase_begin( FRAMETIME_GEOMETRY );
+	bounds_update_all( );
+
+	/* Draw low-detail geometry (culled tree walk), with the outlines
+	 * shaded in if possible */
+	cel_lines = high_detail && ogl_cel_lines( TRUE );
+	occlusion_begin( );
+	impostor_begin( );
+	ogl_pick_ids( TRUE );
 	treev_draw_recursive( globals.fstree, NIL, treev_core_radius, TREEV_DRAW_GEOMETRY_WITH_BRANCHES, 0.0 );
-
-	if (high_detail) {
+	vbuf_flush( picking_mode );
+	ogl_pick_ids( FALSE );
+	impostor_end( );
+	occlusion_end( );
+	if (cel_lines)
+		ogl_cel_lines( FALSE );
+	frametime_phase_end( FRAMETIME_GEOMETRY );
+
+	if (high_detail && !cel_lines) {
 		/* "Cel lines" — skip outlines on small/distant subtrees */
+		frametime_phase_begin( FRAMETIME_OUTLINES );
 		outline_pre( );
 		drawing_outlines = TRUE;
 		treev_draw_recursive( globals.fstree, NIL, treev_core_radius, TREEV_DRAW_GEOMETRY, 0.0 );
+		vbuf_flush( FALSE );
 		drawing_outlines = FALSE;
 		outline_post( );
+		frametime_phase_end( FRAMETIME_OUTLINES );
+	}
 
+	if (high_detail) {
 		/* Node name labels */
+		frametime_phase_begin( FRAMETIME_LABELS );
 		text_pre( );
+		label_place_begin( );
 		treev_draw_recursive( globals.fstree, NIL, treev_core_radius, TREEV_DRAW_LABELS, 0.0 );
+		label_place_end( );
+		vbuf_flush( FALSE );
 		text_post( );
+		frametime_phase_end( FRAMETIME_LABELS );
+	}
 
+	if (!picking_mode) {
 		/* Node cursor */
+		frametime_phase_begin( FRAMETIME_CURSOR );
 		treev_draw_cursor( CURSOR_POS(camera->pan_part) );
+		frametime_phase_end( FRAMETIME_CURSOR );
 	}
 }
 
@@ -2987,8 +5283,8 @@ static void
 outline_pre( void )
 {
 	glDisable( GL_CULL_FACE );
-	glDisable( GL_LIGHT0 );
-	glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+	ogl_disable( GL_LIGHT0 );
+	ogl_polygon_mode( GL_LINE );
 }
 
 
@@ -2996,8 +5292,8 @@ outline_pre( void )
 static void
 outline_post( void )
 {
-	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-	glEnable( GL_LIGHT0 );
+	ogl_polygon_mode( GL_FILL );
+	ogl_enable( GL_LIGHT0 );
 	glEnable( GL_CULL_FACE );
 }
 
@@ -3006,7 +5302,7 @@ outline_post( void )
 static void
 cursor_pre( void )
 {
-	glDisable( GL_LIGHTING );
+	ogl_disable( GL_LIGHTING );
 }
 
 
@@ -3016,10 +5312,10 @@ cursor_hidden_part( void )
 {
 	/* Hidden part is drawn with a thin dashed line */
 	glDepthFunc( GL_GREATER );
-	glEnable( GL_LINE_STIPPLE );
-	glLineStipple( 3, 0x3333 );
+	ogl_enable( GL_LINE_STIPPLE );
+	ogl_line_stipple( 3, 0x3333 );
 	glLineWidth( 3.0 );
-	glColor3f( 0.75, 0.75, 0.75 );
+	vbuf_color3f( 0.75, 0.75, 0.75 );
 }
 
 
@@ -3029,9 +5325,9 @@ cursor_visible_part( void )
 {
 	/* Visible part is drawn with a thick solid line */
 	glDepthFunc( GL_LEQUAL );
-	glDisable( GL_LINE_STIPPLE );
+	ogl_disable( GL_LINE_STIPPLE );
 	glLineWidth( 5.0 );
-	glColor3f( 1.0, 1.0, 1.0 );
+	vbuf_color3f( 1.0, 1.0, 1.0 );
 }
 
 
@@ -3040,19 +5336,34 @@ static void
 cursor_post( void )
 {
 	glLineWidth( 1.0 );
-	glEnable( GL_LIGHTING );
+	ogl_enable( GL_LIGHTING );
 }
 
 
 /* Invalidates cached rendering state. Called when geometry or
- * scene state changes. Per-directory display lists handle their
- * own stale flags; this just invalidates the pick FBO cache and
+ * scene state changes. Per-directory geometry has its own stale
+ * flags; this just invalidates the pick FBO cache and impostors, and
  * flags TreeV for rearrangement. */
 static void
 queue_uncached_draw( void )
 {
 	treev_needs_arrange = TRUE;
 	ogl_pick_invalidate( );
+	impostor_invalidate( );
+}
+
+
+/* Flags a directory's geometry for rebuilding, keeping any that is being
+ * built in advance */
+static void
+queue_rebuild( GNode *dnode )
+{
+	DIR_NODE_DESC(dnode)->a_stale = TRUE;
+	DIR_NODE_DESC(dnode)->b_stale = TRUE;
+	DIR_NODE_DESC(dnode)->c_stale = TRUE;
+	DIR_NODE_DESC(dnode)->i_stale = TRUE;
+
+	queue_uncached_draw( );
 }
 
 
@@ -3060,11 +5371,8 @@ queue_uncached_draw( void )
 void
 geometry_queue_rebuild( GNode *dnode )
 {
-	DIR_NODE_DESC(dnode)->a_dlist_stale = TRUE;
-	DIR_NODE_DESC(dnode)->b_dlist_stale = TRUE;
-	DIR_NODE_DESC(dnode)->c_dlist_stale = TRUE;
-
-	queue_uncached_draw( );
+	build_job_discard( DIR_NODE_DESC(dnode) );
+	queue_rebuild( dnode );
 }
 
 
@@ -3072,8 +5380,11 @@ geometry_queue_rebuild( GNode *dnode )
 void
 geometry_init( FsvMode mode )
 {
+	build_job_discard_all( );
 	DIR_NODE_DESC(globals.fstree)->deployment = 1.0;
 	geometry_queue_rebuild( globals.fstree );
+	bounds_all_stale = TRUE;
+	occlusion_reset( );
 
 	switch (mode) {
 		case FSV_DISCV:
@@ -3104,15 +5415,15 @@ geometry_gldraw_fsv( void )
 	const int *triangles = NULL, *edges = NULL;
 	int c, v, e, i;
 
-	glEnable( GL_NORMALIZE );
+	ogl_enable( GL_NORMALIZE );
 	for (c = 0; c < 3; c++) {
-		glColor3fv( (float *)&fsv_colors[c] );
+		vbuf_color3fv( (float *)&fsv_colors[c] );
 		vertices = fsv_vertices[c];
 		triangles = fsv_triangles[c];
 		edges = fsv_edges[c];
 
 		/* Side faces */
-		glBegin( GL_QUAD_STRIP );
+		vbuf_begin( GL_QUAD_STRIP );
 		for (e = 0; edges[e] >= 0; e++) {
 			i = edges[e];
 			p.x = vertices[2 * i];
@@ -3121,37 +5432,37 @@ geometry_gldraw_fsv( void )
 			if (i >= 0) {
 				n.x = vertices[2 * i + 1] - p.y;
 				n.y = p.x - vertices[2 * i];
-				glNormal3d( n.x, n.y, 0.0 );
+				vbuf_normal3d( n.x, n.y, 0.0 );
 			}
-			glVertex3d( p.x, p.y, 30.0 );
-			glVertex3d( p.x, p.y, -30.0 );
+			vbuf_vertex3d( p.x, p.y, 30.0 );
+			vbuf_vertex3d( p.x, p.y, -30.0 );
 
 		}
-		glEnd( );
+		vbuf_end( );
 
 		/* Front faces */
-		glNormal3d( 0.0, 0.0, 1.0 );
-		glBegin( GL_TRIANGLES );
+		vbuf_normal3d( 0.0, 0.0, 1.0 );
+		vbuf_begin( GL_TRIANGLES );
 		for (v = 0; triangles[v] >= 0; v++) {
                         i = triangles[v];
 			p.x = vertices[2 * i];
 			p.y = vertices[2 * i + 1];
-			glVertex3d( p.x, p.y, 30.0 );
+			vbuf_vertex3d( p.x, p.y, 30.0 );
 		}
-		glEnd( );
+		vbuf_end( );
 
 		/* Back faces */
-		glNormal3d( 0.0, 0.0, -1.0 );
-		glBegin( GL_TRIANGLES );
+		vbuf_normal3d( 0.0, 0.0, -1.0 );
+		vbuf_begin( GL_TRIANGLES );
 		for (--v; v >= 0; v--) {
                         i = triangles[v];
 			p.x = vertices[2 * i];
 			p.y = vertices[2 * i + 1];
-			glVertex3d( p.x, p.y, -30.0 );
+			vbuf_vertex3d( p.x, p.y, -30.0 );
 		}
-		glEnd( );
+		vbuf_end( );
 	}
-	glDisable( GL_NORMALIZE );
+	ogl_disable( GL_NORMALIZE );
 }
 
 
@@ -3161,45 +5472,45 @@ splash_draw( void )
 {
 	XYZvec text_pos;
 	XYvec text_dims;
+	XformMatrix prev_projection, prev_view, m;
 	double bottom_y;
 	double k;
 
+	xform_copy( prev_projection, xform_projection( ) );
+	xform_copy( prev_view, xform_view( ) );
+
 	/* Draw fsv title */
 
 	/* Set up projection matrix */
-	glMatrixMode( GL_PROJECTION );
-	glPushMatrix( );
-	glLoadIdentity( );
 	k = 82.84 / ogl_aspect_ratio( );
-	glFrustum( -70.82, 95.40, - k, k, 200.0, 400.0 );
+	xform_matrix_frustum( m, -70.82, 95.40, - k, k, 200.0, 400.0 );
+	xform_set_projection( m );
 
 	/* Set up modelview matrix */
-	glMatrixMode( GL_MODELVIEW );
-	glPushMatrix( );
-	glLoadIdentity( );
-	glTranslated( 0.0, 0.0, -300.0 );
-	glRotated( 10.5, 1.0, 0.0, 0.0 );
-	glTranslated( 20.0, 20.0, -30.0 );
+	xform_identity( m );
+	xform_matrix_translate( m, 0.0, 0.0, -300.0 );
+	xform_matrix_rotate( m, 10.5, 1.0, 0.0, 0.0 );
+	xform_matrix_translate( m, 20.0, 20.0, -30.0 );
+	xform_set_view( m );
 
 	geometry_gldraw_fsv( );
 
 	/* Draw accompanying text */
 
 	/* Set up projection matrix */
-	glMatrixMode( GL_PROJECTION );
-	glLoadIdentity( );
 	k = 0.5 / ogl_aspect_ratio( );
-	glOrtho( 0.0, 1.0, - k, k, -1.0, 1.0 );
+	xform_matrix_ortho( m, 0.0, 1.0, - k, k, -1.0, 1.0 );
+	xform_set_projection( m );
 	bottom_y = - k;
 
 	/* Set up modelview matrix */
-	glMatrixMode( GL_MODELVIEW );
-	glLoadIdentity( );
+	xform_identity( m );
+	xform_set_view( m );
 
 	text_pre( );
 
 	/* Title */
-	glColor3f( 1.0, 1.0, 1.0 );
+	vbuf_color3f( 1.0, 1.0, 1.0 );
 	text_pos.x = 0.2059;
 	text_pos.y = -0.1700;
 	text_pos.z = 0.0;
@@ -3212,14 +5523,14 @@ splash_draw( void )
 	text_draw_straight( "Visualizer", &text_pos, &text_dims );
 
 	/* Version */
-	glColor3f( 0.75, 0.75, 0.75 );
+	vbuf_color3f( 0.75, 0.75, 0.75 );
 	text_pos.x = 0.5000;
 	text_pos.y = (2.0 - MAGIC_NUMBER) * (0.2247 + bottom_y) - 0.2013;
 	text_dims.y = 0.0386;
 	text_draw_straight( "Version " VERSION, &text_pos, &text_dims );
 
 	/* Copyright/author info */
-	glColor3f( 0.5, 0.5, 0.5 );
+	vbuf_color3f( 0.5, 0.5, 0.5 );
 	text_pos.y = bottom_y + 0.0117;
 	text_dims.y = 0.0234;
 	/*text_draw_straight( "Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>, udates (c) 2026 sterlingphoenix <fsv@freakzilla.com>", &text_pos, &text_dims );*/
@@ -3227,24 +5538,22 @@ splash_draw( void )
 	text_post( );
 
 	/* Restore previous matrices */
-	glMatrixMode( GL_PROJECTION );
-	glPopMatrix( );
-	glMatrixMode( GL_MODELVIEW );
-	glPopMatrix( );
+	xform_set_projection( prev_projection );
+	xform_set_view( prev_view );
 }
 
 
-/* Draw geometry in color-picking mode (node IDs encoded as colors).
- * Per-directory display list caching is bypassed since pick colors
- * differ from normal colors. */
+/* Draw geometry in color-picking mode (node IDs passed as a vertex
+ * attribute). The vertex buffers carry pick IDs alongside colors, so
+ * the same per-directory geometry is drawn as in the normal pass. (The
+ * core-profile renderer writes these IDs during the normal pass as
+ * well, so this is only needed when a pick comes in before the next
+ * frame has been drawn) */
 void
 geometry_draw_for_pick( void )
 {
 	picking_mode = TRUE;
 
-	glInitNames( );
-	glPushName( 0 );
-
 	switch (globals.fsv_mode) {
 		case FSV_DISCV:
 		discv_draw( FALSE );
@@ -3266,20 +5575,54 @@ geometry_draw_for_pick( void )
 }
 
 
+/* Brings the bounds of all directories up to date for the current mode
+ * (see "Subtree bounds" above) */
+static void
+bounds_update_all( void )
+{
+	BoundsFrame frame;
+
+	switch (globals.fsv_mode) {
+		case FSV_DISCV:
+		frame.x = 0.0;
+		frame.y = 0.0;
+		frame.scale = 1.0;
+		discv_bounds_recursive( globals.fstree, &frame, bounds_all_stale );
+		break;
+
+		case FSV_MAPV:
+		frame.z = 0.0;
+		mapv_bounds_recursive( globals.fstree, &frame, bounds_all_stale );
+		break;
+
+		case FSV_TREEV:
+		/* The tree swings around while being rearranged */
+		frame.subtree_r0 = treev_core_radius;
+		frame.theta = 0.0;
+		treev_bounds_recursive( globals.fstree, &frame, bounds_all_stale || treev_animating );
+		break;
+
+		default:
+		return;
+	}
+
+	bounds_all_stale = FALSE;
+}
+
+
 static void geometry_draw_highlight( void );
 
-/* Top-level call to draw viewport content */
+/* Top-level call to draw viewport content. Without high_detail (i.e.
+ * while the view is moving faster than it can be drawn in full), labels
+ * and outlines are left out, and curves are kept coarse */
 void
 geometry_draw( boolean high_detail )
 {
-	/* Initialize name stack */
-	glInitNames( );
-	glPushName( 0 );
+	coarse_curves = !high_detail;
 
 	if (about( ABOUT_CHECK )) {
 		/* Currently giving About presentation */
-		if (high_detail)
-			about( ABOUT_DRAW );
+		about( ABOUT_DRAW );
 		return;
 	}
 
@@ -3303,8 +5646,14 @@ geometry_draw( boolean high_detail )
 		SWITCH_FAIL
 	}
 
-	/* Draw highlight overlay if active */
+	/* Draw highlight overlay if active (timed along with the cursor) */
+	frametime_phase_begin( FRAMETIME_CURSOR );
 	geometry_draw_highlight( );
+	frametime_phase_end( FRAMETIME_CURSOR );
+
+	/* Collapse/expand callbacks set this again for the next frame,
+	 * until the last one has finished */
+	colexp_active = FALSE;
 }
 
 
@@ -3341,6 +5690,15 @@ geometry_colexp_initiated( GNode *dnode )
 	 * or its inner radius may have changed) */
 	if (DIR_COLLAPSED(dnode) && (globals.fsv_mode == FSV_TREEV))
 		treev_reshape_platform( dnode, geometry_treev_platform_r0( dnode ) );
+
+	/* A directory about to expand in MapV mode gets a head start on
+	 * the geometry of its children */
+	if (globals.fsv_mode == FSV_MAPV) {
+		if (DIR_COLLAPSED(dnode))
+			build_job_submit( dnode );
+		else
+			build_job_discard( DIR_NODE_DESC(dnode) );
+	}
 }
 
 
@@ -3354,10 +5712,19 @@ geometry_colexp_in_progress( GNode *dnode )
 	/* Check geometry status against deployment. If they don't concur
 	 * properly, then directory geometry has to be rebuilt */
         if (DIR_NODE_DESC(dnode)->geom_expanded != (DIR_NODE_DESC(dnode)->deployment > EPSILON))
-		geometry_queue_rebuild( dnode );
+		queue_rebuild( dnode );
         else
 		queue_uncached_draw( );
 
+	/* Geometry under this directory is on the move until the final
+	 * call (and will be rebuilt in its resting place after that) */
+	if (!DIR_COLLAPSED(dnode) && !DIR_EXPANDED(dnode))
+		colexp_active = TRUE;
+
+	/* Everything under this directory moves along with it */
+	bounds_queue_update_recursive( dnode );
+	bounds_queue_update( dnode );
+
 	if (globals.fsv_mode == FSV_TREEV) {
 		/* Take care of shifting angles */
 		treev_queue_rearrange( dnode );
@@ -3365,6 +5732,95 @@ geometry_colexp_in_progress( GNode *dnode )
 }
 
 
+/* Finds the node visible at viewport location (x,y) by casting a ray
+ * from the eye through it, against the node bounds of the last frame's
+ * view (width x height, (0,0) being the upper-left corner). The node ID
+ * (0 if nothing was hit) and face ID (as in the pick pass) are stored in
+ * node_id and face_id. Returns FALSE if the layout is in a state where
+ * this can't be done, in which case the pick pass is the way to go */
+boolean
+geometry_pick( int x, int y, int width, int height, unsigned int *node_id, unsigned int *face_id )
+{
+	XformMatrix mvp, inv_mvp;
+	BoundsFrame frame;
+	PickRay ray;
+	BvhRayFunc hit_func;
+	double ndc[2], p[2][4];
+	int i, j;
+
+	*node_id = 0;
+	*face_id = 0;
+
+	switch (globals.fsv_mode) {
+		case FSV_DISCV:
+		hit_func = discv_ray_hit;
+		frame.x = 0.0;
+		frame.y = 0.0;
+		frame.scale = 1.0;
+		discv_children_frame( globals.fstree, &frame, &ray.frame );
+		break;
+
+		case FSV_MAPV:
+		hit_func = mapv_ray_hit;
+		frame.z = 0.0;
+		mapv_children_frame( globals.fstree, &frame, &ray.frame );
+		break;
+
+		case FSV_TREEV:
+		/* Leaf positions are only known once the next frame
+		 * has been laid out */
+		if (treev_needs_arrange)
+			return FALSE;
+		hit_func = treev_ray_hit;
+		frame.subtree_r0 = treev_core_radius;
+		frame.theta = 0.0;
+		treev_children_frame( globals.fstree, &frame, &ray.frame );
+		break;
+
+		default:
+		/* No nodes to be had */
+		return TRUE;
+	}
+
+	if ((width <= 0) || (height <= 0))
+		return TRUE;
+
+	bounds_update_all( );
+	if (DIR_NODE_DESC(globals.fstree)->bvh == NULL)
+		return TRUE;
+
+	/* Unproject the pixel center onto the near and far planes */
+	frustum_extract( );
+	xform_mult( mvp, xform_projection( ), xform_view( ) );
+	if (!xform_invert( inv_mvp, mvp ))
+		return FALSE;
+	ndc[0] = 2.0 * ((double)x + 0.5) / (double)width - 1.0;
+	ndc[1] = 1.0 - 2.0 * ((double)y + 0.5) / (double)height;
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < 4; j++)
+			p[i][j] = inv_mvp[j] * ndc[0] + inv_mvp[4 + j] * ndc[1] + inv_mvp[8 + j] * (double)(2 * i - 1) + inv_mvp[12 + j];
+		if (fabs( p[i][3] ) < EPSILON)
+			return FALSE;
+	}
+
+	/* Ray runs from near plane (t = 0) to far plane (t = 1) */
+	for (j = 0; j < 3; j++) {
+		ray.origin[j] = p[0][j] / p[0][3];
+		ray.direction[j] = p[1][j] / p[1][3] - ray.origin[j];
+	}
+	ray.node = NULL;
+	ray.face_id = 0;
+	bvh_raycast( DIR_NODE_DESC(globals.fstree)->bvh, ray.origin, ray.direction, 1.0, hit_func, &ray );
+
+	if (ray.node != NULL) {
+		*node_id = NODE_DESC(ray.node)->id;
+		*face_id = ray.face_id;
+	}
+
+	return TRUE;
+}
+
+
 /* This tells if the specified node should be highlighted when the user
  * points at the specified face */
 boolean
@@ -3394,7 +5850,7 @@ geometry_should_highlight( GNode *node, unsigned int face_id )
 static void
 draw_node( GNode *node )
 {
-	glPushMatrix( );
+	xform_push( );
 
 	switch (globals.fsv_mode) {
 		case FSV_DISCV:
@@ -3402,24 +5858,24 @@ draw_node( GNode *node )
 			XYvec *abs_pos;
 			abs_pos = geometry_discv_node_pos( node );
 			/* Translate to absolute position, draw disc at origin */
-			glTranslated( abs_pos->x - DISCV_GEOM_PARAMS(node)->pos.x,
-			              abs_pos->y - DISCV_GEOM_PARAMS(node)->pos.y, 0.0 );
-			discv_gldraw_node( node, 1.0 );
+			xform_translate( abs_pos->x - DISCV_GEOM_PARAMS(node)->pos.x,
+			                 abs_pos->y - DISCV_GEOM_PARAMS(node)->pos.y, 0.0 );
+			discv_gldraw_node( node, 1.0, HUGE_VAL );
 		}
 		break;
 
 		case FSV_MAPV:
-		glTranslated( 0.0, 0.0, geometry_mapv_node_z0( node ) );
+		xform_translate( 0.0, 0.0, geometry_mapv_node_z0( node ) );
 		mapv_gldraw_node( node );
 		break;
 
 		case FSV_TREEV:
 		if (geometry_treev_is_leaf( node )) {
-			glRotated( geometry_treev_platform_theta( node->parent ), 0.0, 0.0, 1.0 );
+			xform_rotate( geometry_treev_platform_theta( node->parent ), 0.0, 0.0, 1.0 );
 			treev_gldraw_leaf( node, geometry_treev_platform_r0( node->parent ), TRUE );
 		}
 		else {
-			glRotated( geometry_treev_platform_theta( node ), 0.0, 0.0, 1.0 );
+			xform_rotate( geometry_treev_platform_theta( node ), 0.0, 0.0, 1.0 );
 			treev_gldraw_platform( node, geometry_treev_platform_r0( node ) );
 		}
 		break;
@@ -3427,7 +5883,7 @@ draw_node( GNode *node )
 		SWITCH_FAIL
 	}
 
-	glPopMatrix( );
+	xform_pop( );
 }
 
 
@@ -3446,23 +5902,23 @@ geometry_draw_highlight( void )
 		return;
 
 	glDisable( GL_DEPTH_TEST );
-	glDisable( GL_LIGHTING );
-	glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+	ogl_disable( GL_LIGHTING );
+	ogl_polygon_mode( GL_LINE );
 
 	if (cur_highlight_strong) {
 		glLineWidth( 7.0 );
-		glColor3f( 1.0, 0.75, 0.0 );
+		vbuf_color3f( 1.0, 0.75, 0.0 );
 		draw_node( cur_highlight_node );
-		glColor3f( 1.0, 0.5, 0.0 );
+		vbuf_color3f( 1.0, 0.5, 0.0 );
 	}
 	else
-		glColor3f( 1.0, 1.0, 1.0 );
+		vbuf_color3f( 1.0, 1.0, 1.0 );
 	glLineWidth( 3.0 );
 	draw_node( cur_highlight_node );
 	glLineWidth( 1.0 );
 
-	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-	glEnable( GL_LIGHTING );
+	ogl_polygon_mode( GL_FILL );
+	ogl_enable( GL_LIGHTING );
 	glEnable( GL_DEPTH_TEST );
 }
 
@@ -3499,8 +5955,9 @@ geometry_highlight_node( GNode *node, boolean strong )
 }
 
 
-/* Frees all allocated display lists in the subtree rooted at the
- * specified directory node */
+/* Frees all allocated vertex buffer ranges (and bounding volumes,
+ * occlusion queries, impostors and build jobs) in the subtree rooted at
+ * the specified directory node */
 void
 geometry_free_recursive( GNode *dnode )
 {
@@ -3511,18 +5968,19 @@ geometry_free_recursive( GNode *dnode )
 
 	dir_ndesc = DIR_NODE_DESC(dnode);
 
-	if (dir_ndesc->a_dlist != NULL_DLIST) {
-		glDeleteLists( dir_ndesc->a_dlist, 1 );
-		dir_ndesc->a_dlist = NULL_DLIST;
-	}
-	if (dir_ndesc->b_dlist != NULL_DLIST) {
-		glDeleteLists( dir_ndesc->b_dlist, 1 );
-		dir_ndesc->b_dlist = NULL_DLIST;
-	}
-	if (dir_ndesc->c_dlist != NULL_DLIST) {
-		glDeleteLists( dir_ndesc->c_dlist, 1 );
-		dir_ndesc->c_dlist = NULL_DLIST;
+	build_job_discard( dir_ndesc );
+	vbuf_range_free( &dir_ndesc->a_vbuf );
+	vbuf_range_free( &dir_ndesc->b_vbuf );
+	vbuf_range_free( &dir_ndesc->label_vbuf );
+	if (dir_ndesc->label_set != NULL) {
+		xfree( dir_ndesc->label_set->spans );
+		xfree( dir_ndesc->label_set );
+		dir_ndesc->label_set = NULL;
 	}
+	bvh_free( dir_ndesc->bvh );
+	dir_ndesc->bvh = NULL;
+	occlusion_free( dir_ndesc );
+	impostor_remove( dir_ndesc );
 
 	/* Recurse into subdirectories */
 	node = dnode->children;
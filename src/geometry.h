@@ -104,6 +104,7 @@ void geometry_treev_reinit( void );
 void geometry_gldraw_fsv( void );
 void geometry_draw( boolean high_detail );
 void geometry_draw_for_pick( void );
+boolean geometry_pick( int x, int y, int width, int height, unsigned int *node_id, unsigned int *face_id );
 void geometry_camera_pan_finished( void );
 void geometry_colexp_initiated( GNode *dnode );
 void geometry_colexp_in_progress( GNode *dnode );
@@ -0,0 +1,799 @@
+/* glsl.c */
+
+/* Shader programs for the core-profile renderer */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "common.h"
+#include "glsl.h"
+
+#include <epoxy/gl.h>
+
+#include "ogl.h" /* OGL_PICK_ATTRIB */
+#include "xform.h"
+
+
+/* A core-profile context has no fixed-function pipeline, so the little
+ * of it that fsv relies on is done here instead: one positional light
+ * with color-tracked materials, distance-field text with alpha test,
+ * linear fog, stippled lines, and the edge-flagged wireframes of the
+ * outline pass. The drawing code keeps toggling that state through
+ * ogl_enable( ) and friends, and glsl_use( ) picks whichever program and
+ * uniform settings reproduce it for the next draw.
+ *
+ * Every program is put together from a vertex fetch source, which turns
+ * the vertex attributes into a Vertex (see vertex_prelude_src), and one
+ * of a few fixed kinds of vertex/geometry/fragment stages. A program set
+ * is one fetch source built into each kind of program */
+
+/* Kinds of program in a set */
+enum {
+	PROGRAM_SURFACE,	/* Plain drawing */
+	PROGRAM_STIPPLE,	/* Lines, with a stipple pattern */
+	PROGRAM_OUTLINE,	/* Triangles, as wireframe (GL_LINE mode) */
+	PROGRAM_CEL,		/* Triangles, with outlines shaded in */
+	PROGRAM_PICK,		/* Node/face IDs, for color picking */
+	NUM_PROGRAM_KINDS
+};
+
+/* Uniforms set by glsl_use( ) */
+enum {
+	UNIFORM_MODELVIEW,
+	UNIFORM_PROJECTION,
+	UNIFORM_NORMAL_MATRIX,
+	UNIFORM_LIGHTING,
+	UNIFORM_TEXTURING,
+	UNIFORM_ALPHA_TEST,
+	UNIFORM_FOG,
+	UNIFORM_FOG_RANGE,
+	UNIFORM_STIPPLE_FACTOR,
+	UNIFORM_STIPPLE_PATTERN,
+	UNIFORM_VIEWPORT_SIZE,
+	UNIFORM_CULL_BACK,
+	UNIFORM_TEXTURE_COLOR,
+	NUM_UNIFORMS
+};
+
+/* Fixed-function capabilities that are emulated (see glsl_cap( )) */
+enum {
+	CAP_LIGHTING,
+	CAP_LIGHT0,
+	CAP_TEXTURE_2D,
+	CAP_ALPHA_TEST,
+	CAP_LINE_STIPPLE,
+	CAP_FOG,
+	CAP_NORMALIZE,		/* (Normals are always normalized) */
+	CAP_COLOR_MATERIAL,	/* (Color always tracks material) */
+	NUM_CAPS
+};
+
+/* Varyings passed between all stages. Members are copied one by one in
+ * the geometry shaders, so keep copy_vertex( ) in step with this */
+#define VERTEX_DATA_BLOCK \
+	"VertexData {\n" \
+	"	flat vec4 color;\n" \
+	"	vec2 texcoord;\n" \
+	"	float fog_depth;\n" \
+	"	noperspective float line_pos;\n" \
+	"	flat float edge;\n" \
+	"	flat vec4 line_color;\n" \
+	"	noperspective vec3 edge_dist;\n" \
+	"	flat uvec2 pick_id;\n" \
+	"}"
+
+
+/* One linked program, and its uniform locations */
+typedef struct _GlslProgram GlslProgram;
+struct _GlslProgram {
+	GLuint	program;
+	GLint	uniforms[NUM_UNIFORMS];
+	/* Values last sent to each uniform (see uniform_changed( )), and
+	 * whether the normal matrix goes with the modelview sent */
+	boolean	sent[NUM_UNIFORMS];
+	GLfloat	values[NUM_UNIFORMS][16];
+	boolean	normal_matrix_sent;
+};
+
+struct _GlslProgramSet {
+	GlslProgram	programs[NUM_PROGRAM_KINDS];
+};
+
+
+static const char version_src[] = "#version 150\n";
+
+/* Prelude to the vertex fetch source. fetch_vertex( ) is to fill in all
+ * members of a Vertex, in object space */
+static const char vertex_prelude_src[] =
+	"uniform mat4 modelview;\n"
+	"uniform mat4 projection;\n"
+	"uniform mat3 normal_matrix;\n"
+	"uniform int lighting;\n"
+	"struct Vertex {\n"
+	"	vec4 position;\n"
+	"	vec3 normal;\n"
+	"	vec4 color;\n"
+	"	float edge;\n"
+	"	vec2 texcoord;\n"
+	"	uvec2 pick_id;\n"
+	"};\n";
+
+/* Vertex stage main( ). Lighting is done the way fixed-function GL does
+ * it with the state set up in ogl_init( ): a positional light at the
+ * eye (ambient 0.2, diffuse 0.5), on top of the default scene ambient of
+ * 0.2, with color tracking ambient and diffuse material. The lighting
+ * uniform is 0 if lighting is off, 1 if only the scene ambient applies
+ * (light 0 is disabled during the outline pass), and 2 otherwise.
+ * line_color is what the outline pass would give the vertex, for cel
+ * lines shaded in by PROGRAM_CEL; edge_dist is only set there */
+static const char vertex_main_src[] =
+	"out " VERTEX_DATA_BLOCK " vs_out;\n"
+	"void main( ) {\n"
+	"	Vertex v = fetch_vertex( );\n"
+	"	vec4 eye_pos = modelview * v.position;\n"
+	"	vec4 color = v.color;\n"
+	"	vs_out.line_color = color;\n"
+	"	if (lighting > 0) {\n"
+	"		vec3 lit = 0.2 * color.rgb;\n"
+	"		if (lighting > 1) {\n"
+	"			vec3 N = normalize( normal_matrix * v.normal );\n"
+	"			vec3 L = normalize( - eye_pos.xyz );\n"
+	"			lit += (0.2 + 0.5 * max( dot( N, L ), 0.0 )) * color.rgb;\n"
+	"		}\n"
+	"		color.rgb = lit;\n"
+	"		vs_out.line_color.rgb *= 0.2;\n"
+	"	}\n"
+	"	gl_Position = projection * eye_pos;\n"
+	"	vs_out.color = color;\n"
+	"	vs_out.texcoord = v.texcoord;\n"
+	"	vs_out.fog_depth = - eye_pos.z;\n"
+	"	vs_out.line_pos = 0.0;\n"
+	"	vs_out.edge = v.edge;\n"
+	"	vs_out.edge_dist = vec3( 1.0e6 );\n"
+	"	vs_out.pick_id = v.pick_id;\n"
+	"}\n";
+
+/* Common part of the geometry stages */
+static const char geometry_common_src[] =
+	"in " VERTEX_DATA_BLOCK " gs_in[];\n"
+	"out " VERTEX_DATA_BLOCK " gs_out;\n"
+	"void copy_vertex( int i ) {\n"
+	"	gs_out.color = gs_in[i].color;\n"
+	"	gs_out.texcoord = gs_in[i].texcoord;\n"
+	"	gs_out.fog_depth = gs_in[i].fog_depth;\n"
+	"	gs_out.line_pos = gs_in[i].line_pos;\n"
+	"	gs_out.edge = gs_in[i].edge;\n"
+	"	gs_out.line_color = gs_in[i].line_color;\n"
+	"	gs_out.edge_dist = gs_in[i].edge_dist;\n"
+	"	gs_out.pick_id = gs_in[i].pick_id;\n"
+	"}\n";
+
+/* Stippled lines: line_pos measures the distance along the line, in
+ * pixels, for the fragment stage to look up the pattern with */
+static const char stipple_layout_src[] =
+	"layout(lines) in;\n"
+	"layout(line_strip, max_vertices = 2) out;\n";
+static const char stipple_main_src[] =
+	"uniform vec2 viewport_size;\n"
+	"void main( ) {\n"
+	"	vec2 p0 = 0.5 * viewport_size * gl_in[0].gl_Position.xy / gl_in[0].gl_Position.w;\n"
+	"	vec2 p1 = 0.5 * viewport_size * gl_in[1].gl_Position.xy / gl_in[1].gl_Position.w;\n"
+	"	copy_vertex( 0 );\n"
+	"	gs_out.line_pos = 0.0;\n"
+	"	gl_Position = gl_in[0].gl_Position;\n"
+	"	EmitVertex( );\n"
+	"	copy_vertex( 1 );\n"
+	"	gs_out.line_pos = length( p1 - p0 );\n"
+	"	gl_Position = gl_in[1].gl_Position;\n"
+	"	EmitVertex( );\n"
+	"	EndPrimitive( );\n"
+	"}\n";
+
+/* Wireframe triangles. Each vertex's edge flag applies to the edge that
+ * starts there, and the provoking (last) vertex colors all of them, as
+ * with glPolygonMode( GL_LINE ) and flat shading */
+static const char outline_layout_src[] =
+	"layout(triangles) in;\n"
+	"layout(line_strip, max_vertices = 6) out;\n";
+static const char outline_main_src[] =
+	"uniform bool cull_back;\n"
+	"void main( ) {\n"
+	"	if (cull_back) {\n"
+	"		vec2 a = gl_in[0].gl_Position.xy / gl_in[0].gl_Position.w;\n"
+	"		vec2 b = gl_in[1].gl_Position.xy / gl_in[1].gl_Position.w;\n"
+	"		vec2 c = gl_in[2].gl_Position.xy / gl_in[2].gl_Position.w;\n"
+	"		if (((b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y)) <= 0.0)\n"
+	"			return;\n"
+	"	}\n"
+	"	for (int i = 0; i < 3; i++) {\n"
+	"		if (gs_in[i].edge < 0.5)\n"
+	"			continue;\n"
+	"		copy_vertex( 2 );\n"
+	"		gl_Position = gl_in[i].gl_Position;\n"
+	"		EmitVertex( );\n"
+	"		copy_vertex( 2 );\n"
+	"		gl_Position = gl_in[(i + 1) % 3].gl_Position;\n"
+	"		EmitVertex( );\n"
+	"		EndPrimitive( );\n"
+	"	}\n"
+	"}\n";
+
+/* Filled triangles with their edge-flagged edges shaded in as outlines,
+ * so that cel lines need no pass of their own. Each vertex gets its
+ * distance in pixels from each edge (zero for the two edges through it,
+ * the triangle's height for the opposite one), and the fragment stage
+ * draws in line_color where one of them is under about a pixel. Edges
+ * are left out of triangles under 4 pixels across, as the outline pass
+ * leaves out such subtrees (cf. OUTLINE_SIZE_THRESHOLD in geometry.c),
+ * and out of triangles reaching behind the eye, where the projection
+ * to pixels breaks down */
+static const char cel_layout_src[] =
+	"layout(triangles) in;\n"
+	"layout(triangle_strip, max_vertices = 3) out;\n";
+static const char cel_main_src[] =
+	"uniform vec2 viewport_size;\n"
+	"void main( ) {\n"
+	"	vec2 p[3];\n"
+	"	vec3 h;\n"
+	"	bool drawn = true;\n"
+	"	for (int i = 0; i < 3; i++) {\n"
+	"		drawn = drawn && (gl_in[i].gl_Position.w > 0.0);\n"
+	"		p[i] = 0.5 * viewport_size * gl_in[i].gl_Position.xy / gl_in[i].gl_Position.w;\n"
+	"	}\n"
+	"	vec2 size = max( max( p[0], p[1] ), p[2] ) - min( min( p[0], p[1] ), p[2] );\n"
+	"	drawn = drawn && (max( size.x, size.y ) >= 4.0);\n"
+	"	float area2 = abs( (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y) );\n"
+	"	for (int e = 0; e < 3; e++) {\n"
+	"		float len = length( p[(e + 1) % 3] - p[e] );\n"
+	"		h[e] = (drawn && (gs_in[e].edge > 0.5) && (len > 0.0)) ? area2 / len : -1.0;\n"
+	"	}\n"
+	"	for (int i = 0; i < 3; i++) {\n"
+	"		copy_vertex( i );\n"
+	"		for (int e = 0; e < 3; e++) {\n"
+	"			if (h[e] < 0.0)\n"
+	"				gs_out.edge_dist[e] = 1.0e6;\n"
+	"			else\n"
+	"				gs_out.edge_dist[e] = (i == (e + 2) % 3) ? h[e] : 0.0;\n"
+	"		}\n"
+	"		gl_Position = gl_in[i].gl_Position;\n"
+	"		EmitVertex( );\n"
+	"	}\n"
+	"	EndPrimitive( );\n"
+	"}\n";
+
+/* Fragment stage of the drawing programs. The text texture is a glyph
+ * distance field (see tmaptext.c), whose half-way crossing is smoothed
+ * over about a pixel on screen for coverage; the alpha test then only
+ * throws out the transparent fringe. Fog fades to black as in
+ * draw_fsv( ) in about.c. A color texture (see glsl_texture_color( ))
+ * is applied as is. Cel lines (see cel_main_src) come out a pixel wide
+ * where two faces meet, softened on the inside. Node/face IDs go to the
+ * second draw buffer, if there is one (see glsl_set_pick_output( )) */
+static const char fragment_draw_src[] =
+	"in " VERTEX_DATA_BLOCK " fs_in;\n"
+	"out vec4 frag_color;\n"
+	"out uvec2 frag_pick_id;\n"
+	"uniform sampler2D tex;\n"
+	"uniform bool texturing;\n"
+	"uniform bool texture_color;\n"
+	"uniform bool alpha_test;\n"
+	"uniform bool fog;\n"
+	"uniform vec2 fog_range;\n"
+	"uniform int stipple_factor;\n"
+	"uniform int stipple_pattern;\n"
+	"void main( ) {\n"
+	"	vec4 color = fs_in.color;\n"
+	"	float line_dist = min( min( fs_in.edge_dist.x, fs_in.edge_dist.y ), fs_in.edge_dist.z );\n"
+	"	if (line_dist < 1.0)\n"
+	"		color = mix( fs_in.line_color, color, smoothstep( 0.5, 1.0, line_dist ) );\n"
+	"	if (stipple_factor > 0) {\n"
+	"		int bit = int( fs_in.line_pos / float( stipple_factor ) ) & 15;\n"
+	"		if (((stipple_pattern >> bit) & 1) == 0)\n"
+	"			discard;\n"
+	"	}\n"
+	"	if (texturing && texture_color)\n"
+	"		color *= texture( tex, fs_in.texcoord );\n"
+	"	else if (texturing) {\n"
+	"		float dist = texture( tex, fs_in.texcoord ).r;\n"
+	"		float edge = max( 0.5 * fwidth( dist ), 1.0 / 255.0 );\n"
+	"		color.a *= smoothstep( 0.5 - edge, 0.5 + edge, dist );\n"
+	"	}\n"
+	"	if (alpha_test && (color.a < 0.0625))\n"
+	"		discard;\n"
+	"	if (fog)\n"
+	"		color.rgb *= clamp( (fog_range.y - fs_in.fog_depth) / (fog_range.y - fog_range.x), 0.0, 1.0 );\n"
+	"	frag_color = color;\n"
+	"	frag_pick_id = fs_in.pick_id;\n"
+	"}\n";
+
+/* Fragment stage of the pick programs (cf. ogl_color_pick( )) */
+static const char fragment_pick_src[] =
+	"in " VERTEX_DATA_BLOCK " fs_in;\n"
+	"out uvec2 frag_pick_id;\n"
+	"void main( ) {\n"
+	"	frag_pick_id = fs_in.pick_id;\n"
+	"}\n";
+
+/* Vertex fetch for the plain program set (vertex buffers) */
+static const char plain_fetch_src[] =
+	"in vec3 position;\n"
+	"in vec3 normal;\n"
+	"in vec4 color;\n"
+	"in float edge;\n"
+	"in vec2 texcoord;\n"
+	"in uvec2 pick_id;\n"
+	"Vertex fetch_vertex( ) {\n"
+	"	Vertex v;\n"
+	"	v.position = vec4( position, 1.0 );\n"
+	"	v.normal = normal;\n"
+	"	v.color = color;\n"
+	"	v.edge = edge;\n"
+	"	v.texcoord = texcoord;\n"
+	"	v.pick_id = pick_id;\n"
+	"	return v;\n"
+	"}\n";
+
+static const GlslAttrib plain_attribs[] = {
+	{ GLSL_ATTRIB_POSITION, "position" },
+	{ GLSL_ATTRIB_NORMAL, "normal" },
+	{ GLSL_ATTRIB_COLOR, "color" },
+	{ GLSL_ATTRIB_EDGE, "edge" },
+	{ GLSL_ATTRIB_TEXCOORD, "texcoord" },
+	{ OGL_PICK_ATTRIB, "pick_id" },
+	{ 0, NULL }
+};
+
+static const char *uniform_names[NUM_UNIFORMS] = {
+	"modelview",
+	"projection",
+	"normal_matrix",
+	"lighting",
+	"texturing",
+	"alpha_test",
+	"fog",
+	"fog_range",
+	"stipple_factor",
+	"stipple_pattern",
+	"viewport_size",
+	"cull_back",
+	"texture_color"
+};
+
+/* Capabilities, in CAP_* order */
+static const GLenum cap_names[NUM_CAPS] = {
+	GL_LIGHTING,
+	GL_LIGHT0,
+	GL_TEXTURE_2D,
+	GL_ALPHA_TEST,
+	GL_LINE_STIPPLE,
+	GL_FOG,
+	GL_NORMALIZE,
+	GL_COLOR_MATERIAL
+};
+
+
+/* Emulated fixed-function state */
+static boolean caps[NUM_CAPS];
+static GLenum polygon_mode = GL_FILL;
+static int stipple_factor = 1;
+static int stipple_pattern = 0xFFFF;
+static float fog_start = 0.0;
+static float fog_end = 1.0;
+
+/* TRUE while drawing for ogl_color_pick( ) */
+static boolean picking = FALSE;
+
+/* TRUE while node/face IDs are written alongside colors */
+static boolean pick_output = FALSE;
+
+/* TRUE if the bound texture holds colors rather than a distance field */
+static boolean texture_color = FALSE;
+
+/* TRUE if filled triangles get their outlines shaded in */
+static boolean cel_lines = FALSE;
+
+/* Program set for the vertex buffers (see vbuf.c) */
+static GlslProgramSet *plain_set = NULL;
+
+
+/* Compiles one shader stage from a NULL-terminated list of source
+ * strings. Returns 0 on error */
+static GLuint
+shader_compile( GLenum type, const char **srcs )
+{
+	GLuint shader;
+	GLint status;
+	int n;
+	char log[1024];
+
+	n = 0;
+	while (srcs[n] != NULL)
+		++n;
+
+	shader = glCreateShader( type );
+	glShaderSource( shader, n, srcs, NULL );
+	glCompileShader( shader );
+	glGetShaderiv( shader, GL_COMPILE_STATUS, &status );
+	if (!status) {
+		glGetShaderInfoLog( shader, sizeof(log), NULL, log );
+		g_warning( "shader compile failed: %s", log );
+		glDeleteShader( shader );
+		return 0;
+	}
+
+	return shader;
+}
+
+
+/* Builds one program of a set. geom_srcs may be NULL (no geometry stage).
+ * Returns FALSE on error */
+static boolean
+program_build( GlslProgram *prog, const char **vert_srcs, const char **geom_srcs, const char **frag_srcs, const GlslAttrib *attribs, boolean pick )
+{
+	GLuint shaders[3];
+	GLint status;
+	int num_shaders, i;
+	char log[1024];
+
+	num_shaders = 0;
+	shaders[num_shaders++] = shader_compile( GL_VERTEX_SHADER, vert_srcs );
+	if (geom_srcs != NULL)
+		shaders[num_shaders++] = shader_compile( GL_GEOMETRY_SHADER, geom_srcs );
+	shaders[num_shaders++] = shader_compile( GL_FRAGMENT_SHADER, frag_srcs );
+	for (i = 0; i < num_shaders; i++) {
+		if (shaders[i] == 0)
+			break;
+	}
+	if (i < num_shaders) {
+		for (i = 0; i < num_shaders; i++) {
+			if (shaders[i] != 0)
+				glDeleteShader( shaders[i] );
+		}
+		return FALSE;
+	}
+
+	prog->program = glCreateProgram( );
+	for (i = 0; i < num_shaders; i++)
+		glAttachShader( prog->program, shaders[i] );
+	for (i = 0; attribs[i].name != NULL; i++)
+		glBindAttribLocation( prog->program, attribs[i].location, attribs[i].name );
+	if (pick)
+		glBindFragDataLocation( prog->program, 0, "frag_pick_id" );
+	else {
+		glBindFragDataLocation( prog->program, 0, "frag_color" );
+		glBindFragDataLocation( prog->program, 1, "frag_pick_id" );
+	}
+	glLinkProgram( prog->program );
+	for (i = 0; i < num_shaders; i++)
+		glDeleteShader( shaders[i] );
+
+	glGetProgramiv( prog->program, GL_LINK_STATUS, &status );
+	if (!status) {
+		glGetProgramInfoLog( prog->program, sizeof(log), NULL, log );
+		g_warning( "shader link failed: %s", log );
+		glDeleteProgram( prog->program );
+		prog->program = 0;
+		return FALSE;
+	}
+
+	for (i = 0; i < NUM_UNIFORMS; i++)
+		prog->uniforms[i] = glGetUniformLocation( prog->program, uniform_names[i] );
+
+	return TRUE;
+}
+
+
+/* Builds a program set. fetch_src defines fetch_vertex( ) (see
+ * vertex_prelude_src), and attribs gives the locations of its inputs.
+ * Returns NULL if any of the programs could not be built */
+GlslProgramSet *
+glsl_program_set_new( const char *fetch_src, const GlslAttrib *attribs )
+{
+	GlslProgramSet *set;
+	const char *vert_srcs[] = { version_src, vertex_prelude_src, fetch_src, vertex_main_src, NULL };
+	const char *stipple_srcs[] = { version_src, stipple_layout_src, geometry_common_src, stipple_main_src, NULL };
+	const char *outline_srcs[] = { version_src, outline_layout_src, geometry_common_src, outline_main_src, NULL };
+	const char *cel_srcs[] = { version_src, cel_layout_src, geometry_common_src, cel_main_src, NULL };
+	const char *draw_srcs[] = { version_src, fragment_draw_src, NULL };
+	const char *pick_srcs[] = { version_src, fragment_pick_src, NULL };
+	boolean ok;
+	int i;
+
+	set = NEW(GlslProgramSet);
+	memset( set, 0, sizeof(GlslProgramSet) );
+
+	ok = program_build( &set->programs[PROGRAM_SURFACE], vert_srcs, NULL, draw_srcs, attribs, FALSE );
+	ok = ok && program_build( &set->programs[PROGRAM_STIPPLE], vert_srcs, stipple_srcs, draw_srcs, attribs, FALSE );
+	ok = ok && program_build( &set->programs[PROGRAM_OUTLINE], vert_srcs, outline_srcs, draw_srcs, attribs, FALSE );
+	ok = ok && program_build( &set->programs[PROGRAM_CEL], vert_srcs, cel_srcs, draw_srcs, attribs, FALSE );
+	ok = ok && program_build( &set->programs[PROGRAM_PICK], vert_srcs, NULL, pick_srcs, attribs, TRUE );
+	if (!ok) {
+		for (i = 0; i < NUM_PROGRAM_KINDS; i++) {
+			if (set->programs[i].program != 0)
+				glDeleteProgram( set->programs[i].program );
+		}
+		xfree( set );
+		return NULL;
+	}
+
+	return set;
+}
+
+
+/* Builds the plain program set. Returns FALSE if the shaders could not
+ * be built (the core-profile renderer is then unusable) */
+boolean
+glsl_init( void )
+{
+	if (plain_set == NULL)
+		plain_set = glsl_program_set_new( plain_fetch_src, plain_attribs );
+
+	return plain_set != NULL;
+}
+
+
+/* Enables or disables an emulated fixed-function capability (cf.
+ * glEnable( ), glDisable( )). Returns FALSE if cap is not one of them,
+ * i.e. it should be passed on to GL */
+boolean
+glsl_cap( unsigned int cap, boolean enabled )
+{
+	int i;
+
+	for (i = 0; i < NUM_CAPS; i++) {
+		if (cap_names[i] == cap) {
+			caps[i] = enabled;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+
+/* cf. glPolygonMode( GL_FRONT_AND_BACK, mode ) */
+void
+glsl_polygon_mode( unsigned int mode )
+{
+	polygon_mode = mode;
+}
+
+
+/* cf. glLineStipple( ) */
+void
+glsl_line_stipple( int factor, unsigned short pattern )
+{
+	stipple_factor = CLAMP(factor, 1, 256);
+	stipple_pattern = pattern;
+}
+
+
+/* Sets the range of linear fog (cf. GL_FOG_START, GL_FOG_END) */
+void
+glsl_fog_range( double start, double end )
+{
+	fog_start = start;
+	fog_end = end;
+}
+
+
+/* Switches to (or from) writing node/face IDs instead of colors */
+void
+glsl_set_picking( boolean pick )
+{
+	picking = pick;
+}
+
+
+/* Returns TRUE while drawing for color picking */
+boolean
+glsl_picking( void )
+{
+	return picking;
+}
+
+
+/* Switches the bound texture between a glyph distance field (the
+ * default) and an RGBA picture applied as is, as for impostors */
+void
+glsl_texture_color( boolean color )
+{
+	texture_color = color;
+}
+
+
+/* Switches the shading in of outlines ("cel lines") on filled, untextured
+ * triangles on or off. This stands in for drawing everything over again
+ * with glsl_polygon_mode( GL_LINE ) and light 0 off */
+void
+glsl_cel_lines( boolean on )
+{
+	cel_lines = on;
+}
+
+
+/* Switches the writing of node/face IDs to the second draw buffer on or
+ * off, for a render pass that fills in the pick buffer as it draws (see
+ * pick_ids_begin( ) in ogl.c). Writes are masked off while this is off,
+ * and while on, are let through for filled triangles only, which is
+ * what the pick pass would draw */
+void
+glsl_set_pick_output( boolean output )
+{
+	pick_output = output;
+	glColorMaski( 1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+}
+
+
+/* Returns TRUE if a uniform of a program doesn't hold the given n
+ * values yet, noting them down as sent. Uniforms are kept with the
+ * program, so only those that change need to be sent again */
+static boolean
+uniform_changed( GlslProgram *prog, int u, const GLfloat *v, int n )
+{
+	if (prog->sent[u] && !memcmp( prog->values[u], v, n * sizeof(GLfloat) ))
+		return FALSE;
+
+	memcpy( prog->values[u], v, n * sizeof(GLfloat) );
+	prog->sent[u] = TRUE;
+
+	return TRUE;
+}
+
+
+/* glUniform1i( ), if the value changed */
+static void
+uniform_int( GlslProgram *prog, int u, int value )
+{
+	GLfloat v = (GLfloat)value;
+
+	if (uniform_changed( prog, u, &v, 1 ))
+		glUniform1i( prog->uniforms[u], value );
+}
+
+
+/* glUniform2f( ), if the values changed */
+static void
+uniform_vec2( GlslProgram *prog, int u, GLfloat x, GLfloat y )
+{
+	GLfloat v[2];
+
+	v[0] = x;
+	v[1] = y;
+	if (uniform_changed( prog, u, v, 2 ))
+		glUniform2f( prog->uniforms[u], x, y );
+}
+
+
+/* Puts the program appropriate for the current state into use, for
+ * drawing primitives of type prim (GL_TRIANGLES or GL_LINES) under the
+ * given model transformation (the view and projection matrices are
+ * taken from xform.c). set may be NULL for the plain program set.
+ * Returns the program, so the caller can set any uniforms of its own */
+unsigned int
+glsl_use( GlslProgramSet *set, unsigned int prim, const double *model )
+{
+	GlslProgram *prog;
+	const double *projection;
+	XformMatrix modelview, inverse;
+	GLfloat mv[16], proj[16], normal_matrix[9];
+	GLint viewport[4];
+	int kind, lighting = 0;
+	int i, j;
+	boolean write_ids;
+
+	if (set == NULL)
+		set = plain_set;
+
+	if (picking)
+		kind = PROGRAM_PICK;
+	else if ((prim == GL_TRIANGLES) && (polygon_mode == GL_LINE))
+		kind = PROGRAM_OUTLINE;
+	else if ((prim == GL_TRIANGLES) && cel_lines && !caps[CAP_TEXTURE_2D])
+		kind = PROGRAM_CEL;
+	else if ((prim == GL_LINES) && caps[CAP_LINE_STIPPLE])
+		kind = PROGRAM_STIPPLE;
+	else
+		kind = PROGRAM_SURFACE;
+	prog = &set->programs[kind];
+	glUseProgram( prog->program );
+
+	if (pick_output) {
+		write_ids = ((kind == PROGRAM_SURFACE) || (kind == PROGRAM_CEL)) && (prim == GL_TRIANGLES);
+		glColorMaski( 1, write_ids, write_ids, write_ids, write_ids );
+	}
+
+	if (kind != PROGRAM_PICK) {
+		if (!caps[CAP_LIGHTING])
+			lighting = 0;
+		else if (!caps[CAP_LIGHT0])
+			lighting = 1;
+		else
+			lighting = 2;
+	}
+
+	/* Matrices */
+	xform_mult( modelview, xform_view( ), model );
+	projection = xform_projection( );
+	for (i = 0; i < 16; i++) {
+		mv[i] = (GLfloat)modelview[i];
+		proj[i] = (GLfloat)projection[i];
+	}
+	if (uniform_changed( prog, UNIFORM_MODELVIEW, mv, 16 )) {
+		glUniformMatrix4fv( prog->uniforms[UNIFORM_MODELVIEW], 1, GL_FALSE, mv );
+		prog->normal_matrix_sent = FALSE;
+	}
+	if (uniform_changed( prog, UNIFORM_PROJECTION, proj, 16 ))
+		glUniformMatrix4fv( prog->uniforms[UNIFORM_PROJECTION], 1, GL_FALSE, proj );
+
+	/* Normals go by the inverse transpose of the modelview, which is
+	 * only needed with the light on */
+	if ((lighting > 1) && !prog->normal_matrix_sent) {
+		if (!xform_invert( inverse, modelview ))
+			xform_copy( inverse, modelview );
+		for (i = 0; i < 3; i++) {
+			for (j = 0; j < 3; j++)
+				normal_matrix[3 * i + j] = (GLfloat)inverse[4 * j + i];
+		}
+		glUniformMatrix3fv( prog->uniforms[UNIFORM_NORMAL_MATRIX], 1, GL_FALSE, normal_matrix );
+		prog->normal_matrix_sent = TRUE;
+	}
+
+	if (kind == PROGRAM_PICK)
+		return prog->program;
+
+	uniform_int( prog, UNIFORM_LIGHTING, lighting );
+	uniform_int( prog, UNIFORM_TEXTURING, caps[CAP_TEXTURE_2D] );
+	uniform_int( prog, UNIFORM_TEXTURE_COLOR, texture_color );
+	uniform_int( prog, UNIFORM_ALPHA_TEST, caps[CAP_ALPHA_TEST] );
+	uniform_int( prog, UNIFORM_FOG, caps[CAP_FOG] );
+	uniform_vec2( prog, UNIFORM_FOG_RANGE, fog_start, fog_end );
+
+	switch (kind) {
+		case PROGRAM_SURFACE:
+		uniform_int( prog, UNIFORM_STIPPLE_FACTOR, 0 );
+		break;
+
+		case PROGRAM_STIPPLE:
+		glGetIntegerv( GL_VIEWPORT, viewport );
+		uniform_vec2( prog, UNIFORM_VIEWPORT_SIZE, (GLfloat)viewport[2], (GLfloat)viewport[3] );
+		uniform_int( prog, UNIFORM_STIPPLE_FACTOR, stipple_factor );
+		uniform_int( prog, UNIFORM_STIPPLE_PATTERN, stipple_pattern );
+		break;
+
+		case PROGRAM_OUTLINE:
+		uniform_int( prog, UNIFORM_STIPPLE_FACTOR, 0 );
+		uniform_int( prog, UNIFORM_CULL_BACK, glIsEnabled( GL_CULL_FACE ) );
+		break;
+
+		case PROGRAM_CEL:
+		glGetIntegerv( GL_VIEWPORT, viewport );
+		uniform_vec2( prog, UNIFORM_VIEWPORT_SIZE, (GLfloat)viewport[2], (GLfloat)viewport[3] );
+		uniform_int( prog, UNIFORM_STIPPLE_FACTOR, 0 );
+		break;
+
+		SWITCH_FAIL
+	}
+
+	return prog->program;
+}
+
+
+/* end glsl.c */
@@ -0,0 +1,67 @@
+/* glsl.h */
+
+/* Shader programs for the core-profile renderer */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifdef FSV_GLSL_H
+	#error
+#endif
+#define FSV_GLSL_H
+
+
+/* Vertex attribute locations of the plain program set (vertex buffers,
+ * cf. VBufVertex in vbuf.c). The pick ID goes in OGL_PICK_ATTRIB */
+#define GLSL_ATTRIB_POSITION	0
+#define GLSL_ATTRIB_NORMAL	1
+#define GLSL_ATTRIB_COLOR	2
+#define GLSL_ATTRIB_EDGE	3
+#define GLSL_ATTRIB_TEXCOORD	4
+
+
+/* Binding of a vertex shader input to an attribute location. Lists of
+ * these are terminated by an entry with a NULL name */
+typedef struct _GlslAttrib GlslAttrib;
+struct _GlslAttrib {
+	unsigned int	location;
+	const char	*name;
+};
+
+/* Programs sharing one way of fetching vertices (contents are private
+ * to glsl.c) */
+typedef struct _GlslProgramSet GlslProgramSet;
+
+
+boolean glsl_init( void );
+boolean glsl_cap( unsigned int cap, boolean enabled );
+void glsl_polygon_mode( unsigned int mode );
+void glsl_line_stipple( int factor, unsigned short pattern );
+void glsl_fog_range( double start, double end );
+void glsl_set_picking( boolean picking );
+boolean glsl_picking( void );
+void glsl_set_pick_output( boolean output );
+void glsl_texture_color( boolean color );
+void glsl_cel_lines( boolean on );
+GlslProgramSet *glsl_program_set_new( const char *fetch_src, const GlslAttrib *attribs );
+unsigned int glsl_use( GlslProgramSet *set, unsigned int prim, const double *model );
+
+
+/* end glsl.h */
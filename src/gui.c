@@ -509,41 +509,6 @@ gui_ctree_add( GtkWidget *parent_w )
 }
 
 
-/* Adds a new node to a tree view backed by a GtkTreeStore.
- * Returns a heap-allocated GtkTreeIter (caller stores in ctnode field).
- * icon_pair[0] = collapsed icon, icon_pair[1] = expanded icon.
- * The collapsed icon is displayed initially; expand/collapse callbacks
- * swap icons as needed. */
-GtkTreeIter *
-gui_ctree_node_add( GtkWidget *tree_w, GtkTreeIter *parent, Icon icon_pair[2], const char *text, boolean expanded, void *data )
-{
-	GtkTreeStore *store;
-	GtkTreeIter *iter;
-	GdkPixbuf *icon;
-
-	store = GTK_TREE_STORE(gtk_tree_view_get_model( GTK_TREE_VIEW(tree_w) ));
-	iter = g_new( GtkTreeIter, 1 );
-	gtk_tree_store_append( store, iter, parent );
-
-	/* Use collapsed or expanded icon based on initial state */
-	icon = expanded ? icon_pair[1].pixbuf : icon_pair[0].pixbuf;
-	gtk_tree_store_set( store, iter,
-		CTREE_COL_PIXBUF, icon,
-		CTREE_COL_NAME, text,
-		CTREE_COL_DATA, data,
-		-1 );
-
-	/* Expand the row if requested */
-	if (expanded) {
-		GtkTreePath *path = gtk_tree_model_get_path( GTK_TREE_MODEL(store), iter );
-		gtk_tree_view_expand_row( GTK_TREE_VIEW(tree_w), path, FALSE );
-		gtk_tree_path_free( path );
-	}
-
-	return iter;
-}
-
-
 /* Changes the mouse cursor associated with the given widget.
  * A name of NULL indicates the default cursor.
  * Uses CSS cursor names: "wait", "move", "ns-resize", "not-allowed", etc.
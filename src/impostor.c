@@ -0,0 +1,211 @@
+/* impostor.c */
+
+/* Impostors */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "common.h"
+#include "impostor.h"
+
+#include <epoxy/gl.h>
+
+#include "glsl.h"
+#include "memstat.h"
+#include "ogl.h"
+#include "vbuf.h"
+
+
+/* An impostor is taken by drawing into its texture (framed by whatever
+ * projection the caller sets up), and then stands in for what was drawn
+ * as a quad wearing that texture. The background is left transparent,
+ * and cut away with the alpha test. What the quad should look like from
+ * where, and when the picture is too old to use, is up to the caller
+ * (see "Impostors" in geometry.c) */
+
+/* Framebuffer that pictures are taken in, and its depth buffer (which
+ * grows to suit the largest picture so far) */
+static GLuint capture_fbo = 0;
+static GLuint capture_depth_rb = 0;
+static int capture_depth_width = 0;
+static int capture_depth_height = 0;
+
+/* Framebuffer and viewport to go back to after a capture */
+static GLint prev_fbo;
+static GLint prev_viewport[4];
+
+/* Whether pictures can be taken at all (-1 if not checked yet) */
+static int capture_supported = -1;
+
+
+/* Returns TRUE if pictures can be taken with the current GL context.
+ * That takes framebuffer objects and glClearBuffer*( ), i.e. GL 3.0,
+ * which a compatibility context need not provide */
+boolean
+impostor_available( void )
+{
+	if (capture_supported < 0)
+		capture_supported = epoxy_gl_version( ) >= 30;
+
+	return capture_supported;
+}
+
+
+/* Creates a new (empty) impostor */
+Impostor *
+impostor_new( void )
+{
+	Impostor *imp;
+
+	imp = NEW(Impostor);
+	memset( imp, 0, sizeof(Impostor) );
+	imp->slot = -1;
+
+	memstat_add( MEMSTAT_IMPOSTOR, 1, sizeof(Impostor) );
+
+	return imp;
+}
+
+
+/* Directs drawing into an impostor's texture, resized as necessary and
+ * cleared to transparent. The caller is to set up a projection framing
+ * the geometry to be drawn */
+void
+impostor_capture_begin( Impostor *imp, int width, int height )
+{
+	static const GLfloat clear_color[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+	glGetIntegerv( GL_DRAW_FRAMEBUFFER_BINDING, &prev_fbo );
+	glGetIntegerv( GL_VIEWPORT, prev_viewport );
+
+	if ((imp->texture == 0) || (imp->width != width) || (imp->height != height)) {
+		if (imp->texture == 0)
+			glGenTextures( 1, &imp->texture );
+		else
+			memstat_add( MEMSTAT_IMPOSTOR, 0, - 4 * (int64)imp->width * imp->height );
+		glBindTexture( GL_TEXTURE_2D, imp->texture );
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+		/* Pictures are taken at about the size they are shown at,
+		 * and filtering would only darken the cut-away edges */
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		glBindTexture( GL_TEXTURE_2D, 0 );
+		imp->width = width;
+		imp->height = height;
+		memstat_add( MEMSTAT_IMPOSTOR, 0, 4 * (int64)width * height );
+	}
+
+	if (capture_fbo == 0) {
+		glGenFramebuffers( 1, &capture_fbo );
+		glGenRenderbuffers( 1, &capture_depth_rb );
+	}
+	if ((width > capture_depth_width) || (height > capture_depth_height)) {
+		capture_depth_width = MAX(capture_depth_width, width);
+		capture_depth_height = MAX(capture_depth_height, height);
+		glBindRenderbuffer( GL_RENDERBUFFER, capture_depth_rb );
+		glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, capture_depth_width, capture_depth_height );
+		glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+	}
+
+	glBindFramebuffer( GL_FRAMEBUFFER, capture_fbo );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_TEXTURE_2D, imp->texture, 0 );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+		GL_RENDERBUFFER, capture_depth_rb );
+	glViewport( 0, 0, width, height );
+
+	glClearBufferfv( GL_COLOR, 0, clear_color );
+	glClear( GL_DEPTH_BUFFER_BIT );
+}
+
+
+/* Ends drawing into an impostor's texture, going back to the previous
+ * framebuffer and viewport */
+void
+impostor_capture_end( G_GNUC_UNUSED Impostor *imp )
+{
+	glBindFramebuffer( GL_FRAMEBUFFER, (GLuint)prev_fbo );
+	glViewport( prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3] );
+}
+
+
+/* Call before drawing impostors */
+void
+impostor_draw_pre( void )
+{
+	ogl_disable( GL_LIGHTING );
+	ogl_enable( GL_ALPHA_TEST );
+	ogl_enable( GL_TEXTURE_2D );
+	if (ogl_core_profile( ))
+		glsl_texture_color( TRUE );
+	vbuf_color3f( 1.0, 1.0, 1.0 );
+}
+
+
+/* Draws an impostor's quad */
+void
+impostor_draw( const Impostor *imp )
+{
+	static const double texcoords[4][2] = {
+		{ 0.0, 0.0 }, { 1.0, 0.0 }, { 1.0, 1.0 }, { 0.0, 1.0 }
+	};
+	int i;
+
+	glBindTexture( GL_TEXTURE_2D, imp->texture );
+	vbuf_begin( GL_QUADS );
+	for (i = 0; i < 4; i++) {
+		vbuf_texcoord2d( texcoords[i][0], texcoords[i][1] );
+		vbuf_vertex3d( imp->corners[i][0], imp->corners[i][1], imp->corners[i][2] );
+	}
+	vbuf_end( );
+}
+
+
+/* Call after drawing impostors */
+void
+impostor_draw_post( void )
+{
+	if (ogl_core_profile( ))
+		glsl_texture_color( FALSE );
+	ogl_disable( GL_TEXTURE_2D );
+	ogl_disable( GL_ALPHA_TEST );
+	ogl_enable( GL_LIGHTING );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+}
+
+
+/* Destroys an impostor */
+void
+impostor_free( Impostor *imp )
+{
+	if (imp->texture != 0) {
+		ogl_make_current( );
+		glDeleteTextures( 1, &imp->texture );
+		memstat_add( MEMSTAT_IMPOSTOR, 0, - 4 * (int64)imp->width * imp->height );
+	}
+	memstat_add( MEMSTAT_IMPOSTOR, -1, - (int64)sizeof(Impostor) );
+
+	xfree( imp );
+}
+
+
+/* end impostor.c */
@@ -0,0 +1,56 @@
+/* impostor.h */
+
+/* Impostors */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifdef FSV_IMPOSTOR_H
+	#error
+#endif
+#define FSV_IMPOSTOR_H
+
+
+/* A picture of some geometry, drawn in its place as a single textured
+ * quad. The fields past the texture are for the caller to fill in */
+typedef struct _Impostor Impostor;
+struct _Impostor {
+	unsigned int	texture;	/* Texture object (RGBA, 0 if none) */
+	int		width, height;	/* Texture size */
+	float		corners[4][3];	/* Quad, counterclockwise from lower left */
+	double		eye[3];		/* Camera position the picture was taken from */
+	double		pixels;		/* Size on screen it was taken at */
+	unsigned int	generation;	/* Scene state it was taken in */
+	unsigned int	frame;		/* Frame it was last drawn in */
+	int		slot;		/* Caller's bookkeeping */
+};
+
+
+boolean impostor_available( void );
+Impostor *impostor_new( void );
+void impostor_capture_begin( Impostor *imp, int width, int height );
+void impostor_capture_end( Impostor *imp );
+void impostor_draw_pre( void );
+void impostor_draw( const Impostor *imp );
+void impostor_draw_post( void );
+void impostor_free( Impostor *imp );
+
+
+/* end impostor.h */
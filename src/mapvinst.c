@@ -0,0 +1,618 @@
+/* mapvinst.c */
+
+/* Instanced drawing of MapV node boxes */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "common.h"
+#include "mapvinst.h"
+
+#include <epoxy/gl.h>
+
+#include "glsl.h"
+#include "memstat.h"
+#include "ogl.h" /* ogl_core_profile( ), ogl_count_draws( ) */
+#include "xform.h"
+
+
+/* Every MapV node is a box of the same shape: a bottom rectangle, and a
+ * top face inset by an amount that depends on the node type. So all of
+ * them can be drawn as instances of a single unit box mesh, placed by a
+ * vertex shader using a handful of per-instance attributes (see
+ * MapVInstance). The instance buffer holds one record per node, in the
+ * order the layout is walked: the children of a directory, followed by
+ * the subtrees of its subdirectories. Any part of the tree that is drawn
+ * in full is then one contiguous stretch of the buffer, and an entire
+ * view usually comes down to a few instanced draw calls.
+ *
+ * The legacy renderer uses the two programs below; the core-profile one
+ * builds the same box placement into a program set (see glsl.c) */
+
+/* Vertex attribute locations */
+#define ATTRIB_CORNER		0	/* Mesh: x/y selectors, top flag, face */
+#define ATTRIB_RECT		1	/* Instance: c0, c1 */
+#define ATTRIB_Z_RANGE		2	/* Instance: z0, height */
+#define ATTRIB_COLOR_TYPE	3	/* Instance: color, node type */
+#define ATTRIB_NODE_ID		4	/* Instance: node ID */
+#define ATTRIB_EDGE		5	/* Mesh: edge flag (core profile) */
+
+/* Capacity of the slant ratio table in the shaders */
+#define SLANT_RATIOS_MAX	16
+
+/* Staged instance data is uploaded whenever it grows past this size
+ * (in instances), or as soon as it stops being contiguous */
+#define STAGE_FLUSH_INSTANCES	(1 << 16)
+
+/* Number of vertices in the unit box mesh (four sides and the top,
+ * two triangles each; the bottom is never seen) */
+#define BOX_MESH_VERTICES	30
+
+
+/* Vertex format of the unit box mesh */
+typedef struct _BoxVertex BoxVertex;
+struct _BoxVertex {
+	GLfloat		corner[4];	/* x/y selectors, top flag, face */
+	GLboolean	edge;		/* Edge flag (for the outline pass) */
+	GLubyte		pad[3];
+};
+
+/* Contiguous runs of instances queued for drawing */
+typedef struct _InstRuns InstRuns;
+struct _InstRuns {
+	int	*firsts;
+	int	*counts;
+	int	num;
+	int	alloc;
+};
+
+/* Instance data waiting to be uploaded */
+typedef struct _InstStage InstStage;
+struct _InstStage {
+	MapVInstance	*insts;
+	int		first;		/* Destination in the instance buffer */
+	int		num;
+	int		alloc;
+};
+
+
+/* Shader source shared by all programs: places a vertex of the unit box
+ * mesh according to the instance attributes. This follows the geometry
+ * of mapv_gldraw_node( ) in geometry.c */
+static const char box_vertex_common_src[] =
+	"uniform float slant_ratios[16];\n"
+	"in vec4 corner;\n"
+	"in vec4 rect;\n"
+	"in vec2 z_range;\n"
+	"in uvec4 color_type;\n"
+	"vec4 box_vertex( out vec3 normal ) {\n"
+	"	vec2 dims = rect.zw - rect.xy;\n"
+	"	float height = z_range.y;\n"
+	"	vec2 offset = min( vec2( height ), slant_ratios[int( color_type.a )] * dims );\n"
+	"	vec2 len = max( sqrt( offset * offset + height * height ), vec2( 1.0e-6 ) );\n"
+	"	vec2 n = height / len;\n"
+	"	vec2 n_z = offset / len;\n"
+	"	int face = int( corner.w );\n"
+	"	if (face == 0)\n"
+	"		normal = vec3( 0.0, n.y, n_z.y );\n"
+	"	else if (face == 1)\n"
+	"		normal = vec3( n.x, 0.0, n_z.x );\n"
+	"	else if (face == 2)\n"
+	"		normal = vec3( 0.0, - n.y, n_z.y );\n"
+	"	else if (face == 3)\n"
+	"		normal = vec3( - n.x, 0.0, n_z.x );\n"
+	"	else\n"
+	"		normal = vec3( 0.0, 0.0, 1.0 );\n"
+	"	vec2 xy = mix( rect.xy, rect.zw, corner.xy ) + corner.z * offset * (1.0 - 2.0 * corner.xy);\n"
+	"	return vec4( xy, z_range.x + corner.z * height, 1.0 );\n"
+	"}\n";
+
+/* Drawing program. Lighting is done the way fixed-function GL would do
+ * it with the state set up in ogl_init( ) (one positional light, color
+ * tracking ambient and diffuse). The lighting uniform is 0 if lighting
+ * is off, 1 if only the ambient term applies (light 0 is disabled during
+ * the outline pass), and 2 otherwise */
+static const char draw_vertex_shader_src[] =
+	"uniform int lighting;\n"
+	"flat out vec4 v_color;\n"
+	"void main( ) {\n"
+	"	vec3 normal;\n"
+	"	vec4 eye_pos = gl_ModelViewMatrix * box_vertex( normal );\n"
+	"	vec3 color = vec3( color_type.rgb ) / 255.0;\n"
+	"	gl_Position = gl_ProjectionMatrix * eye_pos;\n"
+	"	if (lighting > 0) {\n"
+	"		vec3 lit = gl_LightModel.ambient.rgb * color;\n"
+	"		if (lighting > 1) {\n"
+	"			vec3 N = normalize( gl_NormalMatrix * normal );\n"
+	"			vec3 L = normalize( gl_LightSource[0].position.xyz - gl_LightSource[0].position.w * eye_pos.xyz );\n"
+	"			lit += gl_LightSource[0].ambient.rgb * color;\n"
+	"			lit += max( dot( N, L ), 0.0 ) * gl_LightSource[0].diffuse.rgb * color;\n"
+	"		}\n"
+	"		color = lit;\n"
+	"	}\n"
+	"	v_color = vec4( color, 1.0 );\n"
+	"}\n";
+static const char draw_fragment_shader_src[] =
+	"#version 130\n"
+	"flat in vec4 v_color;\n"
+	"void main( ) {\n"
+	"	gl_FragColor = v_color;\n"
+	"}\n";
+
+/* Pick program (cf. the pick shaders in ogl.c). Top face has ID of 1 */
+static const char pick_vertex_shader_src[] =
+	"in uint node_id;\n"
+	"flat out uvec2 v_pick_id;\n"
+	"void main( ) {\n"
+	"	vec3 normal;\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * box_vertex( normal );\n"
+	"	v_pick_id = uvec2( node_id, (corner.w > 3.5) ? 1u : 0u );\n"
+	"}\n";
+static const char pick_fragment_shader_src[] =
+	"#version 130\n"
+	"flat in uvec2 v_pick_id;\n"
+	"out uvec2 frag_pick_id;\n"
+	"void main( ) {\n"
+	"	frag_pick_id = v_pick_id;\n"
+	"}\n";
+
+/* Vertex fetch for the core-profile program set (follows
+ * box_vertex_common_src) */
+static const char box_fetch_src[] =
+	"in float edge;\n"
+	"in uint node_id;\n"
+	"Vertex fetch_vertex( ) {\n"
+	"	Vertex v;\n"
+	"	v.position = box_vertex( v.normal );\n"
+	"	v.color = vec4( vec3( color_type.rgb ) / 255.0, 1.0 );\n"
+	"	v.edge = edge;\n"
+	"	v.texcoord = vec2( 0.0 );\n"
+	"	v.pick_id = uvec2( node_id, (corner.w > 3.5) ? 1u : 0u );\n"
+	"	return v;\n"
+	"}\n";
+
+static const GlslAttrib box_attribs[] = {
+	{ ATTRIB_CORNER, "corner" },
+	{ ATTRIB_RECT, "rect" },
+	{ ATTRIB_Z_RANGE, "z_range" },
+	{ ATTRIB_COLOR_TYPE, "color_type" },
+	{ ATTRIB_NODE_ID, "node_id" },
+	{ ATTRIB_EDGE, "edge" },
+	{ 0, NULL }
+};
+
+
+/* Set once the GL context has been checked for instancing support */
+static boolean inst_checked = FALSE;
+static boolean inst_supported = FALSE;
+
+/* Shader programs, and their uniform locations (legacy renderer) */
+static GLuint draw_program = 0;
+static GLuint pick_program = 0;
+static GLint draw_slant_ratios_loc;
+static GLint draw_lighting_loc;
+static GLint pick_slant_ratios_loc;
+
+/* Shader programs (core-profile renderer) */
+static GlslProgramSet *box_program_set = NULL;
+
+/* Vertex array object, unit box mesh, and instance buffer */
+static GLuint box_vao = 0;
+static GLuint box_mesh_buffer = 0;
+static GLuint inst_buffer = 0;
+static int inst_capacity = 0;
+
+/* Side face slant ratios, by node type */
+static float slant_ratios[SLANT_RATIOS_MAX];
+
+static InstRuns inst_runs;
+static InstStage inst_stage;
+
+
+/* Compiles one shader stage. The source is taken as prelude + src
+ * (prelude may be NULL, in which case src has its own #version line).
+ * Returns 0 on error */
+static GLuint
+shader_compile( GLenum type, const char *prelude, const char *src )
+{
+	const char *srcs[3];
+	GLuint shader;
+	GLint status;
+	char log[1024];
+
+	if (prelude != NULL) {
+		srcs[0] = "#version 130\n";
+		srcs[1] = prelude;
+		srcs[2] = src;
+	}
+	else
+		srcs[0] = src;
+
+	shader = glCreateShader( type );
+	glShaderSource( shader, (prelude != NULL) ? 3 : 1, srcs, NULL );
+	glCompileShader( shader );
+	glGetShaderiv( shader, GL_COMPILE_STATUS, &status );
+	if (!status) {
+		glGetShaderInfoLog( shader, sizeof(log), NULL, log );
+		g_warning( "instanced box shader compile failed: %s", log );
+		glDeleteShader( shader );
+		return 0;
+	}
+
+	return shader;
+}
+
+
+/* Builds one of the box programs. Returns 0 on error */
+static GLuint
+program_build( const char *vert_src, const char *frag_src, boolean picking )
+{
+	GLuint program, vert, frag;
+	GLint status;
+	char log[1024];
+
+	vert = shader_compile( GL_VERTEX_SHADER, box_vertex_common_src, vert_src );
+	frag = shader_compile( GL_FRAGMENT_SHADER, NULL, frag_src );
+	if ((vert == 0) || (frag == 0)) {
+		if (vert != 0)
+			glDeleteShader( vert );
+		if (frag != 0)
+			glDeleteShader( frag );
+		return 0;
+	}
+
+	program = glCreateProgram( );
+	glAttachShader( program, vert );
+	glAttachShader( program, frag );
+	glBindAttribLocation( program, ATTRIB_CORNER, "corner" );
+	glBindAttribLocation( program, ATTRIB_RECT, "rect" );
+	glBindAttribLocation( program, ATTRIB_Z_RANGE, "z_range" );
+	glBindAttribLocation( program, ATTRIB_COLOR_TYPE, "color_type" );
+	if (picking) {
+		glBindAttribLocation( program, ATTRIB_NODE_ID, "node_id" );
+		glBindFragDataLocation( program, 0, "frag_pick_id" );
+	}
+	glLinkProgram( program );
+	glDeleteShader( vert );
+	glDeleteShader( frag );
+
+	glGetProgramiv( program, GL_LINK_STATUS, &status );
+	if (!status) {
+		glGetProgramInfoLog( program, sizeof(log), NULL, log );
+		g_warning( "instanced box shader link failed: %s", log );
+		glDeleteProgram( program );
+		return 0;
+	}
+
+	return program;
+}
+
+
+/* Emits the two triangles of a quad into the mesh. The corners are given
+ * as x/y selectors and top flag, in counterclockwise order. The edge
+ * flags leave out the diagonal (cf. prim_assemble( ) in vbuf.c) */
+static BoxVertex *
+box_mesh_quad( BoxVertex *v, const float quad[4][3], int face )
+{
+	static const int order[6] = { 0, 1, 2, 0, 2, 3 };
+	static const boolean edges[6] = { TRUE, TRUE, FALSE, FALSE, TRUE, TRUE };
+	int i, c;
+
+	for (i = 0; i < 6; i++) {
+		for (c = 0; c < 3; c++)
+			v->corner[c] = quad[order[i]][c];
+		v->corner[3] = (GLfloat)face;
+		v->edge = edges[i] ? GL_TRUE : GL_FALSE;
+		++v;
+	}
+
+	return v;
+}
+
+
+/* Sets up the unit box mesh, and the vertex array object that ties it
+ * together with the instance buffer */
+static void
+box_mesh_init( void )
+{
+	/* Bottom edge of each side face (rear, right, front, left) */
+	static const float side_edges[4][2][2] = {
+		{ { 0.0, 1.0 }, { 1.0, 1.0 } },
+		{ { 1.0, 1.0 }, { 1.0, 0.0 } },
+		{ { 1.0, 0.0 }, { 0.0, 0.0 } },
+		{ { 0.0, 0.0 }, { 0.0, 1.0 } }
+	};
+	static const float top_face[4][3] = {
+		{ 0.0, 0.0, 1.0 },
+		{ 1.0, 0.0, 1.0 },
+		{ 1.0, 1.0, 1.0 },
+		{ 0.0, 1.0, 1.0 }
+	};
+	BoxVertex mesh[BOX_MESH_VERTICES];
+	BoxVertex *v = mesh;
+	float quad[4][3];
+	int f;
+
+	memset( mesh, 0, sizeof(mesh) );
+	for (f = 0; f < 4; f++) {
+		quad[0][0] = side_edges[f][0][0];
+		quad[0][1] = side_edges[f][0][1];
+		quad[0][2] = 0.0;
+		quad[1][0] = side_edges[f][0][0];
+		quad[1][1] = side_edges[f][0][1];
+		quad[1][2] = 1.0;
+		quad[2][0] = side_edges[f][1][0];
+		quad[2][1] = side_edges[f][1][1];
+		quad[2][2] = 1.0;
+		quad[3][0] = side_edges[f][1][0];
+		quad[3][1] = side_edges[f][1][1];
+		quad[3][2] = 0.0;
+		v = box_mesh_quad( v, (const float (*)[3])quad, f );
+	}
+	v = box_mesh_quad( v, top_face, 4 );
+	g_assert( v == &mesh[BOX_MESH_VERTICES] );
+
+	glGenVertexArrays( 1, &box_vao );
+	glBindVertexArray( box_vao );
+
+	glGenBuffers( 1, &box_mesh_buffer );
+	glBindBuffer( GL_ARRAY_BUFFER, box_mesh_buffer );
+	glBufferData( GL_ARRAY_BUFFER, sizeof(mesh), mesh, GL_STATIC_DRAW );
+	glVertexAttribPointer( ATTRIB_CORNER, 4, GL_FLOAT, GL_FALSE, sizeof(BoxVertex), (void *)G_STRUCT_OFFSET(BoxVertex, corner) );
+	glEnableVertexAttribArray( ATTRIB_CORNER );
+	if (ogl_core_profile( )) {
+		glVertexAttribPointer( ATTRIB_EDGE, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(BoxVertex), (void *)G_STRUCT_OFFSET(BoxVertex, edge) );
+		glEnableVertexAttribArray( ATTRIB_EDGE );
+	}
+	else {
+		glEdgeFlagPointer( sizeof(BoxVertex), (void *)G_STRUCT_OFFSET(BoxVertex, edge) );
+		glEnableClientState( GL_EDGE_FLAG_ARRAY );
+	}
+
+	/* Instance attributes (pointers are set per draw) */
+	glEnableVertexAttribArray( ATTRIB_RECT );
+	glEnableVertexAttribArray( ATTRIB_Z_RANGE );
+	glEnableVertexAttribArray( ATTRIB_COLOR_TYPE );
+	glEnableVertexAttribArray( ATTRIB_NODE_ID );
+	glVertexAttribDivisor( ATTRIB_RECT, 1 );
+	glVertexAttribDivisor( ATTRIB_Z_RANGE, 1 );
+	glVertexAttribDivisor( ATTRIB_COLOR_TYPE, 1 );
+	glVertexAttribDivisor( ATTRIB_NODE_ID, 1 );
+
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	memstat_add( MEMSTAT_VBUF, 1, sizeof(mesh) );
+}
+
+
+/* Returns TRUE if instanced drawing can be used with the current GL
+ * context. Otherwise, the caller should stick to vertex buffers */
+boolean
+mapvinst_available( void )
+{
+	int gl_version;
+
+	if (inst_checked)
+		return inst_supported;
+	inst_checked = TRUE;
+
+	gl_version = epoxy_gl_version( );
+	if ((gl_version < 33) && !((gl_version >= 31) && epoxy_has_gl_extension( "GL_ARB_instanced_arrays" )))
+		return FALSE;
+
+	if (ogl_core_profile( )) {
+		char *fetch_src;
+
+		fetch_src = g_strconcat( box_vertex_common_src, box_fetch_src, NULL );
+		box_program_set = glsl_program_set_new( fetch_src, box_attribs );
+		g_free( fetch_src );
+		if (box_program_set == NULL)
+			return FALSE;
+
+		box_mesh_init( );
+		inst_supported = TRUE;
+
+		return TRUE;
+	}
+
+	draw_program = program_build( draw_vertex_shader_src, draw_fragment_shader_src, FALSE );
+	pick_program = program_build( pick_vertex_shader_src, pick_fragment_shader_src, TRUE );
+	if ((draw_program == 0) || (pick_program == 0)) {
+		if (draw_program != 0)
+			glDeleteProgram( draw_program );
+		if (pick_program != 0)
+			glDeleteProgram( pick_program );
+		draw_program = 0;
+		pick_program = 0;
+		return FALSE;
+	}
+	draw_slant_ratios_loc = glGetUniformLocation( draw_program, "slant_ratios" );
+	draw_lighting_loc = glGetUniformLocation( draw_program, "lighting" );
+	pick_slant_ratios_loc = glGetUniformLocation( pick_program, "slant_ratios" );
+
+	box_mesh_init( );
+	inst_supported = TRUE;
+
+	return TRUE;
+}
+
+
+/* (Re)creates the instance buffer, with room for the given number of
+ * nodes. All previous instance data is discarded. ratios gives the side
+ * face slant ratio for each node type */
+void
+mapvinst_reset( int num_instances, const float *ratios )
+{
+	g_assert( inst_supported );
+	g_assert( NUM_NODE_TYPES <= SLANT_RATIOS_MAX );
+
+	memset( slant_ratios, 0, sizeof(slant_ratios) );
+	memcpy( slant_ratios, ratios, NUM_NODE_TYPES * sizeof(float) );
+
+	if (inst_buffer == 0)
+		glGenBuffers( 1, &inst_buffer );
+	else
+		memstat_add( MEMSTAT_VBUF, -1, - (int64)inst_capacity * sizeof(MapVInstance) );
+	inst_capacity = MAX(1, num_instances);
+	glBindBuffer( GL_ARRAY_BUFFER, inst_buffer );
+	glBufferData( GL_ARRAY_BUFFER, (GLsizeiptr)inst_capacity * sizeof(MapVInstance), NULL, GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	memstat_add( MEMSTAT_VBUF, 1, (int64)inst_capacity * sizeof(MapVInstance) );
+
+	inst_stage.num = 0;
+	inst_runs.num = 0;
+}
+
+
+/* Uploads staged instance data */
+static void
+stage_upload( void )
+{
+	if (inst_stage.num == 0)
+		return;
+
+	glBindBuffer( GL_ARRAY_BUFFER, inst_buffer );
+	glBufferSubData( GL_ARRAY_BUFFER, (GLintptr)inst_stage.first * sizeof(MapVInstance), (GLsizeiptr)inst_stage.num * sizeof(MapVInstance), inst_stage.insts );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	inst_stage.num = 0;
+}
+
+
+/* Returns space for count instance records, to be filled in by the
+ * caller and written to the instance buffer at position first. The
+ * upload happens later, so that neighboring updates go out together */
+MapVInstance *
+mapvinst_stage( int first, int count )
+{
+	MapVInstance *insts;
+
+	g_assert( (first >= 0) && ((first + count) <= inst_capacity) );
+
+	if (inst_stage.num > 0) {
+		if ((first != (inst_stage.first + inst_stage.num)) || (inst_stage.num >= STAGE_FLUSH_INSTANCES))
+			stage_upload( );
+	}
+	if (inst_stage.num == 0)
+		inst_stage.first = first;
+	if ((inst_stage.num + count) > inst_stage.alloc) {
+		inst_stage.alloc = MAX(inst_stage.num + count, 2 * inst_stage.alloc);
+		RESIZE(inst_stage.insts, inst_stage.alloc, MapVInstance);
+	}
+
+	insts = &inst_stage.insts[inst_stage.num];
+	inst_stage.num += count;
+
+	return insts;
+}
+
+
+/* Queues count instances, starting at position first, to be drawn at
+ * the next mapvinst_flush( ) */
+void
+mapvinst_queue( int first, int count )
+{
+	InstRuns *runs = &inst_runs;
+
+	if (count <= 0)
+		return;
+
+	if (runs->num > 0) {
+		if (first == (runs->firsts[runs->num - 1] + runs->counts[runs->num - 1])) {
+			/* Extends the previous run */
+			runs->counts[runs->num - 1] += count;
+			return;
+		}
+	}
+
+	if (runs->num == runs->alloc) {
+		runs->alloc = MAX(64, 2 * runs->alloc);
+		RESIZE(runs->firsts, runs->alloc, int);
+		RESIZE(runs->counts, runs->alloc, int);
+	}
+	runs->firsts[runs->num] = first;
+	runs->counts[runs->num] = count;
+	++runs->num;
+}
+
+
+/* Points the instance attributes at the given position in the buffer */
+static void
+instance_pointers( int first )
+{
+	GLintptr base = (GLintptr)first * sizeof(MapVInstance);
+
+	glVertexAttribPointer( ATTRIB_RECT, 4, GL_FLOAT, GL_FALSE, sizeof(MapVInstance), (void *)(base + G_STRUCT_OFFSET(MapVInstance, c0)) );
+	glVertexAttribPointer( ATTRIB_Z_RANGE, 2, GL_FLOAT, GL_FALSE, sizeof(MapVInstance), (void *)(base + G_STRUCT_OFFSET(MapVInstance, z0)) );
+	glVertexAttribIPointer( ATTRIB_COLOR_TYPE, 4, GL_UNSIGNED_BYTE, sizeof(MapVInstance), (void *)(base + G_STRUCT_OFFSET(MapVInstance, color)) );
+	glVertexAttribIPointer( ATTRIB_NODE_ID, 1, GL_UNSIGNED_INT, sizeof(MapVInstance), (void *)(base + G_STRUCT_OFFSET(MapVInstance, node_id)) );
+}
+
+
+/* Draws everything queued since the last flush. Instances are placed in
+ * world space, under the current modelview matrix. In picking mode, node
+ * and face IDs are written out instead of colors (see ogl_color_pick( )) */
+void
+mapvinst_flush( boolean picking )
+{
+	GLuint program;
+	GLint prev_program;
+	int lighting, i;
+
+	stage_upload( );
+	if (inst_runs.num == 0)
+		return;
+
+	glGetIntegerv( GL_CURRENT_PROGRAM, &prev_program );
+	if (ogl_core_profile( )) {
+		program = glsl_use( box_program_set, GL_TRIANGLES, xform_current( ) );
+		glUniform1fv( glGetUniformLocation( program, "slant_ratios" ), SLANT_RATIOS_MAX, slant_ratios );
+	}
+	else if (picking) {
+		glUseProgram( pick_program );
+		glUniform1fv( pick_slant_ratios_loc, SLANT_RATIOS_MAX, slant_ratios );
+	}
+	else {
+		if (!glIsEnabled( GL_LIGHTING ))
+			lighting = 0;
+		else if (!glIsEnabled( GL_LIGHT0 ))
+			lighting = 1;
+		else
+			lighting = 2;
+		glUseProgram( draw_program );
+		glUniform1fv( draw_slant_ratios_loc, SLANT_RATIOS_MAX, slant_ratios );
+		glUniform1i( draw_lighting_loc, lighting );
+	}
+
+	glBindVertexArray( box_vao );
+	glBindBuffer( GL_ARRAY_BUFFER, inst_buffer );
+	for (i = 0; i < inst_runs.num; i++) {
+		instance_pointers( inst_runs.firsts[i] );
+		glDrawArraysInstanced( GL_TRIANGLES, 0, BOX_MESH_VERTICES, inst_runs.counts[i] );
+		ogl_count_draws( 1, (int64)(BOX_MESH_VERTICES / 3) * inst_runs.counts[i] );
+	}
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glBindVertexArray( 0 );
+	glUseProgram( (GLuint)prev_program );
+
+	inst_runs.num = 0;
+}
+
+
+/* end mapvinst.c */
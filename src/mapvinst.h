@@ -0,0 +1,52 @@
+/* mapvinst.h */
+
+/* Instanced drawing of MapV node boxes */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifdef FSV_MAPVINST_H
+	#error
+#endif
+#define FSV_MAPVINST_H
+
+
+/* Per-instance attributes of one node box, as stored in the instance
+ * buffer (everything the vertex shader needs to place and light it) */
+typedef struct _MapVInstance MapVInstance;
+struct _MapVInstance {
+	float		c0[2];		/* Left/front corner of bottom face */
+	float		c1[2];		/* Right/rear corner of bottom face */
+	float		z0;		/* Height of bottom face (world space) */
+	float		height;		/* Height of box */
+	unsigned char	color[3];	/* Node color */
+	unsigned char	type;		/* Node type (selects side slant) */
+	unsigned int	node_id;	/* Node ID (for picking) */
+};
+
+
+boolean mapvinst_available( void );
+void mapvinst_reset( int num_instances, const float *ratios );
+MapVInstance *mapvinst_stage( int first, int count );
+void mapvinst_queue( int first, int count );
+void mapvinst_flush( boolean picking );
+
+
+/* end mapvinst.h */
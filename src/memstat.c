@@ -0,0 +1,154 @@
+/* memstat.c */
+
+/* Memory accounting */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+#include "common.h"
+#include "memstat.h"
+
+
+/* Running totals for one kind of memory consumer */
+struct MemStat {
+	int64	count;	/* Number of objects */
+	int64	bytes;	/* Memory used by them (bytes) */
+};
+
+/* Counters are plain integers, cheap enough to be kept up in all builds
+ * (unlike the allocator wrappers in debug/debug.c). Worker threads may
+ * adjust them too, hence the lock */
+static struct MemStat memstats[NUM_MEMSTATS];
+static GMutex memstats_mutex;
+
+/* Display names for the counters */
+static const char *memstat_names[NUM_MEMSTATS] = {
+	__("Node descriptors"),
+	__("Tree links (GNode)"),
+	__("Node names"),
+	__("Directory tree rows"),
+	__("File list rows"),
+	__("Display lists"),
+	__("Vertex buffers"),
+	__("Morph records"),
+	__("Search results"),
+	__("Bounding volumes"),
+	__("Impostors")
+};
+
+
+/* Adjusts a counter. count and bytes may be negative, to account for
+ * objects being freed */
+void
+memstat_add( MemStatType type, int64 count, int64 bytes )
+{
+	g_mutex_lock( &memstats_mutex );
+	memstats[type].count += count;
+	memstats[type].bytes += bytes;
+	g_mutex_unlock( &memstats_mutex );
+}
+
+
+/* Zeroes a counter (e.g. when all objects of a type are freed at once) */
+void
+memstat_clear( MemStatType type )
+{
+	g_mutex_lock( &memstats_mutex );
+	memstats[type].count = 0;
+	memstats[type].bytes = 0;
+	g_mutex_unlock( &memstats_mutex );
+}
+
+
+/* Returns the number of live objects of a type */
+int64
+memstat_count( MemStatType type )
+{
+	int64 count;
+
+	g_mutex_lock( &memstats_mutex );
+	count = memstats[type].count;
+	g_mutex_unlock( &memstats_mutex );
+
+	return count;
+}
+
+
+/* Returns the memory used by objects of a type, in bytes. Memory held
+ * by the GL driver (e.g. display lists) is not known, and reads as 0 */
+int64
+memstat_bytes( MemStatType type )
+{
+	int64 bytes;
+
+	g_mutex_lock( &memstats_mutex );
+	bytes = memstats[type].bytes;
+	g_mutex_unlock( &memstats_mutex );
+
+	return bytes;
+}
+
+
+/* Returns a newly allocated, human-readable table of all the counters
+ * (free with xfree( )) */
+char *
+memstat_report( void )
+{
+	int64 total_bytes = 0;
+	int i;
+	int64 count, bytes;
+	char *report;
+	char strbuf[256];
+	char count_str[64];
+
+	report = xstrdup( "" );
+	for (i = 0; i < NUM_MEMSTATS; i++) {
+		count = memstat_count( (MemStatType)i );
+		bytes = memstat_bytes( (MemStatType)i );
+		strcpy( count_str, i64toa( count ) );
+		if (bytes > 0)
+			snprintf( strbuf, sizeof(strbuf), "%-22s %15s  %12s\n", _(memstat_names[i]), count_str, abbrev_size( bytes ) );
+		else
+			snprintf( strbuf, sizeof(strbuf), "%-22s %15s  %12s\n", _(memstat_names[i]), count_str, "-" );
+		STRRECAT(report, strbuf);
+		total_bytes += bytes;
+	}
+	snprintf( strbuf, sizeof(strbuf), "%-22s %15s  %12s\n", _("Total"), "", abbrev_size( total_bytes ) );
+	STRRECAT(report, strbuf);
+
+	return report;
+}
+
+
+/* Writes the counter table to the given stream */
+void
+memstat_dump( FILE *stream )
+{
+	char *report;
+
+	report = memstat_report( );
+	fputs( report, stream );
+	fflush( stream );
+	xfree( report );
+}
+
+
+/* end memstat.c */
@@ -0,0 +1,57 @@
+/* memstat.h */
+
+/* Memory accounting */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+
+#ifdef FSV_MEMSTAT_H
+	#error
+#endif
+#define FSV_MEMSTAT_H
+
+
+/* Memory consumers that are tracked */
+typedef enum {
+	MEMSTAT_NODE_DESC,	/* NodeDesc/DirNodeDesc records */
+	MEMSTAT_GNODE,		/* GNode links of the filesystem tree */
+	MEMSTAT_NAMES,		/* Node name strings */
+	MEMSTAT_DIRTREE,	/* Directory tree rows */
+	MEMSTAT_FILELIST,	/* File list rows */
+	MEMSTAT_DLIST,		/* OpenGL display lists */
+	MEMSTAT_VBUF,		/* Shared vertex buffers, and recordings awaiting upload */
+	MEMSTAT_MORPH,		/* Morph records */
+	MEMSTAT_SEARCH,		/* Search result list */
+	MEMSTAT_BVH,		/* Bounding volume hierarchies */
+	MEMSTAT_IMPOSTOR,	/* Impostors and their textures */
+	NUM_MEMSTATS
+} MemStatType;
+
+
+void memstat_add( MemStatType type, int64 count, int64 bytes );
+void memstat_clear( MemStatType type );
+int64 memstat_count( MemStatType type );
+int64 memstat_bytes( MemStatType type );
+char *memstat_report( void );
+void memstat_dump( FILE *stream );
+
+
+/* end memstat.h */
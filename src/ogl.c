@@ -27,17 +27,41 @@
 
 #include <gtk/gtk.h>
 #include <epoxy/gl.h>
+#ifdef HAVE_EPOXY_EGL
+	#include <epoxy/egl.h>
+#endif
 
-#include "animation.h" /* redraw( ) */
+#include "animation.h" /* redraw( ), animation_high_detail( ) */
 #include "camera.h"
+#include "frametime.h"
 #include "geometry.h"
+#include "glsl.h"
+#include "memstat.h"
 #include "tmaptext.h" /* text_init( ) */
+#include "xform.h"
 
 
 /* Main viewport OpenGL area widget */
 static GtkWidget *viewport_gl_area_w = NULL;
 
-/* Private FBO for color picking (keeps pick renders off the display FBO) */
+#ifdef HAVE_EPOXY_EGL
+/* Offscreen rendering, in place of the widget (see ogl_offscreen_init( )):
+ * EGL display and context, and the framebuffer drawn into */
+static EGLDisplay offscreen_display = EGL_NO_DISPLAY;
+static EGLContext offscreen_context = EGL_NO_CONTEXT;
+#endif
+static GLuint offscreen_fbo = 0;
+static GLuint offscreen_rbs[2] = { 0, 0 };
+static int offscreen_width = 0;
+static int offscreen_height = 0;
+
+/* TRUE if the context is core profile, and drawing goes through the
+ * shaders in glsl.c. Otherwise, it is a legacy (compatibility) context,
+ * and fixed-function state is set directly */
+static boolean core_profile = FALSE;
+
+/* Private FBO for color picking (keeps pick renders off the display FBO).
+ * The color attachment is RG32UI: node ID in R, face ID in G */
 static GLuint pick_fbo = 0;
 static GLuint pick_color_rb = 0;
 static GLuint pick_depth_rb = 0;
@@ -45,6 +69,189 @@ static int pick_fb_width = 0;
 static int pick_fb_height = 0;
 static boolean pick_fbo_valid = FALSE;
 
+/* Pixels the pick FBO was last drawn over: x0, y0, x1, y1 (GL window
+ * coordinates, exclusive of x1/y1). Pick renders are confined to a
+ * square this wide around the pick location */
+#define PICK_REGION_SIZE 64
+static int pick_region[4];
+
+/* Asynchronous pick readback (see ogl_color_pick_async( )): pixel
+ * buffer object receiving the pick pixel, fence set after the read,
+ * function to pass the result on to, and the frame clock tick callback
+ * polling the fence. pick_async_supported is -1 until checked */
+static GLuint pick_pbo = 0;
+static GLsync pick_fence = NULL;
+static OglPickFunc pick_async_func = NULL;
+static guint pick_tick_id = 0;
+static int pick_async_supported = -1;
+
+/* TRUE while the main render pass is writing node/face IDs into the
+ * pick FBO's color renderbuffer (see pick_ids_begin( )), and set if that
+ * turned out not to work with GtkGLArea's framebuffer */
+static boolean pick_ids_active = FALSE;
+static boolean pick_ids_failed = FALSE;
+
+/* Set if something was drawn this frame without IDs to match (see
+ * ogl_pick_ids_partial( )) */
+static boolean pick_ids_partial = FALSE;
+
+/* Shader program that routes the per-node pick attribute through to the
+ * integer color attachment (fixed-function output can't reach it) */
+static GLuint pick_program = 0;
+static boolean pick_program_failed = FALSE;
+
+/* Draw calls made and triangles drawn in the current frame (see
+ * ogl_count_draws( )) */
+static int frame_draw_calls = 0;
+static int64 frame_triangles = 0;
+
+/* Pick shaders (legacy renderer). Vertex transformation is still the
+ * fixed-function matrices, so the rest of the drawing code is left
+ * untouched. The core-profile renderer has its own (see glsl.c) */
+static const char pick_vertex_shader_src[] =
+	"#version 130\n"
+	"in uvec2 pick_id;\n"
+	"flat out uvec2 v_pick_id;\n"
+	"void main( ) {\n"
+	"	gl_Position = ftransform( );\n"
+	"	v_pick_id = pick_id;\n"
+	"}\n";
+static const char pick_fragment_shader_src[] =
+	"#version 130\n"
+	"flat in uvec2 v_pick_id;\n"
+	"out uvec2 frag_pick_id;\n"
+	"void main( ) {\n"
+	"	frag_pick_id = v_pick_id;\n"
+	"}\n";
+
+
+/* Returns TRUE if the core-profile renderer is in use */
+boolean
+ogl_core_profile( void )
+{
+	return core_profile;
+}
+
+
+/* cf. glEnable( ). Fixed-function capabilities are emulated when
+ * there is no fixed-function pipeline */
+void
+ogl_enable( unsigned int cap )
+{
+	if (!core_profile || !glsl_cap( cap, TRUE ))
+		glEnable( cap );
+}
+
+
+/* cf. glDisable( ) */
+void
+ogl_disable( unsigned int cap )
+{
+	if (!core_profile || !glsl_cap( cap, FALSE ))
+		glDisable( cap );
+}
+
+
+/* cf. glPolygonMode( GL_FRONT_AND_BACK, mode ). Wireframes have to
+ * respect edge flags, which core profile doesn't have */
+void
+ogl_polygon_mode( unsigned int mode )
+{
+	if (core_profile)
+		glsl_polygon_mode( mode );
+	else
+		glPolygonMode( GL_FRONT_AND_BACK, mode );
+}
+
+
+/* Switches the shading in of outlines ("cel lines") on filled triangles
+ * on or off, so that they need no pass of their own. Returns FALSE if
+ * this can't be done (without shaders), and a separate pass is needed */
+boolean
+ogl_cel_lines( boolean on )
+{
+	if (!core_profile)
+		return FALSE;
+
+	glsl_cel_lines( on );
+
+	return TRUE;
+}
+
+
+/* cf. glLineStipple( ) */
+void
+ogl_line_stipple( int factor, unsigned short pattern )
+{
+	if (core_profile)
+		glsl_line_stipple( factor, pattern );
+	else
+		glLineStipple( factor, pattern );
+}
+
+
+/* Sets up linear fog over the given range of eye distances (GL_FOG
+ * still needs to be enabled) */
+void
+ogl_fog_linear( double start, double end )
+{
+	if (core_profile)
+		glsl_fog_range( start, end );
+	else {
+		glFogi( GL_FOG_MODE, GL_LINEAR );
+		glFogf( GL_FOG_START, start );
+		glFogf( GL_FOG_END, end );
+	}
+}
+
+
+/* Starts (re)compiling the display list *dlist if rebuild is TRUE or if
+ * it doesn't exist yet, and returns TRUE; the caller then draws the
+ * contents, followed by ogl_list_end( ). Otherwise, the list is called,
+ * and FALSE is returned. Core profile has no display lists, so there
+ * the caller always draws directly */
+boolean
+ogl_list_begin( unsigned int *dlist, boolean rebuild )
+{
+	if (core_profile)
+		return TRUE;
+
+	if (!rebuild && (*dlist != NULL_DLIST)) {
+		glCallList( *dlist );
+		return FALSE;
+	}
+
+	if (*dlist == NULL_DLIST) {
+		*dlist = glGenLists( 1 );
+		memstat_add( MEMSTAT_DLIST, 1, 0 );
+	}
+	glNewList( *dlist, GL_COMPILE_AND_EXECUTE );
+
+	return TRUE;
+}
+
+
+/* Finishes a display list started by ogl_list_begin( ) */
+void
+ogl_list_end( void )
+{
+	if (!core_profile)
+		glEndList( );
+}
+
+
+/* Deletes a display list, if it exists */
+void
+ogl_list_free( unsigned int *dlist )
+{
+	if (*dlist == NULL_DLIST)
+		return;
+
+	glDeleteLists( *dlist, 1 );
+	memstat_add( MEMSTAT_DLIST, -1, 0 );
+	*dlist = NULL_DLIST;
+}
+
 
 /* Ensures the GL context is current (public interface) */
 void
@@ -76,32 +283,35 @@ ogl_init( void )
 	/* Set viewport size */
 	ogl_resize( );
 
-	/* Create the initial modelview matrix
-	 * (right-handed coordinate system, +z = straight up,
-	 * camera at origin looking in -x direction) */
-	glMatrixMode( GL_MODELVIEW );
-	glLoadIdentity( );
-	glRotated( -90.0, 1.0, 0.0, 0.0 );
-	glRotated( -90.0, 0.0, 0.0, 1.0 );
-	glPushMatrix( ); /* Matrix will stay just below top of MVM stack */
-
-	/* Set up lighting */
-	glEnable( GL_LIGHTING );
-	glEnable( GL_LIGHT0 );
-	glLightfv( GL_LIGHT0, GL_AMBIENT, light_ambient );
-	glLightfv( GL_LIGHT0, GL_DIFFUSE, light_diffuse );
-	glLightfv( GL_LIGHT0, GL_SPECULAR, light_specular );
-	glLightfv( GL_LIGHT0, GL_POSITION, light_position );
-
-	/* Set up materials */
-	glColorMaterial( GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE );
-	glEnable( GL_COLOR_MATERIAL );
+	if (core_profile) {
+		/* Lighting, materials and the like are built into the
+		 * shaders (keep them in step with the legacy setup below) */
+		if (!glsl_init( ))
+			quit( _("Could not set up OpenGL shaders. Try running fsv with --legacy") );
+	}
+	else {
+		/* Set up lighting (light position is in eye coordinates) */
+		glMatrixMode( GL_MODELVIEW );
+		glLoadIdentity( );
+		glLightfv( GL_LIGHT0, GL_AMBIENT, light_ambient );
+		glLightfv( GL_LIGHT0, GL_DIFFUSE, light_diffuse );
+		glLightfv( GL_LIGHT0, GL_SPECULAR, light_specular );
+		glLightfv( GL_LIGHT0, GL_POSITION, light_position );
+
+		/* Set up materials */
+		glColorMaterial( GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE );
+
+		/* Text glyph edges (see text_pre( )) */
+		glAlphaFunc( GL_GEQUAL, 0.5 );
+		glShadeModel( GL_FLAT );
+	}
+	ogl_enable( GL_LIGHTING );
+	ogl_enable( GL_LIGHT0 );
+	ogl_enable( GL_COLOR_MATERIAL );
 
 	/* Miscellaneous */
-	glAlphaFunc( GL_GEQUAL, 0.0625 );
 	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 	glEnable( GL_CULL_FACE );
-	glShadeModel( GL_FLAT );
 	glEnable( GL_DEPTH_TEST );
 	glDepthFunc( GL_LEQUAL );
 	glEnable( GL_POLYGON_OFFSET_FILL );
@@ -120,6 +330,11 @@ ogl_resize( void )
 	GtkAllocation allocation;
 	int width, height;
 
+	if (viewport_gl_area_w == NULL) {
+		glViewport( 0, 0, offscreen_width, offscreen_height );
+		return;
+	}
+
 	gtk_widget_get_allocation( viewport_gl_area_w, &allocation );
 	width = allocation.width;
 	height = allocation.height;
@@ -149,78 +364,101 @@ ogl_aspect_ratio( void )
 }
 
 
-/* Sets up the projection matrix. full_reset should be TRUE unless the
- * current matrix is to be multiplied in */
+/* Sets up the projection matrix */
 static void
-setup_projection_matrix( boolean full_reset )
+setup_projection_matrix( void )
 {
+	XformMatrix m;
 	double dx, dy;
 
 	dx = camera->near_clip * tan( 0.5 * RAD(camera->fov) );
 	dy = dx / ogl_aspect_ratio( );
-	glMatrixMode( GL_PROJECTION );
-	if (full_reset)
-		glLoadIdentity( );
-	glFrustum( - dx, dx, - dy, dy, camera->near_clip, camera->far_clip );
+	xform_matrix_frustum( m, - dx, dx, - dy, dy, camera->near_clip, camera->far_clip );
+	xform_set_projection( m );
 }
 
 
-/* Sets up the modelview matrix */
+/* Sets up the camera's view matrix */
 static void
 setup_modelview_matrix( void )
 {
-	glMatrixMode( GL_MODELVIEW );
-	/* Remember, base matrix lives just below top of stack */
-	glPopMatrix( );
-	glPushMatrix( );
+	XformMatrix m;
+
+	/* Base matrix (right-handed coordinate system, +z = straight up,
+	 * camera at origin looking in -x direction) */
+	xform_identity( m );
+	xform_matrix_rotate( m, -90.0, 1.0, 0.0, 0.0 );
+	xform_matrix_rotate( m, -90.0, 0.0, 0.0, 1.0 );
 
 	switch (globals.fsv_mode) {
 		case FSV_SPLASH:
 		break;
 
 		case FSV_DISCV:
-		glTranslated( - camera->distance, 0.0, 0.0 );
-		glRotated( 90.0, 0.0, 1.0, 0.0 );
-		glRotated( 90.0, 0.0, 0.0, 1.0 );
-		glTranslated( - DISCV_CAMERA(camera)->target.x, - DISCV_CAMERA(camera)->target.y, 0.0 );
+		xform_matrix_translate( m, - camera->distance, 0.0, 0.0 );
+		xform_matrix_rotate( m, 90.0, 0.0, 1.0, 0.0 );
+		xform_matrix_rotate( m, 90.0, 0.0, 0.0, 1.0 );
+		xform_matrix_translate( m, - DISCV_CAMERA(camera)->target.x, - DISCV_CAMERA(camera)->target.y, 0.0 );
 		break;
 
 		case FSV_MAPV:
-		glTranslated( - camera->distance, 0.0, 0.0 );
-		glRotated( camera->phi, 0.0, 1.0, 0.0 );
-		glRotated( - camera->theta, 0.0, 0.0, 1.0 );
-		glTranslated( - MAPV_CAMERA(camera)->target.x, - MAPV_CAMERA(camera)->target.y, - MAPV_CAMERA(camera)->target.z );
+		xform_matrix_translate( m, - camera->distance, 0.0, 0.0 );
+		xform_matrix_rotate( m, camera->phi, 0.0, 1.0, 0.0 );
+		xform_matrix_rotate( m, - camera->theta, 0.0, 0.0, 1.0 );
+		xform_matrix_translate( m, - MAPV_CAMERA(camera)->target.x, - MAPV_CAMERA(camera)->target.y, - MAPV_CAMERA(camera)->target.z );
 		break;
 
 		case FSV_TREEV:
-		glTranslated( - camera->distance, 0.0, 0.0 );
-		glRotated( camera->phi, 0.0, 1.0, 0.0 );
-		glRotated( - camera->theta, 0.0, 0.0, 1.0 );
-		glTranslated( TREEV_CAMERA(camera)->target.r, 0.0, - TREEV_CAMERA(camera)->target.z );
-		glRotated( 180.0 - TREEV_CAMERA(camera)->target.theta, 0.0, 0.0, 1.0 );
+		xform_matrix_translate( m, - camera->distance, 0.0, 0.0 );
+		xform_matrix_rotate( m, camera->phi, 0.0, 1.0, 0.0 );
+		xform_matrix_rotate( m, - camera->theta, 0.0, 0.0, 1.0 );
+		xform_matrix_translate( m, TREEV_CAMERA(camera)->target.r, 0.0, - TREEV_CAMERA(camera)->target.z );
+		xform_matrix_rotate( m, 180.0 - TREEV_CAMERA(camera)->target.theta, 0.0, 0.0, 1.0 );
 		break;
 
 		SWITCH_FAIL
 	}
+
+	xform_set_view( m );
 }
 
 
+static void pick_ids_begin( void );
+static void pick_ids_end( void );
+
 /* (Re)draws the viewport
  * NOTE: Don't call this directly! Use redraw( ) */
 void
 ogl_draw( void )
 {
 	static FsvMode prev_mode = FSV_NONE;
+	double t0;
+	boolean high_detail;
 #ifdef DEBUG
 	int err;
 #endif
 
+	/* Detail is reduced while frames can't keep up with motion */
+	high_detail = animation_high_detail( );
+	t0 = xgettime( );
+
+	frame_draw_calls = 0;
+	frame_triangles = 0;
+	frametime_frame_begin( );
+
 	geometry_highlight_node( NULL, TRUE );
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	pick_ids_begin( );
 
-	setup_projection_matrix( TRUE );
+	setup_projection_matrix( );
 	setup_modelview_matrix( );
-	geometry_draw( TRUE );
+	geometry_draw( high_detail );
+	pick_ids_end( );
+	animation_frame_drawn( high_detail, xgettime( ) - t0 );
+
+	/* The timing overlay goes on top, and is not itself timed */
+	frametime_frame_end( );
+	frametime_draw_overlay( );
 
 #ifdef DEBUG
 	/* Error check (causes GPU pipeline sync -- debug only) */
@@ -239,6 +477,97 @@ ogl_draw( void )
 }
 
 
+/* Adds to the number of draw calls made, and triangles drawn, in the
+ * current frame */
+void
+ogl_count_draws( int draw_calls, int64 triangles )
+{
+	frame_draw_calls += draw_calls;
+	frame_triangles += triangles;
+}
+
+
+/* Gets the number of draw calls made, and triangles drawn, in the last
+ * frame drawn */
+void
+ogl_frame_counts( int *draw_calls, int64 *triangles )
+{
+	*draw_calls = frame_draw_calls;
+	*triangles = frame_triangles;
+}
+
+
+/* Compiles one stage of the pick shader program. Returns 0 on error */
+static GLuint
+pick_shader_compile( GLenum type, const char *src )
+{
+	GLuint shader;
+	GLint status;
+	char log[1024];
+
+	shader = glCreateShader( type );
+	glShaderSource( shader, 1, &src, NULL );
+	glCompileShader( shader );
+	glGetShaderiv( shader, GL_COMPILE_STATUS, &status );
+	if (!status) {
+		glGetShaderInfoLog( shader, sizeof(log), NULL, log );
+		g_warning( "pick shader compile failed: %s", log );
+		glDeleteShader( shader );
+		return 0;
+	}
+
+	return shader;
+}
+
+
+/* Ensures the pick shader program exists. Returns FALSE if it could not
+ * be built (picking is then disabled) */
+static boolean
+pick_program_ensure( void )
+{
+	GLuint vert, frag;
+	GLint status;
+	char log[1024];
+
+	if (pick_program != 0)
+		return TRUE;
+	if (pick_program_failed)
+		return FALSE;
+
+	vert = pick_shader_compile( GL_VERTEX_SHADER, pick_vertex_shader_src );
+	frag = pick_shader_compile( GL_FRAGMENT_SHADER, pick_fragment_shader_src );
+	if ((vert == 0) || (frag == 0)) {
+		if (vert != 0)
+			glDeleteShader( vert );
+		if (frag != 0)
+			glDeleteShader( frag );
+		pick_program_failed = TRUE;
+		return FALSE;
+	}
+
+	pick_program = glCreateProgram( );
+	glAttachShader( pick_program, vert );
+	glAttachShader( pick_program, frag );
+	glBindAttribLocation( pick_program, OGL_PICK_ATTRIB, "pick_id" );
+	glBindFragDataLocation( pick_program, 0, "frag_pick_id" );
+	glLinkProgram( pick_program );
+	glDeleteShader( vert );
+	glDeleteShader( frag );
+
+	glGetProgramiv( pick_program, GL_LINK_STATUS, &status );
+	if (!status) {
+		glGetProgramInfoLog( pick_program, sizeof(log), NULL, log );
+		g_warning( "pick shader link failed: %s", log );
+		glDeleteProgram( pick_program );
+		pick_program = 0;
+		pick_program_failed = TRUE;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
 /* Ensures the pick FBO exists and matches the viewport size */
 static void
 pick_fbo_ensure( int width, int height )
@@ -253,7 +582,7 @@ pick_fbo_ensure( int width, int height )
 	}
 
 	glBindRenderbuffer( GL_RENDERBUFFER, pick_color_rb );
-	glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_RG32UI, width, height );
 	glBindRenderbuffer( GL_RENDERBUFFER, pick_depth_rb );
 	glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height );
 	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
@@ -271,76 +600,337 @@ pick_fbo_ensure( int width, int height )
 }
 
 
-/* Color-buffer picking: renders the scene with node IDs encoded as colors,
- * then reads the pixel at (x,y) to determine which node is there.
- * Uses a private FBO so the display framebuffer is never disturbed.
- * The pick FBO is cached -- re-rendered only when invalidated by camera
- * or scene changes (via ogl_pick_invalidate).
- * Returns the node ID (0 = no hit). face_id is set from the alpha channel. */
+/* Sets up the main render pass to fill in the pick FBO as it draws, so
+ * that picking needs no pass of its own. The pick FBO's color
+ * renderbuffer is attached to GtkGLArea's framebuffer as a second draw
+ * buffer, to which the drawing programs write node/face IDs while the
+ * geometry code has them switched on (see ogl_pick_ids( )). The depth
+ * test is shared with the colors, so the IDs are those of exactly what
+ * ends up on screen. Core-profile renderer only: fixed-function
+ * drawing has no way to write integer colors */
+static void
+pick_ids_begin( void )
+{
+	static const GLuint clear_value[4] = { 0, 0, 0, 0 };
+	static const GLenum draw_buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	GLint viewport[4];
+	GLint area_fbo;
+
+	if (!core_profile || pick_ids_failed)
+		return;
+
+	glGetIntegerv( GL_DRAW_FRAMEBUFFER_BINDING, &area_fbo );
+	if (area_fbo == 0)
+		return;
+	glGetIntegerv( GL_VIEWPORT, viewport );
+	pick_fbo_ensure( viewport[2], viewport[3] );
+
+	glBindFramebuffer( GL_FRAMEBUFFER, (GLuint)area_fbo );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+		GL_RENDERBUFFER, pick_color_rb );
+	if (glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE) {
+		g_warning( "cannot render node IDs alongside colors; picking will take a separate pass" );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+			GL_RENDERBUFFER, 0 );
+		pick_ids_failed = TRUE;
+		return;
+	}
+	glDrawBuffers( 2, draw_buffers );
+
+	/* Clear to zero (node ID 0 = no hit) */
+	glClearBufferuiv( GL_COLOR, 1, clear_value );
+
+	glsl_set_pick_output( FALSE );
+	pick_ids_active = TRUE;
+}
+
+
+/* Finishes what pick_ids_begin( ) started. The pick FBO then matches
+ * the frame just drawn, over the whole viewport */
+static void
+pick_ids_end( void )
+{
+	static const GLenum draw_buffer = GL_COLOR_ATTACHMENT0;
+
+	if (!pick_ids_active)
+		return;
+
+	glsl_set_pick_output( FALSE );
+	glColorMaski( 1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+	glDrawBuffers( 1, &draw_buffer );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+		GL_RENDERBUFFER, 0 );
+	pick_ids_active = FALSE;
+
+	if (pick_ids_partial) {
+		/* Leave it to the separate pass */
+		pick_ids_partial = FALSE;
+		pick_fbo_valid = FALSE;
+		return;
+	}
+
+	pick_region[0] = 0;
+	pick_region[1] = 0;
+	pick_region[2] = pick_fb_width;
+	pick_region[3] = pick_fb_height;
+	pick_fbo_valid = TRUE;
+}
+
+
+/* Switches the writing of node/face IDs in the main render pass on or
+ * off. The geometry code has it on while drawing the nodes themselves,
+ * i.e. what geometry_draw_for_pick( ) would draw */
+void
+ogl_pick_ids( boolean on )
+{
+	if (pick_ids_active)
+		glsl_set_pick_output( on );
+}
+
+
+/* Notes that some of the frame being drawn stands in for nodes whose
+ * IDs it can't write (as with impostors), so that the IDs that were
+ * written are not taken for a complete pick buffer */
+void
+ogl_pick_ids_partial( void )
+{
+	if (pick_ids_active)
+		pick_ids_partial = TRUE;
+}
+
+
+/* Renders the pick scene into the pick FBO, unless what is there is
+ * still good for location (x,y). Only a small square of pixels around
+ * that location is rasterized; moving within it reuses the render.
+ * Returns FALSE if picking is unavailable */
+static boolean
+pick_render( int x, int y, const GLint *viewport )
+{
+	static const GLuint clear_value[4] = { 0, 0, 0, 0 };
+	int fb_y;
+
+	if (!core_profile && !pick_program_ensure( ))
+		return FALSE;
+
+	/* Set up the pick FBO (may invalidate if resized) */
+	pick_fbo_ensure( viewport[2], viewport[3] );
+
+	fb_y = viewport[3] - y;
+	if (pick_fbo_valid && (x >= pick_region[0]) && (x < pick_region[2]) && (fb_y >= pick_region[1]) && (fb_y < pick_region[3]))
+		return TRUE;
+
+	/* Re-render the pick scene into the FBO */
+	frametime_phase_begin( FRAMETIME_PICK );
+	glBindFramebuffer( GL_FRAMEBUFFER, pick_fbo );
+	glViewport( 0, 0, viewport[2], viewport[3] );
+	pick_region[0] = MAX(0, x - PICK_REGION_SIZE / 2);
+	pick_region[1] = MAX(0, fb_y - PICK_REGION_SIZE / 2);
+	pick_region[2] = MIN(viewport[2], x + PICK_REGION_SIZE / 2);
+	pick_region[3] = MIN(viewport[3], fb_y + PICK_REGION_SIZE / 2);
+	glScissor( pick_region[0], pick_region[1], pick_region[2] - pick_region[0], pick_region[3] - pick_region[1] );
+	glEnable( GL_SCISSOR_TEST );
+
+	/* Set up for flat-ID picking (no lighting/texturing) */
+	ogl_disable( GL_LIGHTING );
+	ogl_disable( GL_TEXTURE_2D );
+	glDisable( GL_BLEND );
+	glDisable( GL_DITHER );
+	ogl_disable( GL_FOG );
+	ogl_disable( GL_ALPHA_TEST );
+
+	/* Clear to zero (node ID 0 = no hit) */
+	glClearBufferuiv( GL_COLOR, 0, clear_value );
+	glClear( GL_DEPTH_BUFFER_BIT );
+
+	/* Set up matrices and draw in pick mode */
+	if (core_profile)
+		glsl_set_picking( TRUE );
+	else {
+		glShadeModel( GL_FLAT );
+		glUseProgram( pick_program );
+	}
+	setup_projection_matrix( );
+	setup_modelview_matrix( );
+	geometry_draw_for_pick( );
+	if (core_profile)
+		glsl_set_picking( FALSE );
+	else
+		glUseProgram( 0 );
+
+	/* Restore GtkGLArea's FBO and GL state for normal rendering */
+	glDisable( GL_SCISSOR_TEST );
+	gtk_gl_area_attach_buffers( GTK_GL_AREA(viewport_gl_area_w) );
+	glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
+	glClearColor( 0.0, 0.0, 0.0, 0.0 );
+	ogl_enable( GL_LIGHTING );
+	glEnable( GL_DEPTH_TEST );
+	glEnable( GL_CULL_FACE );
+	glEnable( GL_POLYGON_OFFSET_FILL );
+	frametime_phase_end( FRAMETIME_PICK );
+
+	pick_fbo_valid = TRUE;
+
+	return TRUE;
+}
+
+
+/* Picking. The node at (x,y) is normally found by casting a ray into
+ * the layout (see geometry_pick( )), which needs no rendering at all.
+ * Failing that, this falls back on color-buffer picking: renders the
+ * scene with node IDs written to an integer color attachment, then
+ * reads the pixel at (x,y) to determine which node is there. The full
+ * 32-bit node ID range is representable. Uses a private FBO so the
+ * display framebuffer is never disturbed. The pick FBO is cached --
+ * re-rendered only when invalidated by camera or scene changes (via
+ * ogl_pick_invalidate), or when (x,y) leaves the region last drawn.
+ * With the core-profile renderer, every frame leaves it filled in (see
+ * pick_ids_begin( )), so the separate pass is only needed in between.
+ * Returns the node ID (0 = no hit). face_id is set from the G channel. */
 unsigned int
 ogl_color_pick( int x, int y, unsigned int *face_id )
 {
 	GLint viewport[4];
-	unsigned char pixel[4] = { 0, 0, 0, 0 };
+	GLuint pixel[2] = { 0, 0 };
 	unsigned int node_id;
 
+	*face_id = 0;
+
 	/* Ensure GL context is current */
 	ogl_make_current( );
 
 	/* Get viewport dimensions */
 	glGetIntegerv( GL_VIEWPORT, viewport );
 
-	/* Set up the pick FBO (may invalidate if resized) */
-	pick_fbo_ensure( viewport[2], viewport[3] );
+	if (geometry_pick( x, y, viewport[2], viewport[3], &node_id, face_id ))
+		return node_id;
 
-	if (!pick_fbo_valid) {
-		/* Re-render the pick scene into the FBO */
-		glBindFramebuffer( GL_FRAMEBUFFER, pick_fbo );
-		glViewport( 0, 0, viewport[2], viewport[3] );
-
-		/* Set up for flat-color picking (no lighting/texturing) */
-		glDisable( GL_LIGHTING );
-		glDisable( GL_TEXTURE_2D );
-		glDisable( GL_BLEND );
-		glDisable( GL_DITHER );
-		glDisable( GL_FOG );
-		glDisable( GL_ALPHA_TEST );
-		glShadeModel( GL_FLAT );
+	if (!pick_render( x, y, viewport ))
+		return 0;
 
-		/* Clear to black (node ID 0 = no hit) */
-		glClearColor( 0.0, 0.0, 0.0, 0.0 );
-		glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	/* Read the pixel at (x, y) from the cached pick FBO */
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, pick_fbo );
+	glReadBuffer( GL_COLOR_ATTACHMENT0 );
+	glReadPixels( x, viewport[3] - y, 1, 1, GL_RG_INTEGER, GL_UNSIGNED_INT, pixel );
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, 0 );
 
-		/* Set up matrices and draw in pick mode */
-		setup_projection_matrix( TRUE );
-		setup_modelview_matrix( );
-		geometry_draw_for_pick( );
+	/* Node ID is in R, face ID in G */
+	*face_id = pixel[1];
+
+	return pixel[0];
+}
 
-		/* Restore GtkGLArea's FBO and GL state for normal rendering */
-		gtk_gl_area_attach_buffers( GTK_GL_AREA(viewport_gl_area_w) );
-		glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
-		glClearColor( 0.0, 0.0, 0.0, 0.0 );
-		glEnable( GL_LIGHTING );
-		glShadeModel( GL_FLAT );
-		glEnable( GL_DEPTH_TEST );
-		glEnable( GL_CULL_FACE );
-		glEnable( GL_POLYGON_OFFSET_FILL );
 
-		pick_fbo_valid = TRUE;
+/* Drops the pending asynchronous pick, if any */
+static void
+pick_async_cancel( void )
+{
+	if (pick_fence != NULL) {
+		glDeleteSync( pick_fence );
+		pick_fence = NULL;
 	}
+	if (pick_tick_id != 0) {
+		gtk_widget_remove_tick_callback( viewport_gl_area_w, pick_tick_id );
+		pick_tick_id = 0;
+	}
+	pick_async_func = NULL;
+}
 
-	/* Read the pixel at (x, y) from the cached pick FBO */
+
+/* Frame clock tick callback: hands over the result of the pending
+ * asynchronous pick once the GPU is done with it */
+static gboolean
+pick_async_tick_cb( G_GNUC_UNUSED GtkWidget *widget, G_GNUC_UNUSED GdkFrameClock *frame_clock, G_GNUC_UNUSED gpointer user_data )
+{
+	OglPickFunc pick_func;
+	GLuint pixel[2] = { 0, 0 };
+	GLuint *mapped;
+	GLenum status;
+
+	ogl_make_current( );
+
+	status = glClientWaitSync( pick_fence, 0, 0 );
+	if (status == GL_TIMEOUT_EXPIRED)
+		return G_SOURCE_CONTINUE;
+
+	if (status != GL_WAIT_FAILED) {
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, pick_pbo );
+		mapped = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, sizeof(pixel), GL_MAP_READ_BIT );
+		if (mapped != NULL) {
+			pixel[0] = mapped[0];
+			pixel[1] = mapped[1];
+			glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+		}
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+	}
+
+	/* Clear the pending state first, as the callback may well ask
+	 * for another pick */
+	pick_func = pick_async_func;
+	pick_tick_id = 0;
+	pick_async_cancel( );
+	(pick_func)( pixel[0], pixel[1] );
+
+	return G_SOURCE_REMOVE;
+}
+
+
+/* Asynchronous version of ogl_color_pick( ), for when the answer is
+ * not needed right away (e.g. hover highlighting). If the ray cast
+ * can't be used, the pick pixel is copied into a pixel buffer object
+ * without waiting on the GPU, and pick_func gets the result on a later
+ * frame (or right away, if no GL sync objects are to be had). A newer
+ * request supersedes one still pending */
+void
+ogl_color_pick_async( int x, int y, OglPickFunc pick_func )
+{
+	GLint viewport[4];
+	unsigned int node_id, face_id = 0;
+	int gl_version;
+
+	ogl_make_current( );
+	pick_async_cancel( );
+
+	glGetIntegerv( GL_VIEWPORT, viewport );
+	if (geometry_pick( x, y, viewport[2], viewport[3], &node_id, &face_id )) {
+		(pick_func)( node_id, face_id );
+		return;
+	}
+
+	if (pick_async_supported < 0) {
+		gl_version = epoxy_gl_version( );
+		pick_async_supported = (gl_version >= 32) || epoxy_has_gl_extension( "GL_ARB_sync" );
+	}
+	if (!pick_async_supported) {
+		node_id = ogl_color_pick( x, y, &face_id );
+		(pick_func)( node_id, face_id );
+		return;
+	}
+
+	if (!pick_render( x, y, viewport )) {
+		(pick_func)( 0, 0 );
+		return;
+	}
+
+	if (pick_pbo == 0) {
+		glGenBuffers( 1, &pick_pbo );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, pick_pbo );
+		glBufferData( GL_PIXEL_PACK_BUFFER, 2 * sizeof(GLuint), NULL, GL_STREAM_READ );
+	}
+	else
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, pick_pbo );
+
+	/* With a pack buffer bound, the "pixels" argument is an offset
+	 * into it, and the read returns without waiting for the pixel */
 	glBindFramebuffer( GL_READ_FRAMEBUFFER, pick_fbo );
-	glReadPixels( x, viewport[3] - y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel );
+	glReadBuffer( GL_COLOR_ATTACHMENT0 );
+	glReadPixels( x, viewport[3] - y, 1, 1, GL_RG_INTEGER, GL_UNSIGNED_INT, NULL );
 	glBindFramebuffer( GL_READ_FRAMEBUFFER, 0 );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
 
-	/* Decode node ID from RGB, face ID from alpha */
-	node_id = ((unsigned int)pixel[0] << 16) |
-	          ((unsigned int)pixel[1] << 8) |
-	          (unsigned int)pixel[2];
-	*face_id = (unsigned int)pixel[3];
-
-	return node_id;
+	pick_fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	glFlush( );
+	pick_async_func = pick_func;
+	pick_tick_id = gtk_widget_add_tick_callback( viewport_gl_area_w, pick_async_tick_cb, NULL, NULL );
 }
 
 
@@ -361,6 +951,10 @@ realize_cb( GtkWidget *widget, G_GNUC_UNUSED gpointer user_data )
 	if (gtk_gl_area_get_error( GTK_GL_AREA(widget) ) != NULL)
 		return;
 
+	/* GDK falls back to a legacy context if a core-profile one could
+	 * not be had (or if one was asked for, see main( )) */
+	core_profile = !gdk_gl_context_is_legacy( gtk_gl_area_get_context( GTK_GL_AREA(widget) ) );
+
 	ogl_init( );
 
 	/* Queue the initial render */
@@ -398,8 +992,9 @@ ogl_widget_new( void )
 	gtk_gl_area_set_auto_render( GTK_GL_AREA(viewport_gl_area_w), FALSE );
 
 	/* Connect signals.
-	 * Note: compatibility profile is requested via GDK_GL=legacy
-	 * environment variable set in main() before gtk_init() */
+	 * Note: with the legacy renderer, compatibility profile is requested
+	 * via GDK_GL=legacy environment variable set in main() before
+	 * gtk_init(). Otherwise, GtkGLArea's default core profile is used */
 	g_signal_connect( viewport_gl_area_w, "realize", G_CALLBACK(realize_cb), NULL );
 	g_signal_connect( viewport_gl_area_w, "render", G_CALLBACK(render_cb), NULL );
 	g_signal_connect( viewport_gl_area_w, "resize", G_CALLBACK(resize_cb), NULL );
@@ -408,6 +1003,123 @@ ogl_widget_new( void )
 }
 
 
+/* Returns the viewport GL widget (NULL if it hasn't been created, or
+ * when rendering offscreen) */
+GtkWidget *
+ogl_widget( void )
+{
+	return viewport_gl_area_w;
+}
+
+
+#ifdef HAVE_EPOXY_EGL
+/* Helper function for ogl_offscreen_init( ): gets the EGL context and
+ * framebuffer. Returns FALSE at the first step that fails, leaving
+ * whatever was set up so far to ogl_offscreen_end( ) */
+static boolean
+offscreen_setup( int width, int height, boolean core )
+{
+	static const EGLint config_attribs[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	static const EGLint core_context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 2,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	static const EGLint legacy_context_attribs[] = {
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint num_configs;
+
+	if (epoxy_has_egl_extension( EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless" ))
+		offscreen_display = eglGetPlatformDisplayEXT( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+	else
+		offscreen_display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+	if (offscreen_display == EGL_NO_DISPLAY)
+		return FALSE;
+	if (!eglInitialize( offscreen_display, NULL, NULL ))
+		return FALSE;
+	if (!eglBindAPI( EGL_OPENGL_API ))
+		return FALSE;
+	if (!eglChooseConfig( offscreen_display, config_attribs, &config, 1, &num_configs ) || (num_configs < 1))
+		return FALSE;
+	offscreen_context = eglCreateContext( offscreen_display, config, EGL_NO_CONTEXT, core ? core_context_attribs : legacy_context_attribs );
+	if (offscreen_context == EGL_NO_CONTEXT)
+		return FALSE;
+	if (!eglMakeCurrent( offscreen_display, EGL_NO_SURFACE, EGL_NO_SURFACE, offscreen_context ))
+		return FALSE;
+
+	/* Stand-in for GtkGLArea's framebuffer */
+	glGenFramebuffers( 1, &offscreen_fbo );
+	glGenRenderbuffers( 2, offscreen_rbs );
+	glBindRenderbuffer( GL_RENDERBUFFER, offscreen_rbs[0] );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+	glBindRenderbuffer( GL_RENDERBUFFER, offscreen_rbs[1] );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height );
+	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+	glBindFramebuffer( GL_FRAMEBUFFER, offscreen_fbo );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreen_rbs[0] );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreen_rbs[1] );
+
+	return glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE;
+}
+#endif /* HAVE_EPOXY_EGL */
+
+
+/* Sets up rendering into a width x height offscreen framebuffer, with
+ * no window or display server, on a surfaceless EGL context (as with
+ * Mesa's software rasterizers). core selects the core-profile renderer.
+ * Returns FALSE if no context could be had */
+boolean
+ogl_offscreen_init( int width, int height, boolean core )
+{
+#ifdef HAVE_EPOXY_EGL
+	g_assert( viewport_gl_area_w == NULL );
+
+	if (!offscreen_setup( width, height, core )) {
+		ogl_offscreen_end( );
+		return FALSE;
+	}
+	offscreen_width = width;
+	offscreen_height = height;
+
+	core_profile = core;
+	ogl_init( );
+
+	return TRUE;
+#else
+	return FALSE;
+#endif /* not HAVE_EPOXY_EGL */
+}
+
+
+/* Tears down what ogl_offscreen_init( ) set up */
+void
+ogl_offscreen_end( void )
+{
+#ifdef HAVE_EPOXY_EGL
+	if (offscreen_fbo != 0) {
+		glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+		glDeleteFramebuffers( 1, &offscreen_fbo );
+		glDeleteRenderbuffers( 2, offscreen_rbs );
+		offscreen_fbo = 0;
+	}
+	if (offscreen_display != EGL_NO_DISPLAY) {
+		eglMakeCurrent( offscreen_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+		if (offscreen_context != EGL_NO_CONTEXT)
+			eglDestroyContext( offscreen_display, offscreen_context );
+		eglTerminate( offscreen_display );
+		offscreen_context = EGL_NO_CONTEXT;
+		offscreen_display = EGL_NO_DISPLAY;
+	}
+#endif
+}
+
+
 /* Returns TRUE if GL is available */
 gboolean
 ogl_gl_query( void )
@@ -28,6 +28,23 @@
 #define FSV_OGL_H
 
 
+/* Generic vertex attribute carrying (node ID, face ID) in pick mode */
+#define OGL_PICK_ATTRIB		7
+
+/* Receives the result of an asynchronous pick */
+typedef void (*OglPickFunc)( unsigned int node_id, unsigned int face_id );
+
+
+boolean ogl_core_profile( void );
+void ogl_enable( unsigned int cap );
+void ogl_disable( unsigned int cap );
+void ogl_polygon_mode( unsigned int mode );
+boolean ogl_cel_lines( boolean on );
+void ogl_line_stipple( int factor, unsigned short pattern );
+void ogl_fog_linear( double start, double end );
+boolean ogl_list_begin( unsigned int *dlist, boolean rebuild );
+void ogl_list_end( void );
+void ogl_list_free( unsigned int *dlist );
 void ogl_make_current( void );
 void ogl_queue_render( void );
 void ogl_resize( void );
@@ -35,9 +52,17 @@ void ogl_refresh( void );
 double ogl_aspect_ratio( void );
 void ogl_draw( void );
 unsigned int ogl_color_pick( int x, int y, unsigned int *face_id );
+void ogl_color_pick_async( int x, int y, OglPickFunc pick_func );
+void ogl_pick_ids( boolean on );
+void ogl_pick_ids_partial( void );
 void ogl_pick_invalidate( void );
+void ogl_count_draws( int draw_calls, int64 triangles );
+void ogl_frame_counts( int *draw_calls, int64 *triangles );
+boolean ogl_offscreen_init( int width, int height, boolean core );
+void ogl_offscreen_end( void );
 #ifdef __GTK_H__
 GtkWidget *ogl_widget_new( void );
+GtkWidget *ogl_widget( void );
 gboolean ogl_gl_query( void );
 #endif
 
@@ -35,6 +35,7 @@
 #include "filelist.h"
 #include "geometry.h" /* geometry_free( ) */
 #include "gui.h" /* gui_update( ) */
+#include "memstat.h"
 #include "viewport.h" /* viewport_pass_node_table( ) */
 #include "window.h"
 
@@ -148,8 +149,10 @@ process_dir( const char *dir, GNode *dnode )
 		return -1;
 
 	/* Update display */
-	snprintf( strbuf, sizeof(strbuf), _("Scanning: %s"), dir );
-	window_statusbar( SB_RIGHT, strbuf );
+	if (!globals.headless) {
+		snprintf( strbuf, sizeof(strbuf), _("Scanning: %s"), dir );
+		window_statusbar( SB_RIGHT, strbuf );
+	}
 
 	/* Prepare path buffer: "dir/" prefix, entry name appended per iteration */
 	dir_len = strlen( dir );
@@ -175,14 +178,21 @@ process_dir( const char *dir, GNode *dnode )
 		}
 		++stat_count;
 		++node_id;
+		memstat_add( MEMSTAT_GNODE, 1, sizeof(GNode) );
+		memstat_add( MEMSTAT_NAMES, 1, strlen( NODE_DESC(node)->name ) + 1 );
 
 		if (NODE_IS_DIR(node)) {
-			/* Create corresponding directory tree entry */
-			dirtree_entry_new( node );
+			/* Directory tree entries start out collapsed */
+			DIR_NODE_DESC(node)->tree_expanded = FALSE;
 			/* Initialize display lists */
-			DIR_NODE_DESC(node)->a_dlist = NULL_DLIST;
-			DIR_NODE_DESC(node)->b_dlist = NULL_DLIST;
-			DIR_NODE_DESC(node)->c_dlist = NULL_DLIST;
+			DIR_NODE_DESC(node)->a_vbuf = NULL;
+			DIR_NODE_DESC(node)->b_vbuf = NULL;
+			DIR_NODE_DESC(node)->label_vbuf = NULL;
+			DIR_NODE_DESC(node)->label_set = NULL;
+			DIR_NODE_DESC(node)->bvh = NULL;
+			DIR_NODE_DESC(node)->occ_query = 0;
+			DIR_NODE_DESC(node)->impostor = NULL;
+			DIR_NODE_DESC(node)->build_job = NULL;
 
 			/* Recurse down using the already-built path */
 			process_dir( pathbuf, node );
@@ -191,12 +201,14 @@ process_dir( const char *dir, GNode *dnode )
 			andesc = (union AnyNodeDesc *)g_slice_new0( DirNodeDesc );
 			memcpy( andesc, DIR_NODE_DESC(node), sizeof(DirNodeDesc) );
 			node->data = andesc;
+			memstat_add( MEMSTAT_NODE_DESC, 1, sizeof(DirNodeDesc) );
 		}
 		else {
 			/* Move new descriptor into working memory */
 			andesc = (union AnyNodeDesc *)g_slice_new0( NodeDesc );
 			memcpy( andesc, NODE_DESC(node), sizeof(NodeDesc) );
 			node->data = andesc;
+			memstat_add( MEMSTAT_NODE_DESC, 1, sizeof(NodeDesc) );
 		}
 
 		/* Add to appropriate node/size counts
@@ -207,7 +219,7 @@ process_dir( const char *dir, GNode *dnode )
 		free( dir_entries[i] ); /* !xfree */
 
 		/* Keep the user interface responsive (throttled) */
-		{
+		if (!globals.headless) {
 			double now = xgettime( );
 			if (now - scan_last_ui_update >= SCAN_UI_UPDATE_INTERVAL) {
 				gui_update( );
@@ -340,6 +352,11 @@ scanfs( const char *dir )
 	guint handler_id;
 	char *name;
 
+	/* Path-to-node index and directory tree refer to the old tree */
+	node_index_invalidate( );
+	if (!globals.headless)
+		dirtree_clear( );
+
 	if (globals.fstree != NULL) {
 		/* Free existing geometry and filesystem tree */
 		geometry_free_recursive( globals.fstree );
@@ -347,15 +364,15 @@ scanfs( const char *dir )
 		g_node_traverse( globals.fstree, G_PRE_ORDER, G_TRAVERSE_ALL, -1, free_node_data_cb, NULL );
 		g_node_destroy( globals.fstree );
 	}
+	memstat_clear( MEMSTAT_NODE_DESC );
+	memstat_clear( MEMSTAT_GNODE );
+	memstat_clear( MEMSTAT_NAMES );
 
 	/* ...and string chunks to hold name strings */
 	if (name_strchunk != NULL)
 		g_string_chunk_free( name_strchunk );
 	name_strchunk = g_string_chunk_new( 8192 );
 
-	/* Clear out directory tree */
-	dirtree_clear( );
-
 	/* Reset node numbering */
 	node_id = 0;
 
@@ -371,10 +388,14 @@ scanfs( const char *dir )
 	name = g_path_get_dirname( root_dir );
 	NODE_DESC(globals.fstree)->name = g_string_chunk_insert( name_strchunk, name );
 	g_free( name );
-	DIR_NODE_DESC(globals.fstree)->ctnode = NULL; /* needed in dirtree_entry_new( ) */
-	DIR_NODE_DESC(globals.fstree)->a_dlist = NULL_DLIST;
-	DIR_NODE_DESC(globals.fstree)->b_dlist = NULL_DLIST;
-	DIR_NODE_DESC(globals.fstree)->c_dlist = NULL_DLIST;
+	DIR_NODE_DESC(globals.fstree)->a_vbuf = NULL;
+	DIR_NODE_DESC(globals.fstree)->b_vbuf = NULL;
+	DIR_NODE_DESC(globals.fstree)->label_vbuf = NULL;
+	DIR_NODE_DESC(globals.fstree)->label_set = NULL;
+	DIR_NODE_DESC(globals.fstree)->bvh = NULL;
+	DIR_NODE_DESC(globals.fstree)->occ_query = 0;
+	DIR_NODE_DESC(globals.fstree)->impostor = NULL;
+	DIR_NODE_DESC(globals.fstree)->build_job = NULL;
 
 	/* Set up root directory node */
 	g_node_append_data( globals.fstree, g_slice_new0( DirNodeDesc ) );
@@ -384,30 +405,54 @@ scanfs( const char *dir )
 	name = g_path_get_basename( root_dir );
 	NODE_DESC(root_dnode)->name = g_string_chunk_insert( name_strchunk, name );
 	g_free( name );
-	DIR_NODE_DESC(root_dnode)->a_dlist = NULL_DLIST;
-	DIR_NODE_DESC(root_dnode)->b_dlist = NULL_DLIST;
-	DIR_NODE_DESC(root_dnode)->c_dlist = NULL_DLIST;
+	/* Account for metanode and root directory node */
+	memstat_add( MEMSTAT_NODE_DESC, 2, 2 * sizeof(DirNodeDesc) );
+	memstat_add( MEMSTAT_GNODE, 2, 2 * sizeof(GNode) );
+	memstat_add( MEMSTAT_NAMES, 2, strlen( NODE_DESC(globals.fstree)->name ) + strlen( NODE_DESC(root_dnode)->name ) + 2 );
+	DIR_NODE_DESC(root_dnode)->a_vbuf = NULL;
+	DIR_NODE_DESC(root_dnode)->b_vbuf = NULL;
+	DIR_NODE_DESC(root_dnode)->label_vbuf = NULL;
+	DIR_NODE_DESC(root_dnode)->label_set = NULL;
+	DIR_NODE_DESC(root_dnode)->bvh = NULL;
+	DIR_NODE_DESC(root_dnode)->occ_query = 0;
+	DIR_NODE_DESC(root_dnode)->impostor = NULL;
+	DIR_NODE_DESC(root_dnode)->build_job = NULL;
 	stat_node( root_dnode, root_dir );
-	dirtree_entry_new( root_dnode );
 
-	/* GUI stuff */
-	filelist_scan_monitor_init( );
-	handler_id = g_timeout_add( SCAN_MONITOR_PERIOD, scan_monitor, NULL );
-	scan_last_ui_update = xgettime( );
-
-	/* Let the disk thrashing begin */
-	process_dir( root_dir, root_dnode );
-
-	/* GUI stuff again */
-	g_source_remove( handler_id );
-	window_statusbar( SB_RIGHT, "" );
-	dirtree_no_more_entries( );
-	gui_update( );
+	if (globals.headless) {
+		/* Just the scan */
+		process_dir( root_dir, root_dnode );
+	}
+	else {
+		/* GUI stuff */
+		filelist_scan_monitor_init( );
+		handler_id = g_timeout_add( SCAN_MONITOR_PERIOD, scan_monitor, NULL );
+		scan_last_ui_update = xgettime( );
+
+		/* Let the disk thrashing begin */
+		process_dir( root_dir, root_dnode );
+
+		/* GUI stuff again */
+		g_source_remove( handler_id );
+		window_statusbar( SB_RIGHT, "" );
+		gui_update( );
+	}
 
 	/* Allocate node table and perform final tree setup */
 	node_table = NEW_ARRAY(GNode *, node_id);
 	setup_fstree_recursive( globals.fstree, node_table );
 
+	/* Drop any index built from the partial tree during the scan */
+	node_index_invalidate( );
+
+	/* Directory tree can now be shown (it relies on the sort order) */
+	if (globals.headless)
+		DIR_NODE_DESC(root_dnode)->tree_expanded = TRUE;
+	else {
+		dirtree_no_more_entries( );
+		gui_update( );
+	}
+
 	/* Pass off new node table to the viewport handler */
 	viewport_pass_node_table( node_table, node_id );
 }
@@ -18,6 +18,7 @@
 #include "filelist.h"
 #include "geometry.h"
 #include "gui.h"
+#include "memstat.h"
 #include "window.h"
 
 
@@ -106,6 +107,7 @@ search_clear_results( void )
 	}
 	search_result_count = 0;
 	search_current_index = -1;
+	memstat_clear( MEMSTAT_SEARCH );
 	if (search_next_button_w != NULL)
 		gtk_widget_set_sensitive( search_next_button_w, FALSE );
 }
@@ -173,6 +175,7 @@ search_execute_cb( G_GNUC_UNUSED GtkWidget *widget, G_GNUC_UNUSED gpointer data
 	/* Search the filesystem tree */
 	search_tree_recursive( globals.fstree, pattern, is_glob_pattern( pattern ), &search_results );
 	search_result_count = g_list_length( search_results );
+	memstat_add( MEMSTAT_SEARCH, search_result_count, search_result_count * sizeof(GList) );
 
 	if (search_result_count == 0) {
 		window_statusbar( SB_LEFT, _("No matches found") );
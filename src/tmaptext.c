@@ -27,6 +27,9 @@
 
 #include <epoxy/gl.h>
 
+#include "ogl.h"
+#include "vbuf.h"
+
 /* Bitmap font definition */
 #define char_width 16
 #define char_height 32
@@ -37,6 +40,9 @@
 #define TEXT_MAX_SQUEEZE 2.0
 /* Mipmaps make faraway text look nice */
 #define TEXT_USE_MIPMAPS
+/* Distance (in font pixels) over which the glyph distance field goes
+ * from fully inside to fully outside */
+#define TEXT_SDF_SPREAD 4
 
 
 /* Normal character aspect ratio */
@@ -77,50 +83,115 @@ xbm_pixels( const byte *xbm_bits, int pixel_count )
 }
 
 
+/* Converts the charset bitmap (as returned by xbm_pixels( )) into a
+ * signed distance field: 128 on glyph outlines, rising to 255 at
+ * TEXT_SDF_SPREAD pixels inside a glyph and falling to 0 as far outside.
+ * Distances are only taken within a glyph's own cell. Caller assumes
+ * responsibility for freeing the returned buffer */
+static byte *
+sdf_pixels( const byte *pixels )
+{
+	double dist, min_dist;
+	int x, y, x0, y0, x1, y1, i, j;
+	int cell_x, cell_y;
+	boolean inside, other_inside;
+	byte *field;
+
+	field = NEW_ARRAY(byte, charset_width * charset_height);
+
+	for (y = 0; y < charset_height; y++) {
+		cell_y = y - (y % char_height);
+		for (x = 0; x < charset_width; x++) {
+			cell_x = x - (x % char_width);
+			inside = pixels[y * charset_width + x] != 0;
+
+			/* Nearest pixel on the other side of the outline
+			 * (outside the cell counts as outside the glyph) */
+			min_dist = (double)TEXT_SDF_SPREAD + 0.5;
+			x0 = x - TEXT_SDF_SPREAD;
+			x1 = x + TEXT_SDF_SPREAD;
+			y0 = y - TEXT_SDF_SPREAD;
+			y1 = y + TEXT_SDF_SPREAD;
+			for (j = y0; j <= y1; j++) {
+				for (i = x0; i <= x1; i++) {
+					if ((i < cell_x) || (i >= (cell_x + char_width)) || (j < cell_y) || (j >= (cell_y + char_height)))
+						other_inside = FALSE;
+					else
+						other_inside = pixels[j * charset_width + i] != 0;
+					if (other_inside == inside)
+						continue;
+					dist = sqrt( (double)(SQR(i - x) + SQR(j - y)) );
+					min_dist = MIN(min_dist, dist);
+				}
+			}
+
+			/* The outline runs halfway between pixel centers */
+			dist = min_dist - 0.5;
+			if (!inside)
+				dist = - dist;
+			dist = CLAMP(dist / (double)TEXT_SDF_SPREAD, -1.0, 1.0);
+			field[y * charset_width + x] = (byte)(127.5 + 127.5 * dist);
+		}
+	}
+
+	return field;
+}
+
+
 /* Initializes texture-mapping state for drawing text */
 void
 text_init( void )
 {
-	float border_color[] = { 0.0, 0.0, 0.0, 1.0 };
 	byte *charset_pixels;
+	byte *sdf;
 
 	/* Set up text texture object */
 	glGenTextures( 1, &text_tobj );
 	glBindTexture( GL_TEXTURE_2D, text_tobj );
 
-	/* Set up texture-mapping parameters */
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+	/* Set up texture-mapping parameters. The texture is a distance
+	 * field, so it is always filtered linearly: glyph outlines then
+	 * come out smooth at any magnification */
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 #ifdef TEXT_USE_MIPMAPS
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
 #else
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
 #endif
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-	glTexParameterfv( GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border_color );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
 
-	/* Load texture */
+	/* Load texture. It only supplies alpha (the legacy renderer cuts
+	 * glyphs out with the alpha test, see text_pre( ); the core-profile
+	 * shaders read the red channel instead, see glsl.c) */
 	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
 	charset_pixels = xbm_pixels( charset_bits, charset_width * charset_height );
+	sdf = sdf_pixels( charset_pixels );
+	if (ogl_core_profile( ))
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_R8, charset_width, charset_height, 0, GL_RED, GL_UNSIGNED_BYTE, sdf );
+	else
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA8, charset_width, charset_height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, sdf );
 #ifdef TEXT_USE_MIPMAPS
-	glTexImage2D( GL_TEXTURE_2D, 0, GL_INTENSITY4, charset_width, charset_height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, charset_pixels );
 	glGenerateMipmap( GL_TEXTURE_2D );
-#else
-	glTexImage2D( GL_TEXTURE_2D, 0, GL_INTENSITY4, charset_width, charset_height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, charset_pixels );
 #endif
+	xfree( sdf );
 	xfree( charset_pixels );
 }
 
 
-/* Call before drawing text */
+/* Call before drawing text. Glyph edges are where the distance field
+ * crosses one half. The core-profile shaders shade a pixel-wide band
+ * around them, blended; the legacy renderer can only threshold, with
+ * the alpha test (cf. glAlphaFunc( ) in ogl_init( )) */
 void
 text_pre( void )
 {
-	glDisable( GL_LIGHTING );
+	ogl_disable( GL_LIGHTING );
 	glDisable( GL_POLYGON_OFFSET_FILL );
-	glEnable( GL_ALPHA_TEST );
-	glEnable( GL_BLEND );
-	glEnable( GL_TEXTURE_2D );
+	ogl_enable( GL_ALPHA_TEST );
+	if (ogl_core_profile( ))
+		glEnable( GL_BLEND );
+	ogl_enable( GL_TEXTURE_2D );
 	glBindTexture( GL_TEXTURE_2D, text_tobj );
 }
 
@@ -129,11 +200,12 @@ text_pre( void )
 void
 text_post( void )
 {
-	glDisable( GL_TEXTURE_2D );
-	glDisable( GL_BLEND );
-	glDisable( GL_ALPHA_TEST );
+	ogl_disable( GL_TEXTURE_2D );
+	if (ogl_core_profile( ))
+		glDisable( GL_BLEND );
+	ogl_disable( GL_ALPHA_TEST );
 	glEnable( GL_POLYGON_OFFSET_FILL );
-	glEnable( GL_LIGHTING );
+	ogl_enable( GL_LIGHTING );
 }
 
 
@@ -173,6 +245,21 @@ get_char_dims( int len, const XYvec *max_dims, XYvec *cdims )
 }
 
 
+/* Returns the dimensions that the given text will actually occupy, when
+ * drawn to fit within max_dims (cf. text_draw_straight( )) */
+void
+text_get_extents( const char *text, const XYvec *max_dims, XYvec *dims )
+{
+	XYvec cdims;
+	int len;
+
+	len = strlen( text );
+	get_char_dims( len, max_dims, &cdims );
+	dims->x = (double)len * cdims.x;
+	dims->y = cdims.y;
+}
+
+
 /* Returns the texture-space coordinates of the bottom-left and upper-right
  * corners of the specified character (glyph) */
 static void
@@ -220,27 +307,27 @@ text_draw_straight( const char *text, const XYZvec *text_pos, const XYvec *text_
 	c1.x = c0.x + cdims.x;
 	c1.y = c0.y + cdims.y;
 
-	glBegin( GL_QUADS );
+	vbuf_begin( GL_QUADS );
 	for (i = 0; i < len; i++) {
 		get_char_tex_coords( text[i], &t_c0, &t_c1 );
 
 		/* Lower left */
-		glTexCoord2d( t_c0.x, t_c0.y );
-		glVertex3d( c0.x, c0.y, text_pos->z );
+		vbuf_texcoord2d( t_c0.x, t_c0.y );
+		vbuf_vertex3d( c0.x, c0.y, text_pos->z );
 		/* Lower right */
-		glTexCoord2d( t_c1.x, t_c0.y );
-		glVertex3d( c1.x, c0.y, text_pos->z );
+		vbuf_texcoord2d( t_c1.x, t_c0.y );
+		vbuf_vertex3d( c1.x, c0.y, text_pos->z );
 		/* Upper right */
-		glTexCoord2d( t_c1.x, t_c1.y );
-		glVertex3d( c1.x, c1.y, text_pos->z );
+		vbuf_texcoord2d( t_c1.x, t_c1.y );
+		vbuf_vertex3d( c1.x, c1.y, text_pos->z );
 		/* Upper left */
-		glTexCoord2d( t_c0.x, t_c1.y );
-		glVertex3d( c0.x, c1.y, text_pos->z );
+		vbuf_texcoord2d( t_c0.x, t_c1.y );
+		vbuf_vertex3d( c0.x, c1.y, text_pos->z );
 
 		c0.x = c1.x;
 		c1.x += cdims.x;
 	}
-	glEnd( );
+	vbuf_end( );
 }
 
 
@@ -275,29 +362,29 @@ text_draw_straight_rotated( const char *text, const RTZvec *text_pos, const XYve
 	c1.x = c0.x + hdelta.x + vdelta.x;
 	c1.y = c0.y + hdelta.y + vdelta.y;
 
-	glBegin( GL_QUADS );
+	vbuf_begin( GL_QUADS );
 	for (i = 0; i < len; i++) {
 		get_char_tex_coords( text[i], &t_c0, &t_c1 );
 
 		/* Lower left */
-		glTexCoord2d( t_c0.x, t_c0.y );
-		glVertex3d( c0.x, c0.y, text_pos->z );
+		vbuf_texcoord2d( t_c0.x, t_c0.y );
+		vbuf_vertex3d( c0.x, c0.y, text_pos->z );
 		/* Lower right */
-		glTexCoord2d( t_c1.x, t_c0.y );
-		glVertex3d( c0.x + hdelta.x, c0.y + hdelta.y, text_pos->z );
+		vbuf_texcoord2d( t_c1.x, t_c0.y );
+		vbuf_vertex3d( c0.x + hdelta.x, c0.y + hdelta.y, text_pos->z );
 		/* Upper right */
-		glTexCoord2d( t_c1.x, t_c1.y );
-		glVertex3d( c1.x, c1.y, text_pos->z );
+		vbuf_texcoord2d( t_c1.x, t_c1.y );
+		vbuf_vertex3d( c1.x, c1.y, text_pos->z );
 		/* Upper left */
-		glTexCoord2d( t_c0.x, t_c1.y );
-		glVertex3d( c1.x - hdelta.x, c1.y - hdelta.y, text_pos->z );
+		vbuf_texcoord2d( t_c0.x, t_c1.y );
+		vbuf_vertex3d( c1.x - hdelta.x, c1.y - hdelta.y, text_pos->z );
 
 		c0.x += hdelta.x;
 		c0.y += hdelta.y;
 		c1.x += hdelta.x;
 		c1.y += hdelta.y;
 	}
-	glEnd( );
+	vbuf_end( );
 }
 
 
@@ -328,7 +415,7 @@ text_draw_curved( const char *text, const RTZvec *text_pos, const RTvec *text_ma
 	char_arc_width = (180.0 / PI) * cdims.x / text_r;
 
 	theta = text_pos->theta + 0.5 * (double)(len - 1) * char_arc_width;
-	glBegin( GL_QUADS );
+	vbuf_begin( GL_QUADS );
 	for (i = 0; i < len; i++) {
 		sin_theta = sin( RAD(theta) );
 		cos_theta = cos( RAD(theta) );
@@ -345,21 +432,21 @@ text_draw_curved( const char *text, const RTZvec *text_pos, const RTvec *text_ma
 		get_char_tex_coords( text[i], &t_c0, &t_c1 );
 
 		/* Lower left */
-		glTexCoord2d( t_c0.x, t_c0.y );
-		glVertex3d( char_pos.x - fwsl.x, char_pos.y - fwsl.y, text_pos->z );
+		vbuf_texcoord2d( t_c0.x, t_c0.y );
+		vbuf_vertex3d( char_pos.x - fwsl.x, char_pos.y - fwsl.y, text_pos->z );
 		/* Lower right */
-		glTexCoord2d( t_c1.x, t_c0.y );
-		glVertex3d( char_pos.x + bwsl.x, char_pos.y + bwsl.y, text_pos->z );
+		vbuf_texcoord2d( t_c1.x, t_c0.y );
+		vbuf_vertex3d( char_pos.x + bwsl.x, char_pos.y + bwsl.y, text_pos->z );
 		/* Upper right */
-		glTexCoord2d( t_c1.x, t_c1.y );
-		glVertex3d( char_pos.x + fwsl.x, char_pos.y + fwsl.y, text_pos->z );
+		vbuf_texcoord2d( t_c1.x, t_c1.y );
+		vbuf_vertex3d( char_pos.x + fwsl.x, char_pos.y + fwsl.y, text_pos->z );
 		/* Upper left */
-		glTexCoord2d( t_c0.x, t_c1.y );
-		glVertex3d( char_pos.x - bwsl.x, char_pos.y - bwsl.y, text_pos->z );
+		vbuf_texcoord2d( t_c0.x, t_c1.y );
+		vbuf_vertex3d( char_pos.x - bwsl.x, char_pos.y - bwsl.y, text_pos->z );
 
 		theta -= char_arc_width;
 	}
-	glEnd( );
+	vbuf_end( );
 }
 
 
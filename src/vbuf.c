@@ -0,0 +1,1239 @@
+/* vbuf.c */
+
+/* Buffered geometry (vertex buffer objects) */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "common.h"
+#include "vbuf.h"
+
+#include <epoxy/gl.h>
+
+#include "glsl.h"
+#include "memstat.h"
+#include "ogl.h" /* OGL_PICK_ATTRIB, ogl_count_draws( ) */
+#include "xform.h"
+
+
+/* Geometry is described with the familiar glBegin( )/glVertex( )/glEnd( )
+ * vocabulary, through the vbuf_*( ) calls below. Outside of a recording,
+ * these simply pass through to immediate-mode GL (or, with the core-
+ * profile renderer, each primitive is streamed out to a scratch buffer
+ * and drawn on the spot). Inside a recording, primitives are broken down
+ * into independent triangles and lines, transformed into world space,
+ * and stored in one of a few large shared buffer objects. A frame then
+ * draws every queued range sharing a buffer with a single
+ * glMultiDrawArrays( ) call per primitive type */
+
+/* Size of a shared vertex buffer (in vertices) */
+#define VBUF_ARENA_VERTICES	(1 << 18)
+
+/* Ranges are allocated with this much room to grow (as a right shift of
+ * their size), so that rebuilds can usually be updated in place */
+#define VBUF_SLACK_SHIFT	3
+
+/* Stored texture coordinates are fixed-point, with this as 1.0 */
+#define VBUF_TEXCOORD_ONE	32767.0
+
+
+/* Vertex format, as stored in the buffer objects */
+typedef struct _VBufVertex VBufVertex;
+struct _VBufVertex {
+	float		pos[3];		/* Position (world space) */
+	GLbyte		normal[3];	/* Normal (world space) */
+	GLboolean	edge;		/* Edge flag (for the outline pass) */
+	GLubyte		color[4];	/* Node color */
+	GLuint		pick[2];	/* Node ID, face ID */
+	GLshort		texcoord[2];	/* Texture coordinates (text) */
+};
+
+/* Free block in a shared buffer */
+typedef struct _VBufBlock VBufBlock;
+struct _VBufBlock {
+	int	first;
+	int	count;
+};
+
+/* Draw commands queued up for one shared buffer */
+typedef struct _VBufDraws VBufDraws;
+struct _VBufDraws {
+	GLint	*firsts;
+	GLsizei	*counts;
+	int	num;
+	int	alloc;
+};
+
+/* Shared vertex buffer */
+typedef struct _VBufArena VBufArena;
+struct _VBufArena {
+	GLuint		buffer;		/* Buffer object name */
+	int		size;		/* Capacity (in vertices) */
+	GList		*free_list;	/* Free blocks, in order of position */
+	VBufDraws	triangles;	/* Queued triangle ranges */
+	VBufDraws	lines;		/* Queued line ranges */
+};
+
+/* Recorded geometry of one directory */
+struct _VBufRange {
+	VBufArena	*arena;		/* Buffer holding the vertices */
+	int		first;		/* Position of first vertex */
+	int		size;		/* Number of vertices allocated */
+	int		tri_count;	/* Triangle vertices (come first) */
+	int		line_count;	/* Line vertices (follow triangles) */
+	/* Vertices of a deferred recording, waiting to be uploaded (see
+	 * vbuf_record_begin_deferred( )) */
+	struct _VBufVertex *pending;
+	boolean		deferred;
+	/* Model transformation in effect when the range was recorded,
+	 * and its inverse (valid if invertible is TRUE) */
+	XformMatrix	matrix;
+	XformMatrix	inverse;
+	double		det;
+	boolean		invertible;
+};
+
+/* A range queued for drawing under a different transformation than the
+ * one it was recorded with (e.g. while a directory grows or shrinks) */
+typedef struct _VBufDisplaced VBufDisplaced;
+struct _VBufDisplaced {
+	const VBufRange	*range;
+	XformMatrix	delta;		/* current * inverse(recorded) */
+	int		tri_first;	/* Triangle vertices to draw */
+	int		tri_count;
+	int		line_count;	/* Line vertices to draw (all or none) */
+};
+
+/* Growable vertex array */
+typedef struct _VBufVertexArray VBufVertexArray;
+struct _VBufVertexArray {
+	VBufVertex	*verts;
+	int		num;
+	int		alloc;
+};
+
+/* Geometry specification state. Each thread has its own, so that worker
+ * threads can record geometry while the GL thread draws (see
+ * vbuf_record_begin_deferred( )) */
+typedef struct _VBufState VBufState;
+struct _VBufState {
+	/* Current vertex attributes (cf. glNormal( ), glColor( ), etc.) */
+	double		normal[3];
+	VBufVertex	vertex;
+	/* TRUE if vertex.normal is up to date with normal (under the
+	 * transformation of the current recording) */
+	boolean		normal_valid;
+	/* Recording state */
+	VBufRange	*rec_range;
+	VBufVertexArray	triangles;
+	VBufVertexArray	lines;
+	/* Vertices of the primitive being specified, and its type */
+	VBufVertexArray	prim_verts;
+	GLenum		prim_mode;
+	/* Vertices passed on to immediate-mode GL since vbuf_begin( ) */
+	int		imm_verts;
+};
+
+
+/* All shared buffers (elements are of type VBufArena) */
+static GList *arena_list = NULL;
+
+/* Displaced ranges queued for the next flush */
+static VBufDisplaced *displaced_queue = NULL;
+static int displaced_num = 0;
+static int displaced_alloc = 0;
+
+/* Initial state of a thread */
+static const VBufState initial_state = {
+	{ 0.0, 0.0, 1.0 },
+	{ { 0.0, 0.0, 0.0 }, { 0, 0, 127 }, GL_TRUE, { 255, 255, 255, 255 }, { 0, 0 }, { 0, 0 } },
+	FALSE,
+	NULL,
+	{ NULL, 0, 0 },
+	{ NULL, 0, 0 },
+	{ NULL, 0, 0 },
+	GL_POINTS,
+	0
+};
+
+static void state_free( gpointer data );
+
+/* State of each thread using vbuf_*( ) */
+static GPrivate state_key = G_PRIVATE_INIT(state_free);
+
+/* Core profile: vertex array object for all vbuf drawing, and the
+ * scratch buffer that primitives are streamed through */
+static GLuint core_vao = 0;
+static GLuint stream_buffer = 0;
+static int stream_size = 0;
+
+
+/**** Thread state ****************/
+
+
+/* Destroys the state of a thread, as it exits */
+static void
+state_free( gpointer data )
+{
+	VBufState *st = (VBufState *)data;
+
+	xfree( st->triangles.verts );
+	xfree( st->lines.verts );
+	xfree( st->prim_verts.verts );
+	xfree( st );
+}
+
+
+/* Returns the state of the calling thread */
+static VBufState *
+state_get( void )
+{
+	VBufState *st;
+
+	st = (VBufState *)g_private_get( &state_key );
+	if (st == NULL) {
+		st = NEW(VBufState);
+		*st = initial_state; /* struct assign */
+		g_private_set( &state_key, st );
+	}
+
+	return st;
+}
+
+
+/**** Buffer management ****************/
+
+
+/* Creates a new shared buffer, with room for at least min_size vertices */
+static VBufArena *
+arena_new( int min_size )
+{
+	VBufArena *arena;
+	VBufBlock *block;
+
+	arena = NEW(VBufArena);
+	memset( arena, 0, sizeof(VBufArena) );
+	arena->size = MAX(VBUF_ARENA_VERTICES, min_size);
+	glGenBuffers( 1, &arena->buffer );
+	glBindBuffer( GL_ARRAY_BUFFER, arena->buffer );
+	glBufferData( GL_ARRAY_BUFFER, (GLsizeiptr)arena->size * sizeof(VBufVertex), NULL, GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	memstat_add( MEMSTAT_VBUF, 1, (int64)arena->size * sizeof(VBufVertex) );
+
+	/* Entire buffer is free */
+	block = NEW(VBufBlock);
+	block->first = 0;
+	block->count = arena->size;
+	G_LIST_APPEND(arena->free_list, block);
+
+	G_LIST_APPEND(arena_list, arena);
+
+	return arena;
+}
+
+
+/* Allocates room for count vertices (first fit). Returns the buffer,
+ * and the position of the block in *first */
+static VBufArena *
+arena_alloc( int count, int *first )
+{
+	VBufArena *arena;
+	VBufBlock *block;
+	GList *arena_llink, *block_llink;
+
+	g_assert( count > 0 );
+
+	arena_llink = arena_list;
+	while (arena_llink != NULL) {
+		arena = (VBufArena *)arena_llink->data;
+		block_llink = arena->free_list;
+		while (block_llink != NULL) {
+			block = (VBufBlock *)block_llink->data;
+			if (block->count >= count) {
+				*first = block->first;
+				block->first += count;
+				block->count -= count;
+				if (block->count == 0) {
+					G_LIST_REMOVE(arena->free_list, block);
+					xfree( block );
+				}
+				return arena;
+			}
+			block_llink = block_llink->next;
+		}
+		arena_llink = arena_llink->next;
+	}
+
+	/* No room anywhere, so start a new buffer */
+	arena = arena_new( count );
+
+	return arena_alloc( count, first );
+}
+
+
+/* Returns a block of vertices to its buffer's free list, coalescing it
+ * with its neighbors */
+static void
+arena_free( VBufArena *arena, int first, int count )
+{
+	VBufBlock *block, *prev_block = NULL, *next_block;
+	GList *block_llink;
+
+	/* Find first free block that comes after this one */
+	block_llink = arena->free_list;
+	while (block_llink != NULL) {
+		next_block = (VBufBlock *)block_llink->data;
+		if (next_block->first > first)
+			break;
+		prev_block = next_block;
+		block_llink = block_llink->next;
+	}
+
+	if ((prev_block != NULL) && ((prev_block->first + prev_block->count) == first)) {
+		/* Extend preceding block */
+		prev_block->count += count;
+		block = prev_block;
+	}
+	else {
+		block = NEW(VBufBlock);
+		block->first = first;
+		block->count = count;
+		if (block_llink == NULL)
+			G_LIST_APPEND(arena->free_list, block);
+		else
+			G_LIST_INSERT_BEFORE(arena->free_list, block_llink, block);
+	}
+
+	if (block_llink != NULL) {
+		next_block = (VBufBlock *)block_llink->data;
+		if ((block->first + block->count) == next_block->first) {
+			/* Absorb following block */
+			block->count += next_block->count;
+			G_LIST_REMOVE(arena->free_list, next_block);
+			xfree( next_block );
+		}
+	}
+}
+
+
+/* Appends a vertex to a growable array */
+static void
+vertex_array_append( VBufVertexArray *array, const VBufVertex *vertex )
+{
+	if (array->num == array->alloc) {
+		array->alloc = MAX(256, 2 * array->alloc);
+		RESIZE(array->verts, array->alloc, VBufVertex);
+	}
+	array->verts[array->num++] = *vertex; /* struct assign */
+}
+
+
+/* Appends a draw command to a queue */
+static void
+draws_append( VBufDraws *draws, int first, int count )
+{
+	if (draws->num == draws->alloc) {
+		draws->alloc = MAX(64, 2 * draws->alloc);
+		RESIZE(draws->firsts, draws->alloc, GLint);
+		RESIZE(draws->counts, draws->alloc, GLsizei);
+	}
+	draws->firsts[draws->num] = first;
+	draws->counts[draws->num] = count;
+	++draws->num;
+}
+
+
+/**** Primitive assembly ****************/
+
+
+/* Emits one triangle of a recorded primitive. Attributes are taken from
+ * the provoking vertex (as GL_FLAT shading would have done), and the
+ * edge flags are those of the edges starting at a, b and c */
+static void
+emit_triangle( VBufState *st, const VBufVertex *a, const VBufVertex *b, const VBufVertex *c, const VBufVertex *provoking, boolean edge_a, boolean edge_b, boolean edge_c )
+{
+	VBufVertex v;
+	const VBufVertex *corners[3];
+	const boolean edges[3] = { edge_a, edge_b, edge_c };
+	int i;
+
+	corners[0] = a;
+	corners[1] = b;
+	corners[2] = c;
+	v = *provoking; /* struct assign */
+	for (i = 0; i < 3; i++) {
+		memcpy( v.pos, corners[i]->pos, sizeof(v.pos) );
+		memcpy( v.texcoord, corners[i]->texcoord, sizeof(v.texcoord) );
+		v.edge = edges[i] ? GL_TRUE : GL_FALSE;
+		vertex_array_append( &st->triangles, &v );
+	}
+}
+
+
+/* Emits one line segment of a recorded primitive */
+static void
+emit_line( VBufState *st, const VBufVertex *a, const VBufVertex *b )
+{
+	VBufVertex v;
+
+	/* Second vertex provokes */
+	v = *b; /* struct assign */
+	memcpy( v.pos, a->pos, sizeof(v.pos) );
+	memcpy( v.texcoord, a->texcoord, sizeof(v.texcoord) );
+	vertex_array_append( &st->lines, &v );
+	vertex_array_append( &st->lines, b );
+}
+
+
+/* Breaks down the primitive in st->prim_verts into independent triangles or
+ * lines. Quad diagonals (and the like) get a FALSE edge flag, so that the
+ * outline pass draws the same edges it would have before */
+static void
+prim_assemble( VBufState *st )
+{
+	const VBufVertex *v = st->prim_verts.verts;
+	int n = st->prim_verts.num;
+	int i;
+
+	switch (st->prim_mode) {
+		case GL_TRIANGLES:
+		for (i = 0; (i + 2) < n; i += 3)
+			emit_triangle( st, &v[i], &v[i + 1], &v[i + 2], &v[i + 2], v[i].edge, v[i + 1].edge, v[i + 2].edge );
+		break;
+
+		case GL_TRIANGLE_STRIP:
+		for (i = 0; (i + 2) < n; i++) {
+			/* Every other triangle has reversed winding */
+			if (i & 1)
+				emit_triangle( st, &v[i + 1], &v[i], &v[i + 2], &v[i + 2], TRUE, TRUE, TRUE );
+			else
+				emit_triangle( st, &v[i], &v[i + 1], &v[i + 2], &v[i + 2], TRUE, TRUE, TRUE );
+		}
+		break;
+
+		case GL_TRIANGLE_FAN:
+		for (i = 1; (i + 1) < n; i++)
+			emit_triangle( st, &v[0], &v[i], &v[i + 1], &v[i + 1], TRUE, TRUE, TRUE );
+		break;
+
+		case GL_QUADS:
+		for (i = 0; (i + 3) < n; i += 4) {
+			emit_triangle( st, &v[i], &v[i + 1], &v[i + 2], &v[i + 3], v[i].edge, v[i + 1].edge, FALSE );
+			emit_triangle( st, &v[i], &v[i + 2], &v[i + 3], &v[i + 3], FALSE, v[i + 2].edge, v[i + 3].edge );
+		}
+		break;
+
+		case GL_QUAD_STRIP:
+		for (i = 0; (i + 3) < n; i += 2) {
+			/* Quad is (i, i+1, i+3, i+2) */
+			emit_triangle( st, &v[i], &v[i + 1], &v[i + 3], &v[i + 3], TRUE, TRUE, FALSE );
+			emit_triangle( st, &v[i], &v[i + 3], &v[i + 2], &v[i + 3], FALSE, TRUE, TRUE );
+		}
+		break;
+
+		case GL_POLYGON:
+		/* First vertex provokes */
+		for (i = 1; (i + 1) < n; i++)
+			emit_triangle( st, &v[0], &v[i], &v[i + 1], &v[0], (i == 1) && v[0].edge, v[i].edge, ((i + 2) == n) && v[i + 1].edge );
+		break;
+
+		case GL_LINES:
+		for (i = 0; (i + 1) < n; i += 2)
+			emit_line( st, &v[i], &v[i + 1] );
+		break;
+
+		case GL_LINE_STRIP:
+		for (i = 0; (i + 1) < n; i++)
+			emit_line( st, &v[i], &v[i + 1] );
+		break;
+
+		case GL_LINE_LOOP:
+		for (i = 0; (i + 1) < n; i++)
+			emit_line( st, &v[i], &v[i + 1] );
+		if (n > 2)
+			emit_line( st, &v[n - 1], &v[0] );
+		break;
+
+		SWITCH_FAIL
+	}
+
+	st->prim_verts.num = 0;
+}
+
+
+/**** Core-profile drawing ****************/
+
+
+/* Sets up vertex attribute pointers into a buffer, for the plain
+ * program set in glsl.c (the vertex array object must be bound) */
+static void
+core_bind( GLuint buffer )
+{
+	glBindBuffer( GL_ARRAY_BUFFER, buffer );
+	glVertexAttribPointer( GLSL_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, pos) );
+	glVertexAttribPointer( GLSL_ATTRIB_NORMAL, 3, GL_BYTE, GL_TRUE, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, normal) );
+	glVertexAttribPointer( GLSL_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, color) );
+	glVertexAttribPointer( GLSL_ATTRIB_EDGE, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, edge) );
+	glVertexAttribPointer( GLSL_ATTRIB_TEXCOORD, 2, GL_SHORT, GL_TRUE, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, texcoord) );
+	glVertexAttribIPointer( OGL_PICK_ATTRIB, 2, GL_UNSIGNED_INT, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, pick) );
+}
+
+
+/* Binds the vertex array object, creating it if necessary */
+static void
+core_vao_bind( void )
+{
+	if (core_vao == 0) {
+		glGenVertexArrays( 1, &core_vao );
+		glBindVertexArray( core_vao );
+		glEnableVertexAttribArray( GLSL_ATTRIB_POSITION );
+		glEnableVertexAttribArray( GLSL_ATTRIB_NORMAL );
+		glEnableVertexAttribArray( GLSL_ATTRIB_COLOR );
+		glEnableVertexAttribArray( GLSL_ATTRIB_EDGE );
+		glEnableVertexAttribArray( GLSL_ATTRIB_TEXCOORD );
+		glEnableVertexAttribArray( OGL_PICK_ATTRIB );
+	}
+	else
+		glBindVertexArray( core_vao );
+}
+
+
+/* Draws the triangles and lines just assembled from a primitive (in
+ * st->triangles and st->lines, which are free outside of a recording).
+ * Vertices are in object space, under the current model transformation */
+static void
+stream_draw( VBufState *st )
+{
+	int tri_count = st->triangles.num;
+	int line_count = st->lines.num;
+	int size;
+
+	st->triangles.num = 0;
+	st->lines.num = 0;
+	if (glsl_picking( ))
+		line_count = 0;
+	if ((tri_count + line_count) == 0)
+		return;
+
+	core_vao_bind( );
+	if (stream_buffer == 0)
+		glGenBuffers( 1, &stream_buffer );
+	glBindBuffer( GL_ARRAY_BUFFER, stream_buffer );
+
+	/* Orphan the old contents, so as not to wait on draws using them */
+	size = MAX(stream_size, tri_count + line_count);
+	if (size > stream_size) {
+		memstat_add( MEMSTAT_VBUF, (stream_size == 0) ? 1 : 0, (int64)(size - stream_size) * sizeof(VBufVertex) );
+		stream_size = size;
+	}
+	glBufferData( GL_ARRAY_BUFFER, (GLsizeiptr)stream_size * sizeof(VBufVertex), NULL, GL_STREAM_DRAW );
+	if (tri_count > 0)
+		glBufferSubData( GL_ARRAY_BUFFER, 0, (GLsizeiptr)tri_count * sizeof(VBufVertex), st->triangles.verts );
+	if (line_count > 0)
+		glBufferSubData( GL_ARRAY_BUFFER, (GLintptr)tri_count * sizeof(VBufVertex), (GLsizeiptr)line_count * sizeof(VBufVertex), st->lines.verts );
+	core_bind( stream_buffer );
+
+	if (tri_count > 0) {
+		glsl_use( NULL, GL_TRIANGLES, xform_current( ) );
+		glDrawArrays( GL_TRIANGLES, 0, tri_count );
+		ogl_count_draws( 1, tri_count / 3 );
+	}
+	if (line_count > 0) {
+		glsl_use( NULL, GL_LINES, xform_current( ) );
+		glDrawArrays( GL_LINES, tri_count, line_count );
+		ogl_count_draws( 1, 0 );
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glBindVertexArray( 0 );
+}
+
+
+/* Draws everything queued since the last flush (see vbuf_flush( )) */
+static void
+core_flush( boolean picking )
+{
+	VBufArena *arena;
+	VBufDisplaced *displaced;
+	const VBufRange *range;
+	XformMatrix model;
+	GList *arena_llink;
+	int i;
+
+	core_vao_bind( );
+
+	/* Batched draws, a couple of calls per shared buffer */
+	arena_llink = arena_list;
+	while (arena_llink != NULL) {
+		arena = (VBufArena *)arena_llink->data;
+		if ((arena->triangles.num > 0) || (arena->lines.num > 0)) {
+			core_bind( arena->buffer );
+			if (arena->triangles.num > 0) {
+				glsl_use( NULL, GL_TRIANGLES, xform_current( ) );
+				glMultiDrawArrays( GL_TRIANGLES, arena->triangles.firsts, arena->triangles.counts, arena->triangles.num );
+				ogl_count_draws( 1, 0 );
+			}
+			if ((arena->lines.num > 0) && !picking) {
+				glsl_use( NULL, GL_LINES, xform_current( ) );
+				glMultiDrawArrays( GL_LINES, arena->lines.firsts, arena->lines.counts, arena->lines.num );
+				ogl_count_draws( 1, 0 );
+			}
+		}
+		arena->triangles.num = 0;
+		arena->lines.num = 0;
+		arena_llink = arena_llink->next;
+	}
+
+	/* Displaced ranges, each under its own correction matrix */
+	for (i = 0; i < displaced_num; i++) {
+		displaced = &displaced_queue[i];
+		range = displaced->range;
+		xform_mult( model, xform_current( ), displaced->delta );
+		core_bind( range->arena->buffer );
+		if (displaced->tri_count > 0) {
+			glsl_use( NULL, GL_TRIANGLES, model );
+			glDrawArrays( GL_TRIANGLES, displaced->tri_first, displaced->tri_count );
+			ogl_count_draws( 1, 0 );
+		}
+		if ((displaced->line_count > 0) && !picking) {
+			glsl_use( NULL, GL_LINES, model );
+			glDrawArrays( GL_LINES, range->first + range->tri_count, displaced->line_count );
+			ogl_count_draws( 1, 0 );
+		}
+	}
+	displaced_num = 0;
+
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glBindVertexArray( 0 );
+}
+
+
+/**** Geometry specification ****************/
+
+
+/* Returns TRUE if vbuf_*( ) calls go straight through to immediate-mode
+ * GL (legacy renderer, outside of a recording) */
+static boolean
+immediate_mode( const VBufState *st )
+{
+	return (st->rec_range == NULL) && !ogl_core_profile( );
+}
+
+
+/* Packs the current normal into st->vertex. Recorded normals are brought
+ * into world space, streamed ones are left in object space */
+static void
+normal_update( VBufState *st )
+{
+	double n[3], len;
+	float normal[3];
+	int i;
+
+	if (st->rec_range != NULL)
+		xform_apply_normal( st->rec_range->matrix, st->normal[0], st->normal[1], st->normal[2], normal );
+	else {
+		len = sqrt( SQR(st->normal[0]) + SQR(st->normal[1]) + SQR(st->normal[2]) );
+		for (i = 0; i < 3; i++)
+			normal[i] = (len > EPSILON) ? st->normal[i] / len : 0.0;
+	}
+	for (i = 0; i < 3; i++) {
+		n[i] = 127.0 * normal[i];
+		st->vertex.normal[i] = (GLbyte)(n[i] < 0.0 ? n[i] - 0.5 : n[i] + 0.5);
+	}
+	st->normal_valid = TRUE;
+}
+
+
+/* Returns the number of triangles that n vertices of the given type of
+ * primitive make up */
+static int
+prim_triangles( GLenum mode, int n )
+{
+	switch (mode) {
+		case GL_TRIANGLES:
+		return n / 3;
+
+		case GL_TRIANGLE_STRIP:
+		case GL_TRIANGLE_FAN:
+		case GL_POLYGON:
+		return MAX(0, n - 2);
+
+		case GL_QUADS:
+		return 2 * (n / 4);
+
+		case GL_QUAD_STRIP:
+		return 2 * MAX(0, (n - 2) / 2);
+
+		default:
+		/* Points and lines */
+		return 0;
+	}
+}
+
+
+/* cf. glBegin( ) */
+void
+vbuf_begin( unsigned int mode )
+{
+	VBufState *st = state_get( );
+
+	if (immediate_mode( st )) {
+		glBegin( mode );
+		st->prim_mode = mode;
+		st->imm_verts = 0;
+		return;
+	}
+
+	g_assert( st->prim_verts.num == 0 );
+	st->prim_mode = mode;
+}
+
+
+/* cf. glEnd( ) */
+void
+vbuf_end( void )
+{
+	VBufState *st = state_get( );
+
+	if (immediate_mode( st )) {
+		glEnd( );
+		ogl_count_draws( 1, prim_triangles( st->prim_mode, st->imm_verts ) );
+		return;
+	}
+
+	prim_assemble( st );
+	if (st->rec_range == NULL)
+		stream_draw( st );
+}
+
+
+/* cf. glVertex3d( ) */
+void
+vbuf_vertex3d( double x, double y, double z )
+{
+	VBufState *st = state_get( );
+
+	if (immediate_mode( st )) {
+		glVertex3d( x, y, z );
+		++st->imm_verts;
+		return;
+	}
+
+	if (!st->normal_valid)
+		normal_update( st );
+
+	if (st->rec_range != NULL)
+		xform_apply( st->rec_range->matrix, x, y, z, st->vertex.pos );
+	else {
+		st->vertex.pos[0] = x;
+		st->vertex.pos[1] = y;
+		st->vertex.pos[2] = z;
+	}
+	vertex_array_append( &st->prim_verts, &st->vertex );
+}
+
+
+/* cf. glVertex2d( ) */
+void
+vbuf_vertex2d( double x, double y )
+{
+	vbuf_vertex3d( x, y, 0.0 );
+}
+
+
+/* cf. glNormal3d( ) */
+void
+vbuf_normal3d( double x, double y, double z )
+{
+	VBufState *st = state_get( );
+
+	st->normal[0] = x;
+	st->normal[1] = y;
+	st->normal[2] = z;
+	st->normal_valid = FALSE;
+
+	if (immediate_mode( st ))
+		glNormal3d( x, y, z );
+}
+
+
+/* cf. glColor3fv( ) */
+void
+vbuf_color3fv( const float *color )
+{
+	VBufState *st = state_get( );
+	int i;
+
+	for (i = 0; i < 3; i++)
+		st->vertex.color[i] = (GLubyte)(255.0 * CLAMP(color[i], 0.0, 1.0) + 0.5);
+
+	if (immediate_mode( st ))
+		glColor3fv( color );
+}
+
+
+/* cf. glColor3f( ) */
+void
+vbuf_color3f( float r, float g, float b )
+{
+	float color[3];
+
+	color[0] = r;
+	color[1] = g;
+	color[2] = b;
+	vbuf_color3fv( color );
+}
+
+
+/* cf. glTexCoord2d( ). Coordinates are limited to [0, 1] */
+void
+vbuf_texcoord2d( double s, double t )
+{
+	VBufState *st = state_get( );
+
+	st->vertex.texcoord[0] = (GLshort)(VBUF_TEXCOORD_ONE * CLAMP(s, 0.0, 1.0) + 0.5);
+	st->vertex.texcoord[1] = (GLshort)(VBUF_TEXCOORD_ONE * CLAMP(t, 0.0, 1.0) + 0.5);
+
+	if (immediate_mode( st ))
+		glTexCoord2d( s, t );
+}
+
+
+/* Sets the node and face IDs that go with subsequent vertices, for
+ * color-buffer picking (see ogl_color_pick( )) */
+void
+vbuf_pick_id( unsigned int node_id, unsigned int face_id )
+{
+	VBufState *st = state_get( );
+
+	st->vertex.pick[0] = node_id;
+	st->vertex.pick[1] = face_id;
+
+	if (immediate_mode( st ))
+		glVertexAttribI2ui( OGL_PICK_ATTRIB, node_id, face_id );
+}
+
+
+/* cf. glEdgeFlag( ) */
+void
+vbuf_edge_flag( boolean flag )
+{
+	VBufState *st = state_get( );
+
+	st->vertex.edge = flag ? GL_TRUE : GL_FALSE;
+
+	if (immediate_mode( st ))
+		glEdgeFlag( flag ? GL_TRUE : GL_FALSE );
+}
+
+
+/**** Recording ****************/
+
+
+/* Helper function for vbuf_record_begin( ) and
+ * vbuf_record_begin_deferred( ) */
+static void
+record_begin( VBufRange **range, const double *matrix, boolean deferred )
+{
+	VBufState *st = state_get( );
+	VBufRange *r;
+
+	g_assert( st->rec_range == NULL );
+
+	if (*range == NULL) {
+		r = NEW(VBufRange);
+		memset( r, 0, sizeof(VBufRange) );
+		*range = r;
+	}
+	else
+		r = *range;
+
+	xform_copy( r->matrix, matrix );
+	r->invertible = xform_invert( r->inverse, r->matrix );
+	r->det = xform_det3( r->matrix );
+	r->deferred = deferred;
+
+	st->rec_range = r;
+	st->triangles.num = 0;
+	st->lines.num = 0;
+	st->prim_verts.num = 0;
+	st->normal_valid = FALSE;
+}
+
+
+/* Starts recording geometry into the given range (which is created if
+ * *range is NULL), replacing its previous contents. Vertices are stored
+ * under the current model transformation (see xform.c) */
+void
+vbuf_record_begin( VBufRange **range )
+{
+	record_begin( range, xform_current( ), FALSE );
+}
+
+
+/* Starts recording geometry into a new range (*range must be NULL),
+ * under the given model transformation. This makes no GL calls, and so
+ * may be done in a worker thread; the vertices are kept aside until the
+ * GL thread takes the range in with vbuf_range_adopt( ) */
+void
+vbuf_record_begin_deferred( VBufRange **range, const double *matrix )
+{
+	g_assert( *range == NULL );
+
+	record_begin( range, matrix, TRUE );
+}
+
+
+/* Stores vertices into a range's block of a shared buffer, (re)allocating
+ * it if need be */
+static void
+range_upload( VBufRange *r, const VBufVertex *tri_verts, int tri_count, const VBufVertex *line_verts, int line_count )
+{
+	int count;
+
+	count = tri_count + line_count;
+	if ((r->arena != NULL) && (count > r->size)) {
+		/* Outgrew its old block */
+		arena_free( r->arena, r->first, r->size );
+		r->arena = NULL;
+	}
+	if ((r->arena == NULL) && (count > 0)) {
+		r->size = count + (count >> VBUF_SLACK_SHIFT);
+		r->arena = arena_alloc( r->size, &r->first );
+	}
+
+	r->tri_count = tri_count;
+	r->line_count = line_count;
+	if (count > 0) {
+		glBindBuffer( GL_ARRAY_BUFFER, r->arena->buffer );
+		if (tri_count > 0)
+			glBufferSubData( GL_ARRAY_BUFFER, (GLintptr)r->first * sizeof(VBufVertex), (GLsizeiptr)tri_count * sizeof(VBufVertex), tri_verts );
+		if (line_count > 0)
+			glBufferSubData( GL_ARRAY_BUFFER, (GLintptr)(r->first + tri_count) * sizeof(VBufVertex), (GLsizeiptr)line_count * sizeof(VBufVertex), line_verts );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	}
+}
+
+
+/* Finishes recording, and uploads the geometry (or for a deferred
+ * recording, sets it aside) */
+void
+vbuf_record_end( void )
+{
+	VBufState *st = state_get( );
+	VBufRange *r = st->rec_range;
+
+	g_assert( r != NULL );
+
+	if (r->deferred) {
+		r->tri_count = st->triangles.num;
+		r->line_count = st->lines.num;
+		r->pending = NEW_ARRAY(VBufVertex, MAX(1, r->tri_count + r->line_count));
+		memcpy( r->pending, st->triangles.verts, r->tri_count * sizeof(VBufVertex) );
+		memcpy( r->pending + r->tri_count, st->lines.verts, r->line_count * sizeof(VBufVertex) );
+		memstat_add( MEMSTAT_VBUF, 0, (int64)MAX(1, r->tri_count + r->line_count) * sizeof(VBufVertex) );
+	}
+	else
+		range_upload( r, st->triangles.verts, st->triangles.num, st->lines.verts, st->lines.num );
+
+	st->rec_range = NULL;
+	st->normal_valid = FALSE;
+}
+
+
+/* Replaces the contents of *dest with those of a finished deferred
+ * recording, uploading them (into the block *dest already has, if they
+ * fit), and frees the latter. *dest is created if it is NULL */
+void
+vbuf_range_adopt( VBufRange **dest, VBufRange **src )
+{
+	VBufRange *d, *s = *src;
+
+	g_assert( (s != NULL) && s->deferred );
+
+	if (*dest == NULL) {
+		d = NEW(VBufRange);
+		memset( d, 0, sizeof(VBufRange) );
+		*dest = d;
+	}
+	else
+		d = *dest;
+
+	xform_copy( d->matrix, s->matrix );
+	xform_copy( d->inverse, s->inverse );
+	d->det = s->det;
+	d->invertible = s->invertible;
+	range_upload( d, s->pending, s->tri_count, s->pending + s->tri_count, s->line_count );
+
+	vbuf_range_free( src );
+}
+
+
+/* Returns the model transformation of the recording in progress */
+const double *
+vbuf_record_matrix( void )
+{
+	VBufState *st = state_get( );
+
+	g_assert( st->rec_range != NULL );
+
+	return st->rec_range->matrix;
+}
+
+
+/* Returns TRUE if a range can be drawn as is under the current model
+ * transformation. That is always the case if the transformation hasn't
+ * changed since the range was recorded. If allow_displaced is TRUE, a
+ * range can also be drawn by applying the change in transformation,
+ * provided this does not magnify it (which would also magnify the
+ * rounding error in its stored vertices) */
+boolean
+vbuf_range_usable( const VBufRange *range, boolean allow_displaced )
+{
+	if (range == NULL)
+		return FALSE;
+	if (xform_is_current( range->matrix ))
+		return TRUE;
+	if (!allow_displaced || !range->invertible)
+		return FALSE;
+
+	return fabs( xform_det3( xform_current( ) ) ) <= (fabs( range->det ) * (1.0 + EPSILON));
+}
+
+
+/* Returns the number of triangle vertices recorded so far. Together
+ * with vbuf_queue_triangles( ), this allows drawing selected parts of
+ * a range */
+int
+vbuf_record_position( void )
+{
+	VBufState *st = state_get( );
+
+	g_assert( st->rec_range != NULL );
+
+	return st->triangles.num;
+}
+
+
+/* Helper function for vbuf_queue( ) and vbuf_queue_triangles( ).
+ * tri_first is relative to the start of the range */
+static void
+queue_draws( const VBufRange *range, int tri_first, int tri_count, int line_count )
+{
+	VBufDisplaced *displaced;
+
+	if ((range == NULL) || (range->arena == NULL))
+		return;
+	if ((tri_count + line_count) == 0)
+		return;
+
+	/* (Draw calls are counted as they are made, in vbuf_flush( )) */
+	ogl_count_draws( 0, tri_count / 3 );
+
+	if (xform_is_current( range->matrix )) {
+		if (tri_count > 0)
+			draws_append( &range->arena->triangles, range->first + tri_first, tri_count );
+		if (line_count > 0)
+			draws_append( &range->arena->lines, range->first + range->tri_count, line_count );
+		return;
+	}
+
+	g_assert( range->invertible );
+	if (displaced_num == displaced_alloc) {
+		displaced_alloc = MAX(16, 2 * displaced_alloc);
+		RESIZE(displaced_queue, displaced_alloc, VBufDisplaced);
+	}
+	displaced = &displaced_queue[displaced_num++];
+	displaced->range = range;
+	xform_mult( displaced->delta, xform_current( ), range->inverse );
+	displaced->tri_first = range->first + tri_first;
+	displaced->tri_count = tri_count;
+	displaced->line_count = line_count;
+}
+
+
+/* Queues a range to be drawn at the next vbuf_flush( ) */
+void
+vbuf_queue( const VBufRange *range )
+{
+	if (range == NULL)
+		return;
+
+	queue_draws( range, 0, range->tri_count, range->line_count );
+}
+
+
+/* Queues count triangle vertices of a range, starting with the first'th
+ * (as given by vbuf_record_position( ) while the range was recorded),
+ * to be drawn at the next vbuf_flush( ) */
+void
+vbuf_queue_triangles( const VBufRange *range, int first, int count )
+{
+	if (range == NULL)
+		return;
+
+	g_assert( (first >= 0) && ((first + count) <= range->tri_count) );
+	queue_draws( range, first, count, 0 );
+}
+
+
+/**** Drawing ****************/
+
+
+/* Sets up vertex array pointers into a shared buffer */
+static void
+arena_bind( const VBufArena *arena, boolean picking )
+{
+	glBindBuffer( GL_ARRAY_BUFFER, arena->buffer );
+	glVertexPointer( 3, GL_FLOAT, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, pos) );
+	if (picking)
+		glVertexAttribIPointer( OGL_PICK_ATTRIB, 2, GL_UNSIGNED_INT, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, pick) );
+	else {
+		glNormalPointer( GL_BYTE, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, normal) );
+		glColorPointer( 4, GL_UNSIGNED_BYTE, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, color) );
+		glEdgeFlagPointer( sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, edge) );
+		glTexCoordPointer( 2, GL_SHORT, sizeof(VBufVertex), (void *)G_STRUCT_OFFSET(VBufVertex, texcoord) );
+	}
+}
+
+
+/* Draws everything queued since the last flush. In picking mode, only
+ * triangles are drawn, and the pick attribute takes the place of normals
+ * and colors (with the legacy renderer, the pick shader program must be
+ * in use) */
+void
+vbuf_flush( boolean picking )
+{
+	VBufArena *arena;
+	VBufDisplaced *displaced;
+	const VBufRange *range;
+	GList *arena_llink;
+	VBufState *st = state_get( );
+	int i;
+
+	g_assert( st->rec_range == NULL );
+
+	if (ogl_core_profile( )) {
+		core_flush( picking );
+		return;
+	}
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	if (picking)
+		glEnableVertexAttribArray( OGL_PICK_ATTRIB );
+	else {
+		glEnableClientState( GL_NORMAL_ARRAY );
+		glEnableClientState( GL_COLOR_ARRAY );
+		glEnableClientState( GL_EDGE_FLAG_ARRAY );
+		glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+		/* Texture coordinate arrays can't be normalized, so the
+		 * texture matrix has to take care of that */
+		glMatrixMode( GL_TEXTURE );
+		glLoadIdentity( );
+		glScaled( 1.0 / VBUF_TEXCOORD_ONE, 1.0 / VBUF_TEXCOORD_ONE, 1.0 );
+		glMatrixMode( GL_MODELVIEW );
+	}
+
+	/* Batched draws, a couple of calls per shared buffer */
+	arena_llink = arena_list;
+	while (arena_llink != NULL) {
+		arena = (VBufArena *)arena_llink->data;
+		if ((arena->triangles.num > 0) || (arena->lines.num > 0)) {
+			arena_bind( arena, picking );
+			if (arena->triangles.num > 0) {
+				glMultiDrawArrays( GL_TRIANGLES, arena->triangles.firsts, arena->triangles.counts, arena->triangles.num );
+				ogl_count_draws( 1, 0 );
+			}
+			if ((arena->lines.num > 0) && !picking) {
+				glMultiDrawArrays( GL_LINES, arena->lines.firsts, arena->lines.counts, arena->lines.num );
+				ogl_count_draws( 1, 0 );
+			}
+		}
+		arena->triangles.num = 0;
+		arena->lines.num = 0;
+		arena_llink = arena_llink->next;
+	}
+
+	/* Displaced ranges, each under its own correction matrix */
+	if (!picking && (displaced_num > 0))
+		glEnable( GL_NORMALIZE );
+	for (i = 0; i < displaced_num; i++) {
+		displaced = &displaced_queue[i];
+		range = displaced->range;
+		arena_bind( range->arena, picking );
+		glPushMatrix( );
+		glMultMatrixd( displaced->delta );
+		if (displaced->tri_count > 0) {
+			glDrawArrays( GL_TRIANGLES, displaced->tri_first, displaced->tri_count );
+			ogl_count_draws( 1, 0 );
+		}
+		if ((displaced->line_count > 0) && !picking) {
+			glDrawArrays( GL_LINES, range->first + range->tri_count, displaced->line_count );
+			ogl_count_draws( 1, 0 );
+		}
+		glPopMatrix( );
+	}
+	if (!picking && (displaced_num > 0))
+		glDisable( GL_NORMALIZE );
+	displaced_num = 0;
+
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glDisableClientState( GL_VERTEX_ARRAY );
+	if (picking)
+		glDisableVertexAttribArray( OGL_PICK_ATTRIB );
+	else {
+		glDisableClientState( GL_NORMAL_ARRAY );
+		glDisableClientState( GL_COLOR_ARRAY );
+		glDisableClientState( GL_EDGE_FLAG_ARRAY );
+		glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+		glMatrixMode( GL_TEXTURE );
+		glLoadIdentity( );
+		glMatrixMode( GL_MODELVIEW );
+
+		/* Array drawing leaves current normal/color undefined */
+		glNormal3d( st->normal[0], st->normal[1], st->normal[2] );
+		glColor4ubv( st->vertex.color );
+	}
+}
+
+
+/* Releases a range, returning its vertices to the shared pool */
+void
+vbuf_range_free( VBufRange **range )
+{
+	VBufRange *r = *range;
+
+	if (r == NULL)
+		return;
+
+	g_assert( r != state_get( )->rec_range );
+
+	if (r->arena != NULL)
+		arena_free( r->arena, r->first, r->size );
+	if (r->pending != NULL) {
+		memstat_add( MEMSTAT_VBUF, 0, - (int64)MAX(1, r->tri_count + r->line_count) * sizeof(VBufVertex) );
+		xfree( r->pending );
+	}
+	xfree( r );
+	*range = NULL;
+}
+
+
+/* end vbuf.c */
@@ -0,0 +1,59 @@
+/* vbuf.h */
+
+/* Buffered geometry (vertex buffer objects) */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifdef FSV_VBUF_H
+	#error
+#endif
+#define FSV_VBUF_H
+
+
+/* A directory's worth of recorded geometry, living in a shared
+ * vertex buffer (contents are private to vbuf.c) */
+typedef struct _VBufRange VBufRange;
+
+
+void vbuf_begin( unsigned int mode );
+void vbuf_end( void );
+void vbuf_vertex2d( double x, double y );
+void vbuf_vertex3d( double x, double y, double z );
+void vbuf_normal3d( double x, double y, double z );
+void vbuf_color3f( float r, float g, float b );
+void vbuf_color3fv( const float *color );
+void vbuf_texcoord2d( double s, double t );
+void vbuf_pick_id( unsigned int node_id, unsigned int face_id );
+void vbuf_edge_flag( boolean flag );
+void vbuf_record_begin( VBufRange **range );
+void vbuf_record_begin_deferred( VBufRange **range, const double *matrix );
+void vbuf_record_end( void );
+void vbuf_range_adopt( VBufRange **dest, VBufRange **src );
+const double *vbuf_record_matrix( void );
+int vbuf_record_position( void );
+boolean vbuf_range_usable( const VBufRange *range, boolean allow_displaced );
+void vbuf_queue( const VBufRange *range );
+void vbuf_queue_triangles( const VBufRange *range, int first, int count );
+void vbuf_flush( boolean picking );
+void vbuf_range_free( VBufRange **range );
+
+
+/* end vbuf.h */
@@ -65,6 +65,9 @@ static int btn1_press_x = 0, btn1_press_y = 0;
 #define PICK_MIN_INTERVAL (1.0 / 60.0)
 static double last_pick_time = 0.0;
 
+/* TRUE while a hover pick result is wanted */
+static boolean hover_pick_pending = FALSE;
+
 /* Keyboard pan state: TRUE while the key is physically held */
 static boolean pan_key_left = FALSE;
 static boolean pan_key_right = FALSE;
@@ -89,8 +92,8 @@ viewport_pass_node_table( GNode **new_node_table, unsigned int table_size )
 /* This returns the node (if any) that is visible at viewport location
  * (x,y) (where (0,0) indicates the upper-left corner). The ID number of
  * the particular face being pointed at is stored in face_id.
- * Uses color-buffer picking: renders scene with node IDs as colors,
- * reads back the pixel to determine the node. */
+ * Casts a ray into the layout, or failing that, renders the scene with
+ * node IDs as colors and reads back the pixel (see ogl_color_pick( )) */
 static GNode *
 node_at_location( int x, int y, unsigned int *face_id )
 {
@@ -104,6 +107,35 @@ node_at_location( int x, int y, unsigned int *face_id )
 }
 
 
+/* Takes the result of a hover pick (see ogl_color_pick_async( )) */
+static void
+hover_pick_done( unsigned int node_id, unsigned int face_id )
+{
+	/* Drop the result if the pointer has since left, or a button
+	 * press or camera move has taken over */
+	if (!hover_pick_pending)
+		return;
+	hover_pick_pending = FALSE;
+	if (btn1_pressed || camera_moving( ))
+		return;
+
+	indicated_node = NULL;
+	if (node_id != 0 && node_id < node_table_size)
+		indicated_node = node_table[node_id];
+	if (indicated_node == NULL) {
+		geometry_highlight_node( NULL, FALSE );
+		window_statusbar( SB_RIGHT, "" );
+	}
+	else {
+		if (geometry_should_highlight( indicated_node, face_id ))
+			geometry_highlight_node( indicated_node, FALSE );
+		else
+			geometry_highlight_node( NULL, FALSE );
+		window_statusbar( SB_RIGHT, node_absname( indicated_node ) );
+	}
+}
+
+
 /* Per-frame keyboard pan callback. Runs as a GLib idle while any
  * pan key is held, giving smooth frame-rate-coupled movement.
  * Movement is scaled by elapsed time for consistent speed. */
@@ -191,6 +223,7 @@ viewport_cb( GtkWidget *gl_area_w, GdkEvent *event )
 	/* Mouse-related events */
 	switch (event->type) {
 		case GDK_BUTTON_PRESS:
+		hover_pick_pending = FALSE;
 		/* Grab focus so the GL area receives key events */
 		if (!gtk_widget_has_focus( gl_area_w ))
 			gtk_widget_grab_focus( gl_area_w );
@@ -302,18 +335,8 @@ viewport_cb( GtkWidget *gl_area_w, GdkEvent *event )
 				double t_now = xgettime( );
 				if (t_now - last_pick_time >= PICK_MIN_INTERVAL) {
 					last_pick_time = t_now;
-					indicated_node = node_at_location( x, y, &face_id );
-					if (indicated_node == NULL) {
-						geometry_highlight_node( NULL, FALSE );
-						window_statusbar( SB_RIGHT, "" );
-					}
-					else {
-						if (geometry_should_highlight( indicated_node, face_id ))
-							geometry_highlight_node( indicated_node, FALSE );
-						else
-							geometry_highlight_node( NULL, FALSE );
-						window_statusbar( SB_RIGHT, node_absname( indicated_node ) );
-					}
+					hover_pick_pending = TRUE;
+					ogl_color_pick_async( x, y, hover_pick_done );
 				}
 			}
 			prev_x = x;
@@ -340,6 +363,7 @@ viewport_cb( GtkWidget *gl_area_w, GdkEvent *event )
 
 		case GDK_LEAVE_NOTIFY:
 		/* The mouse has left the viewport */
+		hover_pick_pending = FALSE;
 		geometry_highlight_node( NULL, FALSE );
 		window_statusbar( SB_RIGHT, "" );
 		gui_cursor( gl_area_w, NULL );
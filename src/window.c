@@ -141,6 +141,9 @@ window_init( FsvMode fsv_mode )
 	gui_radio_menu_item_add( menu_w, _("DiscV"), G_CALLBACK(on_vis_discv_activate), NULL );
 	gui_radio_menu_item_add( menu_w, _("MapV"), G_CALLBACK(on_vis_mapv_activate), NULL );
 	gui_radio_menu_item_add( menu_w, _("TreeV"), G_CALLBACK(on_vis_treev_activate), NULL );
+	gui_separator_add( menu_w );
+	menu_item_w = gui_menu_item_add( menu_w, _("Frame timing"), G_CALLBACK(on_vis_frame_timing_activate), NULL );
+	gui_keybind( menu_item_w, _("^T") );
 
 	/* Color menu */
 	menu_w = gui_menu_add( menu_bar_w, _("Colors") );
@@ -180,6 +183,7 @@ window_init( FsvMode fsv_mode )
 		}
 	}
 	/* Help menu items */
+	gui_menu_item_add( menu_w, _("Statistics..."), G_CALLBACK(on_help_statistics_activate), NULL );
 	gui_menu_item_add( menu_w, _("About"), G_CALLBACK(on_help_about_fsv_activate), NULL );
 
 	/* Done with the menu bar */
@@ -0,0 +1,436 @@
+/* xform.c */
+
+/* Transformation matrix stack */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "common.h"
+#include "xform.h"
+
+#include <epoxy/gl.h>
+
+#include "ogl.h" /* ogl_core_profile( ) */
+
+
+/* Geometry is laid out with the usual push/translate/rotate/pop
+ * sequences, but vertex buffers need to know where things end up in
+ * world space. This keeps a CPU-side copy of the model transformation
+ * (everything below the camera's view matrix), along with the view and
+ * projection matrices. With the legacy renderer, each operation is
+ * mirrored onto the GL matrix stacks as it goes; the core-profile
+ * renderer hands the matrices to its shaders instead (see glsl.c) */
+
+/* Maximum nesting depth (the filesystem tree is rarely this deep, and
+ * the GL stack itself only guarantees 32) */
+#define XFORM_STACK_DEPTH 256
+
+static XformMatrix xform_stack[XFORM_STACK_DEPTH];
+static int xform_top = 0;
+
+/* Camera's view matrix, and the projection matrix */
+static XformMatrix view_matrix = {
+	1.0, 0.0, 0.0, 0.0,
+	0.0, 1.0, 0.0, 0.0,
+	0.0, 0.0, 1.0, 0.0,
+	0.0, 0.0, 0.0, 1.0
+};
+static XformMatrix projection_matrix = {
+	1.0, 0.0, 0.0, 0.0,
+	0.0, 1.0, 0.0, 0.0,
+	0.0, 0.0, 1.0, 0.0,
+	0.0, 0.0, 0.0, 1.0
+};
+
+static const XformMatrix identity_matrix = {
+	1.0, 0.0, 0.0, 0.0,
+	0.0, 1.0, 0.0, 0.0,
+	0.0, 0.0, 1.0, 0.0,
+	0.0, 0.0, 0.0, 1.0
+};
+
+
+/* m = identity */
+void
+xform_identity( XformMatrix m )
+{
+	xform_copy( m, identity_matrix );
+}
+
+
+/* Multiplies m by n (on the right) */
+static void
+matrix_mult_right( XformMatrix m, const XformMatrix n )
+{
+	XformMatrix result;
+
+	xform_mult( result, m, n );
+	xform_copy( m, result );
+}
+
+
+/* Applies a translation to m (cf. glTranslated( )) */
+void
+xform_matrix_translate( XformMatrix m, double x, double y, double z )
+{
+	XformMatrix t;
+
+	xform_copy( t, identity_matrix );
+	t[12] = x;
+	t[13] = y;
+	t[14] = z;
+	matrix_mult_right( m, t );
+}
+
+
+/* Applies a rotation to m (cf. glRotated( )). Angle is in degrees */
+void
+xform_matrix_rotate( XformMatrix m, double angle, double x, double y, double z )
+{
+	XformMatrix r;
+	double len, s, c, k;
+
+	len = sqrt( SQR(x) + SQR(y) + SQR(z) );
+	if (len < EPSILON)
+		return;
+	x /= len;
+	y /= len;
+	z /= len;
+	s = sin( RAD(angle) );
+	c = cos( RAD(angle) );
+	k = 1.0 - c;
+
+	r[0] = x * x * k + c;
+	r[1] = y * x * k + z * s;
+	r[2] = x * z * k - y * s;
+	r[3] = 0.0;
+	r[4] = x * y * k - z * s;
+	r[5] = y * y * k + c;
+	r[6] = y * z * k + x * s;
+	r[7] = 0.0;
+	r[8] = x * z * k + y * s;
+	r[9] = y * z * k - x * s;
+	r[10] = z * z * k + c;
+	r[11] = 0.0;
+	r[12] = 0.0;
+	r[13] = 0.0;
+	r[14] = 0.0;
+	r[15] = 1.0;
+	matrix_mult_right( m, r );
+}
+
+
+/* Applies a scale to m (cf. glScaled( )) */
+void
+xform_matrix_scale( XformMatrix m, double x, double y, double z )
+{
+	XformMatrix s;
+
+	xform_copy( s, identity_matrix );
+	s[0] = x;
+	s[5] = y;
+	s[10] = z;
+	matrix_mult_right( m, s );
+}
+
+
+/* m = perspective projection (cf. glFrustum( ) on an identity matrix) */
+void
+xform_matrix_frustum( XformMatrix m, double left, double right, double bottom, double top, double near_z, double far_z )
+{
+	memset( m, 0, sizeof(XformMatrix) );
+	m[0] = 2.0 * near_z / (right - left);
+	m[5] = 2.0 * near_z / (top - bottom);
+	m[8] = (right + left) / (right - left);
+	m[9] = (top + bottom) / (top - bottom);
+	m[10] = - (far_z + near_z) / (far_z - near_z);
+	m[11] = -1.0;
+	m[14] = -2.0 * far_z * near_z / (far_z - near_z);
+}
+
+
+/* m = parallel projection (cf. glOrtho( ) on an identity matrix) */
+void
+xform_matrix_ortho( XformMatrix m, double left, double right, double bottom, double top, double near_z, double far_z )
+{
+	memset( m, 0, sizeof(XformMatrix) );
+	m[0] = 2.0 / (right - left);
+	m[5] = 2.0 / (top - bottom);
+	m[10] = -2.0 / (far_z - near_z);
+	m[12] = - (right + left) / (right - left);
+	m[13] = - (top + bottom) / (top - bottom);
+	m[14] = - (far_z + near_z) / (far_z - near_z);
+	m[15] = 1.0;
+}
+
+
+/* Sets the projection matrix */
+void
+xform_set_projection( const XformMatrix m )
+{
+	xform_copy( projection_matrix, m );
+
+	if (!ogl_core_profile( )) {
+		glMatrixMode( GL_PROJECTION );
+		glLoadMatrixd( m );
+		glMatrixMode( GL_MODELVIEW );
+	}
+}
+
+
+/* Returns the projection matrix */
+const double *
+xform_projection( void )
+{
+	return projection_matrix;
+}
+
+
+/* Sets the camera's view matrix. The model transformation is reset
+ * to identity */
+void
+xform_set_view( const XformMatrix m )
+{
+	xform_copy( view_matrix, m );
+	xform_load_identity( );
+}
+
+
+/* Returns the camera's view matrix */
+const double *
+xform_view( void )
+{
+	return view_matrix;
+}
+
+
+/* result = view matrix * current model transformation
+ * (i.e. what GL calls the modelview matrix) */
+void
+xform_modelview( XformMatrix result )
+{
+	xform_mult( result, view_matrix, xform_stack[xform_top] );
+}
+
+
+/* Resets the model transformation to identity, leaving just the view
+ * matrix in effect */
+void
+xform_load_identity( void )
+{
+	xform_top = 0;
+	xform_copy( xform_stack[0], identity_matrix );
+
+	if (!ogl_core_profile( ))
+		glLoadMatrixd( view_matrix );
+}
+
+
+/* Saves the current transformation (cf. glPushMatrix( )) */
+void
+xform_push( void )
+{
+	g_assert( xform_top < (XFORM_STACK_DEPTH - 1) );
+
+	xform_copy( xform_stack[xform_top + 1], xform_stack[xform_top] );
+	++xform_top;
+	if (!ogl_core_profile( ))
+		glPushMatrix( );
+}
+
+
+/* Restores the last saved transformation (cf. glPopMatrix( )) */
+void
+xform_pop( void )
+{
+	g_assert( xform_top > 0 );
+
+	--xform_top;
+	if (!ogl_core_profile( ))
+		glPopMatrix( );
+}
+
+
+/* cf. glTranslated( ) */
+void
+xform_translate( double x, double y, double z )
+{
+	xform_matrix_translate( xform_stack[xform_top], x, y, z );
+	if (!ogl_core_profile( ))
+		glTranslated( x, y, z );
+}
+
+
+/* cf. glRotated( ). Angle is in degrees */
+void
+xform_rotate( double angle, double x, double y, double z )
+{
+	xform_matrix_rotate( xform_stack[xform_top], angle, x, y, z );
+	if (!ogl_core_profile( ))
+		glRotated( angle, x, y, z );
+}
+
+
+/* cf. glMultMatrixd( ) */
+void
+xform_multiply( const XformMatrix m )
+{
+	matrix_mult_right( xform_stack[xform_top], m );
+	if (!ogl_core_profile( ))
+		glMultMatrixd( m );
+}
+
+
+/* cf. glScaled( ) */
+void
+xform_scale( double x, double y, double z )
+{
+	xform_matrix_scale( xform_stack[xform_top], x, y, z );
+	if (!ogl_core_profile( ))
+		glScaled( x, y, z );
+}
+
+
+/* Returns the current model transformation */
+const double *
+xform_current( void )
+{
+	return xform_stack[xform_top];
+}
+
+
+/* Returns TRUE if m is (numerically) the current model transformation */
+boolean
+xform_is_current( const XformMatrix m )
+{
+	const double *cur = xform_stack[xform_top];
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		if (fabs( cur[i] - m[i] ) > (EPSILON * MAX(1.0, fabs( m[i] ))))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/* dest = src */
+void
+xform_copy( XformMatrix dest, const XformMatrix src )
+{
+	memcpy( dest, src, sizeof(XformMatrix) );
+}
+
+
+/* result = a * b (result may not alias a or b) */
+void
+xform_mult( XformMatrix result, const XformMatrix a, const XformMatrix b )
+{
+	int i, j;
+
+	for (j = 0; j < 4; j++) {
+		for (i = 0; i < 4; i++) {
+			result[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1] +
+			                    a[8 + i] * b[j * 4 + 2] + a[12 + i] * b[j * 4 + 3];
+		}
+	}
+}
+
+
+/* result = inverse of m. Returns FALSE if m is singular (as happens
+ * with a zero scale factor), in which case result is left undefined */
+boolean
+xform_invert( XformMatrix result, const XformMatrix m )
+{
+	XformMatrix inv;
+	double det;
+	int i;
+
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = - m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = - m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = - m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = - m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = - m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = - m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = - m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = - m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (fabs( det ) < EPSILON)
+		return FALSE;
+
+	for (i = 0; i < 16; i++)
+		result[i] = inv[i] / det;
+
+	return TRUE;
+}
+
+
+/* Returns the determinant of the linear (upper-left 3x3) part of m,
+ * i.e. the factor by which m scales volumes */
+double
+xform_det3( const XformMatrix m )
+{
+	return m[0] * (m[5] * m[10] - m[9] * m[6]) -
+	       m[4] * (m[1] * m[10] - m[9] * m[2]) +
+	       m[8] * (m[1] * m[6] - m[5] * m[2]);
+}
+
+
+/* Transforms the point (x,y,z) by m, storing the result in out[0..2] */
+void
+xform_apply( const XformMatrix m, double x, double y, double z, float *out )
+{
+	out[0] = (float)(m[0] * x + m[4] * y + m[8] * z + m[12]);
+	out[1] = (float)(m[1] * x + m[5] * y + m[9] * z + m[13]);
+	out[2] = (float)(m[2] * x + m[6] * y + m[10] * z + m[14]);
+}
+
+
+/* Transforms the direction (x,y,z) by m, storing the renormalized result
+ * in out[0..2]. (The model transformations used here are rotations and
+ * near-uniform scales, so the inverse transpose is not needed) */
+void
+xform_apply_normal( const XformMatrix m, double x, double y, double z, float *out )
+{
+	double n[3], len;
+
+	n[0] = m[0] * x + m[4] * y + m[8] * z;
+	n[1] = m[1] * x + m[5] * y + m[9] * z;
+	n[2] = m[2] * x + m[6] * y + m[10] * z;
+	len = sqrt( SQR(n[0]) + SQR(n[1]) + SQR(n[2]) );
+	if (len < EPSILON)
+		len = 1.0;
+	out[0] = (float)(n[0] / len);
+	out[1] = (float)(n[1] / len);
+	out[2] = (float)(n[2] / len);
+}
+
+
+/* end xform.c */
@@ -0,0 +1,63 @@
+/* xform.h */
+
+/* Transformation matrix stack */
+
+/* fsv - 3D File System Visualizer
+ * Copyright (C)1999 Daniel Richard G. <skunk@mit.edu>
+ * Updates (c) 2026 sterlingphoenix <fsv@freakzilla.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifdef FSV_XFORM_H
+	#error
+#endif
+#define FSV_XFORM_H
+
+
+/* Column-major 4x4 matrix, as used by OpenGL */
+typedef double XformMatrix[16];
+
+
+void xform_identity( XformMatrix m );
+void xform_matrix_translate( XformMatrix m, double x, double y, double z );
+void xform_matrix_rotate( XformMatrix m, double angle, double x, double y, double z );
+void xform_matrix_scale( XformMatrix m, double x, double y, double z );
+void xform_matrix_frustum( XformMatrix m, double left, double right, double bottom, double top, double near_z, double far_z );
+void xform_matrix_ortho( XformMatrix m, double left, double right, double bottom, double top, double near_z, double far_z );
+void xform_set_projection( const XformMatrix m );
+const double *xform_projection( void );
+void xform_set_view( const XformMatrix m );
+const double *xform_view( void );
+void xform_modelview( XformMatrix result );
+void xform_load_identity( void );
+void xform_push( void );
+void xform_pop( void );
+void xform_translate( double x, double y, double z );
+void xform_rotate( double angle, double x, double y, double z );
+void xform_scale( double x, double y, double z );
+void xform_multiply( const XformMatrix m );
+const double *xform_current( void );
+boolean xform_is_current( const XformMatrix m );
+void xform_copy( XformMatrix dest, const XformMatrix src );
+void xform_mult( XformMatrix result, const XformMatrix a, const XformMatrix b );
+boolean xform_invert( XformMatrix result, const XformMatrix m );
+double xform_det3( const XformMatrix m );
+void xform_apply( const XformMatrix m, double x, double y, double z, float *out );
+void xform_apply_normal( const XformMatrix m, double x, double y, double z, float *out );
+
+
+/* end xform.h */